@@ -0,0 +1,157 @@
+# Linux desktop build against the system libraries. It builds bookr-core
+# and bookr-headless: the app running unmodified against a software vita2d
+# and an input script, able to dump every frame to PNG. Configure it from a
+# build directory whose name contains "headless", e.g.
+#   mkdir build-headless && cd build-headless && cmake .. && make
+#   ./bookr-headless --input script.txt --dump frames
+#
+# Needs the MuPDF, FreeType, libpng, libjpeg and tinyxml2 development
+# packages.
+
+find_package(PkgConfig)
+find_package(Freetype REQUIRED)
+find_package(PNG REQUIRED)
+find_package(JPEG REQUIRED)
+find_package(Threads REQUIRED)
+
+# Distributions ship MuPDF as libmupdf (with or without a separate
+# libmupdf-third); a pkg-config file is not always there.
+if(PKG_CONFIG_FOUND)
+  pkg_check_modules(MUPDF mupdf)
+endif()
+if(NOT MUPDF_FOUND)
+  find_path(MUPDF_INCLUDE_DIRS mupdf/fitz.h)
+  find_library(MUPDF_LIBRARY mupdf)
+  find_library(MUPDF_THIRD_LIBRARY mupdf-third)
+  if(NOT MUPDF_INCLUDE_DIRS OR NOT MUPDF_LIBRARY)
+    message(FATAL_ERROR "MuPDF not found, install the mupdf development package")
+  endif()
+  set(MUPDF_LIBRARIES ${MUPDF_LIBRARY})
+  if(MUPDF_THIRD_LIBRARY)
+    set(MUPDF_LIBRARIES ${MUPDF_LIBRARIES} ${MUPDF_THIRD_LIBRARY})
+  endif()
+endif()
+
+find_path(TINYXML2_INCLUDE_DIR tinyxml2.h)
+find_library(TINYXML2_LIBRARY tinyxml2)
+if(NOT TINYXML2_INCLUDE_DIR OR NOT TINYXML2_LIBRARY)
+  message(FATAL_ERROR "tinyxml2 not found, install the tinyxml2 development package")
+endif()
+
+include_directories(
+  ${CMAKE_BINARY_DIR}
+  # vita2d.h resolves to the software one
+  ${CMAKE_SOURCE_DIR}/src/graphics/headless
+  ${TINYXML2_INCLUDE_DIR}
+  ${FREETYPE_INCLUDE_DIRS}
+  ${PNG_INCLUDE_DIRS}
+  ${MUPDF_INCLUDE_DIRS}
+)
+link_directories(${MUPDF_LIBRARY_DIRS})
+
+## Optional viewers
+find_library(DJVULIBRE_LIBRARY djvulibre)
+IF(DJVULIBRE_LIBRARY)
+  add_definitions(-DBOOKR_DJVU)
+  set(VIEWER_SRCS ${VIEWER_SRCS} src/filetypes/bkdjvu.cpp)
+  set(VIEWER_LIBS ${VIEWER_LIBS} ${DJVULIBRE_LIBRARY})
+ENDIF()
+
+add_library(bookr-core STATIC
+  ${CORE_SRCS}
+  ${bk_resources}
+  data/fonts/res_txtfont.c
+  data/fonts/res_uifont.c
+
+  src/graphics/fzimagepng.cpp
+  src/graphics/fzfontvita.cpp
+  src/filetypes/bkmudocument.cpp
+  src/filetypes/bkmustrip.cpp
+  src/filetypes/bkmuspread.cpp
+  src/filetypes/bkmureflow.cpp
+  ${VIEWER_SRCS}
+)
+
+target_link_libraries(bookr-core
+  ${VIEWER_LIBS}
+  ${MUPDF_LIBRARIES}
+  ${FREETYPE_LIBRARIES}
+  ${PNG_LIBRARIES}
+  ${JPEG_LIBRARIES}
+  ${CMAKE_THREAD_LIBS_INIT}
+  ${TINYXML2_LIBRARY}
+  m
+)
+
+# The FZScreen backend is compiled into each executable that links
+# bookr-core, so the core never depends on a particular screen.
+set(HEADLESS_SCREEN_SRCS
+  src/graphics/fzscreenheadless.cpp
+  src/graphics/headless/vita2dsoft.cpp
+)
+
+add_executable(bookr-headless
+  ${APP_SRCS}
+  ${HEADLESS_SCREEN_SRCS}
+)
+
+target_link_libraries(bookr-headless
+  bookr-core
+)
+
+# Benchmarks on a generated corpus, see src/bench/bookrbench.cpp
+#   ./bookr-bench --generate --corpus corpus --out bench.json
+add_executable(bookr-bench
+  src/bench/bookrbench.cpp
+  src/bench/bkbench.cpp
+  src/bench/bkcorpus.cpp
+  src/bench/bkzipwriter.cpp
+  ${HEADLESS_SCREEN_SRCS}
+)
+
+target_link_libraries(bookr-bench
+  bookr-core
+)
+
+# Batch page rendering through BKMUDocument, see src/bench/bookrrender.cpp
+#   ./bookr-render --out pages book.pdf
+add_executable(bookr-render
+  src/bench/bookrrender.cpp
+  src/bench/bkbench.cpp
+  src/bench/bkzipwriter.cpp
+  ${HEADLESS_SCREEN_SRCS}
+)
+
+target_link_libraries(bookr-render
+  bookr-core
+)
+
+# Unit tests of the core, see src/tests/bktest.h
+#   ctest, or ./bookr-tests [group...]
+enable_testing()
+set(TEST_GROUPS
+  crops
+  library
+  pool
+  png
+  settings
+  tiling
+)
+add_executable(bookr-tests
+  src/tests/bookrtests.cpp
+  src/tests/bkmucropstest.cpp
+  src/tests/bklibrarytest.cpp
+  src/tests/bkusertest.cpp
+  src/tests/fzbufferpooltest.cpp
+  src/tests/fzimagepngtest.cpp
+  src/tests/fzimagetiletest.cpp
+  ${HEADLESS_SCREEN_SRCS}
+)
+
+target_link_libraries(bookr-tests
+  bookr-core
+)
+
+foreach(group ${TEST_GROUPS})
+  add_test(NAME ${group} COMMAND bookr-tests ${group})
+endforeach()
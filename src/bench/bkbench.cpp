@@ -0,0 +1,184 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <math.h>
+
+#include "bkbench.h"
+
+BKBench::BKBench() {
+}
+
+BKBench::Series* BKBench::find(const char* name, const string& file) {
+  for (size_t i = 0; i < series.size(); ++i) {
+    if (series[i].name == name && series[i].file == file)
+      return &series[i];
+  }
+  return NULL;
+}
+
+void BKBench::add(const char* name, const string& file, double value, const char* unit, double bytes) {
+  Series* s = find(name, file);
+  if (s == NULL) {
+    series.push_back(Series());
+    s = &series.back();
+    s->name = name;
+    s->file = file;
+    s->unit = unit;
+    s->bytes = bytes;
+  }
+  s->samples.push_back(value);
+}
+
+void BKBench::setMeta(const char* key, const string& value) {
+  for (size_t i = 0; i < meta.size(); ++i) {
+    if (meta[i].first == key) {
+      meta[i].second = value;
+      return;
+    }
+  }
+  meta.push_back(make_pair(string(key), value));
+}
+
+void BKBench::fail(const char* what) {
+  failures.push_back(what);
+}
+
+// linear interpolation between the two closest ranks
+static double percentile(const vector<double>& sorted, double p) {
+  if (sorted.size() == 1)
+    return sorted[0];
+  double rank = p / 100.0 * (sorted.size() - 1);
+  size_t lo = (size_t)floor(rank);
+  size_t hi = lo + 1 < sorted.size() ? lo + 1 : lo;
+  return sorted[lo] + (sorted[hi] - sorted[lo]) * (rank - lo);
+}
+
+void BKBench::summarize(const vector<double>& samples, Summary& s) {
+  s.count = samples.size();
+  s.min = s.median = s.mean = s.p90 = s.p95 = s.p99 = s.max = 0;
+  if (samples.empty())
+    return;
+  vector<double> sorted(samples);
+  sort(sorted.begin(), sorted.end());
+  double sum = 0;
+  for (size_t i = 0; i < sorted.size(); ++i)
+    sum += sorted[i];
+  s.min = sorted.front();
+  s.max = sorted.back();
+  s.mean = sum / sorted.size();
+  s.median = percentile(sorted, 50);
+  s.p90 = percentile(sorted, 90);
+  s.p95 = percentile(sorted, 95);
+  s.p99 = percentile(sorted, 99);
+}
+
+void BKBench::print(FILE* out) const {
+  for (size_t i = 0; i < series.size(); ++i) {
+    const Series& r = series[i];
+    Summary s;
+    summarize(r.samples, s);
+    fprintf(out, "%-22s %-24s n=%-4d median %10.3f p95 %10.3f max %10.3f %s",
+      r.name.c_str(), r.file.c_str(), s.count, s.median, s.p95, s.max, r.unit.c_str());
+    if (r.bytes > 0 && s.median > 0)
+      fprintf(out, "  %.1f MB/s", r.bytes / (1024.0 * 1024.0) / (s.median / 1000.0));
+    fprintf(out, "\n");
+  }
+  for (size_t i = 0; i < failures.size(); ++i)
+    fprintf(out, "FAILED: %s\n", failures[i].c_str());
+}
+
+static void writeString(FILE* f, const string& s) {
+  fputc('"', f);
+  for (size_t i = 0; i < s.size(); ++i) {
+    unsigned char c = s[i];
+    if (c == '"' || c == '\\')
+      fprintf(f, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(f, "\\u%04x", c);
+    else
+      fputc(c, f);
+  }
+  fputc('"', f);
+}
+
+/*
+{
+  "version": 1,
+  "ok": true,
+  "meta": { "git": "...", "date": "...", ... },
+  "failures": [],
+  "results": [
+    { "name": "open", "file": "text-1m.txt", "unit": "ms", "count": 10,
+      "min": 0, "median": 0, "mean": 0, "p90": 0, "p95": 0, "p99": 0,
+      "max": 0, "mb_per_s": 0, "samples": [ ... ] },
+    ...
+  ]
+}
+*/
+bool BKBench::writeJSON(const char* path) const {
+  FILE* f = fopen(path, "w");
+  if (f == NULL)
+    return false;
+
+  fprintf(f, "{\n  \"version\": 1,\n  \"ok\": %s,\n  \"meta\": {", ok() ? "true" : "false");
+  for (size_t i = 0; i < meta.size(); ++i) {
+    fprintf(f, "%s\n    ", i == 0 ? "" : ",");
+    writeString(f, meta[i].first);
+    fprintf(f, ": ");
+    writeString(f, meta[i].second);
+  }
+  fprintf(f, "\n  },\n  \"failures\": [");
+  for (size_t i = 0; i < failures.size(); ++i) {
+    fprintf(f, "%s", i == 0 ? "" : ", ");
+    writeString(f, failures[i]);
+  }
+  fprintf(f, "],\n  \"results\": [");
+  for (size_t i = 0; i < series.size(); ++i) {
+    const Series& r = series[i];
+    Summary s;
+    summarize(r.samples, s);
+    fprintf(f, "%s\n    { \"name\": ", i == 0 ? "" : ",");
+    writeString(f, r.name);
+    fprintf(f, ", \"file\": ");
+    writeString(f, r.file);
+    fprintf(f, ", \"unit\": ");
+    writeString(f, r.unit);
+    fprintf(f, ", \"count\": %d, \"min\": %.4f, \"median\": %.4f, \"mean\": %.4f, "
+      "\"p90\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f",
+      s.count, s.min, s.median, s.mean, s.p90, s.p95, s.p99, s.max);
+    if (r.bytes > 0 && s.median > 0)
+      fprintf(f, ", \"mb_per_s\": %.2f", r.bytes / (1024.0 * 1024.0) / (s.median / 1000.0));
+    fprintf(f, ", \"samples\": [");
+    for (size_t j = 0; j < r.samples.size(); ++j)
+      fprintf(f, "%s%.4f", j == 0 ? "" : ", ", r.samples[j]);
+    fprintf(f, "] }");
+  }
+  fprintf(f, "\n  ]\n}\n");
+  return fclose(f) == 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BKBENCH_H
+#define BKBENCH_H
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+using namespace std;
+
+/*! \brief Samples and summaries of one bookr-bench run.
+ *
+ *  Every measurement is a named series of samples, optionally tied to a
+ *  corpus file. The report keeps the raw samples and writes the median
+ *  and percentiles of each series as JSON, so two runs can be diffed or
+ *  plotted across commits.
+ */
+class BKBench {
+  public:
+  struct Series {
+    string name;
+    string file;
+    // "ms" for timings, anything else for counters
+    string unit;
+    // payload per sample, turns timings into MB/s; 0 if not a throughput
+    double bytes;
+    vector<double> samples;
+  };
+
+  struct Summary {
+    int count;
+    double min;
+    double median;
+    double mean;
+    double p90;
+    double p95;
+    double p99;
+    double max;
+  };
+
+  BKBench();
+
+  // a new sample of the series name for file ("" for none)
+  void add(const char* name, const string& file, double value, const char* unit = "ms", double bytes = 0);
+  // free-form key in the "meta" object, e.g. the corpus or a label
+  void setMeta(const char* key, const string& value);
+  // a failed check, reported as "ok": false in the JSON
+  void fail(const char* what);
+  bool ok() const { return failures.empty(); }
+
+  // series in insertion order
+  const vector<Series>& getSeries() const { return series; }
+  static void summarize(const vector<double>& samples, Summary& s);
+
+  // one line per series, for the console
+  void print(FILE* out) const;
+  // returns false if the file cannot be written
+  bool writeJSON(const char* path) const;
+
+  private:
+  vector<Series> series;
+  vector<pair<string, string> > meta;
+  vector<string> failures;
+  Series* find(const char* name, const string& file);
+};
+
+#endif
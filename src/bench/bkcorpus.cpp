@@ -0,0 +1,752 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <png.h>
+#include <jpeglib.h>
+
+#include "bkcorpus.h"
+#include "bkzipwriter.h"
+
+using namespace std;
+
+#define KB 1024
+#define MB (1024 * 1024)
+
+static const BKCorpus::File corpus[] = {
+  { "text-10k.txt",     BKCORPUS_TEXT,       10 * KB,  10 * KB },
+  { "text-100k.txt",    BKCORPUS_TEXT,      100 * KB, 100 * KB },
+  { "text-1m.txt",      BKCORPUS_TEXT,        1 * MB,   1 * MB },
+  { "text-10m.txt",     BKCORPUS_TEXT,       10 * MB,  10 * MB },
+  { "text-100m.txt",    BKCORPUS_TEXT,      100 * MB, 100 * MB },
+  { "html-100k.html",   BKCORPUS_HTML,      100 * KB, 100 * KB },
+  { "html-1m.html",     BKCORPUS_HTML,        1 * MB,   1 * MB },
+  { "html-10m.html",    BKCORPUS_HTML,       10 * MB,  10 * MB },
+  { "fb2-100k.fb2",     BKCORPUS_FB2,       100 * KB, 100 * KB },
+  { "fb2-1m.fb2",       BKCORPUS_FB2,         1 * MB,   1 * MB },
+  { "fb2-10m.fb2",      BKCORPUS_FB2,        10 * MB,  10 * MB },
+  { "epub-100k.epub",   BKCORPUS_EPUB,      100 * KB, 100 * KB },
+  { "epub-1m.epub",     BKCORPUS_EPUB,        1 * MB,   1 * MB },
+  { "epub-10m.epub",    BKCORPUS_EPUB,       10 * MB,  10 * MB },
+  { "palmdoc-1m.pdb",   BKCORPUS_PALMDOC,     1 * MB, 400 * KB },
+  { "palmdoc-10m.pdb",  BKCORPUS_PALMDOC,    10 * MB,   4 * MB },
+  { "vector-10p.pdf",   BKCORPUS_PDF_VECTOR,      10, 800 * KB },
+  { "vector-100p.pdf",  BKCORPUS_PDF_VECTOR,     100,   8 * MB },
+  { "scan-10p.pdf",     BKCORPUS_PDF_SCAN,        10,   5 * MB },
+  { "scan-100p.pdf",    BKCORPUS_PDF_SCAN,       100,  50 * MB },
+  { "comic-20p.cbz",    BKCORPUS_CBZ,             20,   2 * MB },
+  { "comic-200p.cbz",   BKCORPUS_CBZ,            200,  13 * MB },
+  { "scan-page.png",    BKCORPUS_PNG,              1, 1500 * KB },
+};
+
+const BKCorpus::File* BKCorpus::getFiles(int& n) {
+  n = sizeof(corpus) / sizeof(corpus[0]);
+  return corpus;
+}
+
+// xorshift32, seeded from the file name
+struct Rng {
+  uint32_t s;
+  Rng(const char* seed) {
+    s = 2166136261u;
+    for (const char* p = seed; *p; ++p)
+      s = (s ^ (unsigned char)*p) * 16777619u;
+    if (s == 0)
+      s = 1;
+  }
+  uint32_t next() {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+  }
+  // [0, n)
+  int below(int n) {
+    return next() % n;
+  }
+  // [a, b]
+  int range(int a, int b) {
+    return a + below(b - a + 1);
+  }
+};
+
+// ---------------------------------------------------------------------
+// prose
+
+static const char* words[] = {
+  "the", "of", "and", "a", "to", "in", "was", "he", "she", "it", "that",
+  "with", "for", "as", "his", "her", "on", "at", "by", "had", "from",
+  "they", "which", "but", "not", "were", "one", "all", "there", "been",
+  "river", "window", "letter", "morning", "garden", "silence", "station",
+  "evening", "captain", "lantern", "journey", "harbour", "mountain",
+  "quietly", "suddenly", "remembered", "answered", "travelled", "beneath",
+  "between", "against", "without", "through", "yesterday", "afterwards",
+  "northern", "familiar", "ordinary", "curious", "patient", "distant",
+  "whispered", "wandered", "listened"
+};
+#define N_WORDS (int)(sizeof(words) / sizeof(words[0]))
+
+static void sentence(Rng& r, string& out) {
+  int n = r.range(5, 18);
+  for (int i = 0; i < n; ++i) {
+    const char* w = words[r.below(N_WORDS)];
+    if (i == 0) {
+      out += (char)(w[0] - 'a' + 'A');
+      out += w + 1;
+    } else {
+      out += ' ';
+      out += w;
+    }
+    if (i < n - 1 && r.below(9) == 0)
+      out += ',';
+  }
+  out += r.below(7) == 0 ? "? " : ". ";
+}
+
+static void paragraph(Rng& r, string& out) {
+  int n = r.range(2, 8);
+  for (int i = 0; i < n; ++i)
+    sentence(r, out);
+  out.erase(out.size() - 1);
+}
+
+// endless prose, a new chapter every 40 paragraphs
+class Prose {
+  Rng r;
+  int paragraphs;
+  int chapter;
+
+  public:
+  Prose(const char* seed) : r(seed), paragraphs(0), chapter(0) { }
+  // true when a new chapter starts with the next paragraph
+  bool chapterBreak() {
+    return paragraphs % 40 == 0;
+  }
+  int nextChapter() {
+    return ++chapter;
+  }
+  void next(string& out) {
+    ++paragraphs;
+    paragraph(r, out);
+  }
+  Rng& rng() {
+    return r;
+  }
+};
+
+static bool flush(FILE* f, string& buf) {
+  if (!buf.empty() && fwrite(buf.data(), 1, buf.size(), f) != buf.size())
+    return false;
+  buf.clear();
+  return true;
+}
+
+static bool writeText(FILE* f, const char* seed, size_t size) {
+  Prose p(seed);
+  string buf;
+  size_t written = 0;
+  while (written < size) {
+    size_t before = buf.size();
+    if (p.chapterBreak()) {
+      char h[64];
+      snprintf(h, sizeof(h), "CHAPTER %d\n\n", p.nextChapter());
+      buf += h;
+    }
+    p.next(buf);
+    buf += "\n\n";
+    written += buf.size() - before;
+    if (buf.size() > 64 * KB && !flush(f, buf))
+      return false;
+  }
+  return flush(f, buf);
+}
+
+// some inline markup so the HTML parsers have work to do
+static void markup(Rng& r, string& para) {
+  size_t sp = para.find(' ', para.size() / 3);
+  if (sp == string::npos)
+    return;
+  size_t end = para.find(' ', sp + 1);
+  if (end == string::npos)
+    return;
+  const char* tag = r.below(2) ? "em" : "strong";
+  para.insert(end, string("</") + tag + ">");
+  para.insert(sp + 1, string("<") + tag + ">");
+}
+
+static bool writeHTMLBody(FILE* f, Prose& p, size_t size, const char* pOpen, const char* pClose,
+    const char* hOpen, const char* hClose) {
+  string buf, para;
+  size_t written = 0;
+  while (written < size) {
+    size_t before = buf.size();
+    if (p.chapterBreak()) {
+      char h[128];
+      snprintf(h, sizeof(h), "%sChapter %d%s\n", hOpen, p.nextChapter(), hClose);
+      buf += h;
+    }
+    para.clear();
+    p.next(para);
+    markup(p.rng(), para);
+    buf += pOpen;
+    buf += para;
+    buf += pClose;
+    written += buf.size() - before;
+    if (buf.size() > 64 * KB && !flush(f, buf))
+      return false;
+  }
+  return flush(f, buf);
+}
+
+static bool writeHTML(FILE* f, const char* seed, size_t size) {
+  Prose p(seed);
+  fprintf(f, "<!DOCTYPE html>\n<html>\n<head><meta charset=\"utf-8\"/><title>%s</title></head>\n<body>\n", seed);
+  if (!writeHTMLBody(f, p, size, "<p>", "</p>\n", "<h1>", "</h1>"))
+    return false;
+  fprintf(f, "</body>\n</html>\n");
+  return true;
+}
+
+static bool writeFB2(FILE* f, const char* seed, size_t size) {
+  Prose p(seed);
+  fprintf(f, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    "<FictionBook xmlns=\"http://www.gribuser.ru/xml/fictionbook/2.0\">\n"
+    "<description><title-info><genre>prose</genre><author><first-name>Bookr</first-name>"
+    "<last-name>Bench</last-name></author><book-title>%s</book-title><lang>en</lang>"
+    "</title-info></description>\n<body>\n<section>\n", seed);
+  if (!writeHTMLBody(f, p, size, "<p>", "</p>\n", "</section>\n<section><title><p>", "</p></title>"))
+    return false;
+  fprintf(f, "</section>\n</body>\n</FictionBook>\n");
+  return true;
+}
+
+static bool writeEPUB(FILE* f, const char* seed, size_t size) {
+  BKZipWriter zip(f);
+  // the mimetype entry must come first and be stored
+  zip.add("mimetype", string("application/epub+zip"));
+  zip.add("META-INF/container.xml", string(
+    "<?xml version=\"1.0\"?>\n"
+    "<container version=\"1.0\" xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\">\n"
+    "<rootfiles><rootfile full-path=\"OEBPS/content.opf\" media-type=\"application/oebps-package+xml\"/></rootfiles>\n"
+    "</container>\n"));
+
+  int chapters = size / (100 * KB);
+  if (chapters < 4)
+    chapters = 4;
+  size_t chapterSize = size / chapters;
+
+  Prose p(seed);
+  string manifest, spine;
+  for (int c = 1; c <= chapters; ++c) {
+    char name[64];
+    snprintf(name, sizeof(name), "chapter%04d.xhtml", c);
+    string x;
+    char h[256];
+    snprintf(h, sizeof(h), "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+      "<html xmlns=\"http://www.w3.org/1999/xhtml\">\n<head><title>Chapter %d</title></head>\n"
+      "<body>\n<h1>Chapter %d</h1>\n", c, c);
+    x += h;
+    string para;
+    while (x.size() < chapterSize) {
+      para.clear();
+      p.next(para);
+      markup(p.rng(), para);
+      x += "<p>" + para + "</p>\n";
+    }
+    x += "</body>\n</html>\n";
+    zip.add(string("OEBPS/") + name, x);
+    snprintf(h, sizeof(h), "<item id=\"c%d\" href=\"%s\" media-type=\"application/xhtml+xml\"/>\n", c, name);
+    manifest += h;
+    snprintf(h, sizeof(h), "<itemref idref=\"c%d\"/>\n", c);
+    spine += h;
+  }
+
+  string opf = string("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    "<package xmlns=\"http://www.idpf.org/2007/opf\" version=\"2.0\" unique-identifier=\"id\">\n"
+    "<metadata xmlns:dc=\"http://purl.org/dc/elements/1.1/\"><dc:title>") + seed +
+    "</dc:title><dc:language>en</dc:language><dc:identifier id=\"id\">bookr-bench-" + seed +
+    "</dc:identifier></metadata>\n<manifest>\n" + manifest + "</manifest>\n<spine>\n" + spine +
+    "</spine>\n</package>\n";
+  zip.add("OEBPS/content.opf", opf);
+  return zip.finish();
+}
+
+// ---------------------------------------------------------------------
+// images
+
+// a scanned text page: paper noise, margins and lines of word blobs
+static void scanPage(Rng& r, unsigned char* p, int w, int h) {
+  for (int i = 0; i < w * h; ++i)
+    p[i] = 236 + (r.next() & 15);
+  int margin = w / 10;
+  int lineHeight = h / 48;
+  for (int y = margin; y + lineHeight < h - margin; y += lineHeight) {
+    if (r.below(12) == 0)
+      continue;   // paragraph gap
+    int x = margin + (r.below(10) == 0 ? w / 20 : 0);
+    int right = w - margin - (r.below(6) == 0 ? r.below(w / 2) : 0);
+    while (x < right) {
+      int word = r.range(w / 60, w / 12);
+      if (x + word > right)
+        break;
+      int top = y + lineHeight / 4, bottom = y + lineHeight * 3 / 4;
+      for (int yy = top; yy < bottom; ++yy) {
+        unsigned char* row = p + yy * w;
+        for (int xx = x; xx < x + word; ++xx)
+          row[xx] = (r.next() & 3) ? 30 + (r.next() & 31) : 200;
+      }
+      x += word + r.range(w / 120, w / 60);
+    }
+  }
+}
+
+// a comic page: panels of shaded color with black borders
+static void comicPage(Rng& r, unsigned char* p, int w, int h) {
+  memset(p, 255, w * h * 3);
+  int rows = r.range(2, 4);
+  int gutter = w / 40;
+  int y = gutter;
+  for (int row = 0; row < rows; ++row) {
+    int ph = (h - gutter) / rows - gutter;
+    int cols = r.range(1, 3);
+    int x = gutter;
+    for (int c = 0; c < cols; ++c) {
+      int pw = (w - gutter) / cols - gutter;
+      int cr = r.below(256), cg = r.below(256), cb = r.below(256);
+      for (int yy = y; yy < y + ph; ++yy) {
+        unsigned char* px = p + (yy * w + x) * 3;
+        for (int xx = 0; xx < pw; ++xx, px += 3) {
+          bool border = yy < y + 4 || yy >= y + ph - 4 || xx < 4 || xx >= pw - 4;
+          int shade = (xx + yy - y) * 64 / (pw + ph);
+          px[0] = border ? 0 : (cr + shade) & 0xff;
+          px[1] = border ? 0 : (cg + shade) & 0xff;
+          px[2] = border ? 0 : (cb + shade) & 0xff;
+        }
+      }
+      x += pw + gutter;
+    }
+    y += ph + gutter;
+  }
+}
+
+static bool encodeJPEG(const unsigned char* p, int w, int h, int components, int quality, vector<unsigned char>& out) {
+  struct jpeg_compress_struct cinfo;
+  struct jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&cinfo);
+  unsigned char* mem = NULL;
+  unsigned long memSize = 0;
+  jpeg_mem_dest(&cinfo, &mem, &memSize);
+  cinfo.image_width = w;
+  cinfo.image_height = h;
+  cinfo.input_components = components;
+  cinfo.in_color_space = components == 1 ? JCS_GRAYSCALE : JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+  while (cinfo.next_scanline < cinfo.image_height) {
+    JSAMPROW row = (JSAMPROW)(p + cinfo.next_scanline * w * components);
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  out.assign(mem, mem + memSize);
+  jpeg_destroy_compress(&cinfo);
+  free(mem);
+  return !out.empty();
+}
+
+#define SCAN_WIDTH    1240  // A4 at 150 dpi
+#define SCAN_HEIGHT   1754
+#define COMIC_WIDTH   960
+#define COMIC_HEIGHT  1360
+
+static bool writePNG(FILE* f, const char* seed) {
+  Rng r(seed);
+  vector<unsigned char> page(SCAN_WIDTH * SCAN_HEIGHT);
+  scanPage(r, &page[0], SCAN_WIDTH, SCAN_HEIGHT);
+
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (png == NULL)
+    return false;
+  png_infop info = png_create_info_struct(png);
+  if (info == NULL || setjmp(png_jmpbuf(png))) {
+    png_destroy_write_struct(&png, &info);
+    return false;
+  }
+  png_init_io(png, f);
+  png_set_IHDR(png, info, SCAN_WIDTH, SCAN_HEIGHT, 8, PNG_COLOR_TYPE_GRAY,
+    PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png, info);
+  for (int y = 0; y < SCAN_HEIGHT; ++y)
+    png_write_row(png, &page[y * SCAN_WIDTH]);
+  png_write_end(png, NULL);
+  png_destroy_write_struct(&png, &info);
+  return true;
+}
+
+static bool writeCBZ(FILE* f, const char* seed, int pages) {
+  Rng r(seed);
+  BKZipWriter zip(f);
+  vector<unsigned char> page(COMIC_WIDTH * COMIC_HEIGHT * 3);
+  vector<unsigned char> jpeg;
+  for (int i = 1; i <= pages; ++i) {
+    comicPage(r, &page[0], COMIC_WIDTH, COMIC_HEIGHT);
+    if (!encodeJPEG(&page[0], COMIC_WIDTH, COMIC_HEIGHT, 3, 85, jpeg))
+      return false;
+    char name[32];
+    snprintf(name, sizeof(name), "page-%04d.jpg", i);
+    zip.add(name, &jpeg[0], jpeg.size());
+  }
+  return zip.finish();
+}
+
+// ---------------------------------------------------------------------
+// PDF, uncompressed content streams so every page is real vector work
+
+class PdfWriter {
+  FILE* f;
+  vector<long> offsets;
+
+  public:
+  PdfWriter(FILE* f) : f(f) {
+    fprintf(f, "%%PDF-1.4\n%%\xe2\xe3\xcf\xd3\n");
+  }
+
+  void begin(int obj) {
+    if ((int)offsets.size() <= obj)
+      offsets.resize(obj + 1, 0);
+    offsets[obj] = ftell(f);
+    fprintf(f, "%d 0 obj\n", obj);
+  }
+
+  void end() {
+    fprintf(f, "\nendobj\n");
+  }
+
+  void stream(int obj, const char* dict, const void* data, size_t size) {
+    begin(obj);
+    fprintf(f, "<< %s /Length %lu >>\nstream\n", dict, (unsigned long)size);
+    fwrite(data, 1, size, f);
+    fprintf(f, "\nendstream");
+    end();
+  }
+
+  bool finish(int root) {
+    long xref = ftell(f);
+    fprintf(f, "xref\n0 %d\n0000000000 65535 f \n", (int)offsets.size());
+    // numbers nothing was written for, e.g. images of vector pages
+    for (size_t i = 1; i < offsets.size(); ++i) {
+      if (offsets[i] == 0)
+        fprintf(f, "0000000000 00001 f \n");
+      else
+        fprintf(f, "%010ld 00000 n \n", offsets[i]);
+    }
+    fprintf(f, "trailer\n<< /Size %d /Root %d 0 R >>\nstartxref\n%ld\n%%%%EOF\n",
+      (int)offsets.size(), root, xref);
+    return !ferror(f);
+  }
+};
+
+#define PDF_WIDTH   595
+#define PDF_HEIGHT  842
+// object numbers: catalog, page tree, font, then three per page
+#define PDF_CATALOG 1
+#define PDF_PAGES   2
+#define PDF_FONT    3
+#define PDF_PAGE(i)     (4 + 3 * (i))
+#define PDF_CONTENTS(i) (5 + 3 * (i))
+#define PDF_IMAGE(i)    (6 + 3 * (i))
+
+static void pdfHeader(PdfWriter& pdf, FILE* f, int pages) {
+  pdf.begin(PDF_CATALOG);
+  fprintf(f, "<< /Type /Catalog /Pages %d 0 R >>", PDF_PAGES);
+  pdf.end();
+  pdf.begin(PDF_PAGES);
+  fprintf(f, "<< /Type /Pages /Count %d /Kids [", pages);
+  for (int i = 0; i < pages; ++i)
+    fprintf(f, "%s%d 0 R", i % 16 == 15 ? "\n" : " ", PDF_PAGE(i));
+  fprintf(f, " ] >>");
+  pdf.end();
+  pdf.begin(PDF_FONT);
+  fprintf(f, "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>");
+  pdf.end();
+}
+
+static void pdfPage(PdfWriter& pdf, FILE* f, int i, bool image) {
+  pdf.begin(PDF_PAGE(i));
+  fprintf(f, "<< /Type /Page /Parent %d 0 R /MediaBox [0 0 %d %d] /Contents %d 0 R "
+    "/Resources << /Font << /F1 %d 0 R >>", PDF_PAGES, PDF_WIDTH, PDF_HEIGHT, PDF_CONTENTS(i), PDF_FONT);
+  if (image)
+    fprintf(f, " /XObject << /Im0 %d 0 R >>", PDF_IMAGE(i));
+  fprintf(f, " >> >>");
+  pdf.end();
+}
+
+// about 2000 strokes, curves, fills and short text runs per page, the
+// kind of load maps and technical drawings put on the rasteriser
+static void vectorContents(Rng& r, string& c) {
+  char op[160];
+  for (int i = 0; i < 2000; ++i) {
+    int kind = r.below(10);
+    int x = r.below(PDF_WIDTH), y = r.below(PDF_HEIGHT);
+    if (kind < 4) {
+      snprintf(op, sizeof(op), "%.2f w %d %d m %d %d l S\n", r.below(200) / 100.0,
+        x, y, x + r.range(-80, 80), y + r.range(-80, 80));
+    } else if (kind < 7) {
+      snprintf(op, sizeof(op), "%.2f %.2f %.2f RG %d %d m %d %d %d %d %d %d c S\n",
+        r.below(100) / 100.0, r.below(100) / 100.0, r.below(100) / 100.0, x, y,
+        x + r.range(-60, 60), y + r.range(-60, 60), x + r.range(-60, 60), y + r.range(-60, 60),
+        x + r.range(-60, 60), y + r.range(-60, 60));
+    } else if (kind < 9) {
+      snprintf(op, sizeof(op), "%.2f %.2f %.2f rg %d %d %d %d re f\n",
+        r.below(100) / 100.0, r.below(100) / 100.0, r.below(100) / 100.0, x, y, r.range(2, 40), r.range(2, 40));
+    } else {
+      snprintf(op, sizeof(op), "0 g BT /F1 %d Tf %d %d Td (%s %s %s) Tj ET\n", r.range(5, 12), x, y,
+        words[r.below(N_WORDS)], words[r.below(N_WORDS)], words[r.below(N_WORDS)]);
+    }
+    c += op;
+  }
+}
+
+static bool writeVectorPDF(FILE* f, const char* seed, int pages) {
+  Rng r(seed);
+  PdfWriter pdf(f);
+  pdfHeader(pdf, f, pages);
+  string c;
+  for (int i = 0; i < pages; ++i) {
+    pdfPage(pdf, f, i, false);
+    c.clear();
+    vectorContents(r, c);
+    pdf.stream(PDF_CONTENTS(i), "", c.data(), c.size());
+  }
+  return pdf.finish(PDF_CATALOG);
+}
+
+static bool writeScanPDF(FILE* f, const char* seed, int pages) {
+  Rng r(seed);
+  PdfWriter pdf(f);
+  pdfHeader(pdf, f, pages);
+  vector<unsigned char> page(SCAN_WIDTH * SCAN_HEIGHT);
+  vector<unsigned char> jpeg;
+  char c[64], dict[160];
+  snprintf(c, sizeof(c), "q %d 0 0 %d 0 0 cm /Im0 Do Q", PDF_WIDTH, PDF_HEIGHT);
+  snprintf(dict, sizeof(dict), "/Type /XObject /Subtype /Image /Width %d /Height %d "
+    "/ColorSpace /DeviceGray /BitsPerComponent 8 /Filter /DCTDecode", SCAN_WIDTH, SCAN_HEIGHT);
+  for (int i = 0; i < pages; ++i) {
+    scanPage(r, &page[0], SCAN_WIDTH, SCAN_HEIGHT);
+    if (!encodeJPEG(&page[0], SCAN_WIDTH, SCAN_HEIGHT, 1, 75, jpeg))
+      return false;
+    pdfPage(pdf, f, i, true);
+    pdf.stream(PDF_CONTENTS(i), "", c, strlen(c));
+    pdf.stream(PDF_IMAGE(i), dict, &jpeg[0], jpeg.size());
+  }
+  return pdf.finish(PDF_CATALOG);
+}
+
+// ---------------------------------------------------------------------
+// PalmDoc: a PDB with a record 0 header and LZ77 compressed text records
+
+#define PALM_RECORD 4096
+
+static void be16(unsigned char* p, int v) {
+  p[0] = (v >> 8) & 0xff;
+  p[1] = v & 0xff;
+}
+
+static void be32(unsigned char* p, uint32_t v) {
+  be16(p, v >> 16);
+  be16(p + 2, v & 0xffff);
+}
+
+// greedy PalmDoc LZ77 with a short hash chain; out needs n * 9 / 8 + 8
+static int palmCompress(const unsigned char* in, int n, unsigned char* out) {
+  #define PALM_HASH 4096
+  int head[PALM_HASH];
+  int prev[PALM_RECORD];
+  for (int i = 0; i < PALM_HASH; ++i)
+    head[i] = -1;
+  int o = 0;
+  int i = 0;
+  while (i < n) {
+    int bestLen = 0, bestDist = 0;
+    if (i + 3 <= n) {
+      int h = ((in[i] << 8) ^ (in[i + 1] << 4) ^ in[i + 2]) & (PALM_HASH - 1);
+      int cand = head[h];
+      for (int tries = 0; cand >= 0 && i - cand <= 2047 && tries < 32; ++tries) {
+        int len = 0;
+        while (len < 10 && i + len < n && in[cand + len] == in[i + len])
+          ++len;
+        if (len > bestLen) {
+          bestLen = len;
+          bestDist = i - cand;
+        }
+        cand = prev[cand];
+      }
+    }
+    int step;
+    if (bestLen >= 3) {
+      int v = 0x8000 | (bestDist << 3) | (bestLen - 3);
+      out[o++] = v >> 8;
+      out[o++] = v & 0xff;
+      step = bestLen;
+    } else if (in[i] == ' ' && i + 1 < n && in[i + 1] >= 0x40 && in[i + 1] <= 0x7f) {
+      out[o++] = in[i + 1] ^ 0x80;
+      step = 2;
+    } else if (in[i] == 0 || (in[i] >= 0x09 && in[i] <= 0x7f)) {
+      out[o++] = in[i];
+      step = 1;
+    } else {
+      out[o++] = 1;
+      out[o++] = in[i];
+      step = 1;
+    }
+    for (int k = 0; k < step; ++k, ++i) {
+      if (i + 3 <= n) {
+        int h = ((in[i] << 8) ^ (in[i + 1] << 4) ^ in[i + 2]) & (PALM_HASH - 1);
+        prev[i] = head[h];
+        head[h] = i;
+      }
+    }
+  }
+  return o;
+}
+
+static bool writePalmDoc(FILE* f, const char* seed, size_t size) {
+  // the text is generated up front, PalmDoc books top out at a few MB
+  string text;
+  Prose p(seed);
+  while (text.size() < size) {
+    if (p.chapterBreak()) {
+      char h[64];
+      snprintf(h, sizeof(h), "CHAPTER %d\n\n", p.nextChapter());
+      text += h;
+    }
+    p.next(text);
+    text += "\n\n";
+  }
+
+  int textRecords = (text.size() + PALM_RECORD - 1) / PALM_RECORD;
+  int n = textRecords + 1;
+  vector<string> records(n);
+  unsigned char r0[16];
+  memset(r0, 0, sizeof(r0));
+  be16(r0, 2);                      // PalmDoc compression
+  be32(r0 + 4, text.size());
+  be16(r0 + 8, textRecords);
+  be16(r0 + 10, PALM_RECORD);
+  records[0].assign((char*)r0, sizeof(r0));
+  vector<unsigned char> packed(PALM_RECORD * 9 / 8 + 8);
+  for (int i = 0; i < textRecords; ++i) {
+    int len = text.size() - i * PALM_RECORD;
+    if (len > PALM_RECORD)
+      len = PALM_RECORD;
+    int o = palmCompress((const unsigned char*)text.data() + i * PALM_RECORD, len, &packed[0]);
+    records[i + 1].assign((char*)&packed[0], o);
+  }
+
+  unsigned char h[78];
+  memset(h, 0, sizeof(h));
+  strncpy((char*)h, seed, 31);
+  memcpy(h + 60, "TEXtREAd", 8);
+  be16(h + 76, n);
+  if (fwrite(h, 1, sizeof(h), f) != sizeof(h))
+    return false;
+  uint32_t offset = sizeof(h) + n * 8 + 2;
+  for (int i = 0; i < n; ++i) {
+    unsigned char e[8];
+    be32(e, offset);
+    be32(e + 4, i);   // attributes 0, unique id i
+    if (fwrite(e, 1, 8, f) != 8)
+      return false;
+    offset += records[i].size();
+  }
+  fputc(0, f);
+  fputc(0, f);
+  for (int i = 0; i < n; ++i) {
+    if (fwrite(records[i].data(), 1, records[i].size(), f) != records[i].size())
+      return false;
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------
+
+bool BKCorpus::generate(const File& file, const char* path) {
+  FILE* f = fopen(path, "wb");
+  if (f == NULL)
+    return false;
+  bool ok = false;
+  switch (file.kind) {
+    case BKCORPUS_TEXT:       ok = writeText(f, file.name, file.size); break;
+    case BKCORPUS_HTML:       ok = writeHTML(f, file.name, file.size); break;
+    case BKCORPUS_FB2:        ok = writeFB2(f, file.name, file.size); break;
+    case BKCORPUS_EPUB:       ok = writeEPUB(f, file.name, file.size); break;
+    case BKCORPUS_PDF_VECTOR: ok = writeVectorPDF(f, file.name, file.size); break;
+    case BKCORPUS_PDF_SCAN:   ok = writeScanPDF(f, file.name, file.size); break;
+    case BKCORPUS_CBZ:        ok = writeCBZ(f, file.name, file.size); break;
+    case BKCORPUS_PALMDOC:    ok = writePalmDoc(f, file.name, file.size); break;
+    case BKCORPUS_PNG:        ok = writePNG(f, file.name); break;
+  }
+  if (fclose(f) != 0)
+    ok = false;
+  if (!ok)
+    remove(path);
+  return ok;
+}
+
+int BKCorpus::generate(const char* dir, size_t maxBytes, bool force, FILE* log) {
+  mkdir(dir, 0755);
+  struct stat st;
+  if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode))
+    return -1;
+  int written = 0;
+  for (size_t i = 0; i < sizeof(corpus) / sizeof(corpus[0]); ++i) {
+    const File& file = corpus[i];
+    if (maxBytes > 0 && file.approxBytes > maxBytes)
+      continue;
+    string path = string(dir) + "/" + file.name;
+    if (!force && stat(path.c_str(), &st) == 0)
+      continue;
+    if (log != NULL) {
+      fprintf(log, "writing %s\n", path.c_str());
+      fflush(log);
+    }
+    if (!generate(file, path.c_str()))
+      return -1;
+    ++written;
+  }
+  return written;
+}
@@ -0,0 +1,74 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BKCORPUS_H
+#define BKCORPUS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*! \brief Synthetic documents for bookr-bench.
+ *
+ *  Writes a fixed set of books covering every viewer: plain text,
+ *  HTML, FB2 and EPUB from 10KB to 100MB, vector heavy and scanned
+ *  PDFs, CBZ comics, a compressed PalmDoc and a scanned page as PNG.
+ *  Each file is generated from a seed derived from its name, so the
+ *  same version of the generator always writes the same bytes, and a
+ *  smaller corpus is a subset of a bigger one.
+ */
+class BKCorpus {
+  public:
+  #define BKCORPUS_TEXT       0
+  #define BKCORPUS_HTML       1
+  #define BKCORPUS_FB2        2
+  #define BKCORPUS_EPUB       3
+  #define BKCORPUS_PDF_VECTOR 4
+  #define BKCORPUS_PDF_SCAN   5
+  #define BKCORPUS_CBZ        6
+  #define BKCORPUS_PALMDOC    7
+  #define BKCORPUS_PNG        8
+
+  struct File {
+    const char* name;
+    int kind;
+    // bytes of text for the text formats, pages for the others
+    int size;
+    // rough size on disk, for the size limit
+    size_t approxBytes;
+  };
+
+  static const File* getFiles(int& n);
+
+  // Writes every file of at most maxBytes (0 for all) into dir, which
+  // is created if needed, and skips files that already exist unless
+  // force is set. Returns the number of files written, -1 on error.
+  static int generate(const char* dir, size_t maxBytes, bool force, FILE* log);
+  static bool generate(const File& file, const char* path);
+};
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bkzipwriter.h"
+
+// 1980-01-01 00:00, so the archive does not depend on the clock
+#define ZIP_DOS_TIME 0
+#define ZIP_DOS_DATE 0x21
+
+static uint32_t crcTable[256];
+
+static uint32_t crc32(const unsigned char* p, size_t n) {
+  if (crcTable[1] == 0) {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k)
+        c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      crcTable[i] = c;
+    }
+  }
+  uint32_t c = 0xffffffffu;
+  for (size_t i = 0; i < n; ++i)
+    c = crcTable[(c ^ p[i]) & 0xff] ^ (c >> 8);
+  return c ^ 0xffffffffu;
+}
+
+static void le16(string& s, int v) {
+  s += (char)(v & 0xff);
+  s += (char)((v >> 8) & 0xff);
+}
+
+static void le32(string& s, uint32_t v) {
+  le16(s, v & 0xffff);
+  le16(s, v >> 16);
+}
+
+BKZipWriter::BKZipWriter(FILE* f) : f(f), offset(0), ok(true) {
+}
+
+void BKZipWriter::add(const string& name, const void* data, size_t size) {
+  Entry e;
+  e.name = name;
+  e.crc = crc32((const unsigned char*)data, size);
+  e.size = size;
+  e.offset = offset;
+  string h;
+  le32(h, 0x04034b50);
+  le16(h, 10);              // version needed
+  le16(h, 0);               // flags
+  le16(h, 0);               // stored
+  le16(h, ZIP_DOS_TIME);
+  le16(h, ZIP_DOS_DATE);
+  le32(h, e.crc);
+  le32(h, e.size);
+  le32(h, e.size);
+  le16(h, name.size());
+  le16(h, 0);
+  h += name;
+  ok = ok && fwrite(h.data(), 1, h.size(), f) == h.size();
+  ok = ok && fwrite(data, 1, size, f) == size;
+  offset += h.size() + size;
+  entries.push_back(e);
+}
+
+void BKZipWriter::add(const string& name, const string& data) {
+  add(name, data.data(), data.size());
+}
+
+bool BKZipWriter::finish() {
+  string d;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    Entry& e = entries[i];
+    le32(d, 0x02014b50);
+    le16(d, 20);            // version made by
+    le16(d, 10);
+    le16(d, 0);
+    le16(d, 0);
+    le16(d, ZIP_DOS_TIME);
+    le16(d, ZIP_DOS_DATE);
+    le32(d, e.crc);
+    le32(d, e.size);
+    le32(d, e.size);
+    le16(d, e.name.size());
+    le16(d, 0);             // extra
+    le16(d, 0);             // comment
+    le16(d, 0);             // disk
+    le16(d, 0);             // internal attributes
+    le32(d, 0);             // external attributes
+    le32(d, e.offset);
+    d += e.name;
+  }
+  uint32_t directorySize = d.size();
+  le32(d, 0x06054b50);
+  le16(d, 0);
+  le16(d, 0);
+  le16(d, entries.size());
+  le16(d, entries.size());
+  le32(d, directorySize);
+  le32(d, offset);
+  le16(d, 0);
+  ok = ok && fwrite(d.data(), 1, d.size(), f) == d.size();
+  return ok;
+}
@@ -0,0 +1,68 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BKZIPWRITER_H
+#define BKZIPWRITER_H
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdint.h>
+
+using namespace std;
+
+/*! \brief Writes a zip archive of stored (uncompressed) entries.
+ *
+ *  MuPDF reads stored entries without inflating them, which is all the
+ *  corpus and the pre-baked comic archives need, and the tools stay
+ *  free of a zlib dependency. Entries carry a fixed 1980-01-01 date so
+ *  the same input gives the same archive.
+ */
+class BKZipWriter {
+  struct Entry {
+    string name;
+    uint32_t crc;
+    uint32_t size;
+    uint32_t offset;
+  };
+  FILE* f;
+  uint32_t offset;
+  vector<Entry> entries;
+  bool ok;
+
+  public:
+  // f stays owned by the caller
+  BKZipWriter(FILE* f);
+
+  void add(const string& name, const void* data, size_t size);
+  void add(const string& name, const string& data);
+  // writes the central directory, false if any write failed
+  bool finish();
+};
+
+#endif
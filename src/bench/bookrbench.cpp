@@ -0,0 +1,1316 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+
+#include "../graphics/fzscreen.h"
+#include "../graphics/fzimage.h"
+#include "../graphics/fztexture.h"
+#include "../graphics/fzbufferpool.h"
+#include "../graphics/fzmemory.h"
+#include "../graphics/fzinstreammem.h"
+#include "../graphics/fzinstreamfile.h"
+#include "../graphics/fzinstreammapped.h"
+#include "../bkuser.h"
+#include "../bklayer.h"
+#include "../bklibrary.h"
+#include "../bkbookmark.h"
+#include "../bkdocument.h"
+#include "../bkdocumentcache.h"
+#include "../bkmemorygovernor.h"
+#include "../filetypes/bkfancytext.h"
+#include "../filetypes/bkmudocument.h"
+#include "../filetypes/bkmureflow.h"
+#include "../filetypes/bkpalmdocstream.h"
+#ifdef BOOKR_DJVU
+  #include "../filetypes/bkdjvu.h"
+#endif
+#include "../utils.h"
+#include "bookrconfig.h"
+
+#include "bkbench.h"
+#include "bkcorpus.h"
+
+/*
+ * bookr-bench: times the reader on a synthetic corpus.
+ *
+ *   bookr-bench --generate --corpus corpus --out bench.json
+ *
+ * Documents go through the real BKDocument, BKFancyText and
+ * BKBookmarksManager code, drawn by the headless screen, so the numbers
+ * include layout and rasterising but not the Vita GPU.
+ */
+
+// files over this many bytes get fewer runs of the slow cases
+#define BENCH_BIG_FILE      (10 * 1024 * 1024)
+#define BENCH_BIG_RUNS      3
+// the memory soak skips the biggest books to keep rounds short
+#define BENCH_SOAK_MAX_FILE (16 * 1024 * 1024)
+#define BENCH_SOAK_FLIPS    5
+// slack allowed on the heap peak of the last soak round
+#define BENCH_SOAK_GROWTH_PCT 10
+#define BENCH_SOAK_SLACK    (8 * 1024 * 1024)
+// the page soak flips through the heaviest PDFs this many times, under a
+// heap small enough that two full stores do not fit
+#define BENCH_SOAK_PAGES    3000
+#define BENCH_SOAK_HEAP     64
+#define BENCH_SOAK_SWITCH   100
+#define BENCH_READ_BLOCK    (64 * 1024)
+// continuous scroll: a steady pan for this many frames at 60 a second
+#define BENCH_SCROLL_FRAMES 600
+#define BENCH_FRAME_MS      (1000.0 / 60)
+#define BENCH_SCROLL_PAN    127
+// a spread that is not on screen after this long counts as failed
+#define BENCH_SPREAD_TIMEOUT 10000
+// PNGs decode row by row: libpng holds two rows of at most 8 bytes a
+// pixel (16 bit RGBA), plus zlib's 32KB window and its own structs
+#define BENCH_PNG_ROWS      2
+#define BENCH_PNG_SLACK     (128 * 1024)
+// a palette image keeps its CLUT next to the pixels
+#define BENCH_PNG_CLUT      (256 * 4)
+// linear against tiled page textures: the same square page either way,
+// panned down by BENCH_SCROLL_PAN a frame
+#define BENCH_TILED_SIZE    1024
+#define BENCH_TILED_FRAMES  120
+
+static BKBench bench;
+static int iterations = 10;
+static int flips = 20;
+static int rounds = 5;
+static int soakPages = BENCH_SOAK_PAGES;
+static size_t soakHeap = (size_t)BENCH_SOAK_HEAP * 1024 * 1024;
+static string icons = "data/icons";
+
+static void usage() {
+  fprintf(stderr,
+    "usage: bookr-bench [options]\n"
+    "  --corpus dir       documents to time (default bench-corpus)\n"
+    "  --generate         write the missing corpus files first\n"
+    "  --max-size mb      skip corpus files bigger than this\n"
+    "  --only text        only files whose name contains text\n"
+    "  --out file         JSON results (default bench.json)\n"
+    "  --iterations n     samples per case (default 10)\n"
+    "  --flips n          page flips per document (default 20)\n"
+    "  --rounds n         memory soak rounds, 0 to skip (default 5)\n"
+    "  --soak-pages n     page flips of the page soak, 0 to skip (default 3000)\n"
+    "  --soak-heap mb     governor heap during the page soak (default 64)\n"
+    "  --icons dir        PNGs to decode besides the corpus (default data/icons)\n"
+    "  --label text       stored in the results, e.g. a branch name\n");
+}
+
+static long fileSize(const string& path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    return -1;
+  return st.st_size;
+}
+
+// draw one frame the way the main loop does
+static void frame(BKDocument* doc) {
+  doc->updateContent();
+  FZScreen::startDirectList();
+  doc->render();
+  FZScreen::endAndDisplayList();
+  FZScreen::swapBuffers();
+  BKMemoryGovernor::update();
+}
+
+// the viewer's own drawing, without the banner and toolbar on top
+static void grabPage(BKDocument* doc, vector<unsigned int>& pixels) {
+  doc->updateContent();
+  FZScreen::startDirectList();
+  doc->renderContent();
+  FZScreen::endAndDisplayList();
+  unsigned int* fb = (unsigned int*)FZScreen::framebuffer();
+  pixels.assign(fb, fb + FZ_SCREEN_WIDTH * FZ_SCREEN_HEIGHT);
+  FZScreen::swapBuffers();
+}
+
+// a new instance, not the one BKDocumentCache kept from the last open
+static BKDocument* openFresh(string& path) {
+  BKDocumentCache::remove(path);
+  try {
+    return BKDocument::create(path);
+  } catch (const char* e) {
+    fprintf(stderr, "%s: %s\n", path.c_str(), e);
+    return nullptr;
+  }
+}
+
+static void closeDocument(BKDocument* doc, string& path) {
+  doc->release();
+  BKDocumentCache::remove(path);
+}
+
+static void benchDocument(string& path, const string& name) {
+  long size = fileSize(path);
+  int runs = size > BENCH_BIG_FILE ? min(iterations, BENCH_BIG_RUNS) : iterations;
+
+  BKDocument* doc = nullptr;
+  for (int i = 0; i < runs; ++i) {
+    if (doc != nullptr)
+      closeDocument(doc, path);
+    double t = get_time_ms();
+    doc = openFresh(path);
+    if (doc == nullptr) {
+      bench.fail(("cannot open " + name).c_str());
+      return;
+    }
+    double opened = get_time_ms();
+    frame(doc);
+    bench.add("open", name, opened - t);
+    bench.add("first_page", name, get_time_ms() - t);
+    const BKDocument::OpenTimings& stages = BKDocument::getOpenTimings();
+    bench.add("open_detect", name, stages.detect);
+    bench.add("open_parse", name, stages.open);
+    bench.add("open_count_pages", name, stages.countPages);
+  }
+
+  #ifdef BOOKR_DJVU
+    BKDJVU* djvu = dynamic_cast<BKDJVU*>(doc);
+  #endif
+  if (doc->isPaginated() && doc->getTotalPages() > 1) {
+    int pages = doc->getTotalPages();
+    for (int i = 0; i < flips; ++i) {
+      double t = get_time_ms();
+      doc->setCurrentPage(doc->getCurrentPage() % pages + 1);
+      frame(doc);
+      bench.add("flip", name, get_time_ms() - t);
+      #ifdef BOOKR_DJVU
+        if (djvu != nullptr)
+          bench.add("djvu_decode", name, djvu->getLastDecodeTime());
+      #endif
+    }
+    doc->setCurrentPage(1);
+  }
+
+  if (doc->isZoomable()) {
+    vector<BKDocument::ZoomLevel> levels;
+    doc->getZoomLevels(levels);
+    int base = doc->getCurrentZoomLevel();
+    int other = base + 1 < (int)levels.size() ? base + 1 : base - 1;
+    if (other >= 0) {
+      for (int i = 0; i < runs; ++i) {
+        double t = get_time_ms();
+        doc->setZoomLevel(i % 2 == 0 ? other : base);
+        frame(doc);
+        bench.add("zoom", name, get_time_ms() - t);
+      }
+      doc->setZoomLevel(base);
+    }
+  }
+
+  if (doc->isRotable()) {
+    int base = doc->getRotation();
+    for (int i = 0; i < runs; ++i) {
+      double t = get_time_ms();
+      doc->setRotation((doc->getRotation() + 1) % 4);
+      frame(doc);
+      bench.add("rotate", name, get_time_ms() - t);
+    }
+    doc->setRotation(base);
+  }
+
+  // text views lay the whole book out again on a forced rotation
+  BKFancyText* text = dynamic_cast<BKFancyText*>(doc);
+  if (text != nullptr) {
+    for (int i = 0; i < runs; ++i) {
+      double t = get_time_ms();
+      text->setRotation(text->getRotation(), true);
+      bench.add("reflow", name, get_time_ms() - t);
+    }
+  }
+
+  if (doc->isBookmarkable()) {
+    string fn;
+    doc->getFileName(fn);
+    BKBookmarkList saved;
+    BKBookmarksManager::getBookmarks(fn, saved);
+    for (int i = 0; i < iterations; ++i) {
+      BKBookmark b;
+      b.title = "bench";
+      b.page = doc->getCurrentPage();
+      doc->getBookmarkPosition(b.viewData);
+      double t = get_time_ms();
+      BKBookmarksManager::addBookmark(fn, b);
+      bench.add("bookmark_save", name, get_time_ms() - t);
+      BKBookmarksManager::setBookmarks(fn, saved);
+    }
+  }
+
+  closeDocument(doc, path);
+}
+
+// The document with continuous scroll on, scrolled down at full pad
+// speed with the frames paced like the display. scroll_frame is the
+// main thread's work per frame, scroll_blank the frames that showed a
+// page the worker had not rendered yet.
+static void benchScroll(string& path, const string& name) {
+  bool saved = BKUser::options.pdfContinuousScroll;
+  BKUser::options.pdfContinuousScroll = true;
+  BKDocument* doc = openFresh(path);
+  BKMUDocument* mu = dynamic_cast<BKMUDocument*>(doc);
+  if (mu != nullptr && mu->getStrip() != nullptr) {
+    frame(doc);
+    for (int i = 0; i < BENCH_SCROLL_FRAMES; ++i) {
+      double t = get_time_ms();
+      doc->pan(0, BENCH_SCROLL_PAN);
+      frame(doc);
+      double spent = get_time_ms() - t;
+      bench.add("scroll_frame", name, spent);
+      if (spent < BENCH_FRAME_MS)
+        usleep((useconds_t)((BENCH_FRAME_MS - spent) * 1000));
+    }
+    bench.add("scroll_blank", name, mu->getStrip()->getBlankFrames(), "frames");
+  } else if (doc != nullptr) {
+    bench.fail(("no continuous scroll for " + name).c_str());
+  }
+  if (doc != nullptr)
+    closeDocument(doc, path);
+  BKUser::options.pdfContinuousScroll = saved;
+}
+
+// Page flips with two-page spreads on, back to back, until both pages
+// are on screen; compare spread_flip with the single page flip case.
+static void benchSpreads(string& path, const string& name) {
+  bool saved = BKUser::options.pdfSpreads;
+  BKUser::options.pdfSpreads = true;
+  BKDocument* doc = openFresh(path);
+  BKMUDocument* mu = dynamic_cast<BKMUDocument*>(doc);
+  if (mu != nullptr && mu->getSpread() != nullptr && doc->getTotalPages() > 2) {
+    BKMUSpread* spread = mu->getSpread();
+    int pages = doc->getTotalPages();
+    for (int i = 0; i <= flips; ++i) {
+      double t = get_time_ms();
+      // the first round is the open, not a flip
+      int expected = doc->getCurrentPage() + spread->getCount();
+      if (i > 0) {
+        if (expected >= pages) {
+          expected = 0;
+          doc->setCurrentPage(0);
+        } else {
+          doc->nextPage();
+        }
+      }
+      frame(doc);
+      if (i > 0 && doc->getCurrentPage() != expected) {
+        bench.fail(("next page did not move a whole spread in " + name).c_str());
+        break;
+      }
+      while (!spread->isReady() && get_time_ms() - t < BENCH_SPREAD_TIMEOUT) {
+        usleep(1000);
+        frame(doc);
+      }
+      if (!spread->isReady()) {
+        bench.fail(("spread timed out in " + name).c_str());
+        break;
+      }
+      if (i > 0)
+        bench.add("spread_flip", name, get_time_ms() - t);
+    }
+    // and back: the left page of the spread before, whatever its size
+    int left = doc->getCurrentPage();
+    if (left > 0) {
+      doc->previousPage();
+      frame(doc);
+      if (doc->getCurrentPage() != spread->first(left - 1))
+        bench.fail(("previous page did not move a whole spread in " + name).c_str());
+    }
+  }
+  if (doc != nullptr)
+    closeDocument(doc, path);
+  BKUser::options.pdfSpreads = saved;
+}
+
+// A suspend can leave the document's file descriptor dead. resume()
+// must swap in a new one, and both the page on screen and a page that
+// was never loaded must come out as from a document that kept its file.
+static void benchResume(string& path, const string& name) {
+  vector<unsigned int> expected, before, after;
+  BKDocument* doc = openFresh(path);
+  if (doc == nullptr)
+    return;
+  int last = doc->getTotalPages() - 1;
+  if (dynamic_cast<BKMUDocument*>(doc) == nullptr || last < 1) {
+    closeDocument(doc, path);
+    return;
+  }
+  doc->setCurrentPage(last);
+  grabPage(doc, expected);
+  // the next open restores the first page, the last one stays unread
+  doc->setCurrentPage(0);
+  grabPage(doc, before);
+  closeDocument(doc, path);
+
+  doc = openFresh(path);
+  BKMUDocument* mu = dynamic_cast<BKMUDocument*>(doc);
+  if (mu == nullptr) {
+    bench.fail(("resume: cannot reopen " + name).c_str());
+    if (doc != nullptr)
+      closeDocument(doc, path);
+    return;
+  }
+  mu->invalidateFile();
+  double t = get_time_ms();
+  int r = doc->resume();
+  bench.add("resume_reopen", name, get_time_ms() - t);
+  if (r != BK_CMD_MARK_DIRTY) {
+    bench.fail(("resume: lost file not reopened in " + name).c_str());
+  } else {
+    grabPage(doc, after);
+    if (after != before)
+      bench.fail(("resume: page on screen changed in " + name).c_str());
+    doc->setCurrentPage(last);
+    grabPage(doc, after);
+    if (after != expected)
+      bench.fail(("resume: new page differs after reopen in " + name).c_str());
+    doc->setCurrentPage(0);
+    doc->updateContent();
+  }
+  closeDocument(doc, path);
+}
+
+// PDFs opened as text: pdf_reflow is pages of the PDF read, ordered
+// and laid out per second, open included; pdf_relayout lays the whole
+// text out again from the cached pages, as a rotation does.
+static void benchPdfReflow(string& path, const string& name) {
+  bool saved = BKUser::options.pdfReflow;
+  BKUser::options.pdfReflow = true;
+  for (int i = 0; i < iterations; ++i) {
+    double t = get_time_ms();
+    BKDocument* doc = openFresh(path);
+    BKMUReflow* reflow = dynamic_cast<BKMUReflow*>(doc);
+    if (reflow == nullptr) {
+      if (doc != nullptr)
+        closeDocument(doc, path);
+      bench.fail(("no reflow for " + name).c_str());
+      break;
+    }
+    while (reflow->getLoadedPages() < reflow->getSourcePages())
+      reflow->updateContent();
+    double ms = get_time_ms() - t;
+    if (ms > 0)
+      bench.add("pdf_reflow", name, reflow->getSourcePages() * 1000.0 / ms, "pages/s");
+
+    t = get_time_ms();
+    reflow->setRotation(reflow->getRotation(), true);
+    bench.add("pdf_relayout", name, get_time_ms() - t);
+    closeDocument(doc, path);
+  }
+  BKUser::options.pdfReflow = saved;
+}
+
+static void benchLibrary(const string& corpus) {
+  vector<FZDirent> entries;
+  for (int i = 0; i < iterations; ++i) {
+    entries.clear();
+    double t = get_time_ms();
+    FZScreen::dirContents(corpus.c_str(), entries);
+    bench.add("dir_list", "", get_time_ms() - t);
+  }
+
+  // the first scan sniffs every file, the next ones only stat them
+  BKUser::options.libraryFolder = corpus;
+  for (int i = 0; i <= iterations; ++i) {
+    double t = get_time_ms();
+    BKLibrary::startScan();
+    while (BKLibrary::isScanning())
+      usleep(1000);
+    bench.add(i == 0 ? "library_scan_cold" : "library_scan", "", get_time_ms() - t);
+  }
+}
+
+// a table entry's value as user.xml writes it
+static string settingText(const BKUser::Setting& s) {
+  if (s.type == BKUSER_SETTING_STRING || s.type == BKUSER_SETTING_PATH)
+    return *(string*)s.value;
+  if (s.type == BKUSER_SETTING_BOOL)
+    return *(bool*)s.value ? "1" : "0";
+  return to_string(*(int*)s.value);
+}
+
+// an in-range value other than the default, so a dropped or misread
+// entry cannot pass by holding its default
+static void setOther(const BKUser::Setting& s) {
+  switch (s.type) {
+    case BKUSER_SETTING_BOOL:
+      *(bool*)s.value = s.defaultValue == 0;
+      break;
+    case BKUSER_SETTING_STRING:
+    case BKUSER_SETTING_PATH:
+      *(string*)s.value = string("bench/") + s.name;
+      break;
+    default: {
+      int v = s.defaultValue < s.maxValue ? s.maxValue : s.minValue;
+      // checks outside the table: quarter turns, an existing scheme
+      if (strcmp(s.name, "txtRotation") == 0)
+        v = 90;
+      else if (strcmp(s.name, "currentScheme") == 0)
+        v = 1;
+      *(int*)s.value = v;
+    }
+  }
+}
+
+// user.xml with value for every numeric entry, or with each entry's
+// range exceeded by one when range is 1 (above) or -1 (below)
+static string numericSettingsXML(const char* value, int range) {
+  int n;
+  const BKUser::Setting* settings = BKUser::getSettings(n);
+  string controls, options;
+  for (int i = 0; i < n; ++i) {
+    const BKUser::Setting& s = settings[i];
+    if (s.type == BKUSER_SETTING_STRING || s.type == BKUSER_SETTING_PATH)
+      continue;
+    string v = range > 0 ? to_string((long)s.maxValue + 1) : range < 0 ? to_string((long)s.minValue - 1) : value;
+    if (s.type == BKUSER_SETTING_BUTTON)
+      controls += string("<bind action=\"") + s.name + "\" button=\"" + v + "\"/>";
+    else
+      options += string("<set option=\"") + s.name + "\" value=\"" + v + "\"/>";
+  }
+  return "<?xml version=\"1.0\"?><user><controls>" + controls + "</controls><options>" + options
+    + "</options></user>";
+}
+
+static bool writeText(const string& path, const string& text) {
+  FILE* f = fopen(path.c_str(), "wb");
+  if (f == NULL)
+    return false;
+  bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+  return fclose(f) == 0 && ok;
+}
+
+static void resetSettings() {
+  BKUser::setDefaultControls();
+  BKUser::setDefaultOptions();
+}
+
+// Every table entry set away from its default must come back from a
+// file; out of range and malformed numbers must fall back to their
+// defaults and be counted. Runs on a file of its own, user.xml is not
+// touched, and the settings are put back afterwards.
+static void benchSettings() {
+  char tmp[] = "/tmp/bookr-settings-XXXXXX";
+  int fd = mkstemp(tmp);
+  if (fd < 0) {
+    bench.fail("settings: cannot create a temporary file");
+    return;
+  }
+  close(fd);
+  string path = tmp;
+  string saved;
+  BKUser::serialize(saved);
+
+  int n;
+  const BKUser::Setting* settings = BKUser::getSettings(n);
+  vector<string> expected(n);
+  for (int i = 0; i < n; ++i) {
+    setOther(settings[i]);
+    expected[i] = settingText(settings[i]);
+  }
+
+  string xml;
+  for (int i = 0; i < iterations; ++i) {
+    xml.clear();
+    double t = get_time_ms();
+    BKUser::serialize(xml);
+    bench.add("settings_serialize", "", get_time_ms() - t);
+    t = get_time_ms();
+    int bad = BKUser::parse(xml.c_str(), xml.size());
+    bench.add("settings_parse", "", get_time_ms() - t);
+    if (bad != 0) {
+      bench.fail("settings: serialize() output does not parse cleanly");
+      break;
+    }
+  }
+
+  // the round trip through a file, as at startup
+  char msg[256];
+  if (!writeText(path, xml)) {
+    bench.fail("settings: cannot write the temporary file");
+  } else {
+    for (int i = 0; i < iterations; ++i) {
+      double t = get_time_ms();
+      resetSettings();
+      int bad = BKUser::loadFile(path.c_str());
+      bench.add("settings_load", "", get_time_ms() - t);
+      if (bad != 0) {
+        snprintf(msg, sizeof(msg), "settings: reload reported %d bad values", bad);
+        bench.fail(msg);
+        break;
+      }
+    }
+    for (int i = 0; i < n; ++i) {
+      if (settingText(settings[i]) != expected[i]) {
+        snprintf(msg, sizeof(msg), "settings: %s reloaded as \"%s\", saved \"%s\"", settings[i].name,
+          settingText(settings[i]).c_str(), expected[i].c_str());
+        bench.fail(msg);
+      }
+    }
+  }
+
+  // each bad number resets its entry, starting from non-defaults
+  int numeric = 0;
+  for (int i = 0; i < n; ++i) {
+    if (settings[i].type != BKUSER_SETTING_STRING && settings[i].type != BKUSER_SETTING_PATH)
+      ++numeric;
+  }
+  struct { const char* value; int range; const char* what; } cases[] = {
+    { "", 1, "over range" },
+    { "", -1, "under range" },
+    { "", 0, "empty" },
+    { "abc", 0, "abc" },
+    { "12x", 0, "12x" },
+    { "1.5", 0, "1.5" },
+  };
+  for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); ++k) {
+    resetSettings();
+    for (int i = 0; i < n; ++i)
+      setOther(settings[i]);
+    string bad = numericSettingsXML(cases[k].value, cases[k].range);
+    const char* what = cases[k].what;
+    if (!writeText(path, bad)) {
+      bench.fail("settings: cannot write the temporary file");
+      break;
+    }
+    int errors = BKUser::loadFile(path.c_str());
+    if (errors != numeric) {
+      snprintf(msg, sizeof(msg), "settings: \"%s\" values gave %d errors, expected %d", what, errors, numeric);
+      bench.fail(msg);
+    }
+    for (int i = 0; i < n; ++i) {
+      const BKUser::Setting& s = settings[i];
+      if (s.type == BKUSER_SETTING_STRING || s.type == BKUSER_SETTING_PATH)
+        continue;
+      bool isDefault = s.type == BKUSER_SETTING_BOOL ? *(bool*)s.value == (s.defaultValue != 0)
+        : *(int*)s.value == s.defaultValue;
+      if (!isDefault) {
+        snprintf(msg, sizeof(msg), "settings: %s kept \"%s\" after a \"%s\" value", s.name,
+          settingText(s).c_str(), what);
+        bench.fail(msg);
+      }
+    }
+  }
+
+  // not a settings file at all
+  if (!writeText(path, "<user><options><set option=") || BKUser::loadFile(path.c_str()) != -1)
+    bench.fail("settings: a truncated file was accepted");
+  remove(path.c_str());
+  if (BKUser::loadFile(path.c_str()) != -1)
+    bench.fail("settings: a missing file was accepted");
+
+  resetSettings();
+  BKUser::parse(saved.c_str(), saved.size());
+}
+
+// counts how often it is destroyed, for the FZRef case
+class BenchShared : public FZRefCounted {
+  BenchShared() { }
+  ~BenchShared() { ++deleted; }
+
+  public:
+  static atomic<int> deleted;
+  static BenchShared* create() { return new BenchShared(); }
+};
+atomic<int> BenchShared::deleted(0);
+
+// Threads copy, move, assign and reset FZRef handles to one object and
+// pass them to each other through mailboxes, so references taken on one
+// thread are dropped on another. The count has to add up to the handles
+// still alive and the object has to be deleted exactly once.
+static void benchFZRef() {
+  const int ops = 1 << 18;
+  const int threadCount = 4;
+  // handles change hands every this many operations
+  const int handOver = 64;
+  BenchShared::deleted = 0;
+  FZRef<BenchShared> root(BenchShared::create());
+  FZRef<BenchShared> mailbox[threadCount];
+  std::mutex mailboxLock;
+  for (int i = 0; i < iterations; ++i) {
+    double t = get_time_ms();
+    vector<std::thread> threads;
+    for (int k = 0; k < threadCount; ++k) {
+      // the copy is taken here and dropped on the worker
+      threads.push_back(std::thread([root, k, &mailbox, &mailboxLock]() {
+        FZRef<BenchShared> held;
+        for (int n = 0; n < ops; ++n) {
+          FZRef<BenchShared> a(root);
+          FZRef<BenchShared> b(std::move(a));
+          a = b;
+          held = std::move(b);
+          a.reset();
+          if (n % handOver == 0) {
+            std::lock_guard<std::mutex> lock(mailboxLock);
+            held.swap(mailbox[(k + n / handOver) % threadCount]);
+          }
+        }
+      }));
+    }
+    for (size_t k = 0; k < threads.size(); ++k)
+      threads[k].join();
+    bench.add("fzref_share_4threads", "", get_time_ms() - t);
+
+    int alive = 1;
+    for (int k = 0; k < threadCount; ++k)
+      alive += mailbox[k] ? 1 : 0;
+    if (root->getReferences() != alive) {
+      bench.fail("refcount: FZRef count does not match the live handles");
+      break;
+    }
+  }
+  for (int k = 0; k < threadCount; ++k)
+    mailbox[k].reset();
+  if (root->getReferences() != 1 || BenchShared::deleted != 0)
+    bench.fail("refcount: FZRef handles left references behind");
+  root.reset();
+  if (BenchShared::deleted != 1)
+    bench.fail("refcount: FZRef object not deleted exactly once");
+}
+
+static void benchRefcount() {
+  const int ops = 1 << 20;
+  const int threadCount = 4;
+  FZImage* shared = FZImage::createEmpty(1, 1, 0, FZImage::rgba32);
+  for (int i = 0; i < iterations; ++i) {
+    double t = get_time_ms();
+    for (int k = 0; k < ops; ++k) {
+      shared->retain();
+      shared->release();
+    }
+    bench.add("refcount_1m", "", get_time_ms() - t);
+
+    t = get_time_ms();
+    vector<std::thread> threads;
+    for (int k = 0; k < threadCount; ++k) {
+      threads.push_back(std::thread([shared, ops]() {
+        for (int n = 0; n < ops; ++n) {
+          shared->retain();
+          shared->release();
+        }
+      }));
+    }
+    for (size_t k = 0; k < threads.size(); ++k)
+      threads[k].join();
+    bench.add("refcount_1m_4threads", "", get_time_ms() - t);
+  }
+  if (shared->getReferences() != 1)
+    bench.fail("refcount: references lost under contention");
+  shared->release();
+  benchFZRef();
+}
+
+static void benchPool() {
+  #define POOL_CYCLES 1000
+  // a full screen RGBA page
+  size_t size = 960 * 544 * 4;
+  for (int i = 0; i < iterations; ++i) {
+    double t = get_time_ms();
+    for (int k = 0; k < POOL_CYCLES; ++k) {
+      void* p = FZBufferPool::alloc(size, false);
+      ((char*)p)[size - 1] = 1;
+      FZBufferPool::release(p);
+    }
+    bench.add("pool_alloc_1k", "", get_time_ms() - t);
+
+    t = get_time_ms();
+    for (int k = 0; k < POOL_CYCLES; ++k) {
+      void* p = malloc(size);
+      ((volatile char*)p)[size - 1] = 1;
+      free(p);
+    }
+    bench.add("malloc_1k", "", get_time_ms() - t);
+  }
+}
+
+static bool readFile(const string& path, vector<char>& data) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (f == NULL)
+    return false;
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  data.resize(size);
+  bool ok = size > 0 && fread(&data[0], 1, size, f) == (size_t)size;
+  fclose(f);
+  return ok;
+}
+
+// One decode, timed, with the memory it took: the image buffer is
+// the only pixel buffer allocated and libpng's working memory stays
+// within a few rows, whatever the image height.
+static bool decodePNG(vector<char>& png, const string& series, const string& name) {
+  FZMemory::TagStats pixmaps, decoder;
+  FZMemory::getStats(FZ_MEM_PIXMAP, pixmaps);
+  FZMemory::getStats(FZ_MEM_DECODE, decoder);
+  size_t pixmapsBefore = pixmaps.current;
+  size_t decoderBefore = decoder.current;
+  FZMemory::resetPeak(FZ_MEM_PIXMAP);
+  FZMemory::resetPeak(FZ_MEM_DECODE);
+
+  double t = get_time_ms();
+  FZInputStreamMem* in = FZInputStreamMem::create(&png[0], png.size());
+  FZImage* image = FZImage::createFromPNG(in);
+  double ms = get_time_ms() - t;
+  in->release();
+  if (image == NULL) {
+    bench.fail(("png: cannot decode " + name).c_str());
+    return false;
+  }
+  FZMemory::getStats(FZ_MEM_PIXMAP, pixmaps);
+  FZMemory::getStats(FZ_MEM_DECODE, decoder);
+  unsigned int w, h;
+  image->getDimensions(w, h);
+  size_t bytes = (size_t)w * h * image->getBytesPerPixel();
+  image->release();
+
+  size_t pixmapPeak = pixmaps.peak - pixmapsBefore;
+  size_t decoderPeak = decoder.peak - decoderBefore;
+  bench.add("png_decode", series, ms, "ms", bytes);
+  bench.add("png_peak", series, pixmapPeak + decoderPeak, "bytes");
+  bench.add("png_decoder_peak", series, decoderPeak, "bytes");
+
+  char msg[256];
+  size_t bound = BENCH_PNG_ROWS * ((size_t)w * 8 + 64) + BENCH_PNG_SLACK;
+  if (pixmapPeak > bytes + BENCH_PNG_CLUT) {
+    snprintf(msg, sizeof(msg), "png: %s took %zu bytes of pixel buffers for a %zu byte image",
+      name.c_str(), pixmapPeak, bytes);
+    bench.fail(msg);
+    return false;
+  }
+  if (decoderPeak > bound) {
+    snprintf(msg, sizeof(msg), "png: %s took %zu bytes of decoder memory, the row bound is %zu",
+      name.c_str(), decoderPeak, bound);
+    bench.fail(msg);
+    return false;
+  }
+  return true;
+}
+
+static void benchImages(const string& corpus) {
+  // a large scanned page
+  string name = "scan-page.png";
+  vector<char> png;
+  if (readFile(corpus + "/" + name, png)) {
+    for (int i = 0; i < iterations; ++i) {
+      if (!decodePNG(png, name, name))
+        break;
+    }
+  }
+
+  // the UI icons, one series for all of them
+  vector<FZDirent> entries;
+  FZScreen::dirContents(icons.c_str(), entries);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (get_ext(entries[i].name.c_str()) != string(".png") || !readFile(icons + "/" + entries[i].name, png))
+      continue;
+    for (int k = 0; k < iterations; ++k) {
+      if (!decodePNG(png, "icons", entries[i].name))
+        break;
+    }
+  }
+}
+
+// Bit by bit from the layout's definition, to check FZImage::tile()
+// against: x and y bits alternate while both sides have them, then the
+// larger side's bits follow.
+static unsigned int tiledReference(unsigned int x, unsigned int y, unsigned int w, unsigned int h) {
+  unsigned int tw, th;
+  FZImage::getTiledDimensions(w, h, tw, th);
+  unsigned int index = 0, bit = 0;
+  for (unsigned int b = 1; b < tw || b < th; b <<= 1) {
+    if (b < tw)
+      index |= (x & b ? 1u : 0u) << bit++;
+    if (b < th)
+      index |= (y & b ? 1u : 0u) << bit++;
+  }
+  return index;
+}
+
+static bool checkTiling(unsigned int w, unsigned int h, unsigned int bpp) {
+  // a pitch with slack, as in a pixmap
+  unsigned int pitch = w * bpp + 5;
+  vector<char> linear((size_t)pitch * h), tiled(FZImage::getTiledSize(w, h, bpp)), back(linear.size());
+  for (size_t i = 0; i < linear.size(); ++i)
+    linear[i] = (char)rand();
+  char msg[128];
+  if (!FZImage::tile(&linear[0], pitch, &tiled[0], w, h, bpp)
+      || !FZImage::untile(&tiled[0], &back[0], pitch, w, h, bpp)) {
+    snprintf(msg, sizeof(msg), "tiling: %ux%u at %u bytes a pixel was refused", w, h, bpp);
+    bench.fail(msg);
+    return false;
+  }
+  for (unsigned int y = 0; y < h; ++y) {
+    for (unsigned int x = 0; x < w; ++x) {
+      const char* p = &linear[(size_t)y * pitch + x * bpp];
+      if (memcmp(&tiled[(size_t)tiledReference(x, y, w, h) * bpp], p, bpp) != 0
+          || FZImage::getTiledIndex(x, y, w, h) != tiledReference(x, y, w, h)
+          || memcmp(&back[(size_t)y * pitch + x * bpp], p, bpp) != 0) {
+        snprintf(msg, sizeof(msg), "tiling: %ux%u at %u bytes a pixel differs at %u,%u", w, h, bpp, x, y);
+        bench.fail(msg);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Uploads and pans one page texture; rotated, the sampler walks columns.
+static void panTexture(vita2d_texture* texture, const string& layout, bool rotated) {
+  const char* name = rotated ? "pan_rotated" : "pan";
+  float x = FZ_SCREEN_WIDTH / 2.0f, y = BENCH_TILED_SIZE / 2.0f;
+  for (int i = 0; i < BENCH_TILED_FRAMES; ++i) {
+    double t = get_time_ms();
+    FZScreen::startDirectList();
+    vita2d_draw_texture_tint_scale_rotate(texture, x, y, 1.0f, 1.0f, rotated ? (float)M_PI / 2 : 0.0f, 0xffffffff);
+    FZScreen::endAndDisplayList();
+    bench.add(name, layout, get_time_ms() - t, "ms", (double)FZ_SCREEN_WIDTH * FZ_SCREEN_HEIGHT * 4);
+    FZScreen::swapBuffers();
+    y -= BENCH_SCROLL_PAN;
+    if (y + BENCH_TILED_SIZE / 2.0f < FZ_SCREEN_HEIGHT)
+      y = BENCH_TILED_SIZE / 2.0f;
+  }
+}
+
+// The GXM swizzled layout of page textures: a round trip through
+// FZImage::tile() and untile() for every pixel size, then upload and
+// draw timings for a linear and a tiled page. The headless screen
+// samples on the CPU, so only the upload numbers carry over to the
+// Vita; the draws check the tiled texture is usable end to end.
+static void benchTiling() {
+  static const unsigned int sizes[][2] = { { 1, 1 }, { 7, 3 }, { 3, 7 }, { 33, 17 }, { 64, 64 }, { 100, 300 }, { 960, 544 } };
+  for (unsigned int bpp = 1; bpp <= 4; ++bpp) {
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+      if (!checkTiling(sizes[i][0], sizes[i][1], bpp))
+        return;
+    }
+  }
+
+  unsigned int side = BENCH_TILED_SIZE;
+  vector<char> page((size_t)side * side * 4);
+  for (size_t i = 0; i < page.size(); ++i)
+    page[i] = (char)(i * 7);
+  for (int tiled = 0; tiled <= 1; ++tiled) {
+    string layout = tiled ? "tiled" : "linear";
+    vita2d_texture* texture = nullptr;
+    int runs = max(iterations, 1);
+    for (int i = 0; i < runs; ++i) {
+      double t = get_time_ms();
+      if (tiled) {
+        texture = _vita2d_create_counted_tiled_texture(side, side);
+        if (texture != nullptr)
+          FZImage::tile(&page[0], side * 4, (char*)vita2d_texture_get_datap(texture), side, side, 4);
+      } else {
+        texture = _vita2d_create_counted_texture(side, side);
+        if (texture != nullptr) {
+          char* dst = (char*)vita2d_texture_get_datap(texture);
+          for (unsigned int y = 0; y < side; ++y)
+            memcpy(dst + y * vita2d_texture_get_stride(texture), &page[(size_t)y * side * 4], side * 4);
+        }
+      }
+      bench.add("upload", layout, get_time_ms() - t, "ms", (double)page.size());
+      if (texture == nullptr) {
+        bench.fail(("tiling: no " + layout + " texture").c_str());
+        return;
+      }
+      if (i + 1 < runs)
+        _vita2d_free_counted_texture(texture);
+    }
+    if (FZTexture::isVitaTextureTiled(texture) != (tiled != 0))
+      bench.fail(("tiling: the " + layout + " texture has the wrong layout").c_str());
+    panTexture(texture, layout, false);
+    panTexture(texture, layout, true);
+    _vita2d_free_counted_texture(texture);
+  }
+}
+
+static double drain(FZInputStream* in) {
+  static char block[BENCH_READ_BLOCK];
+  double t = get_time_ms();
+  while (in->getBlock(block, BENCH_READ_BLOCK) > 0)
+    ;
+  return get_time_ms() - t;
+}
+
+static void benchStreams(const string& corpus, const string& name) {
+  string path = corpus + "/" + name;
+  long size = fileSize(path);
+  if (size <= 0)
+    return;
+  for (int i = 0; i < iterations; ++i) {
+    FZInputStream* in = FZInputStreamFile::create(path.c_str());
+    if (in != NULL) {
+      bench.add("stream_file", name, drain(in), "ms", size);
+      in->release();
+    }
+    in = FZInputStreamMapped::create(path.c_str());
+    if (in != NULL) {
+      bench.add("stream_mapped", name, drain(in), "ms", size);
+      in->release();
+    }
+  }
+}
+
+static void benchPalmDoc(const string& corpus, const string& name) {
+  string path = corpus + "/" + name;
+  for (int i = 0; i < iterations; ++i) {
+    FZInputStream* in = FZInputStreamMapped::open(path.c_str());
+    if (in == NULL)
+      return;
+    BKPalmDocStream* text = BKPalmDocStream::create(in);
+    in->release();
+    if (text == NULL) {
+      bench.fail(("palmdoc: cannot read " + name).c_str());
+      return;
+    }
+    bench.add("palmdoc_decode", name, drain(text), "ms", text->getSize());
+    text->release();
+  }
+}
+
+// Open, page through and close every book for a few rounds. Caches may
+// fill up in the first round, after that the heap peak must stay flat.
+static void benchSoak(vector<string>& docs, const string& corpus) {
+  if (rounds <= 0 || docs.empty())
+    return;
+  size_t firstPeak = 0, lastPeak = 0;
+  for (int r = 0; r < rounds; ++r) {
+    size_t peak = 0;
+    for (size_t i = 0; i < docs.size(); ++i) {
+      string path = corpus + "/" + docs[i];
+      if (fileSize(path) > BENCH_SOAK_MAX_FILE)
+        continue;
+      BKDocument* doc = openFresh(path);
+      if (doc == nullptr)
+        continue;
+      for (int k = 0; k < BENCH_SOAK_FLIPS; ++k) {
+        frame(doc);
+        peak = max(peak, FZMemory::getHeapUsed());
+        if (doc->isPaginated())
+          doc->nextPage();
+      }
+      // dropped from the layers but left in BKDocumentCache, as on close
+      doc->release();
+      peak = max(peak, FZMemory::getHeapUsed());
+    }
+    bench.add("soak_peak_heap", "", peak, "bytes");
+    bench.add("soak_end_heap", "", FZMemory::getHeapUsed(), "bytes");
+    bench.add("soak_accounted", "", FZMemory::getTotal(), "bytes");
+    if (r == 0)
+      firstPeak = peak;
+    lastPeak = peak;
+  }
+  BKDocumentCache::clear();
+  if (lastPeak > firstPeak + firstPeak * BENCH_SOAK_GROWTH_PCT / 100 + BENCH_SOAK_SLACK) {
+    char msg[128];
+    snprintf(msg, sizeof(msg), "memory soak: heap peak grew from %zu to %zu bytes", firstPeak, lastPeak);
+    bench.fail(msg);
+  }
+}
+
+// Page through the two biggest PDFs for thousands of flips under a
+// small governor heap, switching between them every BENCH_SOAK_SWITCH
+// flips the way a reader goes back and forth between books, so one of
+// them always holds a full store in the background. The memory the tags
+// account for must stay inside that heap, fitz has to cross its budget,
+// and every time it does update() has to bring it back before the
+// cooldown runs out.
+static void benchSoakPages(vector<string>& docs, const string& corpus) {
+  if (soakPages <= 0)
+    return;
+  vector<pair<long, string> > pdfs;
+  for (size_t i = 0; i < docs.size(); ++i) {
+    if (get_ext(docs[i].c_str()) == string(".pdf"))
+      pdfs.push_back(make_pair(fileSize(corpus + "/" + docs[i]), docs[i]));
+  }
+  sort(pdfs.rbegin(), pdfs.rend());
+  if (pdfs.size() > 2)
+    pdfs.resize(2);
+  if (pdfs.empty())
+    return;
+
+  BKDocumentCache::clear();
+  BKMemoryGovernor::setHeap(soakHeap);
+  string paths[2];
+  for (size_t i = 0; i < pdfs.size(); ++i) {
+    paths[i] = corpus + "/" + pdfs[i].second;
+    // the first one stays open in the background
+    BKDocument* doc = openFresh(paths[i]);
+    if (doc == nullptr) {
+      BKDocumentCache::clear();
+      BKMemoryGovernor::setHeap(0);
+      return;
+    }
+    doc->release();
+  }
+  const string& name = pdfs[0].second;
+  size_t heap = BKMemoryGovernor::getHeapBudget();
+  size_t high = BKMemoryGovernor::getMupdfBudget() / 100 * BKGOV_HIGH_WATER_PCT;
+  int trims = BKMemoryGovernor::getStoreTrims();
+  int futile = BKMemoryGovernor::getFutileTrims();
+  size_t peak = 0, heapPeak = 0, mupdfPeak = 0;
+  int over = 0, longestOver = 0;
+  BKDocument* doc = nullptr;
+  for (int k = 0; k < soakPages; ++k) {
+    if (k % BENCH_SOAK_SWITCH == 0) {
+      if (doc != nullptr)
+        doc->release();
+      // from BKDocumentCache, as when a book is reopened
+      try {
+        doc = BKDocument::create(paths[(k / BENCH_SOAK_SWITCH) % pdfs.size()]);
+      } catch (const char* e) {
+        doc = nullptr;
+      }
+      if (doc == nullptr) {
+        bench.fail("page soak: cannot reopen a document from the cache");
+        break;
+      }
+    }
+    double t = get_time_ms();
+    // the last page is the highest index
+    if (doc->getCurrentPage() >= doc->getTotalPages())
+      doc->setCurrentPage(0);
+    else
+      doc->nextPage();
+    frame(doc);
+    bench.add("soak_page_flip", name, get_time_ms() - t);
+
+    FZMemory::TagStats s;
+    FZMemory::getStats(FZ_MEM_MUPDF, s);
+    mupdfPeak = max(mupdfPeak, s.current);
+    over = s.current > high ? over + 1 : 0;
+    longestOver = max(longestOver, over);
+    peak = max(peak, FZMemory::getTotal());
+    heapPeak = max(heapPeak, FZMemory::getHeapUsed());
+  }
+  trims = BKMemoryGovernor::getStoreTrims() - trims;
+  futile = BKMemoryGovernor::getFutileTrims() - futile;
+  if (doc != nullptr)
+    doc->release();
+  BKDocumentCache::clear();
+  BKMemoryGovernor::setHeap(0);
+
+  bench.add("soak_pages_accounted_peak", name, peak, "bytes");
+  bench.add("soak_pages_heap_peak", name, heapPeak, "bytes");
+  bench.add("soak_pages_mupdf_peak", name, mupdfPeak, "bytes");
+  bench.add("soak_pages_trims", name, trims, "trims");
+  bench.add("soak_pages_futile_trims", name, futile, "trims");
+
+  char msg[160];
+  if (peak > heap) {
+    snprintf(msg, sizeof(msg), "page soak: %zu bytes accounted, over the %zu byte heap", peak, heap);
+    bench.fail(msg);
+  }
+  // one book alone is held to its store limit by MuPDF
+  if (mupdfPeak <= high && pdfs.size() > 1) {
+    snprintf(msg, sizeof(msg), "page soak: fitz never reached its budget, lower --soak-heap");
+    bench.fail(msg);
+  } else if (mupdfPeak > high && trims == 0) {
+    bench.fail("page soak: fitz crossed its budget but the stores were never trimmed");
+  }
+  // the frame that trims is the one after the cooldown; after a futile
+  // trim the governor rightly leaves the stores alone
+  if (longestOver > BKGOV_COOLDOWN_FRAMES + 1 && futile == 0) {
+    snprintf(msg, sizeof(msg), "page soak: fitz over budget for %d frames in a row", longestOver);
+    bench.fail(msg);
+  }
+}
+
+static bool matches(const string& name, const string& only) {
+  return only.empty() || name.find(only) != string::npos;
+}
+
+int main(int argc, char* argv[]) {
+  string corpus = "bench-corpus";
+  string out = "bench.json";
+  string only, label;
+  bool generate = false;
+  size_t maxBytes = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--generate") {
+      generate = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      usage();
+      return 2;
+    }
+    const char* value = argv[++i];
+    if (arg == "--corpus")
+      corpus = value;
+    else if (arg == "--max-size")
+      maxBytes = (size_t)atoi(value) * 1024 * 1024;
+    else if (arg == "--only")
+      only = value;
+    else if (arg == "--out")
+      out = value;
+    else if (arg == "--iterations")
+      iterations = max(1, atoi(value));
+    else if (arg == "--flips")
+      flips = max(0, atoi(value));
+    else if (arg == "--rounds")
+      rounds = max(0, atoi(value));
+    else if (arg == "--soak-pages")
+      soakPages = max(0, atoi(value));
+    else if (arg == "--soak-heap")
+      soakHeap = (size_t)max(1, atoi(value)) * 1024 * 1024;
+    else if (arg == "--label")
+      label = value;
+    else if (arg == "--icons")
+      icons = value;
+    else {
+      usage();
+      return 2;
+    }
+  }
+
+  if (generate && BKCorpus::generate(corpus.c_str(), maxBytes, false, stdout) < 0) {
+    fprintf(stderr, "cannot write the corpus to %s\n", corpus.c_str());
+    return 1;
+  }
+
+  // a scratch data directory, so user.xml, bookmark.xml and library.xml
+  // start empty and the user's own are never touched
+  char data[] = "/tmp/bookr-bench-XXXXXX";
+  if (mkdtemp(data) == NULL) {
+    fprintf(stderr, "cannot create a data directory\n");
+    return 1;
+  }
+  char* screenArgs[] = { argv[0], (char*)"--data", data };
+  FZScreen::open(3, screenArgs);
+  BKMemoryGovernor::init();
+  BKUser::init();
+  BKLibrary::init();
+  BKLayer::load();
+
+  // documents in corpus order, then anything else that was dropped in
+  vector<string> docs;
+  int n;
+  const BKCorpus::File* files = BKCorpus::getFiles(n);
+  for (int i = 0; i < n; ++i) {
+    if (files[i].kind != BKCORPUS_PNG && fileSize(corpus + "/" + files[i].name) > 0)
+      docs.push_back(files[i].name);
+  }
+  vector<FZDirent> entries;
+  FZScreen::dirContents(corpus.c_str(), entries);
+  sort(entries.begin(), entries.end(), [](const FZDirent& a, const FZDirent& b) { return a.name < b.name; });
+  for (size_t i = 0; i < entries.size(); ++i) {
+    string path = corpus + "/" + entries[i].name;
+    char header[BKDOC_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    int headerSize = read_file_header(path.c_str(), header, BKDOC_HEADER_SIZE);
+    if ((entries[i].stat & FZ_STAT_IFDIR) || headerSize < 0
+        || find(docs.begin(), docs.end(), entries[i].name) != docs.end())
+      continue;
+    if (BKDocument::detectFormat(path, header, headerSize) != BKDOC_FORMAT_UNKNOWN)
+      docs.push_back(entries[i].name);
+  }
+  vector<string> selected;
+  for (size_t i = 0; i < docs.size(); ++i) {
+    if (matches(docs[i], only))
+      selected.push_back(docs[i]);
+  }
+  if (selected.empty())
+    fprintf(stderr, "no documents in %s, run with --generate\n", corpus.c_str());
+
+  for (size_t i = 0; i < selected.size(); ++i) {
+    printf("%s\n", selected[i].c_str());
+    fflush(stdout);
+    string path = corpus + "/" + selected[i];
+    benchDocument(path, selected[i]);
+    if (BKMUDocument::isMUDocument(path)) {
+      benchResume(path, selected[i]);
+      benchScroll(path, selected[i]);
+      benchSpreads(path, selected[i]);
+      char header[BKDOC_HEADER_SIZE];
+      int headerSize = read_file_header(path.c_str(), header, BKDOC_HEADER_SIZE);
+      if (BKMUReflow::isReflowable(header, headerSize))
+        benchPdfReflow(path, selected[i]);
+    }
+    if (get_ext(selected[i].c_str()) == string(".pdb"))
+      benchPalmDoc(corpus, selected[i]);
+  }
+  if (matches("library", only))
+    benchLibrary(corpus);
+  if (matches("settings", only))
+    benchSettings();
+  if (matches("refcount", only))
+    benchRefcount();
+  if (matches("pool", only))
+    benchPool();
+  if (matches("image", only))
+    benchImages(corpus);
+  if (matches("tiling", only))
+    benchTiling();
+  if (matches("text-10m.txt", only))
+    benchStreams(corpus, "text-10m.txt");
+  if (matches("soak", only))
+    benchSoak(selected, corpus);
+  if (matches("soak", only))
+    benchSoakPages(docs, corpus);
+
+  char date[32];
+  time_t now = time(NULL);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+  struct utsname host;
+  bench.setMeta("git", GIT_VERSION);
+  bench.setMeta("date", date);
+  bench.setMeta("label", label);
+  bench.setMeta("corpus", corpus);
+  bench.setMeta("iterations", to_string(iterations));
+  if (uname(&host) == 0)
+    bench.setMeta("host", string(host.sysname) + " " + host.release + " " + host.machine);
+
+  bench.print(stdout);
+  if (!bench.writeJSON(out.c_str()))
+    fprintf(stderr, "cannot write %s\n", out.c_str());
+  else
+    printf("results written to %s\n", out.c_str());
+
+  BKLibrary::shutdown();
+  BKUser::shutdown();
+  FZScreen::close();
+  BKLayer::unload();
+  return bench.ok() ? 0 : 1;
+}
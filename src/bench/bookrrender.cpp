@@ -0,0 +1,650 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <png.h>
+
+#include "../graphics/fzimage.h"
+#include "../graphics/fzinstreamfile.h"
+#include "../filetypes/bkmudocument.h"
+#include "../utils.h"
+
+#include "bkbench.h"
+#include "bkzipwriter.h"
+
+/*
+ * bookr-render: rasterises pages of MuPDF documents without a screen.
+ *
+ *   bookr-render --out pages --pages 1-20 book.pdf comic.cbz
+ *   bookr-render --compare golden book.pdf
+ *   bookr-render --bake baked --density 2 --gray drawings.pdf
+ *
+ * Pages go through BKMUDocument::pageTransform and renderPage, the same
+ * rotation and fit-width/fit-height code the reader uses. Work is spread
+ * over threads, each with its own fitz context and its own handle on
+ * every document it touches, so nothing in MuPDF is shared.
+ *
+ * --bake turns each document into a CBZ of pages already at screen
+ * resolution, for books whose pages take seconds to draw on the device.
+ * The images are tagged with 72 dpi times the density, so MuPDF gives a
+ * baked page the size of the view and fit-width draws it unscaled (or
+ * halves a 2x page, leaving the detail for zooming in).
+ */
+
+// zlib level of the written PNGs, goldens only need to be lossless
+#define RENDER_PNG_LEVEL    1
+
+#define RENDER_FORMAT_NONE  0
+#define RENDER_FORMAT_PNG   1
+#define RENDER_FORMAT_RGBA  2
+
+// PNG pHYs is in pixels per metre
+#define RENDER_DPI          72
+#define RENDER_DPI_TO_PPM(d) (((d) * 10000 + 253) / 254)
+
+struct RenderOptions {
+  int firstPage;      // 1-based
+  int lastPage;       // 0 for the last page of each document
+  float scale;        // used when not fitting
+  float rotate;
+  bool fitWidth;
+  bool fitHeight;
+  int width;
+  int height;
+  int density;        // pixels per view pixel
+  bool gray;
+  int format;
+  string out;
+  string compare;
+  string bake;
+  int tolerance;      // per channel
+  bool verbose;
+};
+
+struct RenderDocument {
+  string path;
+  string name;
+  int pages;
+};
+
+struct RenderPage {
+  int document;
+  int page;           // 0-based
+  // filled in by the worker
+  bool ok;
+  int w, h;
+  double load;
+  double render;
+  double open;        // > 0 if the worker opened the document for this page
+  string error;
+  bool done;
+  // the PNG for --bake, until it is in the archive
+  vector<unsigned char> encoded;
+};
+
+static RenderOptions options;
+static vector<RenderDocument> documents;
+static vector<RenderPage> pages;
+static atomic<size_t> nextPage(0);
+// --bake writes pages in order as the workers finish them
+static mutex doneLock;
+static condition_variable pageDone;
+
+static void usage() {
+  fprintf(stderr,
+    "usage: bookr-render [options] file...\n"
+    "  --pages a-b        1-based page range, a, a- or a-b (default all)\n"
+    "  --fit mode         width, height or none (default width)\n"
+    "  --zoom scale       scale when --fit none (default 1)\n"
+    "  --rotate deg       0, 90, 180 or 270\n"
+    "  --view WxH         view the fit modes fit into (default %dx%d)\n"
+    "  --density n        pixels per view pixel, 2 for zooming in (default 1)\n"
+    "  --gray             grayscale pages\n"
+    "  --out dir          write every page there\n"
+    "  --format f         png or rgba, raw 8-bit RGBA (default png)\n"
+    "  --compare dir      compare every page with the file of the same name\n"
+    "  --tolerance n      per channel difference allowed by --compare\n"
+    "  --bake dir         write every document as dir/name.cbz\n"
+    "  --threads n        workers (default one per core)\n"
+    "  --json file        per-page timings\n"
+    "  --verbose          one line per page\n",
+    FZ_SCREEN_WIDTH, FZ_SCREEN_HEIGHT);
+}
+
+static string baseName(const string& path) {
+  size_t slash = path.find_last_of('/');
+  return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+// book.pdf-p0001.png, raw files carry their size: book.pdf-p0001-960x1242.rgba
+static string pageFileName(const RenderPage& p) {
+  char suffix[64];
+  if (options.format == RENDER_FORMAT_RGBA)
+    snprintf(suffix, sizeof(suffix), "-p%04d-%dx%d.rgba", p.page + 1, p.w, p.h);
+  else
+    snprintf(suffix, sizeof(suffix), "-p%04d.png", p.page + 1);
+  return documents[p.document].name + suffix;
+}
+
+// the magic BKMUDocument::create picks, so a misnamed PDF opens the same way
+static fz_document* openDocument(fz_context* ctx, const string& path) {
+  char header[4];
+  memset(header, 0, sizeof(header));
+  int headerSize = read_file_header(path.c_str(), header, 4);
+  bool isPDF = headerSize >= 4 && memcmp(header, "%PDF", 4) == 0;
+
+  fz_document* doc = nullptr;
+  fz_stream* stm = nullptr;
+  fz_var(stm);
+  fz_try(ctx) {
+    stm = fz_open_file(ctx, path.c_str());
+    doc = fz_open_document_with_stream(ctx, isPDF ? "application/pdf" : path.c_str(), stm);
+    if (fz_needs_password(ctx, doc))
+      fz_throw(ctx, FZ_ERROR_GENERIC, "no pass");
+  } fz_always(ctx) {
+    fz_drop_stream(ctx, stm);
+  } fz_catch(ctx) {
+    fz_drop_document(ctx, doc);
+    return nullptr;
+  }
+  return doc;
+}
+
+static void appendPNG(png_structp png, png_bytep data, png_size_t size) {
+  vector<unsigned char>* out = (vector<unsigned char>*)png_get_io_ptr(png);
+  out->insert(out->end(), data, data + size);
+}
+
+static void flushPNG(png_structp png) {
+}
+
+// RGB, or the first channel only for --gray; tagged with the density
+static bool encodePNG(fz_pixmap* pix, vector<unsigned char>& out) {
+  out.clear();
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (png == NULL)
+    return false;
+  png_infop info = png_create_info_struct(png);
+  vector<unsigned char> row(pix->w);
+  if (info == NULL || setjmp(png_jmpbuf(png))) {
+    png_destroy_write_struct(&png, &info);
+    return false;
+  }
+  png_set_write_fn(png, &out, appendPNG, flushPNG);
+  png_set_compression_level(png, RENDER_PNG_LEVEL);
+  png_set_IHDR(png, info, pix->w, pix->h, 8, options.gray ? PNG_COLOR_TYPE_GRAY : PNG_COLOR_TYPE_RGB,
+    PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  int ppm = RENDER_DPI_TO_PPM(RENDER_DPI * options.density);
+  png_set_pHYs(png, info, ppm, ppm, PNG_RESOLUTION_METER);
+  png_write_info(png, info);
+  for (int y = 0; y < pix->h; ++y) {
+    unsigned char* s = pix->samples + (size_t)y * pix->stride;
+    if (options.gray) {
+      for (int x = 0; x < pix->w; ++x)
+        row[x] = s[x * 3];
+      s = &row[0];
+    }
+    png_write_row(png, s);
+  }
+  png_write_end(png, NULL);
+  png_destroy_write_struct(&png, &info);
+  return true;
+}
+
+static bool writeFile(const char* path, const vector<unsigned char>& data) {
+  FILE* f = fopen(path, "wb");
+  if (f == NULL)
+    return false;
+  bool ok = fwrite(&data[0], 1, data.size(), f) == data.size();
+  return fclose(f) == 0 && ok;
+}
+
+// the same luma MuPDF uses, kept in all three channels
+static void toGray(fz_pixmap* pix) {
+  for (int y = 0; y < pix->h; ++y) {
+    unsigned char* s = pix->samples + (size_t)y * pix->stride;
+    for (int x = 0; x < pix->w; ++x, s += 3)
+      s[0] = s[1] = s[2] = (s[0] * 77 + s[1] * 151 + s[2] * 28 + 128) >> 8;
+  }
+}
+
+// the pixmap is RGB, raw output adds an opaque alpha
+static void toRGBA(fz_pixmap* pix, vector<unsigned char>& rgba) {
+  rgba.resize((size_t)pix->w * pix->h * 4);
+  unsigned char* d = &rgba[0];
+  for (int y = 0; y < pix->h; ++y) {
+    const unsigned char* s = pix->samples + (size_t)y * pix->stride;
+    for (int x = 0; x < pix->w; ++x, s += 3, d += 4) {
+      d[0] = s[0];
+      d[1] = s[1];
+      d[2] = s[2];
+      d[3] = 0xff;
+    }
+  }
+}
+
+// "" if the page matches its golden file, otherwise what differs
+static string comparePage(const RenderPage& p, fz_pixmap* pix, const vector<unsigned char>& rgba) {
+  string path = options.compare + "/" + pageFileName(p);
+  const unsigned char* golden = nullptr;
+  vector<unsigned char> raw;
+  FZImage* image = nullptr;
+  int bpp;
+  if (options.format == RENDER_FORMAT_RGBA) {
+    // the size is in the name, a page of another size has no golden file
+    FILE* f = fopen(path.c_str(), "rb");
+    if (f == NULL)
+      return "no golden " + path;
+    raw.resize(rgba.size());
+    bool full = fread(&raw[0], 1, raw.size(), f) == raw.size() && fgetc(f) == EOF;
+    fclose(f);
+    if (!full)
+      return "size differs from " + path;
+    golden = &raw[0];
+    bpp = 4;
+  } else {
+    FZInputStreamFile* in = FZInputStreamFile::create(path.c_str());
+    if (in == NULL)
+      return "no golden " + path;
+    image = FZImage::createFromPNG(in);
+    in->release();
+    if (image == NULL)
+      return "cannot decode " + path;
+    unsigned int w, h;
+    image->getDimensions(w, h);
+    bpp = image->getFormat() == FZImage::mono8 ? 1 : 3;
+    if ((image->getFormat() != FZImage::rgb24 && bpp != 1) || (int)w != pix->w || (int)h != pix->h) {
+      image->release();
+      return "size differs from " + path;
+    }
+    golden = (const unsigned char*)image->getData();
+  }
+
+  int maxDiff = 0;
+  long differing = 0;
+  for (int y = 0; y < pix->h; ++y) {
+    const unsigned char* s = pix->samples + (size_t)y * pix->stride;
+    const unsigned char* g = golden + (size_t)y * pix->w * bpp;
+    for (int x = 0; x < pix->w; ++x, s += 3, g += bpp) {
+      // a gray golden file has one channel for all three
+      int d = max(abs(s[0] - g[0]), max(abs(s[1] - g[bpp > 1]), abs(s[2] - g[bpp > 1 ? 2 : 0])));
+      if (d > options.tolerance)
+        ++differing;
+      maxDiff = max(maxDiff, d);
+    }
+  }
+  if (image != nullptr)
+    image->release();
+  if (differing == 0)
+    return "";
+  char t[128];
+  snprintf(t, sizeof(t), "%ld pixels differ, by up to %d", differing, maxDiff);
+  return t;
+}
+
+static void renderOne(fz_context* ctx, fz_document* doc, RenderPage& p) {
+  fz_page* page = nullptr;
+  fz_pixmap* pix = nullptr;
+  fz_var(page);
+  fz_var(pix);
+  fz_try(ctx) {
+    double t = get_time_ms();
+    page = fz_load_page(ctx, doc, p.page);
+    p.load = get_time_ms() - t;
+
+    t = get_time_ms();
+    float scale = options.scale * options.density;
+    fz_rect bounds;
+    fz_matrix transform = BKMUDocument::pageTransform(ctx, page, options.rotate, options.fitWidth, options.fitHeight,
+      options.width * options.density, options.height * options.density, scale, bounds);
+    pix = BKMUDocument::renderPage(ctx, page, transform);
+    if (options.gray)
+      toGray(pix);
+    p.render = get_time_ms() - t;
+    p.w = pix->w;
+    p.h = pix->h;
+    p.ok = true;
+  } fz_catch(ctx) {
+    p.error = fz_caught_message(ctx);
+  }
+
+  if (p.ok) {
+    vector<unsigned char> rgba;
+    if (options.format == RENDER_FORMAT_RGBA)
+      toRGBA(pix, rgba);
+    if (!options.bake.empty() && !encodePNG(pix, p.encoded)) {
+      p.ok = false;
+      p.error = "cannot encode";
+    }
+    if (p.ok && !options.out.empty()) {
+      string path = options.out + "/" + pageFileName(p);
+      vector<unsigned char> png;
+      bool written = options.format == RENDER_FORMAT_RGBA ? writeFile(path.c_str(), rgba)
+        : encodePNG(pix, png) && writeFile(path.c_str(), png);
+      if (!written) {
+        p.ok = false;
+        p.error = "cannot write " + path;
+      }
+    }
+    if (p.ok && !options.compare.empty()) {
+      p.error = comparePage(p, pix, rgba);
+      p.ok = p.error.empty();
+    }
+  }
+  fz_drop_pixmap(ctx, pix);
+  fz_drop_page(ctx, page);
+}
+
+static void finished(RenderPage& p) {
+  lock_guard<mutex> lock(doneLock);
+  p.done = true;
+  pageDone.notify_all();
+}
+
+// name.cbz with one PNG per page, in page order
+static bool bake(int document, size_t& page) {
+  const RenderDocument& d = documents[document];
+  string path = options.bake + "/" + d.name + ".cbz";
+  FILE* f = fopen(path.c_str(), "wb");
+  if (f != NULL) {
+    BKZipWriter zip(f);
+    char meta[512];
+    snprintf(meta, sizeof(meta), BKMU_BAKE_MAGIC "\nsource %s\nfirst %d\npages %d\ndensity %d\n",
+      d.name.c_str(), pages[page].page + 1, d.pages, options.density);
+    zip.add(BKMU_BAKE_ENTRY, string(meta));
+    bool ok = true;
+    for (; page < pages.size() && pages[page].document == document; ++page) {
+      RenderPage& p = pages[page];
+      {
+        unique_lock<mutex> lock(doneLock);
+        pageDone.wait(lock, [&p] { return p.done; });
+      }
+      if (!p.ok) {
+        ok = false;
+        continue;
+      }
+      char name[32];
+      snprintf(name, sizeof(name), "%05d.png", p.page + 1);
+      zip.add(name, &p.encoded[0], p.encoded.size());
+      vector<unsigned char>().swap(p.encoded);
+    }
+    ok = zip.finish() && ok;
+    if (fclose(f) == 0 && ok)
+      return true;
+  }
+  for (; page < pages.size() && pages[page].document == document; ++page) {
+    unique_lock<mutex> lock(doneLock);
+    pageDone.wait(lock, [&] { return pages[page].done; });
+  }
+  fprintf(stderr, "%s: not baked\n", path.c_str());
+  remove(path.c_str());
+  return false;
+}
+
+static void worker() {
+  fz_context* ctx = BKMUDocument::newContext(nullptr, nullptr, FZ_STORE_DEFAULT);
+  int current = -1;
+  fz_document* doc = nullptr;
+  for (;;) {
+    size_t i = nextPage++;
+    if (i >= pages.size())
+      break;
+    RenderPage& p = pages[i];
+    if (ctx == nullptr) {
+      p.error = "cannot create a fitz context";
+      finished(p);
+      continue;
+    }
+    // pages are in document order, a worker mostly stays on one document
+    if (p.document != current) {
+      fz_drop_document(ctx, doc);
+      double t = get_time_ms();
+      doc = openDocument(ctx, documents[p.document].path);
+      p.open = get_time_ms() - t;
+      current = p.document;
+    }
+    if (doc == nullptr)
+      p.error = "cannot open";
+    else
+      renderOne(ctx, doc, p);
+    finished(p);
+  }
+  if (ctx != nullptr) {
+    fz_drop_document(ctx, doc);
+    fz_drop_context(ctx);
+  }
+}
+
+static bool parseRange(const char* s, int& first, int& last) {
+  char* end;
+  first = strtol(s, &end, 10);
+  if (end == s || first < 1)
+    return false;
+  if (*end == 0) {
+    last = first;
+    return true;
+  }
+  if (*end != '-')
+    return false;
+  s = end + 1;
+  if (*s == 0) {
+    last = 0;
+    return true;
+  }
+  last = strtol(s, &end, 10);
+  return *end == 0 && last >= first;
+}
+
+int main(int argc, char* argv[]) {
+  options.firstPage = 1;
+  options.lastPage = 0;
+  options.scale = 1.0f;
+  options.rotate = 0.0f;
+  options.fitWidth = true;
+  options.fitHeight = false;
+  options.width = FZ_SCREEN_WIDTH;
+  options.height = FZ_SCREEN_HEIGHT;
+  options.density = 1;
+  options.gray = false;
+  options.format = RENDER_FORMAT_PNG;
+  options.tolerance = 0;
+  options.verbose = false;
+  int threads = max(1, (int)thread::hardware_concurrency());
+  string json;
+  vector<string> files;
+
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg.compare(0, 2, "--") != 0) {
+      files.push_back(arg);
+      continue;
+    }
+    if (arg == "--verbose" || arg == "--gray") {
+      options.verbose = options.verbose || arg == "--verbose";
+      options.gray = options.gray || arg == "--gray";
+      continue;
+    }
+    if (i + 1 >= argc) {
+      usage();
+      return 2;
+    }
+    const char* value = argv[++i];
+    bool ok = true;
+    if (arg == "--pages")
+      ok = parseRange(value, options.firstPage, options.lastPage);
+    else if (arg == "--fit") {
+      options.fitWidth = strcmp(value, "width") == 0;
+      options.fitHeight = strcmp(value, "height") == 0;
+      ok = options.fitWidth || options.fitHeight || strcmp(value, "none") == 0;
+    } else if (arg == "--zoom") {
+      options.scale = atof(value);
+      ok = options.scale > 0;
+    } else if (arg == "--rotate") {
+      int r = atoi(value);
+      options.rotate = r;
+      ok = r == 0 || r == 90 || r == 180 || r == 270;
+    } else if (arg == "--view")
+      ok = sscanf(value, "%dx%d", &options.width, &options.height) == 2 && options.width > 0 && options.height > 0;
+    else if (arg == "--density") {
+      options.density = atoi(value);
+      ok = options.density >= 1 && options.density <= 4;
+    } else if (arg == "--out")
+      options.out = value;
+    else if (arg == "--bake")
+      options.bake = value;
+    else if (arg == "--format") {
+      options.format = strcmp(value, "rgba") == 0 ? RENDER_FORMAT_RGBA : RENDER_FORMAT_PNG;
+      ok = options.format == RENDER_FORMAT_RGBA || strcmp(value, "png") == 0;
+    } else if (arg == "--compare")
+      options.compare = value;
+    else if (arg == "--tolerance")
+      options.tolerance = max(0, atoi(value));
+    else if (arg == "--threads")
+      threads = max(1, atoi(value));
+    else if (arg == "--json")
+      json = value;
+    else
+      ok = false;
+    if (!ok) {
+      usage();
+      return 2;
+    }
+  }
+  if (files.empty()) {
+    usage();
+    return 2;
+  }
+  if (!options.out.empty())
+    mkdir(options.out.c_str(), 0777);
+  if (!options.bake.empty())
+    mkdir(options.bake.c_str(), 0777);
+
+  // page counts up front, so the work can be split by page
+  int failed = 0;
+  fz_context* ctx = BKMUDocument::newContext(nullptr, nullptr, FZ_STORE_DEFAULT);
+  if (ctx == nullptr)
+    return 1;
+  for (size_t i = 0; i < files.size(); ++i) {
+    RenderDocument d;
+    d.path = files[i];
+    d.name = baseName(files[i]);
+    d.pages = 0;
+    fz_document* doc = openDocument(ctx, d.path);
+    if (doc != nullptr) {
+      fz_try(ctx)
+        d.pages = fz_count_pages(ctx, doc);
+      fz_catch(ctx)
+        d.pages = -1;
+      fz_drop_document(ctx, doc);
+    }
+    if (doc == nullptr || d.pages < 0) {
+      fprintf(stderr, "%s: cannot open\n", d.path.c_str());
+      ++failed;
+      continue;
+    }
+    int last = options.lastPage > 0 ? min(options.lastPage, d.pages) : d.pages;
+    for (int p = options.firstPage; p <= last; ++p) {
+      RenderPage page;
+      page.document = documents.size();
+      page.page = p - 1;
+      page.ok = false;
+      page.w = page.h = 0;
+      page.load = page.render = page.open = 0;
+      page.done = false;
+      pages.push_back(page);
+    }
+    documents.push_back(d);
+  }
+  fz_drop_context(ctx);
+
+  threads = min(threads, max(1, (int)pages.size()));
+  double t = get_time_ms();
+  vector<thread> workers;
+  for (int i = 0; i < threads; ++i)
+    workers.push_back(thread(worker));
+  int baked = 0;
+  for (size_t i = 0; !options.bake.empty() && i < pages.size(); )
+    baked += bake(pages[i].document, i) ? 1 : 0;
+  for (size_t i = 0; i < workers.size(); ++i)
+    workers[i].join();
+  double wall = get_time_ms() - t;
+
+  BKBench bench;
+  bench.setMeta("tool", "bookr-render");
+  bench.setMeta("threads", to_string(threads));
+  char view[64];
+  snprintf(view, sizeof(view), "%s %dx%d zoom %g rotate %g density %d%s",
+    options.fitWidth ? "fit-width" : options.fitHeight ? "fit-height" : "fixed",
+    options.width, options.height, options.scale, options.rotate, options.density, options.gray ? " gray" : "");
+  bench.setMeta("view", view);
+  double cpu = 0;
+  int rendered = 0;
+  for (size_t i = 0; i < pages.size(); ++i) {
+    const RenderPage& p = pages[i];
+    const string& name = documents[p.document].name;
+    if (p.open > 0)
+      bench.add("open", name, p.open);
+    if (p.ok) {
+      bench.add("page_load", name, p.load);
+      bench.add("page_render", name, p.render);
+      cpu += p.load + p.render;
+      ++rendered;
+    } else {
+      string what = name + " page " + to_string(p.page + 1) + ": " + p.error;
+      fprintf(stderr, "%s\n", what.c_str());
+      bench.fail(what.c_str());
+      ++failed;
+    }
+    if (options.verbose)
+      printf("%s %d %dx%d load %.2fms render %.2fms%s\n", name.c_str(), p.page + 1, p.w, p.h, p.load, p.render,
+        p.ok ? "" : " failed");
+  }
+
+  bench.print(stdout);
+  printf("%d pages in %.0fms on %d threads: %.1f pages/s, %.2fms render time per page\n",
+    rendered, wall, threads, wall > 0 ? rendered * 1000.0 / wall : 0.0, rendered > 0 ? cpu / rendered : 0.0);
+  if (!options.bake.empty())
+    printf("%d of %d documents baked to %s\n", baked, (int)documents.size(), options.bake.c_str());
+  if (!json.empty() && !bench.writeJSON(json.c_str())) {
+    fprintf(stderr, "cannot write %s\n", json.c_str());
+    return 1;
+  }
+  return failed > 0 ? 1 : 0;
+}
@@ -17,9 +17,12 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <sys/stat.h>
 #include <tinyxml2.h>
 
 #include "bkbookmark.h"
+#include "graphics/fzprofiler.h"
+#include "graphics/fzmemory.h"
 
 /*
 <bookmarks>
@@ -53,6 +56,17 @@ using namespace tinyxml2;
 
 static XMLDocument *doc = 0;
 static XMLElement *root = 0;
+static size_t xmlMemory = 0;
+
+// tinyxml2 keeps the text of the file for the life of the document, so
+// its size is what the bookmarks are counted as
+static void updateXMLMemory(const char* xmlfilename) {
+	struct stat s;
+	size_t bytes = 0;
+	if (stat(xmlfilename, &s) == 0)
+		bytes = s.st_size;
+	FZMemory::update(FZ_MEM_BOOKMARK, xmlMemory, bytes);
+}
 
 static void clearXML() {
 	#ifdef DEBUG
@@ -75,6 +89,7 @@ static void clearXML() {
 	#endif
 
 	doc->SaveFile(xmlfilename);
+	updateXMLMemory(xmlfilename);
 }
 
 static void loadXML() {
@@ -114,12 +129,14 @@ static void loadXML() {
 		printf("WARNING: bookmarks file version too old\n");
 		clearXML();
 	}
+	updateXMLMemory(xmlfilename);
 }
 
 static void saveXML() {
 	#ifdef DEBUG
 		printf("saveXML\n");
 	#endif
+	FZ_PROFILE(FZ_PROFILE_BOOKMARK_SAVE);
 
 	char xmlfilename[1024];
 	#ifdef __vita__
@@ -130,6 +147,7 @@ static void saveXML() {
 
 	if (doc != 0) {
 		doc->SaveFile(xmlfilename);
+		updateXMLMemory(xmlfilename);
 	}
 }
 
@@ -20,33 +20,87 @@
 
 #include "bkdocument.h"
 
-#ifdef __vita__
+#if defined(__vita__) || defined(HEADLESS)
   #include <vita2d.h>
 #endif
 #include "filetypes/bkmudocument.h"
-// #include "filetypes/bkdjvu.h"
-// #include "filetypes/bkpalmdoc.h"
+#include "filetypes/bkmureflow.h"
+#ifdef BOOKR_DJVU
+  #include "filetypes/bkdjvu.h"
+#endif
+#include "filetypes/bkpalmdoc.h"
 #include "filetypes/bkplaintext.h"
+#include "bklibrary.h"
+#include "bkdocumentcache.h"
+#include "utils.h"
+#include "graphics/fzprofiler.h"
 
 BKDocument* BKDocument::create(string filePath) {
+  FZ_PROFILE(FZ_PROFILE_DOCUMENT_OPEN);
   #ifdef DEBUG
     printf("BKDocument::create %s\n", filePath.c_str());
   #endif
   BKDocument* doc = nullptr;
+  openTimings = OpenTimings();
+
+  // recently closed documents are still open
+  doc = BKDocumentCache::find(filePath);
+  if (doc != nullptr) {
+    #ifdef DEBUG
+      printf("document cache hit\n");
+    #endif
+    doc->mode = BKDOC_VIEW;
+    doc->bannerFrames = 0;
+    BKBookmarksManager::setLastFile(filePath);
+    return doc;
+  }
+  BKDocumentCache::reserve();
+
+  double t = get_time_ms();
+
+  // The file is opened once: the header is peeked for detection, then
+  // the same handle is rewound and handed over to the viewer, which
+  // takes ownership of it.
+  FILE* file = fopen(filePath.c_str(), "rb");
+  if (file == NULL)
+    throw "failed opening file; try again";
+
+  char header[BKDOC_HEADER_SIZE];
+  memset((void*)header, 0, BKDOC_HEADER_SIZE);
+  int headerSize = fread(header, 1, BKDOC_HEADER_SIZE, file);
+  fseek(file, 0, SEEK_SET);
+
+  int format = detectFormat(filePath, header, headerSize);
+  openTimings.detect = get_time_ms() - t;
+
+  // MuPDF views open straight at the last view, so only the page that
+  // is shown gets rendered
+  BKBookmark last;
+  bool hasLast = BKBookmarksManager::getLastView(filePath, last);
+  bool restored = false;
 
-  // TODO(refactor): open file handle only once and send
-  if (BKMUDocument::isMUDocument(filePath)) {
-      doc = BKMUDocument::create(filePath);
-  // } else if (BKDJVU::isDJVU(filePath)) {
-  // 	doc = BKDJVU::create(filePath);
-  // } else if (BKPalmDoc::isPalmDoc(filePath)) {
-  // 	doc = BKPalmDoc::create(filePath);
-  } else if (BKPlainText::isPlainText(filePath)) {
-    doc = BKPlainText::create(filePath);
+  if (format == BKDOC_FORMAT_MUPDF) {
+    if (BKUser::options.pdfReflow && BKMUReflow::isReflowable(header, headerSize)) {
+      doc = BKMUReflow::create(filePath, file);
+    } else {
+      doc = BKMUDocument::create(filePath, file, header, headerSize, hasLast ? &last.viewData : nullptr);
+      restored = true;
+    }
+  } else if (format == BKDOC_FORMAT_PLAINTEXT) {
+    doc = BKPlainText::create(filePath, file);
+  } else if (format == BKDOC_FORMAT_PALMDOC) {
+    doc = BKPalmDoc::create(filePath, file);
+  #ifdef BOOKR_DJVU
+  } else if (format == BKDOC_FORMAT_DJVU) {
+    // djvulibre opens the file by name
+    fclose(file);
+    doc = BKDJVU::create(filePath);
+  #endif
   } else {
     #ifdef DEBUG
       printf("not accepted type\n");
     #endif
+    fclose(file);
     throw "File not supported";
   }
   
@@ -62,24 +116,51 @@ BKDocument* BKDocument::create(string filePath) {
   
   doc->buildToolbarMenus();
 
-  if (doc->isBookmarkable()) {
-    BKBookmark b;
-    string fn;
-    doc->getFileName(fn);
-    if (BKBookmarksManager::getLastView(fn, b)) {
-      #ifdef DEBUG
-        printf("bookmark: page %i\n", b.page);
-      #endif
-
-      doc->setBookmarkPosition(b.viewData);
-    }
+  if (doc->isBookmarkable() && hasLast && !restored) {
+    #ifdef DEBUG
+      printf("bookmark: page %i\n", last.page);
+    #endif
+    doc->setBookmarkPosition(last.viewData);
   }
 
+  string fn;
+  doc->getFileName(fn);
+  BKLibrary::touch(fn, format, doc->getPageCount());
+
+  BKDocumentCache::insert(filePath, doc);
+  // evicted documents save their last view on the way out
+  BKBookmarksManager::setLastFile(fn);
+
+  #ifdef DEBUG
+    printf("open timings: detect %.1fms, open %.1fms, count pages %.1fms, first render %.1fms\n",
+      openTimings.detect, openTimings.open, openTimings.countPages, openTimings.firstRender);
+  #endif
+
   return doc;
 }
 
+const BKDocument::OpenTimings& BKDocument::getOpenTimings() {
+  return openTimings;
+}
+
+int BKDocument::detectFormat(string& filePath, const char* header, int headerSize) {
+  if (BKMUDocument::isMUDocument(filePath, header, headerSize))
+    return BKDOC_FORMAT_MUPDF;
+  #ifdef BOOKR_DJVU
+    if (BKDJVU::isDJVU(header, headerSize))
+      return BKDOC_FORMAT_DJVU;
+  #endif
+  if (BKPalmDoc::isPalmDoc(header, headerSize))
+    return BKDOC_FORMAT_PALMDOC;
+  if (BKPlainText::isPlainText(filePath))
+    return BKDOC_FORMAT_PLAINTEXT;
+  return BKDOC_FORMAT_UNKNOWN;
+}
+
+BKDocument::OpenTimings BKDocument::openTimings;
+
 BKDocument::BKDocument() : 
-  mode(BKDOC_VIEW), bannerFrames(0), banner(""), 	tipFrames(120), toolbarSelMenu(0),
+  resumeStart(0), lastResumeTime(0), mode(BKDOC_VIEW), bannerFrames(0), banner(""), 	tipFrames(120), toolbarSelMenu(0),
   toolbarSelMenuItem(0), frames(0)
 {
   lastSuspendSerial = FZScreen::getSuspendSerial();
@@ -119,6 +200,7 @@ int BKDocument::update(unsigned int buttons) {
       printf("lastSuspendSerial != FZScreen::getSuspendSerial()\n");
     #endif
     lastSuspendSerial = FZScreen::getSuspendSerial();
+    resumeStart = get_time_ms();
     int r = resume();
     if (r != 0)
       return r;
@@ -182,23 +264,23 @@ int BKDocument::processEventsForView() {
       printf("BKDocument::processEventsForView - paginated - start\n");
     #endif
     // int n = getTotalPages();
-    int p = getCurrentPage();
-    int op = p;
+    int r = 0;
     if (b[BKUser::controls.nextPage] == 1) {
-      p++;
+      r = nextPage();
     }
     if (b[BKUser::controls.previousPage] == 1) {
-      p--;
+      r = previousPage();
     }
+    int p = getCurrentPage();
+    int op = p;
     if (b[BKUser::controls.next10Pages] == 1) {
       p += 10;
     }
     if (b[BKUser::controls.previous10Pages] == 1) {
       p -= 10;
     }
-    int r = 0;
     if (op != p)
-      setCurrentPage(p);
+      r = setCurrentPage(p);
     #ifdef DEBUG_RENDER
       printf("BKDocument::processEventsForView - paginated - end\n");
     #endif
@@ -551,6 +633,14 @@ void BKDocument::render() {
   // content
   renderContent();
 
+  if (resumeStart > 0) {
+    lastResumeTime = get_time_ms() - resumeStart;
+    resumeStart = 0;
+    #ifdef DEBUG
+      printf("resume: page back on screen after %.1fms\n", lastResumeTime);
+    #endif
+  }
+
   // // flash tip for menu/toolbar on load
   if (tipFrames > 0 && mode != BKDOC_TOOLBAR) {
     int alpha = 0xff;
@@ -559,7 +649,7 @@ void BKDocument::render() {
     }
 
     if (alpha > 0) {
-      #ifdef __vita__
+      #if defined(__vita__) || defined(HEADLESS)
         vita2d_draw_rectangle(FZ_SCREEN_WIDTH - MENU_TOOLTIP_WIDTH, 
           FZ_SCREEN_HEIGHT - MENU_TOOLTIP_HEIGHT,
           MENU_TOOLTIP_WIDTH,
@@ -599,7 +689,7 @@ void BKDocument::render() {
 
   // banner that shows page loading and current page number / number of pages
   if (bannerFrames > 0 && BKUser::options.displayLabels) {
-    #ifdef __vita__
+    #if defined(__vita__) || defined(HEADLESS)
       int y = mode == BKDOC_TOOLBAR ? 10 : FZ_SCREEN_HEIGHT - 50;
     #elif defined(PSP)
       int y = mode == BKDOC_TOOLBAR ? 10 : 240;
@@ -609,7 +699,7 @@ void BKDocument::render() {
       alpha = bannerFrames*(256/32) - 8;
     }
     if (alpha > 0) {
-      #ifdef __vita__
+      #if defined(__vita__) || defined(HEADLESS)
         vita2d_draw_rectangle((FZ_SCREEN_WIDTH / 2) - 180, y, (2*180), 30, 0x222222 | (alpha << 24));
         FZScreen::drawText((FZ_SCREEN_WIDTH / 2) - 180 + 90, y + 21, (0xffffff | (alpha << 24)), 1.0f, banner.c_str());
       #elif defined(PSP)
@@ -645,7 +735,7 @@ void BKDocument::render() {
     texUI->bindForDisplay();
     FZScreen::ambientColor(0xf0222222);
     drawTPill(20, 272 - 75, 480 - 46, 272, 6, 31, 1);
-  #elif defined(__vita__)
+  #elif defined(__vita__) || defined(HEADLESS)
     vita2d_draw_rectangle(40, 544 - 150, 960 - 92, 544, 0xf0222222);
   #endif
 
@@ -654,7 +744,7 @@ void BKDocument::render() {
     FZScreen::ambientColor(0xff555555);
     //drawTPill(25, 272 - 40, 480 - 46 - 11, 40, 6, 31, 1);
     drawTPill(25, 272 - 30, 480 - 46 - 11, 30, 6, 31, 1);
-  #elif defined(__vita__)
+  #elif defined(__vita__) || defined(HEADLESS)
     vita2d_draw_rectangle(96, 494, 768, 50, 0xff555555);
   #endif
 
@@ -680,7 +770,7 @@ void BKDocument::render() {
       40, cs*35+45,
       6, 31, 1
     );
-  #elif defined(__vita__)
+  #elif defined(__vita__) || defined(HEADLESS)
     vita2d_draw_rectangle(40 + toolbarSelMenu*75, 544 - 150 - (cs*55), 
       85, (cs*55) + 65, 0xf0555555);
   #endif
@@ -701,7 +791,7 @@ void BKDocument::render() {
       iw + 10 + 35,
       30,
       6, 31, 1);
-  #elif defined(__vita__)
+  #elif defined(__vita__) || defined(HEADLESS)
     vita2d_draw_rectangle(
       60 + toolbarSelMenu*75 - 10,
       544 - 140 - (selItemI*55) - 55,
@@ -716,7 +806,7 @@ void BKDocument::render() {
       FZScreen::ambientColor(0xffcccccc);
       int tw = textW((char*)it.circleLabel.c_str(), fontBig);
       drawImage(480 - tw - 65, 248, BK_IMG_CROSS_XSIZE, BK_IMG_CROSS_YSIZE, BK_IMG_CROSS_X, BK_IMG_CROSS_Y);
-    #elif defined(__vita__)
+    #elif defined(__vita__) || defined(HEADLESS)
       // printf("here");
       switch (BKUser::controls.select)  {
         case FZ_REPS_CROSS:
@@ -735,7 +825,7 @@ void BKDocument::render() {
   if (it.triangleLabel.size() > 0) {
     #ifdef PSP
       drawImage(37, 248, 20, 18, BK_IMG_TRIANGLE_X, BK_IMG_TRIANGLE_Y);
-    #elif defined(__vita__)
+    #elif defined(__vita__) || defined(HEADLESS)
       vita2d_draw_texture_scale(bk_icons["bk_triangle_icon"]->vita_texture, 20 + 130, FZ_SCREEN_HEIGHT - 50 + 7,
                                 DIALOG_ICON_SCALE, DIALOG_ICON_SCALE);
     #endif
@@ -748,7 +838,7 @@ void BKDocument::render() {
     drawImage(38 + 1*55, 205, 18, 26, 19, 53);
     drawImage(38 + 2*55, 205, 18, 26, 38, 53);
     drawImage(38 + 3*55, 205, 19, 26, 19, 79);
-  #elif defined(__vita__)
+  #elif defined(__vita__) || defined(HEADLESS)
     vita2d_draw_texture_scale(bk_icons["bk_bookmark_icon"]->vita_texture, 60, MENU_ICONS_Y_OFFSET, 
       DIALOG_ICON_SCALE, DIALOG_ICON_SCALE);
 
@@ -785,7 +875,7 @@ void BKDocument::render() {
     fontBig->bindForDisplay();
     FZScreen::ambientColor(0xff000000);
     drawText((char*)it.label.c_str(), fontBig, 40 + toolbarSelMenu*55 + 35, 272 - 156 - selItemI*35+48);
-  #elif defined(__vita__)
+  #elif defined(__vita__) || defined(HEADLESS)
     vita2d_font_draw_text(fontBig->v_font, 
       60 + toolbarSelMenu*75 - 10 + 70,
       544 - 140 - (selItemI*55) - 55 + 33,
@@ -34,6 +34,9 @@ using namespace std;
 class BKDocument : public BKLayer {
 private:
 	int lastSuspendSerial;
+	// time of the last resume() until the page is drawn again
+	double resumeStart;
+	double lastResumeTime;
 	#define BKDOC_VIEW			0
 	#define BKDOC_TOOLBAR		1
 	int mode;
@@ -85,8 +88,16 @@ public:
 	// "Blind" update method for the viwers that need it.
 	virtual int updateContent() = 0;
 
-	// Notify the view of a power resume event
+	// Notify the view of a power resume event. Views should keep their
+	// state and only reopen what the platform invalidated; returning
+	// BK_CMD_RELOAD makes the main loop reopen the whole document.
 	virtual int resume() = 0;
+	// milliseconds from the last resume to the page being drawn again
+	double getLastResumeTime() { return lastResumeTime; }
+	#ifdef DEBUG
+	// run the resume path on the next update, as if the console had slept
+	void simulateSuspend() { lastSuspendSerial = -1; }
+	#endif
 
 	// BKDocument has its own UI shell for the toolbar and labels.
 	virtual void render();
@@ -97,6 +108,38 @@ public:
 	// Factory with file detection
 	static BKDocument* create(string filePath);
 
+	// File type detection from a single header read. Shared by the
+	// factory and the library indexer so a file is only sniffed once.
+	#define BKDOC_FORMAT_UNKNOWN		0
+	#define BKDOC_FORMAT_MUPDF			1
+	#define BKDOC_FORMAT_PLAINTEXT		2
+	#define BKDOC_FORMAT_DJVU			3
+	#define BKDOC_FORMAT_PALMDOC		4
+	// PDB files keep their type and creator at bytes 60 to 67
+	#define BKDOC_HEADER_SIZE			68
+	static int detectFormat(string& filePath, const char* header, int headerSize);
+
+	// Per-stage timing of the last create(), in milliseconds, to see
+	// where open latency goes on slow memory cards.
+	struct OpenTimings {
+		double detect;
+		double open;
+		double countPages;
+		double firstRender;
+		OpenTimings() : detect(0), open(0), countPages(0), firstRender(0) { }
+	};
+	static const OpenTimings& getOpenTimings();
+
+	// Memory - documents stay open in BKDocumentCache after they are
+	// closed, these let the cache weigh and shrink them.
+	// Heap bytes held by the document.
+	virtual size_t getMemoryUsage() { return 0; }
+	// Drop whatever can be rebuilt, the document is in the background.
+	virtual void trimMemory() { }
+	// Keep about percent of the rebuildable caches, the document may be
+	// on screen.
+	virtual void shrinkMemory(int percent) { }
+
 	// Document metadata
 	virtual void getFileName(string&) = 0;
 	virtual void getTitle(string&) = 0;
@@ -107,8 +150,15 @@ public:
 	// based on screen size
 	virtual bool isPaginated() = 0;
 	virtual int getTotalPages() = 0;
+	// Pages in the whole file, as the library counts them; 0 when that
+	// is not known without laying out the rest of a streamed book.
+	virtual int getPageCount() { return 0; }
 	virtual int getCurrentPage() = 0;
 	virtual int setCurrentPage(int) = 0;
+	// The page flip buttons. setCurrentPage() jumps to the page it is
+	// given, these move one view, which may be more than one page.
+	virtual int nextPage() { return setCurrentPage(getCurrentPage() + 1); }
+	virtual int previousPage() { return setCurrentPage(getCurrentPage() - 1); }
 
 	// Zoom
 	// The type field is a hint for the shell UI to select an
@@ -151,6 +201,10 @@ public:
 
 	// banners
 	void setBanner(char*);
+
+protected:
+	// filled in by the viewers while create() runs
+	static OpenTimings openTimings;
 };
 
 #endif
@@ -0,0 +1,171 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <list>
+#include <stdio.h>
+
+#include "bkdocumentcache.h"
+#include "bkdocument.h"
+#include "graphics/fzbufferpool.h"
+#include "graphics/fzmemory.h"
+#include "bkmemorygovernor.h"
+
+// most recently used first
+static list<BKDocumentCache::Entry> cache;
+
+static size_t totalMemory() {
+  size_t total = 0;
+  list<BKDocumentCache::Entry>::iterator it(cache.begin());
+  for (; it != cache.end(); ++it)
+    total += it->doc->getMemoryUsage();
+  return total;
+}
+
+static void evictLast() {
+  #ifdef DEBUG
+    printf("document cache: evicting %s\n", cache.back().path.c_str());
+  #endif
+  cache.pop_back();
+}
+
+// Background documents first give up the caches they can rebuild,
+// then the least recently used ones are closed. The front document is
+// the one on screen and is never touched.
+static void shrink(unsigned int maxDocuments) {
+  size_t budget = BKDocumentCache::getMemoryBudget();
+  if (totalMemory() > budget) {
+    list<BKDocumentCache::Entry>::iterator it(cache.begin());
+    for (++it; it != cache.end(); ++it)
+      it->doc->trimMemory();
+  }
+  while (cache.size() > 1 && (cache.size() > maxDocuments || totalMemory() > budget))
+    evictLast();
+}
+
+BKDocument* BKDocumentCache::find(string& path) {
+  list<Entry>::iterator it(cache.begin());
+  for (; it != cache.end(); ++it) {
+    if (it->path == path) {
+      cache.splice(cache.begin(), cache, it);
+      // the caller gets its own reference
+      return FZRef<BKDocument>(it->doc).detach();
+    }
+  }
+  return nullptr;
+}
+
+void BKDocumentCache::reserve() {
+  // nothing is on screen while a document opens
+  while (cache.size() >= BKDOC_CACHE_MAX_DOCUMENTS)
+    evictLast();
+  if (totalMemory() > getMemoryBudget()) {
+    list<Entry>::iterator it(cache.begin());
+    for (; it != cache.end(); ++it)
+      it->doc->trimMemory();
+    FZBufferPool::trim();
+  }
+}
+
+void BKDocumentCache::insert(string& path, BKDocument* doc) {
+  remove(path);
+  Entry e;
+  e.path = path;
+  e.doc = FZRef<BKDocument>::retain(doc);
+  e.memory = 0;
+  cache.push_front(e);
+  shrink(BKDOC_CACHE_MAX_DOCUMENTS);
+  #ifdef DEBUG
+    report();
+  #endif
+}
+
+void BKDocumentCache::remove(string& path) {
+  list<Entry>::iterator it(cache.begin());
+  for (; it != cache.end(); ++it) {
+    if (it->path == path) {
+      cache.erase(it);
+      return;
+    }
+  }
+}
+
+void BKDocumentCache::clear() {
+  while (!cache.empty())
+    evictLast();
+}
+
+void BKDocumentCache::memoryPressure(int level) {
+  trimBackground();
+  if (level >= FZ_MEM_PRESSURE_CRITICAL && !cache.empty()) {
+    closeBackground();
+    cache.front().doc->trimMemory();
+  }
+}
+
+void BKDocumentCache::trimBackground() {
+  if (cache.empty())
+    return;
+  list<Entry>::iterator it(cache.begin());
+  for (++it; it != cache.end(); ++it)
+    it->doc->trimMemory();
+}
+
+void BKDocumentCache::closeBackground() {
+  while (cache.size() > 1)
+    evictLast();
+}
+
+void BKDocumentCache::shrinkFront(int percent) {
+  if (!cache.empty())
+    cache.front().doc->shrinkMemory(percent);
+}
+
+void BKDocumentCache::getEntries(vector<Entry>& entries) {
+  entries.clear();
+  list<Entry>::iterator it(cache.begin());
+  for (; it != cache.end(); ++it) {
+    Entry e = *it;
+    e.memory = e.doc->getMemoryUsage();
+    entries.push_back(e);
+  }
+}
+
+size_t BKDocumentCache::getMemoryBudget() {
+  return BKMemoryGovernor::getDocumentBudget();
+}
+
+void BKDocumentCache::report(FILE* out) {
+  vector<Entry> entries;
+  getEntries(entries);
+  size_t total = 0;
+  for (unsigned int i = 0; i < entries.size(); i++) {
+    fprintf(out, "document cache: %5u KB %s\n", (unsigned int)(entries[i].memory / 1024), entries[i].path.c_str());
+    total += entries[i].memory;
+  }
+  fprintf(out, "document cache: %5u KB of %u KB budget\n", (unsigned int)(total / 1024), (unsigned int)(getMemoryBudget() / 1024));
+}
@@ -0,0 +1,86 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BKDOCUMENTCACHE_H
+#define BKDOCUMENTCACHE_H
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+#include "graphics/fzrefcount.h"
+
+using namespace std;
+
+class BKDocument;
+
+/*! \brief Keeps recently used documents open.
+ *
+ *  The cache holds its own reference on every document, so closing a
+ *  book only drops it from the layer stack and reopening it skips the
+ *  parse. Documents are evicted least recently used first, when there
+ *  are too many of them or their heap use goes over the budget.
+ */
+class BKDocumentCache {
+  #define BKDOC_CACHE_MAX_DOCUMENTS 3
+
+  public:
+  struct Entry {
+    string path;
+    FZRef<BKDocument> doc;
+    size_t memory;
+  };
+
+  // a retained document for path, or nullptr
+  static BKDocument* find(string& path);
+  // make room before opening a new document
+  static void reserve();
+  // take a reference on a freshly opened document
+  static void insert(string& path, BKDocument* doc);
+  // drop the cached reference, e.g. when the document must be reopened
+  static void remove(string& path);
+  // evict everything, least recently used first
+  static void clear();
+  // FZMemory pressure handler: background documents trim their caches,
+  // under critical pressure they are closed and the front one trims too
+  static void memoryPressure(int level);
+  // background documents drop what they can rebuild
+  static void trimBackground();
+  // evict all but the most recently used document
+  static void closeBackground();
+  // the most recently used document keeps about percent of its caches
+  static void shrinkFront(int percent);
+
+  // per document memory use, most recently used first
+  static void getEntries(vector<Entry>& entries);
+  // from BKMemoryGovernor
+  static size_t getMemoryBudget();
+  static void report(FILE* out = stdout);
+};
+
+#endif
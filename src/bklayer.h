@@ -33,6 +33,8 @@
 #ifdef __vita__
   #include <psp2/kernel/threadmgr.h>
   #include <vita2d.h>
+#elif defined(HEADLESS)
+  #include <vita2d.h>
 #elif MAC
   #define GLEW_STATIC
   #include <GL/glew.h>
@@ -68,6 +70,7 @@ using namespace std;
 #define BK_CMD_ZOOM_IN 29
 #define BK_CMD_OUTLINE_GOTO 30
 #define BK_CMD_OPEN_LAST_FILE 31
+#define BK_CMD_OPEN_LIBRARY_FILE 32
 
 #define BK_CMD_INVOKE_MENU 100
 #define BK_CMD_INVOKE_OPEN_FILE 101
@@ -83,6 +86,7 @@ using namespace std;
 #define BK_CMD_INVOKE_THUMBNAIL_COLOR_SCHEME_MANAGER 110
 #define BK_CMD_INVOKE_ZOOM_IN 111
 #define BK_CMD_INVOKE_OUTLINES 112
+#define BK_CMD_INVOKE_LIBRARY 113
 
 #define BK_IMG_TRIANGLE_X 9
 #define BK_IMG_TRIANGLE_Y 53
@@ -167,15 +171,14 @@ class BKLayer : public FZRefCounted {
     int flags;
     unsigned int fgcolor;
     unsigned int bgcolor;
-    FZTexture* tex;
+    FZRef<FZTexture> tex;
     FZFont* currentTexFont;
     int width;
-    BKMenuItem() : flags(0), tex(0) { }
-    BKMenuItem(string& l, string& cl, int f) : label(l), circleLabel(cl), flags(f), tex(0) { }
-    BKMenuItem(const char* l, string& cl, int f) : label(l), circleLabel(cl), flags(f),tex(0) { }
-    BKMenuItem(string& l, const char* cl, int f) : label(l), circleLabel(cl), flags(f),tex(0) { }
-    BKMenuItem(const char* l, const char* cl, int f) : label(l), circleLabel(cl), flags(f),tex(0) { }
-    ~BKMenuItem(){if(tex) tex->release();}
+    BKMenuItem() : flags(0) { }
+    BKMenuItem(string& l, string& cl, int f) : label(l), circleLabel(cl), flags(f) { }
+    BKMenuItem(const char* l, string& cl, int f) : label(l), circleLabel(cl), flags(f) { }
+    BKMenuItem(string& l, const char* cl, int f) : label(l), circleLabel(cl), flags(f) { }
+    BKMenuItem(const char* l, const char* cl, int f) : label(l), circleLabel(cl), flags(f) { }
   };
   #define BK_OUTLINE_ITEM_HAS_TRIANGLE_LABEL 16
   struct BKOutlineItem : public BKMenuItem {
@@ -185,7 +188,6 @@ class BKLayer : public FZRefCounted {
       label = l;
       circleLabel = cl;
       flags = hasTriLabel?BK_OUTLINE_ITEM_HAS_TRIANGLE_LABEL:0;
-      tex = 0;
     }
   };
 
@@ -29,7 +29,7 @@
 #include "bklayer.h"
 
 // Yeah, ok.
-#ifdef __vita__
+#if defined(__vita__) || defined(HEADLESS)
   #define drawFontTextf(font, x, y, color, size, text, ...) vita2d_font_draw_textf(font->v_font, x, y, color, size, text, __VA_ARGS__)
 #else
   #define drawFontTextf FZScreen::drawFontTextf
@@ -0,0 +1,475 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <map>
+#include <set>
+#include <atomic>
+#include <algorithm>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <tinyxml2.h>
+#include <mupdf/fitz.h>
+
+#include "graphics/fzscreen.h"
+#include "bklibrary.h"
+#include "bkdocument.h"
+#include "bkuser.h"
+#include "utils.h"
+
+/*
+<library version="1">
+  <book path="" title="" format="" pages="" size="" mtime="" opened=""/>
+  ...
+</library>
+*/
+using namespace tinyxml2;
+
+// the scan thread only needs metadata, keep its store small
+#define LIBRARY_STORE_SIZE (4 << 20)
+#define LIBRARY_THREAD_STACK (256 * 1024)
+
+// everything below is shared with the scan thread, guarded by libraryMutex
+static map<string, BKLibraryEntry> entries;
+static bool scanRunning = false;
+static int generation = 0;
+// entries changed since library.xml was last written
+static bool dirty = false;
+static pthread_mutex_t libraryMutex = PTHREAD_MUTEX_INITIALIZER;
+// serialises writers of library.xml
+static pthread_mutex_t saveMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// only touched by the UI thread
+static pthread_t scanThread;
+static bool scanJoinable = false;
+
+static std::atomic<bool> scanCancel(false);
+static string scanRoot;
+
+struct ScanState {
+  fz_context *ctx;
+  set<string> seen;
+  int changed;
+};
+
+static string libraryFileName() {
+  char xmlfilename[1024];
+  #ifdef __vita__
+    snprintf(xmlfilename, 1024, "%s%s%s", FZScreen::basePath().c_str(), "data/Bookr/", LIBRARY_XML);
+  #else
+    snprintf(xmlfilename, 1024, "%s/%s", FZScreen::basePath().c_str(), LIBRARY_XML);
+  #endif
+  return string(xmlfilename);
+}
+
+static string titleFromPath(const string& path) {
+  size_t slash = path.find_last_of("/:");
+  string name = (slash == string::npos) ? path : path.substr(slash + 1);
+  size_t dot = name.rfind('.');
+  if (dot != string::npos && dot > 0)
+    name.resize(dot);
+  return name;
+}
+
+static long longAttribute(XMLElement* e, const char* name) {
+  const char* v = e->Attribute(name);
+  return v ? strtol(v, NULL, 10) : 0;
+}
+
+static void setLongAttribute(XMLElement* e, const char* name, long value) {
+  char v[32];
+  snprintf(v, 32, "%ld", value);
+  e->SetAttribute(name, v);
+}
+
+void BKLibrary::init() {
+  #ifdef DEBUG
+    printf("BKLibrary::init\n");
+  #endif
+
+  string filename = libraryFileName();
+  XMLDocument doc;
+  doc.LoadFile(filename.c_str());
+  if (doc.Error()) {
+    // probably file not found, the first scan will create it
+    #ifdef DEBUG
+      printf("no %s, starting with an empty library\n", filename.c_str());
+    #endif
+    return;
+  }
+
+  XMLElement* root = doc.FirstChildElement("library");
+  if (root == 0) {
+    printf("WARNING: corrupted library file\n");
+    return;
+  }
+
+  pthread_mutex_lock(&libraryMutex);
+  XMLElement* e = root->FirstChildElement("book");
+  while (e) {
+    const char* path = e->Attribute("path");
+    if (path != 0) {
+      BKLibraryEntry b;
+      b.path = path;
+      const char* title = e->Attribute("title");
+      b.title = title ? title : titleFromPath(b.path);
+      e->QueryIntAttribute("format", &b.format);
+      e->QueryIntAttribute("pages", &b.pages);
+      b.size = longAttribute(e, "size");
+      b.mtime = longAttribute(e, "mtime");
+      b.lastOpened = longAttribute(e, "opened");
+      entries[b.path] = b;
+    }
+    e = e->NextSiblingElement("book");
+  }
+  generation++;
+  pthread_mutex_unlock(&libraryMutex);
+}
+
+void BKLibrary::save() {
+  #ifdef DEBUG
+    printf("BKLibrary::save\n");
+  #endif
+
+  pthread_mutex_lock(&saveMutex);
+
+  XMLDocument doc;
+  XMLElement* root = doc.NewElement("library");
+  root->SetAttribute("version", 1);
+  doc.InsertFirstChild(root);
+
+  pthread_mutex_lock(&libraryMutex);
+  map<string, BKLibraryEntry>::iterator it(entries.begin());
+  for (; it != entries.end(); ++it) {
+    BKLibraryEntry& b = it->second;
+    XMLElement* e = doc.NewElement("book");
+    e->SetAttribute("path", b.path.c_str());
+    e->SetAttribute("title", b.title.c_str());
+    e->SetAttribute("format", b.format);
+    e->SetAttribute("pages", b.pages);
+    setLongAttribute(e, "size", b.size);
+    setLongAttribute(e, "mtime", b.mtime);
+    setLongAttribute(e, "opened", b.lastOpened);
+    root->InsertEndChild(e);
+  }
+  dirty = false;
+  pthread_mutex_unlock(&libraryMutex);
+
+  // write next to the old index and swap, so a crash mid-save keeps it
+  string filename = libraryFileName();
+  string tmpname = filename + ".tmp";
+  doc.SaveFile(tmpname.c_str());
+  if (!doc.Error()) {
+    if (rename(tmpname.c_str(), filename.c_str()) != 0) {
+      // sceIoRename will not replace an existing file
+      remove(filename.c_str());
+      rename(tmpname.c_str(), filename.c_str());
+    }
+  } else {
+    printf("WARNING: cannot write %s\n", tmpname.c_str());
+    pthread_mutex_lock(&libraryMutex);
+    dirty = true;
+    pthread_mutex_unlock(&libraryMutex);
+  }
+
+  pthread_mutex_unlock(&saveMutex);
+}
+
+static void readMUMetadata(fz_context* ctx, BKLibraryEntry& b) {
+  fz_document* doc = nullptr;
+  fz_var(doc);
+  fz_try(ctx) {
+    doc = fz_open_document(ctx, b.path.c_str());
+
+    char title[256];
+    if (fz_lookup_metadata(ctx, doc, FZ_META_INFO_TITLE, title, sizeof(title)) > 0 && title[0] != 0)
+      b.title = title;
+
+    // counting the pages of a reflowable document lays out the whole
+    // book; leave it for when the user actually opens it
+    if (!fz_is_document_reflowable(ctx, doc))
+      b.pages = fz_count_pages(ctx, doc);
+  }
+  fz_always(ctx) {
+    fz_drop_document(ctx, doc);
+  }
+  fz_catch(ctx) {
+    #ifdef DEBUG
+      printf("library: cannot read %s: %s\n", b.path.c_str(), fz_caught_message(ctx));
+    #endif
+  }
+}
+
+static void indexFile(ScanState& st, const string& path, long size, long mtime) {
+  BKLibraryEntry b;
+  b.path = path;
+  b.size = size;
+  b.mtime = mtime;
+  b.title = titleFromPath(path);
+
+  int oldFormat = BKDOC_FORMAT_UNKNOWN;
+  int oldPages = 0;
+  pthread_mutex_lock(&libraryMutex);
+  map<string, BKLibraryEntry>::iterator it = entries.find(path);
+  if (it != entries.end()) {
+    if (it->second.size == size && it->second.mtime == mtime) {
+      // unchanged since the last scan
+      pthread_mutex_unlock(&libraryMutex);
+      return;
+    }
+    b.lastOpened = it->second.lastOpened;
+    oldFormat = it->second.format;
+    oldPages = it->second.pages;
+  }
+  pthread_mutex_unlock(&libraryMutex);
+
+  // one small read decides the format; only documents get opened
+  char header[BKDOC_HEADER_SIZE];
+  int n = read_file_header(path.c_str(), header, BKDOC_HEADER_SIZE);
+  string p(path);
+  b.format = (n < 0) ? BKDOC_FORMAT_UNKNOWN : BKDocument::detectFormat(p, header, n);
+  if (b.format == BKDOC_FORMAT_MUPDF && st.ctx != nullptr)
+    readMUMetadata(st.ctx, b);
+  // keep the page count learnt when the book was last opened
+  if (b.pages == 0 && b.format == oldFormat)
+    b.pages = oldPages;
+
+  pthread_mutex_lock(&libraryMutex);
+  entries[path] = b;
+  generation++;
+  dirty = true;
+  pthread_mutex_unlock(&libraryMutex);
+
+  if (++st.changed % LIBRARY_SAVE_EVERY == 0)
+    BKLibrary::save();
+}
+
+static void scanFolder(ScanState& st, const string& path, int depth) {
+  vector<FZDirent> files;
+  if (FZScreen::dirContents(path.c_str(), files) < 0)
+    return;
+
+  vector<FZDirent>::iterator it(files.begin());
+  for (; it != files.end() && !scanCancel; ++it) {
+    string full = path + "/" + it->name;
+    if (it->stat & FZ_STAT_IFDIR) {
+      if (depth < LIBRARY_MAX_DEPTH)
+        scanFolder(st, full, depth + 1);
+    } else if (it->stat & FZ_STAT_IFREG) {
+      st.seen.insert(full);
+      struct stat s;
+      long mtime = 0;
+      if (stat(full.c_str(), &s) == 0)
+        mtime = (long)s.st_mtime;
+      indexFile(st, full, it->size, mtime);
+    }
+  }
+}
+
+// forget the files that are gone; entries outside the walked tree
+// (e.g. opened from another folder) are only dropped if deleted
+static void pruneMissing(ScanState& st) {
+  vector<string> unseen;
+  pthread_mutex_lock(&libraryMutex);
+  map<string, BKLibraryEntry>::iterator it(entries.begin());
+  for (; it != entries.end(); ++it) {
+    if (st.seen.find(it->first) == st.seen.end())
+      unseen.push_back(it->first);
+  }
+  pthread_mutex_unlock(&libraryMutex);
+
+  for (unsigned int i = 0; i < unseen.size() && !scanCancel; i++) {
+    struct stat s;
+    if (stat(unseen[i].c_str(), &s) == 0)
+      continue;
+    pthread_mutex_lock(&libraryMutex);
+    entries.erase(unseen[i]);
+    generation++;
+    dirty = true;
+    pthread_mutex_unlock(&libraryMutex);
+    st.changed++;
+  }
+}
+
+static bool isDirty() {
+  pthread_mutex_lock(&libraryMutex);
+  bool r = dirty;
+  pthread_mutex_unlock(&libraryMutex);
+  return r;
+}
+
+static void* scanMain(void*) {
+  #ifdef DEBUG
+    printf("library: scanning %s\n", scanRoot.c_str());
+  #endif
+  ScanState st;
+  st.changed = 0;
+  st.ctx = fz_new_context(nullptr, nullptr, LIBRARY_STORE_SIZE);
+  if (st.ctx != nullptr) {
+    fz_try(st.ctx) {
+      fz_register_document_handlers(st.ctx);
+    }
+    fz_catch(st.ctx) {
+      fz_drop_context(st.ctx);
+      st.ctx = nullptr;
+    }
+  }
+
+  scanFolder(st, scanRoot, 0);
+  if (!scanCancel)
+    pruneMissing(st);
+
+  if (st.ctx != nullptr)
+    fz_drop_context(st.ctx);
+  // also writes out the books opened while the scan ran
+  if (isDirty())
+    BKLibrary::save();
+
+  #ifdef DEBUG
+    printf("library: scan done, %i changes\n", st.changed);
+  #endif
+  pthread_mutex_lock(&libraryMutex);
+  scanRunning = false;
+  generation++;
+  pthread_mutex_unlock(&libraryMutex);
+  return nullptr;
+}
+
+void BKLibrary::startScan() {
+  if (scanJoinable) {
+    if (isScanning())
+      return;
+    pthread_join(scanThread, nullptr);
+    scanJoinable = false;
+  }
+
+  scanRoot = BKUser::options.libraryFolder.empty() ?
+    BKUser::options.lastFolder : BKUser::options.libraryFolder;
+  scanCancel = false;
+
+  pthread_mutex_lock(&libraryMutex);
+  scanRunning = true;
+  pthread_mutex_unlock(&libraryMutex);
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, LIBRARY_THREAD_STACK);
+  if (pthread_create(&scanThread, &attr, scanMain, nullptr) == 0) {
+    scanJoinable = true;
+  } else {
+    printf("WARNING: cannot start the library scan thread\n");
+    pthread_mutex_lock(&libraryMutex);
+    scanRunning = false;
+    pthread_mutex_unlock(&libraryMutex);
+  }
+  pthread_attr_destroy(&attr);
+}
+
+void BKLibrary::stopScan() {
+  if (!scanJoinable)
+    return;
+  scanCancel = true;
+  pthread_join(scanThread, nullptr);
+  scanJoinable = false;
+}
+
+void BKLibrary::shutdown() {
+  stopScan();
+  if (isDirty())
+    save();
+}
+
+bool BKLibrary::isScanning() {
+  pthread_mutex_lock(&libraryMutex);
+  bool r = scanRunning;
+  pthread_mutex_unlock(&libraryMutex);
+  return r;
+}
+
+int BKLibrary::getGeneration() {
+  pthread_mutex_lock(&libraryMutex);
+  int r = generation;
+  pthread_mutex_unlock(&libraryMutex);
+  return r;
+}
+
+static bool byTitle(const BKLibraryEntry& a, const BKLibraryEntry& b) {
+  return strcasecmp(a.title.c_str(), b.title.c_str()) < 0;
+}
+
+static bool byLastOpened(const BKLibraryEntry& a, const BKLibraryEntry& b) {
+  return a.lastOpened > b.lastOpened;
+}
+
+void BKLibrary::getBooks(BKLibraryList& books) {
+  books.clear();
+  pthread_mutex_lock(&libraryMutex);
+  map<string, BKLibraryEntry>::iterator it(entries.begin());
+  for (; it != entries.end(); ++it) {
+    if (it->second.format != BKDOC_FORMAT_UNKNOWN)
+      books.push_back(it->second);
+  }
+  pthread_mutex_unlock(&libraryMutex);
+  sort(books.begin(), books.end(), byTitle);
+}
+
+void BKLibrary::getRecentBooks(BKLibraryList& books, int max) {
+  books.clear();
+  pthread_mutex_lock(&libraryMutex);
+  map<string, BKLibraryEntry>::iterator it(entries.begin());
+  for (; it != entries.end(); ++it) {
+    if (it->second.lastOpened > 0 && it->second.format != BKDOC_FORMAT_UNKNOWN)
+      books.push_back(it->second);
+  }
+  pthread_mutex_unlock(&libraryMutex);
+  sort(books.begin(), books.end(), byLastOpened);
+  if ((int)books.size() > max)
+    books.resize(max);
+}
+
+void BKLibrary::touch(string& path, int format, int pages) {
+  pthread_mutex_lock(&libraryMutex);
+  BKLibraryEntry& b = entries[path];
+  if (b.path.empty()) {
+    b.path = path;
+    b.title = titleFromPath(path);
+  }
+  b.format = format;
+  if (pages > 0)
+    b.pages = pages;
+  b.lastOpened = (long)time(NULL);
+  generation++;
+  dirty = true;
+  pthread_mutex_unlock(&libraryMutex);
+}
@@ -0,0 +1,90 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BKLIBRARY_H
+#define BKLIBRARY_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// One indexed file. Unknown formats are kept too (format ==
+// BKDOC_FORMAT_UNKNOWN) so unchanged files are not sniffed again.
+struct BKLibraryEntry {
+  string path;
+  string title;
+  int format;
+  int pages;       // 0 when unknown, e.g. reflowable documents
+  long size;
+  long mtime;
+  long lastOpened; // 0 if never opened
+  BKLibraryEntry() : format(0), pages(0), size(0), mtime(0), lastOpened(0) { }
+};
+
+typedef vector<BKLibraryEntry> BKLibraryList;
+
+/*! \brief Persisted index of the books found in the library folder.
+ *
+ *  The index lives in library.xml next to bookmark.xml and is loaded
+ *  at startup, so the library view can be shown before any scan runs.
+ *  A background thread walks the library folder and only sniffs and
+ *  opens files whose size or modification time changed.
+ */
+class BKLibrary {
+  #define LIBRARY_XML "library.xml"
+  #define LIBRARY_MAX_DEPTH 4
+  #define LIBRARY_SAVE_EVERY 32
+
+  public:
+  // load library.xml
+  static void init();
+  // start the background scan of BKUser::options.libraryFolder (or
+  // lastFolder when unset); does nothing if a scan is running
+  static void startScan();
+  // ask the scan thread to stop and wait for it
+  static void stopScan();
+  // stop the scan and write out what changed since the last save
+  static void shutdown();
+  static bool isScanning();
+  // bumped every time the index changes, so views know to refresh
+  static int getGeneration();
+
+  // all known books sorted by title
+  static void getBooks(BKLibraryList& books);
+  // books opened at least once, most recent first
+  static void getRecentBooks(BKLibraryList& books, int max);
+
+  // record that a document was just opened; nothing is written here,
+  // the next scan or shutdown() saves it
+  static void touch(string& path, int format, int pages);
+
+  static void save();
+};
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+
+#include "graphics/fzscreen.h"
+
+#include "bklibraryview.h"
+#include "bkuser.h"
+
+BKLibraryView::BKLibraryView() : mode(BKLV_RECENT), generation(-1) {
+  updateBooks();
+  // nothing read yet, show everything that was found so far
+  if (books.empty()) {
+    mode = BKLV_ALL;
+    updateBooks();
+  }
+}
+
+BKLibraryView::~BKLibraryView() {
+}
+
+void BKLibraryView::updateBooks() {
+  generation = BKLibrary::getGeneration();
+  if (mode == BKLV_RECENT)
+    BKLibrary::getRecentBooks(books, BKLV_MAX_RECENT);
+  else
+    BKLibrary::getBooks(books);
+
+  if (selItem >= (int)books.size())
+    selItem = books.empty() ? 0 : books.size() - 1;
+}
+
+void BKLibraryView::getFullPath(string& s) {
+  s = books[selItem].path;
+}
+
+int BKLibraryView::update(unsigned int buttons) {
+  int r = 0;
+  if (generation != BKLibrary::getGeneration()) {
+    updateBooks();
+    r = BK_CMD_MARK_DIRTY;
+  }
+
+  menuCursorUpdate(buttons, books.empty() ? 1 : (int)books.size());
+  int* b = FZScreen::ctrlReps();
+  if (b[BKUser::controls.select] == 1 && !books.empty()) {
+    return BK_CMD_OPEN_LIBRARY_FILE;
+  }
+
+  if (b[BKUser::controls.alternate] == 1) {
+    mode = (mode == BKLV_RECENT) ? BKLV_ALL : BKLV_RECENT;
+    selItem = 0;
+    topItem = 0;
+    updateBooks();
+    return BK_CMD_MARK_DIRTY;
+  }
+  if (b[BKUser::controls.cancel] == 1) {
+    return BK_CMD_CLOSE_TOP_LAYER;
+  }
+  if (b[BKUser::controls.showMainMenu] == 1) {
+    return BK_CMD_CLOSE_TOP_LAYER;
+  }
+  return r;
+}
+
+void BKLibraryView::render() {
+  vector<BKMenuItem> items;
+  int n = books.size();
+  for (int i = 0; i < n; i++) {
+    string label(books[i].title);
+    if (books[i].pages > 0) {
+      char p[32];
+      snprintf(p, 32, " (%d pages)", books[i].pages);
+      label += p;
+    }
+    items.push_back(BKMenuItem(label, "Open book", 0));
+  }
+  if (items.empty())
+    items.push_back(BKMenuItem(BKLibrary::isScanning() ? "<Scanning...>" : "<No books found>", "", 0));
+
+  string title(mode == BKLV_RECENT ? "Recent books" : "All books");
+  string tl(mode == BKLV_RECENT ? "All books" : "Recent books");
+  char crumb[64];
+  snprintf(crumb, 64, "%d books%s", n, BKLibrary::isScanning() ? ", scanning..." : "");
+  string bc(crumb);
+  drawMenu(title, tl, items, bc);
+}
+
+BKLibraryView* BKLibraryView::create() {
+  BKLibraryView* f = new BKLibraryView();
+  FZScreen::resetReps();
+  return f;
+}
@@ -0,0 +1,67 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BKLIBRARYVIEW_H
+#define BKLIBRARYVIEW_H
+
+#include "graphics/fzscreen.h"
+
+using namespace std;
+
+#include "bklayer.h"
+#include "bklibrary.h"
+
+/*! \brief Lists the books in the library index.
+ *
+ *  Only reads the in-memory index, so it opens instantly; refreshes
+ *  itself while the background scan is adding books.
+ */
+class BKLibraryView : public BKLayer {
+  #define BKLV_RECENT 0
+  #define BKLV_ALL 1
+  #define BKLV_MAX_RECENT 20
+
+  int mode;
+  int generation;
+  BKLibraryList books;
+  void updateBooks();
+
+  protected:
+  BKLibraryView();
+  ~BKLibraryView();
+
+  public:
+  virtual int update(unsigned int buttons);
+  virtual void render();
+
+  void getFullPath(string& s);
+
+  static BKLibraryView* create();
+};
+
+#endif
@@ -31,6 +31,8 @@
 #elif defined(__vita__)
   #include <psp2/kernel/threadmgr.h> 
   #include <vita2d.h>
+#elif defined(HEADLESS)
+  #include <vita2d.h>
 #endif
 
 #include <string.h>
@@ -81,7 +83,7 @@ void BKLogo::render() {
   FZScreen::enable(FZ_TEXTURE_2D); // remove
   FZScreen::disable(FZ_GL_BLEND); // remove
 
-  #ifdef __vita__
+  #if defined(__vita__) || defined(HEADLESS)
     vita2d_draw_texture(texLogo->vita_texture, 350, 150);
     vita2d_font_draw_text(fontBig->v_font, 260, 440, RGBA8(0,0,0,255), TITLE_FONT_SIZE, "TXT - PDF - CBZ - HTML - EPUB - FB2");
 
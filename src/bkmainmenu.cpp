@@ -32,7 +32,7 @@
 
 // Main menu layout
 #define MAIN_MENU_ITEM_OPEN_FILE				0
-#define MAIN_MENU_ITEM_BROWSE_CACHE				1
+#define MAIN_MENU_ITEM_LIBRARY					1
 #define MAIN_MENU_ITEM_CONTROLS					2
 #define MAIN_MENU_ITEM_OPTIONS					3
 #define MAIN_MENU_ITEM_ABOUT					4
@@ -56,23 +56,28 @@
 #define OPTIONS_MENU_ITEM_SET_CONTROL_STYLE		1
 #define OPTIONS_MENU_ITEM_PDF_FAST_IMAGES		2
 #define OPTIONS_MENU_ITEM_PDF_INVERT_COLORS		3
-#define OPTIONS_MENU_ITEM_PLAIN_CHOOSE_FONT		4
-#define OPTIONS_MENU_ITEM_PLAIN_FONT_SIZE		5
-#define OPTIONS_MENU_ITEM_PLAIN_SET_LINE_HEIGHT	6
-#define OPTIONS_MENU_ITEM_PLAIN_JUSTIFY_TEXT	7
-#define OPTIONS_MENU_ITEM_PLAIN_WRAP_TEXT		8
-#define OPTIONS_MENU_ITEM_BROWSER_TEXTSIZE		9
-#define OPTIONS_MENU_ITEM_BROWSER_DISPLAYMODE	10
-#define OPTIONS_MENU_ITEM_BROWSER_ENABLEFLASH	11
-#define OPTIONS_MENU_ITEM_BROWSER_INTERFACEMODE	12
-#define OPTIONS_MENU_ITEM_BROWSER_CONFIRMEXIT	13
-#define OPTIONS_MENU_ITEM_BROWSER_SHOWCURSOR	14
-#define OPTIONS_MENU_ITEM_COLOR_SCHEMES			15
-#define OPTIONS_MENU_ITEM_DISPLAY_LABELS		16
-#define OPTIONS_MENU_ITEM_LOAD_LAST_FILE		17
-#define OPTIONS_MENU_ITEM_CPU_BUS_SPEED			18
-#define OPTIONS_MENU_ITEM_CPU_MENU_SPEED		19
-#define OPTIONS_MENU_ITEM_CLEAR_BOOKMARKS		20
+#define OPTIONS_MENU_ITEM_PDF_CONTINUOUS_SCROLL	4
+#define OPTIONS_MENU_ITEM_PDF_SPREADS			5
+#define OPTIONS_MENU_ITEM_PDF_SPREAD_COVER		6
+#define OPTIONS_MENU_ITEM_PDF_REFLOW			7
+#define OPTIONS_MENU_ITEM_PDF_AUTO_CROP			8
+#define OPTIONS_MENU_ITEM_PLAIN_CHOOSE_FONT		9
+#define OPTIONS_MENU_ITEM_PLAIN_FONT_SIZE		10
+#define OPTIONS_MENU_ITEM_PLAIN_SET_LINE_HEIGHT	11
+#define OPTIONS_MENU_ITEM_PLAIN_JUSTIFY_TEXT	12
+#define OPTIONS_MENU_ITEM_PLAIN_WRAP_TEXT		13
+#define OPTIONS_MENU_ITEM_BROWSER_TEXTSIZE		14
+#define OPTIONS_MENU_ITEM_BROWSER_DISPLAYMODE	15
+#define OPTIONS_MENU_ITEM_BROWSER_ENABLEFLASH	16
+#define OPTIONS_MENU_ITEM_BROWSER_INTERFACEMODE	17
+#define OPTIONS_MENU_ITEM_BROWSER_CONFIRMEXIT	18
+#define OPTIONS_MENU_ITEM_BROWSER_SHOWCURSOR	19
+#define OPTIONS_MENU_ITEM_COLOR_SCHEMES			20
+#define OPTIONS_MENU_ITEM_DISPLAY_LABELS		21
+#define OPTIONS_MENU_ITEM_LOAD_LAST_FILE		22
+#define OPTIONS_MENU_ITEM_CPU_BUS_SPEED			23
+#define OPTIONS_MENU_ITEM_CPU_MENU_SPEED		24
+#define OPTIONS_MENU_ITEM_CLEAR_BOOKMARKS		25
 
 BKMainMenu::BKMainMenu() : mode(BKMM_MAIN), captureButton(false), frames(0) {
 	buildMainMenu();
@@ -101,7 +106,7 @@ void BKMainMenu::rebuildMenu() {
 
 void BKMainMenu::buildMainMenu() {
 	mainItems.push_back(BKMenuItem("Open File", "Select", 0));
-	mainItems.push_back(BKMenuItem("Browse chm Cache", "Select", 0));
+	mainItems.push_back(BKMenuItem("Library", "Select", 0));
 	mainItems.push_back(BKMenuItem("Controls", "Select", 0));
 	mainItems.push_back(BKMenuItem("Options", "Select", 0));
 	mainItems.push_back(BKMenuItem("About", "Select", 0));
@@ -175,6 +180,26 @@ void BKMainMenu::buildOptionMenu() {
 	t += BKUser::options.pdfInvertColors ? "Enabled" : "Disabled";
 	optionItems.push_back(BKMenuItem(t, "Toggle", 0));
 
+	t = "PDF - Continuous scroll: ";
+	t += BKUser::options.pdfContinuousScroll ? "Enabled" : "Disabled";
+	optionItems.push_back(BKMenuItem(t, "Toggle", 0));
+
+	t = "PDF - Two-page spreads: ";
+	t += BKUser::options.pdfSpreads ? "Enabled" : "Disabled";
+	optionItems.push_back(BKMenuItem(t, "Toggle", 0));
+
+	t = "PDF - Spreads start with the cover alone: ";
+	t += BKUser::options.pdfSpreadCover ? "Yes" : "No";
+	optionItems.push_back(BKMenuItem(t, "Toggle", 0));
+
+	t = "PDF - Reflow text: ";
+	t += BKUser::options.pdfReflow ? "Enabled" : "Disabled";
+	optionItems.push_back(BKMenuItem(t, "Toggle", 0));
+
+	t = "PDF - Crop margins: ";
+	t += BKUser::options.pdfAutoCrop ? "Enabled" : "Disabled";
+	optionItems.push_back(BKMenuItem(t, "Toggle", 0));
+
 	t = "Plain text - Font file: ";
 	if (BKUser::options.txtFont == "bookr:builtin") {
 		t += "built-in";
@@ -281,8 +306,8 @@ int BKMainMenu::updateMain(unsigned int buttons) {
 		if (selItem == MAIN_MENU_ITEM_OPEN_FILE) {
 			return BK_CMD_INVOKE_OPEN_FILE;
 		}
-		if (selItem == MAIN_MENU_ITEM_BROWSE_CACHE) {
-			return BK_CMD_INVOKE_BROWSE_CACHE;
+		if (selItem == MAIN_MENU_ITEM_LIBRARY) {
+			return BK_CMD_INVOKE_LIBRARY;
 		}
 		if (selItem == MAIN_MENU_ITEM_CONTROLS) {
 			selItem = 0;
@@ -449,6 +474,31 @@ int BKMainMenu::updateOptions(unsigned int buttons) {
 			buildOptionMenu();
 			return BK_CMD_MARK_DIRTY;
 		}
+		if (selItem == OPTIONS_MENU_ITEM_PDF_CONTINUOUS_SCROLL) {
+			BKUser::options.pdfContinuousScroll = !BKUser::options.pdfContinuousScroll;
+			buildOptionMenu();
+			return BK_CMD_MARK_DIRTY;
+		}
+		if (selItem == OPTIONS_MENU_ITEM_PDF_SPREADS) {
+			BKUser::options.pdfSpreads = !BKUser::options.pdfSpreads;
+			buildOptionMenu();
+			return BK_CMD_MARK_DIRTY;
+		}
+		if (selItem == OPTIONS_MENU_ITEM_PDF_SPREAD_COVER) {
+			BKUser::options.pdfSpreadCover = !BKUser::options.pdfSpreadCover;
+			buildOptionMenu();
+			return BK_CMD_MARK_DIRTY;
+		}
+		if (selItem == OPTIONS_MENU_ITEM_PDF_REFLOW) {
+			BKUser::options.pdfReflow = !BKUser::options.pdfReflow;
+			buildOptionMenu();
+			return BK_CMD_MARK_DIRTY;
+		}
+		if (selItem == OPTIONS_MENU_ITEM_PDF_AUTO_CROP) {
+			BKUser::options.pdfAutoCrop = !BKUser::options.pdfAutoCrop;
+			buildOptionMenu();
+			return BK_CMD_MARK_DIRTY;
+		}
 		if (selItem == OPTIONS_MENU_ITEM_CLEAR_BOOKMARKS) {
 			//BKBookmarksManager::clear();
 			popupText = "Bookmarks cleared.";
@@ -0,0 +1,167 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bkmemorygovernor.h"
+#include "bkdocumentcache.h"
+#include "graphics/fzmemory.h"
+#include "graphics/fzbufferpool.h"
+
+#ifdef __vita__
+  extern int _newlib_heap_size_user;
+  #define BKGOV_HEAP ((size_t)_newlib_heap_size_user)
+#endif
+
+static size_t heapBudget = 0;
+static size_t storeBudget = 0;
+static size_t mupdfBudget = 0;
+static size_t documentBudget = 0;
+static size_t poolBudget = 0;
+static int cooldown = 0;
+static int storeTrims = 0;
+static int futileTrims = 0;
+// FZ_MEM_MUPDF after the last futile trim, 0 if there was none since
+// it was last under the low water mark
+static size_t futileAt = 0;
+
+static bool overHighWater(int tag, size_t budget) {
+  FZMemory::TagStats s;
+  FZMemory::getStats(tag, s);
+  return s.current > budget / 100 * BKGOV_HIGH_WATER_PCT;
+}
+
+void BKMemoryGovernor::init() {
+  setHeap(0);
+  #ifdef __vita__
+    // mallinfo only means something against the real heap
+    FZMemory::setHeapLimit(heapBudget);
+  #endif
+  FZMemory::addPressureHandler(BKDocumentCache::memoryPressure);
+  FZMemory::addPressureHandler(FZBufferPool::memoryPressure);
+}
+
+void BKMemoryGovernor::setHeap(size_t heap) {
+  heapBudget = heap > 0 ? heap : BKGOV_HEAP;
+  storeBudget = heapBudget / 100 * BKGOV_STORE_PCT;
+  mupdfBudget = heapBudget / 100 * BKGOV_MUPDF_PCT;
+  documentBudget = heapBudget / 100 * BKGOV_DOCUMENTS_PCT;
+  poolBudget = heapBudget / 100 * BKGOV_POOL_PCT;
+  FZBufferPool::setCacheLimit(poolBudget);
+  cooldown = 0;
+  futileAt = 0;
+}
+
+void BKMemoryGovernor::update() {
+  FZMemory::checkPressure();
+  if (cooldown > 0) {
+    --cooldown;
+    return;
+  }
+
+  FZMemory::TagStats s;
+  FZMemory::getStats(FZ_MEM_MUPDF, s);
+  size_t low = mupdfBudget / 100 * BKGOV_LOW_WATER_PCT;
+  if (s.current < low)
+    futileAt = 0;
+  bool retry = futileAt == 0 || s.current > futileAt + mupdfBudget / 100 * BKGOV_RETRY_PCT;
+  if (overHighWater(FZ_MEM_MUPDF, mupdfBudget) && retry) {
+    size_t before = s.current;
+    BKDocumentCache::trimBackground();
+    FZMemory::getStats(FZ_MEM_MUPDF, s);
+    if (s.current > low)
+      BKDocumentCache::shrinkFront(low * 100 / s.current);
+    FZMemory::getStats(FZ_MEM_MUPDF, s);
+    size_t freed = before > s.current ? before - s.current : 0;
+    // what is left is not the stores, emptying them again only costs
+    // pages that have to be rendered twice
+    if (freed < mupdfBudget / 100 * BKGOV_FUTILE_PCT) {
+      futileAt = s.current;
+      ++futileTrims;
+    } else {
+      futileAt = 0;
+    }
+    cooldown = BKGOV_COOLDOWN_FRAMES;
+    ++storeTrims;
+    #ifdef DEBUG
+      printf("governor: MuPDF over budget, %u KB after the trim\n", (unsigned int)(s.current / 1024));
+    #endif
+  }
+
+  // a background document holds on to the texture of its last page
+  if (overHighWater(FZ_MEM_TEXTURE, BKGOV_TEXTURE_BUDGET)) {
+    BKDocumentCache::closeBackground();
+    cooldown = BKGOV_COOLDOWN_FRAMES;
+    #ifdef DEBUG
+      printf("governor: textures over budget\n");
+    #endif
+  }
+}
+
+size_t BKMemoryGovernor::getStoreBudget() {
+  return storeBudget;
+}
+
+size_t BKMemoryGovernor::getMupdfBudget() {
+  return mupdfBudget;
+}
+
+size_t BKMemoryGovernor::getDocumentBudget() {
+  return documentBudget;
+}
+
+size_t BKMemoryGovernor::getPoolBudget() {
+  return poolBudget;
+}
+
+size_t BKMemoryGovernor::getTextureBudget() {
+  return BKGOV_TEXTURE_BUDGET;
+}
+
+size_t BKMemoryGovernor::getHeapBudget() {
+  return heapBudget;
+}
+
+int BKMemoryGovernor::getStoreTrims() {
+  return storeTrims;
+}
+
+int BKMemoryGovernor::getFutileTrims() {
+  return futileTrims;
+}
+
+void BKMemoryGovernor::report(FILE* out) {
+  FZMemory::TagStats s;
+  FZMemory::getStats(FZ_MEM_MUPDF, s);
+  fprintf(out, "governor: mupdf    %7u KB of %7u KB (peak %7u KB)\n", (unsigned int)(s.current / 1024),
+    (unsigned int)(mupdfBudget / 1024), (unsigned int)(s.peak / 1024));
+  FZMemory::getStats(FZ_MEM_TEXTURE, s);
+  fprintf(out, "governor: textures %7u KB of %7u KB (peak %7u KB)\n", (unsigned int)(s.current / 1024),
+    (unsigned int)(BKGOV_TEXTURE_BUDGET / 1024), (unsigned int)(s.peak / 1024));
+  FZMemory::getStats(FZ_MEM_POOL, s);
+  fprintf(out, "governor: pool     %7u KB of %7u KB (peak %7u KB)\n", (unsigned int)(s.current / 1024),
+    (unsigned int)(poolBudget / 1024), (unsigned int)(s.peak / 1024));
+}
@@ -0,0 +1,94 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BKMEMORYGOVERNOR_H
+#define BKMEMORYGOVERNOR_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*! \brief Memory budgets for the caches and the policy that keeps them.
+ *
+ *  The heap is split between everything fitz allocates for the open
+ *  documents, the document cache and the idle pixel buffers; GPU
+ *  textures get a budget of their own. Each fitz context also gets a
+ *  store limit, which MuPDF keeps to by itself. Once a frame the
+ *  governor compares the FZMemory tags with their budgets. Over the
+ *  high water mark it trims background documents first and only then
+ *  shrinks the store of the document on screen, aiming for the low
+ *  water mark. When that frees next to nothing the rest is documents
+ *  rather than caches, and it backs off until fitz grows again.
+ */
+class BKMemoryGovernor {
+  // shares of the heap
+  #define BKGOV_STORE_PCT       25  // store limit of each fitz context
+  #define BKGOV_MUPDF_PCT       40  // FZ_MEM_MUPDF: fitz of all documents, stores included
+  #define BKGOV_DOCUMENTS_PCT   50  // everything BKDocumentCache keeps open
+  #define BKGOV_POOL_PCT        20  // idle buffers in FZBufferPool
+  #ifdef __vita__
+    // vita2d allocates textures in CDRAM, outside the newlib heap
+    #define BKGOV_TEXTURE_BUDGET ((size_t)48 * 1024 * 1024)
+  #else
+    #define BKGOV_HEAP            ((size_t)512 * 1024 * 1024)
+    #define BKGOV_TEXTURE_BUDGET ((size_t)256 * 1024 * 1024)
+  #endif
+  #define BKGOV_HIGH_WATER_PCT  90
+  #define BKGOV_LOW_WATER_PCT   70
+  // frames a trim gets to show in the counters before the next one
+  #define BKGOV_COOLDOWN_FRAMES 30
+  // a trim freeing less than this is futile; fitz has to grow this much
+  // past it before the next one
+  #define BKGOV_FUTILE_PCT      1
+  #define BKGOV_RETRY_PCT       10
+
+  public:
+  // set the budgets and register the pressure handlers
+  static void init();
+  // split a heap of this many bytes, 0 for the platform's; contexts
+  // created from then on take the new store budget
+  static void setHeap(size_t heap);
+  // once a frame, on the main thread
+  static void update();
+
+  // the store limit of every fitz context
+  static size_t getStoreBudget();
+  // what FZ_MEM_MUPDF is held to
+  static size_t getMupdfBudget();
+  static size_t getDocumentBudget();
+  static size_t getPoolBudget();
+  static size_t getTextureBudget();
+  static size_t getHeapBudget();
+  // times update() trimmed the MuPDF stores, and how many of those
+  // freed next to nothing
+  static int getStoreTrims();
+  static int getFutileTrims();
+
+  static void report(FILE* out);
+};
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+
+#include "bkmemoryoverlay.h"
+#include "graphics/fzmemory.h"
+
+BKMemoryOverlay::BKMemoryOverlay() : visible(false) {
+}
+
+BKMemoryOverlay::~BKMemoryOverlay() {
+}
+
+int BKMemoryOverlay::update(unsigned int buttons) {
+  return 0;
+}
+
+void BKMemoryOverlay::render() {
+  // heap line, one per tag and the total
+  FZScreen::drawRectangle(BKMEMORY_OVERLAY_X, BKMEMORY_OVERLAY_Y,
+    BKMEMORY_OVERLAY_W, (FZ_MEM_TAGS + 2) * BKMEMORY_OVERLAY_LINE + 10, 0xc0000000);
+
+  int y = BKMEMORY_OVERLAY_Y + BKMEMORY_OVERLAY_LINE;
+  char t[128];
+  int level = FZMemory::getPressureLevel();
+  snprintf(t, 128, "heap %6u KB of %6u KB  pressure %d",
+    (unsigned int)(FZMemory::getHeapUsed() / 1024), (unsigned int)(FZMemory::getHeapLimit() / 1024), level);
+  unsigned int color = 0xff00ff00;
+  if (level == FZ_MEM_PRESSURE_MODERATE)
+    color = 0xff00ffff;
+  else if (level == FZ_MEM_PRESSURE_CRITICAL)
+    color = 0xff0000ff;
+  FZScreen::drawText(BKMEMORY_OVERLAY_X + 10, y, color, 1.0f, t);
+  y += BKMEMORY_OVERLAY_LINE;
+
+  for (int i = 0; i < FZ_MEM_TAGS; ++i) {
+    FZMemory::TagStats s;
+    FZMemory::getStats(i, s);
+    snprintf(t, 128, "%-10s %7u KB  peak %7u KB", FZMemory::getTagName(i),
+      (unsigned int)(s.current / 1024), (unsigned int)(s.peak / 1024));
+    FZScreen::drawText(BKMEMORY_OVERLAY_X + 10, y, 0xffffffff, 1.0f, t);
+    y += BKMEMORY_OVERLAY_LINE;
+  }
+  snprintf(t, 128, "%-10s %7u KB", "total", (unsigned int)(FZMemory::getTotal() / 1024));
+  FZScreen::drawText(BKMEMORY_OVERLAY_X + 10, y, 0xffffffff, 1.0f, t);
+}
+
+void BKMemoryOverlay::setVisible(bool v) {
+  visible = v;
+}
+
+bool BKMemoryOverlay::isVisible() {
+  return visible;
+}
+
+BKMemoryOverlay* BKMemoryOverlay::create() {
+  return new BKMemoryOverlay();
+}
@@ -0,0 +1,62 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BKMEMORYOVERLAY_H
+#define BKMEMORYOVERLAY_H
+
+#include "bklayer.h"
+
+/*! \brief Current and peak bytes of every FZMemory tag.
+ *
+ *  Drawn by the main loop over the other layers while it is switched
+ *  on, like BKProfilerOverlay.
+ */
+class BKMemoryOverlay : public BKLayer {
+  #define BKMEMORY_OVERLAY_X 490
+  #define BKMEMORY_OVERLAY_Y 10
+  #define BKMEMORY_OVERLAY_W 460
+  #define BKMEMORY_OVERLAY_LINE 20
+
+  bool visible;
+
+  protected:
+  BKMemoryOverlay();
+  ~BKMemoryOverlay();
+
+  public:
+  virtual int update(unsigned int buttons);
+  virtual void render();
+
+  void setVisible(bool v);
+  bool isVisible();
+
+  static BKMemoryOverlay* create();
+};
+
+#endif
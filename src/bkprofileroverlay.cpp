@@ -0,0 +1,77 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+
+#include "bkprofileroverlay.h"
+#include "graphics/fzprofiler.h"
+
+BKProfilerOverlay::BKProfilerOverlay() {
+}
+
+BKProfilerOverlay::~BKProfilerOverlay() {
+}
+
+int BKProfilerOverlay::update(unsigned int buttons) {
+  return 0;
+}
+
+void BKProfilerOverlay::render() {
+  FZProfiler::ZoneStats zones[FZ_PROFILE_ZONES];
+  int lines = 1;
+  for (int i = 0; i < FZ_PROFILE_ZONES; ++i) {
+    FZProfiler::getStats(i, zones[i]);
+    if (zones[i].count > 0)
+      ++lines;
+  }
+
+  FZScreen::drawRectangle(BKPROFILER_OVERLAY_X, BKPROFILER_OVERLAY_Y,
+    BKPROFILER_OVERLAY_W, lines * BKPROFILER_OVERLAY_LINE + 10, 0xc0000000);
+
+  int y = BKPROFILER_OVERLAY_Y + BKPROFILER_OVERLAY_LINE;
+  char t[128];
+  // the frame zone spans the whole loop, so this is the frame rate the user sees
+  const FZProfiler::ZoneStats& f = zones[FZ_PROFILE_FRAME];
+  snprintf(t, 128, "%5.1f fps  %5.2fms", f.last > 0.0f ? 1000.0f / f.last : 0.0f, f.last);
+  FZScreen::drawText(BKPROFILER_OVERLAY_X + 10, y, 0xff00ff00, 1.0f, t);
+  y += BKPROFILER_OVERLAY_LINE;
+
+  for (int i = 0; i < FZ_PROFILE_ZONES; ++i) {
+    const FZProfiler::ZoneStats& s = zones[i];
+    if (s.count == 0)
+      continue;
+    snprintf(t, 128, "%-14s %6.2f p50 %6.2f p95 %6.2f p99 %6.2f",
+      FZProfiler::getZoneName(i), s.last, s.p50, s.p95, s.p99);
+    FZScreen::drawText(BKPROFILER_OVERLAY_X + 10, y, 0xffffffff, 1.0f, t);
+    y += BKPROFILER_OVERLAY_LINE;
+  }
+}
+
+BKProfilerOverlay* BKProfilerOverlay::create() {
+  return new BKProfilerOverlay();
+}
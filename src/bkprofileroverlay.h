@@ -0,0 +1,57 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BKPROFILEROVERLAY_H
+#define BKPROFILEROVERLAY_H
+
+#include "bklayer.h"
+
+/*! \brief Live frame time and zone percentiles from FZProfiler.
+ *
+ *  Drawn by the main loop on top of the other layers while the
+ *  profiler is on. It is never pushed on the layer stack, so it does
+ *  not take the input focus.
+ */
+class BKProfilerOverlay : public BKLayer {
+  #define BKPROFILER_OVERLAY_X 10
+  #define BKPROFILER_OVERLAY_Y 10
+  #define BKPROFILER_OVERLAY_W 470
+  #define BKPROFILER_OVERLAY_LINE 20
+
+  protected:
+  BKProfilerOverlay();
+  ~BKProfilerOverlay();
+
+  public:
+  virtual int update(unsigned int buttons);
+  virtual void render();
+
+  static BKProfilerOverlay* create();
+};
+
+#endif
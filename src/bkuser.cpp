@@ -26,11 +26,16 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 #include <tinyxml2.h>
 
 #include "graphics/fzscreen.h"
 #include "bkuser.h"
+#include "utils.h"
 
 #include <string>
 
@@ -39,7 +44,121 @@ using namespace tinyxml2;
 BKUser::Controls BKUser::controls;
 BKUser::Options BKUser::options;
 
-int csSize = 0;
+#define BUTTON(n, d)         { "controls." #n, BKUSER_SETTING_BUTTON, &BKUser::controls.n, d, 0, FZ_REPS_SELECT, FZ_REPS_NOTE }
+#define INT(n, d, lo, hi)    { #n, BKUSER_SETTING_INT, &BKUser::options.n, d, 0, lo, hi }
+#define BOOL(n, d)           { #n, BKUSER_SETTING_BOOL, &BKUser::options.n, d, 0, 0, 1 }
+#define STRING(n, d)         { #n, BKUSER_SETTING_STRING, &BKUser::options.n, 0, d, 0, 0 }
+#define PATH(n)              { #n, BKUSER_SETTING_PATH, &BKUser::options.n, 0, 0, 0, 0 }
+
+// in user.xml order
+static const BKUser::Setting settings[] = {
+  BUTTON(previousPage,    FZ_REPS_SQUARE),
+  BUTTON(nextPage,        FZ_REPS_TRIANGLE),
+  BUTTON(previous10Pages, FZ_REPS_CIRCLE),
+  BUTTON(next10Pages,     FZ_REPS_CROSS),
+  BUTTON(screenUp,        FZ_REPS_UP),
+  BUTTON(screenDown,      FZ_REPS_DOWN),
+  BUTTON(screenLeft,      FZ_REPS_LEFT),
+  BUTTON(screenRight,     FZ_REPS_RIGHT),
+  BUTTON(zoomIn,          FZ_REPS_RTRIGGER),
+  BUTTON(zoomOut,         FZ_REPS_LTRIGGER),
+
+  INT(pageScrollCacheMode, 0, 0, 3),
+  INT(txtRotation, 0, 0, 270),
+  STRING(txtFont, "bookr:builtin"),
+  INT(txtSize, 11, 6, 20),
+  INT(txtHeightPct, 100, 50, 150),
+  INT(currentScheme, 0, 0, 255),
+  BOOL(txtJustify, true),
+  INT(pspSpeed, 0, 0, 6),
+  INT(pspMenuSpeed, 0, 0, 6),
+  BOOL(displayLabels, true),
+  BOOL(pdfInvertColors, false),
+  BOOL(pdfContinuousScroll, false),
+  BOOL(pdfSpreads, false),
+  BOOL(pdfSpreadCover, true),
+  BOOL(pdfReflow, false),
+  BOOL(pdfAutoCrop, false),
+  PATH(lastFolder),
+  PATH(lastFontFolder),
+  STRING(libraryFolder, ""),
+  BOOL(loadLastFile, false),
+  INT(txtWrapCR, 0, 0, 3),
+  INT(hScroll, 50, 1, 1000),
+  INT(vScroll, 20, 1, 1000),
+  INT(thumbnail, 0, 0, 255),
+  INT(currentThumbnailScheme, 0, 0, 255),
+  INT(pdfImageQuality, 3, 0, 3),
+  INT(pdfImageBufferSizeM, 4, 0, 256),
+  INT(analogRateX, 100, 1, 1000),
+  INT(analogRateY, 100, 1, 1000),
+  INT(maxTreeHeight, 100, 0, 10000),
+  INT(screenBrightness, 0, 0, 100),   // 0 disables
+  BOOL(autoPruneBookmarks, false),
+  BOOL(pdfOptimizeForSmallImages, false),
+  INT(defaultTitleMode, 0, 0, 4),
+  BOOL(evictGlyphCacheOnNewPage, false),
+  BOOL(ignoreXInOutlineOnSquare, false),
+  BOOL(jpeg2000Decoder, true),
+};
+
+#undef BUTTON
+#undef INT
+#undef BOOL
+#undef STRING
+#undef PATH
+
+#define SETTINGS_COUNT (int)(sizeof(settings) / sizeof(settings[0]))
+
+const BKUser::Setting* BKUser::getSettings(int& n) {
+  n = SETTINGS_COUNT;
+  return settings;
+}
+
+static const BKUser::Setting* findSetting(const char* name, bool button) {
+  for (int i = 0; i < SETTINGS_COUNT; ++i) {
+    if ((settings[i].type == BKUSER_SETTING_BUTTON) == button && strcmp(settings[i].name, name) == 0)
+      return &settings[i];
+  }
+  return 0;
+}
+
+static void setDefault(const BKUser::Setting& s) {
+  switch (s.type) {
+    case BKUSER_SETTING_INT:
+    case BKUSER_SETTING_BUTTON:
+      *(int*)s.value = s.defaultValue;
+      break;
+    case BKUSER_SETTING_BOOL:
+      *(bool*)s.value = s.defaultValue != 0;
+      break;
+    case BKUSER_SETTING_STRING:
+      *(string*)s.value = s.defaultString;
+      break;
+    case BKUSER_SETTING_PATH:
+      *(string*)s.value = FZScreen::basePath();
+      break;
+  }
+}
+
+// returns false if the value was out of range and the default was used
+static bool setValue(const BKUser::Setting& s, const char* v) {
+  if (s.type == BKUSER_SETTING_STRING || s.type == BKUSER_SETTING_PATH) {
+    *(string*)s.value = v;
+    return true;
+  }
+  char* end;
+  long n = strtol(v, &end, 10);
+  if (end == v || *end != 0 || n < s.minValue || n > s.maxValue) {
+    setDefault(s);
+    return false;
+  }
+  if (s.type == BKUSER_SETTING_BOOL)
+    *(bool*)s.value = n != 0;
+  else
+    *(int*)s.value = (int)n;
+  return true;
+}
 
 void BKUser::init() {
   setDefaultControls();
@@ -49,16 +168,10 @@ void BKUser::init() {
 
 void BKUser::setDefaultControls() {
   // set in-book default controls
-  controls.previousPage     = FZ_REPS_SQUARE;
-  controls.nextPage         = FZ_REPS_TRIANGLE;
-  controls.previous10Pages  = FZ_REPS_CIRCLE;
-  controls.next10Pages      = FZ_REPS_CROSS;
-  controls.screenUp         = FZ_REPS_UP;
-  controls.screenDown       = FZ_REPS_DOWN;
-  controls.screenLeft       = FZ_REPS_LEFT;
-  controls.screenRight      = FZ_REPS_RIGHT;
-  controls.zoomIn           = FZ_REPS_RTRIGGER;
-  controls.zoomOut          = FZ_REPS_LTRIGGER;
+  for (int i = 0; i < SETTINGS_COUNT; ++i) {
+    if (settings[i].type == BKUSER_SETTING_BUTTON)
+      setDefault(settings[i]);
+  }
   controls.showMainMenu     = FZ_REPS_START;
   controls.showToolbar      = FZ_REPS_SELECT;
   
@@ -78,11 +191,12 @@ void BKUser::setDefaultControls() {
 
 void BKUser::setDefaultOptions() {
   // set default options
+  for (int i = 0; i < SETTINGS_COUNT; ++i) {
+    if (settings[i].type != BKUSER_SETTING_BUTTON)
+      setDefault(settings[i]);
+  }
+  // not persisted, see the warning in the options menu
   options.pdfFastScroll = false;
-  options.txtRotation = 0;
-  options.txtFont = "bookr:builtin";
-  options.txtSize = 11;
-  options.txtHeightPct = 100;
 
   options.colorSchemes.clear();
   
@@ -94,380 +208,348 @@ void BKUser::setDefaultOptions() {
   aScheme.txtBGColor = 0;
   aScheme.txtFGColor = 0xffffff;
   options.colorSchemes.push_back(aScheme);
-  
-  options.currentScheme = 0;
-
-  options.txtJustify = true;
-  options.pspSpeed = 0;
-  options.pspMenuSpeed = 0;
-  options.displayLabels = true;
-  options.pdfInvertColors = false;
-  options.lastFolder = FZScreen::basePath();
-  options.lastFontFolder = FZScreen::basePath();
-  options.loadLastFile = false;
-  options.txtWrapCR = 0;
-  options.hScroll = 50;
-  options.vScroll = 20;
-  options.thumbnail = 0;
+
+  options.thumbnailColorSchemes.clear();
 
   ColorScheme tnScheme;
   tnScheme.txtBGColor = 0x000000;
   tnScheme.txtFGColor = 0x0000ff;
   options.thumbnailColorSchemes.push_back(tnScheme);
-  
-  options.currentThumbnailScheme = 0;
-  options.pdfImageQuality = 3;
-  options.pdfImageBufferSizeM = 4;
-  options.analogRateX = 100;
-  options.analogRateY = 100;
-  options.maxTreeHeight = 100;
-  options.screenBrightness = 0; /* disable */
-  options.autoPruneBookmarks = false;
-  options.pdfOptimizeForSmallImages = false;
-  options.defaultTitleMode = 0;
-  options.evictGlyphCacheOnNewPage = false;
-  options.pageScrollCacheMode = 0;
-  options.ignoreXInOutlineOnSquare = false;
-  options.jpeg2000Decoder = true;
 }
 
-void BKUser::save() {
-    #ifdef DEBUG
-      printf("BKUser::save\n");
-    #endif
-
-    char filename[1024];
-    #ifdef __vita__
-      snprintf(filename, 1024, "%s%s", FZScreen::basePath().c_str(), "data/Bookr/user.xml");
-    #else
-      snprintf(filename, 1024, "%s/%s", FZScreen::basePath().c_str(), "user.xml");
-    #endif
-    FILE* f = fopen(filename, "w");
-    if (f == NULL) {
-        printf("cannot save prefs to %s\n", filename);
-        return;
-    }
-
-    fprintf(f, "<?xml version=\"1.0\" standalone=\"no\" ?>\n");
-    fprintf(f, "<user>\n");
-    fprintf(f, "\t<controls>\n");
-
-    fprintf(f, "\t\t<bind action=\"controls.previousPage\" button=\"%d\" />\n", controls.previousPage);
-    fprintf(f, "\t\t<bind action=\"controls.nextPage\" button=\"%d\" />\n", controls.nextPage);
-    fprintf(f, "\t\t<bind action=\"controls.previous10Pages\" button=\"%d\" />\n", controls.previous10Pages);
-    fprintf(f, "\t\t<bind action=\"controls.next10Pages\" button=\"%d\" />\n", controls.next10Pages);
-    fprintf(f, "\t\t<bind action=\"controls.screenUp\" button=\"%d\" />\n", controls.screenUp);
-    fprintf(f, "\t\t<bind action=\"controls.screenDown\" button=\"%d\" />\n", controls.screenDown);
-    fprintf(f, "\t\t<bind action=\"controls.screenLeft\" button=\"%d\" />\n", controls.screenLeft);
-    fprintf(f, "\t\t<bind action=\"controls.screenRight\" button=\"%d\" />\n", controls.screenRight);
-    fprintf(f, "\t\t<bind action=\"controls.zoomIn\" button=\"%d\" />\n", controls.zoomIn);
-    fprintf(f, "\t\t<bind action=\"controls.zoomOut\" button=\"%d\" />\n", controls.zoomOut);
-    
-    fprintf(f, "\t</controls>\n");
-
-    fprintf(f, "\t<options>\n");
-
-    //fprintf(f, "\t\t<set option=\"pdfFastScroll\" value=\"%d\" />\n", options.pdfFastScroll ? 1 : 0);
-    fprintf(f, "\t\t<set option=\"pageScrollCacheMode\" value=\"%d\" />\n", options.pageScrollCacheMode);
-    fprintf(f, "\t\t<set option=\"txtRotation\" value=\"%d\" />\n", options.txtRotation);
-    fprintf(f, "\t\t<set option=\"txtFont\" value=\"%s\" />\n", options.txtFont.c_str());
-    fprintf(f, "\t\t<set option=\"txtSize\" value=\"%d\" />\n", options.txtSize);
-    fprintf(f, "\t\t<set option=\"menuControlStyle\" value=\"%s\" />\n", controls.select == FZ_REPS_CIRCLE ? "asian" : "western");
-    fprintf(f, "\t\t<set option=\"txtHeightPct\" value=\"%d\" />\n", options.txtHeightPct);
-    for (unsigned int i = 0; i < options.colorSchemes.size(); i++) {
-        fprintf(f, "\t\t<set option=\"colorScheme\" id=\"%d\" foreground=\"%d\" background=\"%d\" />\n", i, options.colorSchemes[i].txtFGColor, options.colorSchemes[i].txtBGColor);
-    }
-    fprintf(f, "\t\t<set option=\"currentScheme\" value=\"%d\" />\n", options.currentScheme);
-    fprintf(f, "\t\t<set option=\"txtJustify\" value=\"%d\" />\n", options.txtJustify ? 1 : 0);
-    fprintf(f, "\t\t<set option=\"pspSpeed\" value=\"%d\" />\n", options.pspSpeed);
-    fprintf(f, "\t\t<set option=\"pspMenuSpeed\" value=\"%d\" />\n", options.pspMenuSpeed);
-    fprintf(f, "\t\t<set option=\"displayLabels\" value=\"%d\" />\n", options.displayLabels ? 1 : 0);
-    fprintf(f, "\t\t<set option=\"pdfInvertColors\" value=\"%d\" />\n", options.pdfInvertColors ? 1 : 0);
-    fprintf(f, "\t\t<set option=\"lastFolder\" value=\"%s\" />\n", options.lastFolder.c_str());
-    fprintf(f, "\t\t<set option=\"lastFontFolder\" value=\"%s\" />\n", options.lastFontFolder.c_str());
-    fprintf(f, "\t\t<set option=\"loadLastFile\" value=\"%d\" />\n", options.loadLastFile ? 1 : 0);
-    fprintf(f, "\t\t<set option=\"txtWrapCR\" value=\"%d\" />\n", options.txtWrapCR);
-        fprintf(f, "\t\t<set option=\"hScroll\" value=\"%d\" />\n", options.hScroll);
-        fprintf(f, "\t\t<set option=\"vScroll\" value=\"%d\" />\n", options.vScroll);
-        fprintf(f, "\t\t<set option=\"thumbnail\" value=\"%d\" />\n", options.thumbnail);
-
-    for (unsigned int i = 0; i < options.thumbnailColorSchemes.size(); i++) {
-        fprintf(f, "\t\t<set option=\"thumbnailColorScheme\" id=\"%d\" foreground=\"%d\" background=\"%d\" />\n", i, options.thumbnailColorSchemes[i].txtFGColor, options.thumbnailColorSchemes[i].txtBGColor);
-    }
-    fprintf(f, "\t\t<set option=\"currentThumbnailScheme\" value=\"%d\" />\n", options.currentThumbnailScheme);
-    fprintf(f, "\t\t<set option=\"pdfImageQuality\" value=\"%d\" />\n", options.pdfImageQuality);
-    fprintf(f, "\t\t<set option=\"pdfImageBufferSizeM\" value=\"%d\" />\n", options.pdfImageBufferSizeM);
-
-    fprintf(f, "\t\t<set option=\"analogRateX\" value=\"%d\" />\n", options.analogRateX);
-    fprintf(f, "\t\t<set option=\"analogRateY\" value=\"%d\" />\n", options.analogRateY);
-    fprintf(f, "\t\t<set option=\"maxTreeHeight\" value=\"%d\" />\n", options.maxTreeHeight);
-    fprintf(f, "\t\t<set option=\"screenBrightness\" value=\"%d\" />\n", options.screenBrightness);
-    fprintf(f, "\t\t<set option=\"autoPruneBookmarks\" value=\"%d\" />\n", options.autoPruneBookmarks ? 1 : 0);
-    fprintf(f, "\t\t<set option=\"pdfOptimizeForSmallImages\" value=\"%d\" />\n", options.pdfOptimizeForSmallImages ? 1 : 0);
-    fprintf(f, "\t\t<set option=\"defaultTitleMode\" value=\"%d\" />\n", options.defaultTitleMode);
-    fprintf(f, "\t\t<set option=\"evictGlyphCacheOnNewPage\" value=\"%d\" />\n", options.evictGlyphCacheOnNewPage ? 1 : 0);
-    fprintf(f, "\t\t<set option=\"ignoreXInOutlineOnSquare\" value=\"%d\" />\n", options.ignoreXInOutlineOnSquare ? 1 : 0);
-    fprintf(f, "\t\t<set option=\"jpeg2000Decoder\" value=\"%d\" />\n", options.jpeg2000Decoder ? 1 : 0);
-
-    fprintf(f, "\t</options>\n");
-    fprintf(f, "</user>\n");
-
-    fclose(f);
+static string userFileName() {
+  char filename[1024];
+  #ifdef __vita__
+    snprintf(filename, 1024, "%s%s", FZScreen::basePath().c_str(), "data/Bookr/user.xml");
+  #else
+    snprintf(filename, 1024, "%s/%s", FZScreen::basePath().c_str(), "user.xml");
+  #endif
+  return string(filename);
 }
 
-void BKUser::load() {
-    #ifdef DEBUG
-      printf("BKUser::load\n");
-    #endif
-    
-    char filename[1024];
-    #ifdef __vita__
-      snprintf(filename, 1024, "%s%s", FZScreen::basePath().c_str(), "data/Bookr/user.xml");
-    #else
-      snprintf(filename, 1024, "%s/%s", FZScreen::basePath().c_str(), "user.xml");
-    #endif
-
-    FILE *file = fopen(filename, "r");
-
-    if (!file) {
-      #ifndef DEBUG
-        printf("%s doesn't exist; creating.\n", filename);
-      #endif
-      BKUser::save();
-    }
-    
-    XMLDocument doc;
-    doc.LoadFile(filename);
-
-    if(doc.Error()) {
-      #ifndef DEBUG
-        printf("invalid %s, cannot load preferences: %s\n", filename, doc.GetErrorStr1());
-      #endif
-      return;
-    }
-
-    XMLElement* root = doc.RootElement();
-    XMLElement* controls = root->FirstChildElement("controls");
-    if (controls != 0) {
-        XMLElement* bind = controls->FirstChildElement("bind");
-    
-        while (bind) {
-            const char* action = bind->Attribute("action");
-            const char* button = bind->Attribute("button");
-            if (action == 0 || button == 0) {
-                //printf("invalid user.xml in line %d\n", bind->Row());
-                break;
-            }
-            int b = atoi(button);
-                 if (strncmp(action, "controls.previousPage",    128) == 0) BKUser::controls.previousPage    = b;
-            else if (strncmp(action, "controls.nextPage",        128) == 0) BKUser::controls.nextPage        = b;
-            else if (strncmp(action, "controls.previous10Pages", 128) == 0) BKUser::controls.previous10Pages = b;
-            else if (strncmp(action, "controls.next10Pages",     128) == 0) BKUser::controls.next10Pages     = b;
-            else if (strncmp(action, "controls.screenUp",        128) == 0) BKUser::controls.screenUp        = b;
-            else if (strncmp(action, "controls.screenDown",      128) == 0) BKUser::controls.screenDown      = b;
-            else if (strncmp(action, "controls.screenLeft",      128) == 0) BKUser::controls.screenLeft      = b;
-            else if (strncmp(action, "controls.screenRight",     128) == 0) BKUser::controls.screenRight     = b;
-            else if (strncmp(action, "controls.zoomIn",          128) == 0) BKUser::controls.zoomIn          = b;
-            else if (strncmp(action, "controls.zoomOut",         128) == 0) BKUser::controls.zoomOut         = b;
-    
-            bind = bind->NextSiblingElement("bind");
-        }
-    } else {
-        printf("no controls found in user.xml\n");
-    }
+static void pushColorSchemes(XMLPrinter& p, const char* option, vector<BKUser::ColorScheme>& schemes) {
+  for (unsigned int i = 0; i < schemes.size(); i++) {
+    p.OpenElement("set");
+    p.PushAttribute("option", option);
+    p.PushAttribute("id", (int)i);
+    p.PushAttribute("foreground", schemes[i].txtFGColor);
+    p.PushAttribute("background", schemes[i].txtBGColor);
+    p.CloseElement();
+  }
+}
 
-    XMLElement* eoptions = root->FirstChildElement("options");
-    
-    bool isFirstColorSchemeLoad = true;
-    bool isFirstThumbnailColorSchemeLoad = true;
-
-    if (eoptions != 0) {
-        XMLElement* eset = eoptions->FirstChildElement("set");
-    
-        while (eset) {
-            const char* option = eset->Attribute("option");
-            const char* value = eset->Attribute("value");
-            if (option == 0 || (value == 0 && (strncmp(option, "thumbnailColorScheme", 128) != 0) && (strncmp(option, "colorScheme", 128) != 0))) {
-                //printf("invalid user.xml in line %d\n", eset->Row());
-                break;
-            }
-            else if (strncmp(option, "menuControlStyle", 128) == 0) {
-                // default is western so we only do the asian case
-                if (strncmp(value, "western", 128) == 0) {
-                    BKUser::controls.select = FZ_REPS_CROSS;
-                    BKUser::controls.cancel = FZ_REPS_CIRCLE;
-                } else if (strncmp(value, "asian", 128) == 0) {
-                    BKUser::controls.select = FZ_REPS_CIRCLE;
-                    BKUser::controls.cancel = FZ_REPS_CROSS;
-                }
-            }
-            else if (strncmp(option, "txtRotation",     128) == 0) options.txtRotation     = atoi(value);
-            else if (strncmp(option, "txtFont",         128) == 0) options.txtFont         = value;
-            else if (strncmp(option, "txtHeightPct",    128) == 0) options.txtHeightPct    = atoi(value);
-            else if (strncmp(option, "txtSize",         128) == 0) options.txtSize         = atoi(value);
-            else if (strncmp(option, "txtJustify",      128) == 0) options.txtJustify      = atoi(value) != 0;
-            else if (strncmp(option, "pdfFastScroll",   128) == 0) options.pdfFastScroll   = atoi(value) != 0;
-            else if (strncmp(option, "pageScrollCacheMode",   128) == 0) options.pageScrollCacheMode   = atoi(value);
-            else if (strncmp(option, "colorScheme",	    128) == 0) {
-                
-                // Get the scheme number and color values
-                const char* id = eset->Attribute("id");
-                const char* foreground = eset->Attribute("foreground");
-                const char* background = eset->Attribute("background");
-                
-                if (id == 0 || foreground == 0 || background == 0) {
-                    //printf("invalid user.xml in line %d\n", eset->Row());
-                    break;
-                }
-                
-                // This is needed to ensure that a user who wishes to have a single
-                // color profile can do so. Not clearing would leave the second default
-                // scheme active.
-                if (isFirstColorSchemeLoad) {
-                    options.colorSchemes.clear();
-                    isFirstColorSchemeLoad = false;
-                }
-                
-                int iId = atoi(id);
-                if (iId >= options.colorSchemes.size()) {
-                    options.colorSchemes.resize(iId+1);
-                }
-                
-                options.colorSchemes[iId].txtBGColor = atoi(background);
-                options.colorSchemes[iId].txtFGColor = atoi(foreground);	 
-            }
-            else if (strncmp(option, "currentScheme",   128) == 0) options.currentScheme   = atoi(value);
-            else if (strncmp(option, "pspSpeed",        128) == 0) options.pspSpeed        = atoi(value);
-            else if (strncmp(option, "pspMenuSpeed",    128) == 0) options.pspMenuSpeed    = atoi(value);
-            else if (strncmp(option, "displayLabels",   128) == 0) options.displayLabels   = atoi(value) != 0;
-            else if (strncmp(option, "pdfInvertColors", 128) == 0) options.pdfInvertColors = atoi(value) != 0;
-            else if (strncmp(option, "lastFolder",      128) == 0) options.lastFolder      = value;
-            else if (strncmp(option, "lastFontFolder",  128) == 0) options.lastFontFolder  = value;
-            else if (strncmp(option, "loadLastFile",    128) == 0) options.loadLastFile    = atoi(value) != 0;
-            else if (strncmp(option, "txtWrapCR",       128) == 0) options.txtWrapCR       = atoi(value);
-            else if (strncmp(option, "hScroll",         128) == 0) options.hScroll         = atoi(value);
-            else if (strncmp(option, "vScroll",         128) == 0) options.vScroll         = atoi(value);
-            else if (strncmp(option, "thumbnail",       128) == 0) options.thumbnail       = atoi(value);
-            else if (strncmp(option, "thumbnailColorScheme", 128) == 0) {
-                
-                // Get the scheme number and color values
-                const char* id = eset->Attribute("id");
-                const char* foreground = eset->Attribute("foreground");
-                const char* background = eset->Attribute("background");
-                
-                if (id == 0 || foreground == 0 || background == 0) {
-                    //printf("invalid user.xml in line %d\n", eset->Row());
-                    break;
-                }
-                
-                // This is needed to ensure that a user who wishes to have a single
-                // color profile can do so. Not clearing would leave the second default
-                // scheme active.
-                if (isFirstThumbnailColorSchemeLoad) {
-                    options.thumbnailColorSchemes.clear();
-                    isFirstThumbnailColorSchemeLoad = false;
-                }
-                
-                int iId = atoi(id);
-                if (iId >= options.thumbnailColorSchemes.size()) {
-                    options.thumbnailColorSchemes.resize(iId+1);
-                }
-                
-                options.thumbnailColorSchemes[iId].txtBGColor = atoi(background);
-                options.thumbnailColorSchemes[iId].txtFGColor = atoi(foreground);	 
-            }
-            else if (strncmp(option, "currentThumbnailScheme",   128) == 0) options.currentThumbnailScheme   = atoi(value);
-            else if (strncmp(option, "pdfImageQuality",         128) == 0) options.pdfImageQuality         = atoi(value);
-            else if (strncmp(option, "pdfImageBufferSizeM",         128) == 0) options.pdfImageBufferSizeM         = atoi(value);
-
-            else if (strncmp(option, "analogRateX",         128) == 0) options.analogRateX         = atoi(value);
-            else if (strncmp(option, "analogRateY",         128) == 0) options.analogRateY         = atoi(value);
-            else if (strncmp(option, "maxTreeHeight",         128) == 0) options.maxTreeHeight         = atoi(value);
-            else if (strncmp(option, "screenBrightness",         128) == 0) options.screenBrightness         = atoi(value);
-            else if (strncmp(option, "autoPruneBookmarks",         128) == 0) options.autoPruneBookmarks         = atoi(value)!=0;
-            else if (strncmp(option, "pdfOptimizeForSmallImages",         128) == 0) options.pdfOptimizeForSmallImages         = atoi(value)!=0;
-            else if (strncmp(option, "defaultTitleMode",         128) == 0) options.defaultTitleMode         = atoi(value);
-            else if (strncmp(option, "evictGlyphCacheOnNewPage",         128) == 0) options.evictGlyphCacheOnNewPage         = atoi(value)!=0;
-            else if (strncmp(option, "ignoreXInOutlineOnSquare",         128) == 0) options.ignoreXInOutlineOnSquare         = atoi(value)!=0;
-            else if (strncmp(option, "jpeg2000Decoder",         128) == 0) options.jpeg2000Decoder         = atoi(value)!=0;
-
-            eset = eset->NextSiblingElement("set"); 
-        }
-    } else {
-        printf("no options found in user.xml\n");
-    }
+void BKUser::serialize(string& xml) {
+  XMLPrinter p;
+  p.PushDeclaration("xml version=\"1.0\" standalone=\"no\" ");
+  p.OpenElement("user");
+
+  p.OpenElement("controls");
+  for (int i = 0; i < SETTINGS_COUNT; ++i) {
+    const Setting& s = settings[i];
+    if (s.type != BKUSER_SETTING_BUTTON)
+      continue;
+    p.OpenElement("bind");
+    p.PushAttribute("action", s.name);
+    p.PushAttribute("button", *(int*)s.value);
+    p.CloseElement();
+  }
+  p.CloseElement();
+
+  p.OpenElement("options");
+  for (int i = 0; i < SETTINGS_COUNT; ++i) {
+    const Setting& s = settings[i];
+    if (s.type == BKUSER_SETTING_BUTTON)
+      continue;
+    p.OpenElement("set");
+    p.PushAttribute("option", s.name);
+    if (s.type == BKUSER_SETTING_INT)
+      p.PushAttribute("value", *(int*)s.value);
+    else if (s.type == BKUSER_SETTING_BOOL)
+      p.PushAttribute("value", *(bool*)s.value ? 1 : 0);
+    else
+      p.PushAttribute("value", ((string*)s.value)->c_str());
+    p.CloseElement();
+  }
+  p.OpenElement("set");
+  p.PushAttribute("option", "menuControlStyle");
+  p.PushAttribute("value", controls.select == FZ_REPS_CIRCLE ? "asian" : "western");
+  p.CloseElement();
+  pushColorSchemes(p, "colorScheme", options.colorSchemes);
+  pushColorSchemes(p, "thumbnailColorScheme", options.thumbnailColorSchemes);
+  p.CloseElement();
+
+  p.CloseElement();
+  xml.assign(p.CStr(), p.CStrSize() - 1);
+}
 
-    doc.Clear();
+// Reads one colorScheme element. The first one read replaces the
+// defaults, so a user can keep a single scheme.
+static bool parseColorScheme(XMLElement* e, vector<BKUser::ColorScheme>& schemes, bool& first) {
+  const char* id = e->Attribute("id");
+  const char* foreground = e->Attribute("foreground");
+  const char* background = e->Attribute("background");
+  if (id == 0 || foreground == 0 || background == 0)
+    return false;
+  int iId = atoi(id);
+  if (iId < 0 || iId > 255)
+    return false;
+  if (first) {
+    schemes.clear();
+    first = false;
+  }
+  if (iId >= (int)schemes.size())
+    schemes.resize(iId + 1);
+  schemes[iId].txtBGColor = atoi(background);
+  schemes[iId].txtFGColor = atoi(foreground);
+  return true;
+}
 
-    // fix some possible errors before they crash the app
-    bool operror = false;
-    if (options.txtRotation != 0 && options.txtRotation != 90 && options.txtRotation != 180 && options.txtRotation != 270) {
-        options.txtRotation = 0;
-        operror = true;
+int BKUser::parse(const char* xml, size_t size) {
+  XMLDocument doc;
+  doc.Parse(xml, size);
+  if (doc.Error() || doc.RootElement() == 0)
+    return -1;
+
+  int errors = 0;
+  XMLElement* root = doc.RootElement();
+  XMLElement* econtrols = root->FirstChildElement("controls");
+  if (econtrols != 0) {
+    XMLElement* bind = econtrols->FirstChildElement("bind");
+    while (bind) {
+      const char* action = bind->Attribute("action");
+      const char* button = bind->Attribute("button");
+      const Setting* s = action ? findSetting(action, true) : 0;
+      if (s != 0 && button != 0) {
+        if (!setValue(*s, button))
+          ++errors;
+      }
+      bind = bind->NextSiblingElement("bind");
     }
-    
-    if (options.txtSize < 6 || options.txtSize > 20) {
-        options.txtSize = 11;
-        operror = true;
-    }
-    if (options.txtHeightPct < 50 || options.txtHeightPct > 150) {
-        options.txtHeightPct = 100;
-        operror = true;
-    }
-    
-    vector<ColorScheme>::iterator thisColor = options.colorSchemes.begin();
-    while (thisColor != options.colorSchemes.end()) {
-
-        if ((thisColor->txtFGColor & 0xff000000) != 0) {
-            thisColor->txtFGColor &= 0xffffff;
-            operror = true;
+  }
+
+  XMLElement* eoptions = root->FirstChildElement("options");
+  bool isFirstColorSchemeLoad = true;
+  bool isFirstThumbnailColorSchemeLoad = true;
+  if (eoptions != 0) {
+    XMLElement* eset = eoptions->FirstChildElement("set");
+    while (eset) {
+      const char* option = eset->Attribute("option");
+      const char* value = eset->Attribute("value");
+      if (option == 0) {
+        ++errors;
+      } else if (strcmp(option, "colorScheme") == 0) {
+        if (!parseColorScheme(eset, options.colorSchemes, isFirstColorSchemeLoad))
+          ++errors;
+      } else if (strcmp(option, "thumbnailColorScheme") == 0) {
+        if (!parseColorScheme(eset, options.thumbnailColorSchemes, isFirstThumbnailColorSchemeLoad))
+          ++errors;
+      } else if (value == 0) {
+        ++errors;
+      } else if (strcmp(option, "menuControlStyle") == 0) {
+        if (strcmp(value, "asian") == 0) {
+          controls.select = FZ_REPS_CIRCLE;
+          controls.cancel = FZ_REPS_CROSS;
+        } else {
+          controls.select = FZ_REPS_CROSS;
+          controls.cancel = FZ_REPS_CIRCLE;
         }
-        
-        if ((thisColor->txtBGColor & 0xff000000) != 0) {
-            thisColor->txtBGColor &= 0xffffff;
-            operror = true;
-        }
-        thisColor++;
-    }
-
-    if (options.pspSpeed < 0 || options.pspSpeed > 6) {
-        options.pspSpeed = 0;
-        operror = true;
+      } else if (strcmp(option, "pdfFastScroll") == 0) {
+        // older files
+        options.pdfFastScroll = atoi(value) != 0;
+      } else {
+        // unknown options are dropped, they may come from other forks
+        const Setting* s = findSetting(option, false);
+        if (s != 0 && !setValue(*s, value))
+          ++errors;
+      }
+      eset = eset->NextSiblingElement("set");
     }
-    if (options.pspMenuSpeed < 0 || options.pspMenuSpeed > 6) {
-        options.pspMenuSpeed = 0;
-        operror = true;
+  }
+
+  // checks the table cannot express
+  if (options.txtRotation % 90 != 0) {
+    options.txtRotation = 0;
+    ++errors;
+  }
+  if (options.colorSchemes.empty()) {
+    ColorScheme aScheme;
+    aScheme.txtBGColor = 0xffffff;
+    aScheme.txtFGColor = 0;
+    options.colorSchemes.push_back(aScheme);
+    ++errors;
+  }
+  if (options.currentScheme >= (int)options.colorSchemes.size()) {
+    options.currentScheme = 0;
+    ++errors;
+  }
+  vector<ColorScheme>* lists[2] = { &options.colorSchemes, &options.thumbnailColorSchemes };
+  for (int l = 0; l < 2; ++l) {
+    vector<ColorScheme>::iterator thisColor = lists[l]->begin();
+    while (thisColor != lists[l]->end()) {
+      if ((thisColor->txtFGColor & 0xff000000) != 0) {
+        thisColor->txtFGColor &= 0xffffff;
+        ++errors;
+      }
+      if ((thisColor->txtBGColor & 0xff000000) != 0) {
+        thisColor->txtBGColor &= 0xffffff;
+        ++errors;
+      }
+      thisColor++;
     }
+  }
 
+  if (options.pdfFastScroll || options.pageScrollCacheMode == 3) {
+    options.pageScrollCacheMode = 3;
+    options.pdfFastScroll = true;
+  }
+  return errors;
+}
 
-    vector<ColorScheme>::iterator thisThumbnailColor = options.thumbnailColorSchemes.begin();
-    while (thisThumbnailColor != options.thumbnailColorSchemes.end()) {
+static bool readUserFile(const char* path, string& xml) {
+  FILE* f = fopen(path, "rb");
+  if (f == NULL)
+    return false;
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  xml.resize(size > 0 ? size : 0);
+  size_t n = size > 0 ? fread(&xml[0], 1, size, f) : 0;
+  xml.resize(n);
+  fclose(f);
+  return true;
+}
 
-        if ((thisThumbnailColor->txtFGColor & 0xff000000) != 0) {
-            thisThumbnailColor->txtFGColor &= 0xffffff;
-            operror = true;
-        }
-        
-        if ((thisThumbnailColor->txtBGColor & 0xff000000) != 0) {
-            thisThumbnailColor->txtBGColor &= 0xffffff;
-            operror = true;
-        }
-        thisThumbnailColor++;
-    }
+int BKUser::loadFile(const char* path) {
+  string xml;
+  if (!readUserFile(path, xml))
+    return -1;
+  return parse(xml.data(), xml.size());
+}
 
-    if (operror)
-        BKUser::save();
+void BKUser::load() {
+  #ifdef DEBUG
+    printf("BKUser::load\n");
+    double t = get_time_ms();
+  #endif
+
+  string filename = userFileName();
+  string xml;
+  if (!readUserFile(filename.c_str(), xml)) {
+    printf("%s doesn't exist; creating.\n", filename.c_str());
+    save();
+    return;
+  }
+
+  int errors = parse(xml.data(), xml.size());
+  if (errors < 0) {
+    printf("invalid %s, cannot load preferences\n", filename.c_str());
+    return;
+  }
+  // write back the fixed values before they crash the app next time
+  if (errors > 0)
+    save();
+
+  #ifdef DEBUG
+    printf("BKUser::load %.2fms, %d values reset\n", get_time_ms() - t, errors);
+  #endif
+}
 
-    //free(buffer);
+// Saves are written by a thread of their own, so the menus never wait
+// on the memory card. Only the newest snapshot is kept: a burst of
+// saves while one is being written results in a single extra write.
+#define USER_SAVE_THREAD_STACK (64 * 1024)
+
+static pthread_mutex_t saveMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t saveCond = PTHREAD_COND_INITIALIZER;
+static pthread_t saveThread;
+static bool saveThreadRunning = false;
+static bool saveQuit = false;
+static bool saveQueued = false;
+static bool saveBusy = false;
+static string saveXML;
+
+static void writeUserFile(const string& xml) {
+  // write next to the old file and swap, so a crash mid-save keeps it
+  string filename = userFileName();
+  string tmpname = filename + ".tmp";
+  FILE* f = fopen(tmpname.c_str(), "wb");
+  if (f == NULL) {
+    printf("cannot save prefs to %s\n", tmpname.c_str());
+    return;
+  }
+  bool ok = fwrite(xml.data(), 1, xml.size(), f) == xml.size();
+  ok = fclose(f) == 0 && ok;
+  if (!ok) {
+    printf("cannot save prefs to %s\n", tmpname.c_str());
+    remove(tmpname.c_str());
+    return;
+  }
+  if (rename(tmpname.c_str(), filename.c_str()) != 0) {
+    // sceIoRename will not replace an existing file
+    remove(filename.c_str());
+    rename(tmpname.c_str(), filename.c_str());
+  }
+}
 
-    if (options.pdfFastScroll || options.pageScrollCacheMode == 3){
-      options.pageScrollCacheMode = 3;
-      options.pdfFastScroll = true;
-    }
-    else if (options.pageScrollCacheMode>2||options.pageScrollCacheMode<0){
-      options.pageScrollCacheMode = 0;
-    }
+static void* saveMain(void*) {
+  pthread_mutex_lock(&saveMutex);
+  while (true) {
+    while (!saveQueued && !saveQuit)
+      pthread_cond_wait(&saveCond, &saveMutex);
+    if (!saveQueued)
+      break;
+    string xml;
+    xml.swap(saveXML);
+    saveQueued = false;
+    saveBusy = true;
+    pthread_mutex_unlock(&saveMutex);
+
+    writeUserFile(xml);
+
+    pthread_mutex_lock(&saveMutex);
+    saveBusy = false;
+    pthread_cond_broadcast(&saveCond);
+  }
+  pthread_mutex_unlock(&saveMutex);
+  return nullptr;
+}
 
-    fclose(file);
+void BKUser::save() {
+  #ifdef DEBUG
+    printf("BKUser::save\n");
+  #endif
+
+  string xml;
+  serialize(xml);
+
+  pthread_mutex_lock(&saveMutex);
+  if (!saveThreadRunning && !saveQuit) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, USER_SAVE_THREAD_STACK);
+    saveThreadRunning = pthread_create(&saveThread, &attr, saveMain, nullptr) == 0;
+    pthread_attr_destroy(&attr);
+  }
+  if (!saveThreadRunning) {
+    // no thread (or shutting down), write it here
+    pthread_mutex_unlock(&saveMutex);
+    writeUserFile(xml);
+    return;
+  }
+  saveXML.swap(xml);
+  saveQueued = true;
+  pthread_cond_broadcast(&saveCond);
+  pthread_mutex_unlock(&saveMutex);
 }
 
+void BKUser::shutdown() {
+  pthread_mutex_lock(&saveMutex);
+  saveQuit = true;
+  bool running = saveThreadRunning;
+  saveThreadRunning = false;
+  pthread_cond_broadcast(&saveCond);
+  pthread_mutex_unlock(&saveMutex);
+  // the thread writes what is queued before it quits
+  if (running)
+    pthread_join(saveThread, nullptr);
+}
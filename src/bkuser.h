@@ -21,6 +21,7 @@
 #ifndef BKUSER_H
 #define BKUSER_H
 
+#include <stddef.h>
 #include <vector>
 
 class BKUser {
@@ -29,10 +30,44 @@ class BKUser {
 
 	public:
 	static void init();
+	// snapshot the settings and hand them to the writer thread; user.xml
+	// is replaced atomically, so an interrupted save keeps the old file
 	static void save();
+	// wait for the pending save and stop the writer thread, before exit
+	static void shutdown();
 	static void setDefaultControls();
 	static void setDefaultOptions();
 
+	// user.xml text for the current settings, and the reverse. parse()
+	// only sets what the text has and returns the number of values that
+	// were out of range and reset to their defaults, or -1 if the text
+	// is not a settings file.
+	static void serialize(string& xml);
+	static int parse(const char* xml, size_t size);
+	// parse() on a file other than user.xml, -1 if it cannot be read
+	static int loadFile(const char* path);
+
+	// One entry per persisted value. The table drives the defaults,
+	// user.xml reading and writing and the range checks, so a new
+	// option only needs its field and a line in the table.
+	#define BKUSER_SETTING_INT		0
+	#define BKUSER_SETTING_BOOL		1
+	#define BKUSER_SETTING_STRING	2
+	// string defaulting to FZScreen::basePath()
+	#define BKUSER_SETTING_PATH		3
+	// button code, written as a <bind> in <controls>
+	#define BKUSER_SETTING_BUTTON	4
+	struct Setting {
+		const char* name;
+		int type;
+		void* value;
+		int defaultValue;
+		const char* defaultString;
+		int minValue;
+		int maxValue;
+	};
+	static const Setting* getSettings(int& n);
+
 	struct Controls {
 		// in-book controls
 		int previousPage;
@@ -88,8 +123,19 @@ class BKUser {
 		int pspMenuSpeed;
 		bool displayLabels;
 		bool pdfInvertColors;
+		// PDF pages stacked into one vertical strip
+		bool pdfContinuousScroll;
+		// PDF pages in pairs, overrides continuous scroll
+		bool pdfSpreads;
+		bool pdfSpreadCover;
+		// PDFs open as text laid out by the text viewer
+		bool pdfReflow;
+		// trim white page margins before fitting the page
+		bool pdfAutoCrop;
 		string lastFolder;
 		string lastFontFolder;
+		// root of the background library scan; empty means lastFolder
+		string libraryFolder;
 		int txtHeightPct;
 		bool loadLastFile;
 		int txtWrapCR;
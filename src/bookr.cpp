@@ -42,11 +42,43 @@
 #include "bkmainmenu.h"
 #include "bkpopup.h"
 #include "bkfilechooser.h"
+#include "bklibrary.h"
+#include "bklibraryview.h"
 #include "bkdocument.h"
+#include "bkdocumentcache.h"
+#include "bkmemorygovernor.h"
+#include "graphics/fzbufferpool.h"
+#include "graphics/fzprofiler.h"
+#include "graphics/fzmemory.h"
+#include "graphics/fzinputtrace.h"
+#include "bkprofileroverlay.h"
+#include "bkmemoryoverlay.h"
 
 // Double default 32MB
 int _newlib_heap_size_user = 64 * 1024 * 1024;
 
+// profiler and memory dumps go to the data directory
+static string dataFileName(const char* name) {
+  char filename[1024];
+  #ifdef __vita__
+    snprintf(filename, 1024, "%s%s%s", FZScreen::basePath().c_str(), "data/Bookr/", name);
+  #else
+    snprintf(filename, 1024, "%s/%s", FZScreen::basePath().c_str(), name);
+  #endif
+  return string(filename);
+}
+
+static bool writeMemoryReport(const char* path) {
+  FILE* f = fopen(path, "w");
+  if (f == NULL)
+    return false;
+  FZMemory::report(f);
+  BKMemoryGovernor::report(f);
+  BKDocumentCache::report(f);
+  FZBufferPool::report(f);
+  return fclose(f) == 0;
+}
+
 int main(int argc, char* argv[]) {
   BKDocument *documentLayer = 0; // file we're opening
   FZScreen::open(argc, argv);    // GPU init and initalDraw
@@ -56,14 +88,26 @@ int main(int argc, char* argv[]) {
     printf("Debug Started: in main\n");
   #endif
 
+  BKMemoryGovernor::init();      // cache budgets and pressure handlers
   BKUser::init();                // get app settings from user.xml
+  BKLibrary::init();             // get the book index from library.xml
+  BKLibrary::startScan();        // refresh it in the background
+
+  // a trace left in the data directory drives the pad, to replay a
+  // session and measure its input latency
+  string replay = dataFileName("input-replay.txt");
+  if (FZInputTrace::startReplay(replay.c_str(), dataFileName("input-latency.txt").c_str()))
+    printf("replaying %s\n", replay.c_str());
 
   BKLayer::load();                       // make textures
   bkLayers layers;                       // iterator over all gui obj. that are initalsed
   BKFileChooser* fs = 0;                 // file chooser, only opens when Open File in mainmenu
+  BKLibraryView* lib = 0;                // library view, only opens when Library in mainmenu
   BKMainMenu* mm = BKMainMenu::create(); // Main Menu, only opens when pressed start on opening screen
   layers.push_back(BKLogo::create());    // Logo thats displayed with text at the back, first layer, then everything else draw on top
   layers.push_back(mm);                  // Main Menu
+  BKProfilerOverlay* overlay = BKProfilerOverlay::create(); // frame times, drawn while profiling
+  BKMemoryOverlay* memOverlay = BKMemoryOverlay::create(); // memory per tag, drawn while visible
 
   // Swapping buffers based on dirty variable feels dirty.
   bool dirty = true;
@@ -71,22 +115,38 @@ int main(int argc, char* argv[]) {
   int reloadTimer = 0;
   // Event Loop
   while ( !exitApp )  {
+    FZ_PROFILE(FZ_PROFILE_FRAME);
     // draw state to back buffer and swap
     if (dirty) {
-      FZScreen::startDirectList();
-      bkLayersIt it(layers.begin());
-      bkLayersIt end(layers.end());
-      while (it != end) {
-          (*it)->render();
-          ++it;
+      {
+        FZ_PROFILE(FZ_PROFILE_DRAW);
+        FZScreen::startDirectList();
+        bkLayersIt it(layers.begin());
+        bkLayersIt end(layers.end());
+        while (it != end) {
+            (*it)->render();
+            ++it;
+        }
+        if (FZProfiler::isEnabled())
+          overlay->render();
+        if (memOverlay->isVisible())
+          memOverlay->render();
+        FZScreen::endAndDisplayList();
       }
-      FZScreen::endAndDisplayList();
       FZScreen::swapBuffers();
     }
 
     int buttons = FZScreen::readCtrl();
 
-    dirty = buttons != 0;
+    // keep the overlays live while they are shown
+    dirty = buttons != 0 || FZProfiler::isEnabled() || memOverlay->isVisible();
+    BKMemoryGovernor::update();
+
+    #ifdef HEADLESS
+      // the input script ran out or the frame limit was reached
+      if (FZScreen::isClosing())
+        break;
+    #endif
 
     #if defined(MAC) || defined(WIN32)
       if (buttons == FZ_CTRL_LTRIGGER || FZScreen::isClosing())
@@ -105,7 +165,10 @@ int main(int argc, char* argv[]) {
     #ifdef DEBUG_BUTTONS
       printf("pre update-buttons\n");
     #endif
-    command = (*it)->update(buttons);
+    {
+      FZ_PROFILE(FZ_PROFILE_INPUT);
+      command = (*it)->update(buttons);
+    }
     if (command == BK_CMD_OPEN_FILE) {
       #ifdef DEBUG
         printf("Got BK_CMD_OPEN_FILE\n");
@@ -127,6 +190,8 @@ int main(int argc, char* argv[]) {
       case BK_CMD_CLOSE_TOP_LAYER: {
           bkLayersIt it(layers.end());
           --it;
+          if (*it == documentLayer)
+            documentLayer = nullptr;
           (*it)->release();
           layers.erase(it);
 
@@ -157,7 +222,13 @@ int main(int argc, char* argv[]) {
           layers.push_back(fs);
           break;
       }
+      case BK_CMD_INVOKE_LIBRARY: {
+          lib = BKLibraryView::create();
+          layers.push_back(lib);
+          break;
+      }
       case BK_CMD_RELOAD:
+      case BK_CMD_OPEN_LIBRARY_FILE:
       case BK_CMD_OPEN_FILE: {
         // open a file as a document
         #ifdef DEBUG
@@ -168,9 +239,10 @@ int main(int argc, char* argv[]) {
 
         bool convertToVN = false;
 
-        if (command == BK_CMD_RELOAD) {
+        if (command == BK_CMD_RELOAD && documentLayer != nullptr) {
           documentLayer->getFileName(fileName);
-          documentLayer = 0;
+          // really reopen it, not the cached instance
+          BKDocumentCache::remove(fileName);
         }
         if (command == BK_CMD_OPEN_FILE) {
           // open selected file
@@ -181,6 +253,10 @@ int main(int argc, char* argv[]) {
             printf("getFullPath %s\n", fileName.c_str());
           #endif
         }
+        if (command == BK_CMD_OPEN_LIBRARY_FILE) {
+          lib->getFullPath(fileName);
+          lib = 0;
+        }
         fnCpy = string(fileName);
         
         // clear layers
@@ -194,6 +270,8 @@ int main(int argc, char* argv[]) {
           ++it;
         }
         layers.clear();
+        // released with the other layers, and maybe dropped by the cache
+        documentLayer = nullptr;
         #ifdef DEBUG
           printf("getFullPath post layer clear %s\n", fileName.c_str());
         #endif
@@ -263,12 +341,56 @@ int main(int argc, char* argv[]) {
       if (buttons == FZ_CTRL_LTRIGGER || FZScreen::isClosing())
         break;
     #endif
+    // L+R+Select toggles the profiler and its overlay, L+R+Start dumps
+    // what it recorded as a Chrome trace
+    int* reps = FZScreen::ctrlReps();
+    if (buttons == (FZ_CTRL_LTRIGGER | FZ_CTRL_RTRIGGER | FZ_CTRL_SELECT) && reps[FZ_REPS_SELECT] == 1) {
+      FZProfiler::setEnabled(!FZProfiler::isEnabled());
+      dirty = true;
+    } else if (buttons == (FZ_CTRL_LTRIGGER | FZ_CTRL_RTRIGGER | FZ_CTRL_START) && reps[FZ_REPS_START] == 1
+        && FZProfiler::isEnabled()) {
+      string trace = dataFileName("bookr-trace.json");
+      if (FZProfiler::writeTrace(trace.c_str()))
+        printf("profile written to %s\n", trace.c_str());
+    }
+    // L+R+Triangle shows memory per subsystem, L+R+Square writes it out
+    if (buttons == (FZ_CTRL_LTRIGGER | FZ_CTRL_RTRIGGER | FZ_CTRL_TRIANGLE) && reps[FZ_REPS_TRIANGLE] == 1) {
+      memOverlay->setVisible(!memOverlay->isVisible());
+      dirty = true;
+    } else if (buttons == (FZ_CTRL_LTRIGGER | FZ_CTRL_RTRIGGER | FZ_CTRL_SQUARE) && reps[FZ_REPS_SQUARE] == 1) {
+      string report = dataFileName("bookr-memory.txt");
+      if (writeMemoryReport(report.c_str()))
+        printf("memory report written to %s\n", report.c_str());
+    }
+
+    // L+R+Circle starts and stops recording the pad
+    if (buttons == (FZ_CTRL_LTRIGGER | FZ_CTRL_RTRIGGER | FZ_CTRL_CIRCLE) && reps[FZ_REPS_CIRCLE] == 1
+        && !FZInputTrace::isReplaying()) {
+      string trace = dataFileName("input-trace.txt");
+      if (FZInputTrace::isRecording()) {
+        FZInputTrace::stopRecording();
+        printf("input trace written to %s\n", trace.c_str());
+      } else if (FZInputTrace::startRecording(trace.c_str(), dataFileName("input-latency.txt").c_str())) {
+        printf("recording input to %s\n", trace.c_str());
+      }
+    }
+
     #ifdef DEBUG
       // printf("powerResumed %i\n", FZScreen::getSuspendSerial());
       // Quick close
       if ((buttons == (FZ_CTRL_LTRIGGER | FZ_CTRL_CIRCLE)) ||
           FZScreen::isClosing())
           break;
+      // Simulated suspend/resume, prints how long the page took to come back
+      else if (buttons == (FZ_CTRL_LTRIGGER | FZ_CTRL_SQUARE) && documentLayer != nullptr)
+          documentLayer->simulateSuspend();
+      // Heap use per subsystem, of the open documents and the pixel buffer pool
+      else if (buttons == (FZ_CTRL_LTRIGGER | FZ_CTRL_TRIANGLE)) {
+          FZMemory::report(stdout);
+          BKMemoryGovernor::report(stdout);
+          BKDocumentCache::report();
+          FZBufferPool::report();
+      }
       else {
           FZScreen::checkEvents(buttons);
       }
@@ -287,7 +409,13 @@ int main(int argc, char* argv[]) {
     ++it;
   }
   layers.clear();
+  overlay->release();
+  memOverlay->release();
+  BKDocumentCache::clear(); // close the documents kept open
 
+  FZInputTrace::shutdown(); // write a trace still being recorded
+  BKLibrary::shutdown(); // let the indexer finish, write library.xml
+  BKUser::shutdown();    // write out a pending user.xml save
   FZScreen::close();    // deinit graphics layer
   BKLayer::unload();    // free textures
   FZScreen::exit();
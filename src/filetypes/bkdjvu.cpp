@@ -17,26 +17,19 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
  
-#ifdef PSP
-#include <pspsysmem.h>
-#endif
-
 #include <map>
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
-#include <time.h>
+#include <pthread.h>
 
 #include "bkbookmark.h"
-
-#ifdef MAC
-static void* memalign(int t, int s) {
-	return malloc(s);
-}
-#else
-#include <malloc.h>
-#endif
+#include "bkuser.h"
+#include "bkdocumentcache.h"
+#include "utils.h"
+#include "../graphics/fzbufferpool.h"
+#include "../graphics/fzprofiler.h"
 
 #include "bkdjvu.h"
 
@@ -45,29 +38,61 @@ static void* memalign(int t, int s) {
 
 static const char* bookrName = "bookr";
 
-static const int cacheSize = 4*1024*1024;		//MB
+// the worker decodes with djvulibre on its own stack
+#define DJVU_THREAD_STACK (512 * 1024)
+#define DJVU_BUFFER_SIZE (BKDJVU_VIEW_W * BKDJVU_VIEW_H * 4)
 
 static const float zoomLevels[] = { 0.1f, 0.15f, 0.2f, 0.25f, 0.3f, 0.35f, 0.4f, 0.5f, 0.75f, 0.90f, 1.0f, 1.1f, 1.2f, 1.3f, 1.4f, 1.5f,
 	1.6f, 1.7f, 1.8f, 1.9f, 2.0f, 2.25f, 2.5f, 2.75f, 3.0f };
 
 static const ddjvu_page_rotation_t rotateLevels[] = { DDJVU_ROTATE_0, DDJVU_ROTATE_270, DDJVU_ROTATE_180, DDJVU_ROTATE_90 };
 
-static char* bounceBuffer = NULL;
+// Visible region of a page, as the viewer wants it drawn.
+struct DJVURender {
+	int page;
+	ddjvu_page_rotation_t rotate;
+	ddjvu_rect_t pagerect;		// the whole page at the current zoom
+	ddjvu_rect_t renderrect;	// the part that is on screen
+	int offsetX, offsetY;		// where it lands in the frame
+	unsigned int background;
+};
 
 struct DJVUContext {
-	/* current document params */
-	//string docTitle;
 	ddjvu_context_t *context;
 	ddjvu_document_t *document;
-	ddjvu_page_t *page;
-	
-	/* current page params */
+	int pages;
+
+	/* current page params, viewer side */
 	int pageno;
-	int djvupageno;
 	float zoom;
 	int zoomLevel;
 	ddjvu_page_rotation_t rotate;
 	int rotateLevel;
+
+	/* worker side, guarded by mutex */
+	pthread_t thread;
+	bool running;
+	pthread_mutex_t mutex;
+	pthread_cond_t wake;
+	bool quit;
+	bool trim;
+	bool prefetch;			// off while the document is in the background
+	int wantPage;			// page the viewer is waiting for
+	int infoPage;			// last decoded page and its size
+	int infoWidth, infoHeight;
+	bool infoError;
+	bool renderPending;
+	DJVURender render;
+	// two frames: the worker renders into the back one and swaps
+	char* buffers[2];
+	int front;
+	bool frameReady;
+
+	/* owned by the worker */
+	ddjvu_page_t *page;
+	int pageIndex;
+	ddjvu_page_t *next;		// prefetched page after the current one
+	int nextIndex;
 };
 
 static int djvuHandle(ddjvu_context_t* const ctx, int wait)
@@ -95,47 +120,209 @@ static int djvuHandle(ddjvu_context_t* const ctx, int wait)
 	return retval;
 }
 
- static int djvuInit() {
- 	if (bounceBuffer == NULL) {
-		bounceBuffer = (char*)memalign(16, 480*272*4);
+// Pump messages until the page is decoded. Only the worker calls this,
+// it is the sole consumer of the context's message queue.
+static bool djvuDecodePage(DJVUContext* ctx, ddjvu_page_t* page) {
+	while (!ddjvu_page_decoding_done(page))
+		djvuHandle(ctx->context, TRUE);
+	djvuHandle(ctx->context, FALSE);
+	return ddjvu_page_decoding_status(page) == DDJVU_JOB_OK;
+}
+
+static ddjvu_page_t* djvuNewPage(DJVUContext* ctx, int n) {
+	ddjvu_page_t* page = ddjvu_page_create_by_pageno(ctx->document, n);
+	if (page != NULL && !djvuDecodePage(ctx, page)) {
+		ddjvu_page_release(page);
+		page = NULL;
 	}
- 	return bounceBuffer==NULL?0:1;
- }
+	return page;
+}
+
+// Make n the current page, taking it from the prefetch slot if it is
+// there already.
+static bool djvuLoadPage(DJVUContext* ctx, int n) {
+	if (ctx->page != NULL && ctx->pageIndex == n)
+		return true;
+	ddjvu_page_t* page = NULL;
+	if (ctx->next != NULL && ctx->nextIndex == n) {
+		page = ctx->next;
+		ctx->next = NULL;
+		ctx->nextIndex = -1;
+	} else {
+		page = djvuNewPage(ctx, n);
+	}
+	if (ctx->page != NULL)
+		ddjvu_page_release(ctx->page);
+	ctx->page = page;
+	ctx->pageIndex = page != NULL ? n : -1;
+	return page != NULL;
+}
 
-static DJVUContext* djvuOpen(char *filename) {
-	DJVUContext* ctx = new DJVUContext();
-	if(ctx == NULL) {
-		return NULL;
+static void djvuRenderPage(DJVUContext* ctx, DJVURender& r, char* frame) {
+	{
+		FZ_PROFILE(FZ_PROFILE_PAGE_LOAD);
+		if (!djvuLoadPage(ctx, r.page))
+			return;
 	}
+	FZ_PROFILE(FZ_PROFILE_PAGE_RENDER);
+	if (r.offsetX > 0 || r.offsetY > 0 ||
+		(int)r.renderrect.w < BKDJVU_VIEW_W || (int)r.renderrect.h < BKDJVU_VIEW_H) {
+		unsigned int *d = (unsigned int*)frame;
+		for (int i = 0; i < BKDJVU_VIEW_W * BKDJVU_VIEW_H; i++)
+			*d++ = r.background;
+	}
+	ddjvu_page_set_rotation(ctx->page, r.rotate);
+	// byte order R, G, B, A as the textures want it; the fourth value is
+	// xor'ed into every pixel, which makes them opaque
+	static unsigned int masks[4] = { 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000 };
+	ddjvu_format_t* format = ddjvu_format_create(DDJVU_FORMAT_RGBMASK32, 4, masks);
+	ddjvu_format_set_row_order(format, 1);
+	ddjvu_format_set_y_direction(format, 1);
+	ddjvu_page_render(ctx->page,
+		DDJVU_RENDER_COLOR,
+		&r.pagerect,
+		&r.renderrect,
+		format,
+		BKDJVU_VIEW_W * 4,
+		frame + (r.offsetY * BKDJVU_VIEW_W + r.offsetX) * 4);
+	ddjvu_format_release(format);
+}
+
+static void* djvuWorker(void* arg) {
+	DJVUContext* ctx = (DJVUContext*)arg;
+	pthread_mutex_lock(&ctx->mutex);
+	while (!ctx->quit) {
+		if (ctx->trim) {
+			ctx->trim = false;
+			ctx->prefetch = false;
+			pthread_mutex_unlock(&ctx->mutex);
+			if (ctx->next != NULL)
+				ddjvu_page_release(ctx->next);
+			ctx->next = NULL;
+			ctx->nextIndex = -1;
+			ddjvu_cache_clear(ctx->context);
+			pthread_mutex_lock(&ctx->mutex);
+			continue;
+		}
+		// the page the viewer is waiting for comes first
+		if (ctx->wantPage >= 0 && ctx->infoPage != ctx->wantPage) {
+			int n = ctx->wantPage;
+			pthread_mutex_unlock(&ctx->mutex);
+			int w = 0, h = 0;
+			bool ok = djvuLoadPage(ctx, n);
+			if (ok) {
+				ddjvu_page_set_rotation(ctx->page, DDJVU_ROTATE_0);
+				w = ddjvu_page_get_width(ctx->page);
+				h = ddjvu_page_get_height(ctx->page);
+			}
+			pthread_mutex_lock(&ctx->mutex);
+			ctx->infoPage = n;
+			ctx->infoWidth = w;
+			ctx->infoHeight = h;
+			ctx->infoError = !ok;
+			continue;
+		}
+		if (ctx->renderPending) {
+			DJVURender r = ctx->render;
+			ctx->renderPending = false;
+			char* back = ctx->buffers[1 - ctx->front];
+			pthread_mutex_unlock(&ctx->mutex);
+			djvuRenderPage(ctx, r, back);
+			pthread_mutex_lock(&ctx->mutex);
+			ctx->front = 1 - ctx->front;
+			ctx->frameReady = true;
+			continue;
+		}
+		// idle: decode the next page so turning to it is instant
+		int n = ctx->pageIndex + 1;
+		if (ctx->prefetch && ctx->pageIndex >= 0 && n < ctx->pages && ctx->nextIndex != n) {
+			pthread_mutex_unlock(&ctx->mutex);
+			if (ctx->next != NULL)
+				ddjvu_page_release(ctx->next);
+			ctx->next = djvuNewPage(ctx, n);
+			ctx->nextIndex = n;
+			pthread_mutex_lock(&ctx->mutex);
+			continue;
+		}
+		pthread_cond_wait(&ctx->wake, &ctx->mutex);
+	}
+	pthread_mutex_unlock(&ctx->mutex);
+	return nullptr;
+}
+
+// Each cached document gets its share of the document cache budget.
+static unsigned long djvuCacheSize() {
+	return BKDocumentCache::getMemoryBudget() / BKDOC_CACHE_MAX_DOCUMENTS;
+}
+
+static DJVUContext* djvuOpen(const char *filename) {
+	DJVUContext* ctx = new DJVUContext();
 	memset(ctx, 0, sizeof(DJVUContext));
 
 	ctx->pageno = 1;
-	ctx->djvupageno = 0;
 	ctx->zoom = 0.2f;
 	ctx->zoomLevel = 2;
 	ctx->rotate = DDJVU_ROTATE_0;
 	ctx->rotateLevel = 0;
+	ctx->wantPage = -1;
+	ctx->infoPage = -1;
+	ctx->pageIndex = -1;
+	ctx->nextIndex = -1;
 
 	ctx->context = ddjvu_context_create(bookrName);
 	if(ctx->context == NULL) {
 		delete ctx;
 		return NULL;
 	}
-	ddjvu_cache_set_size(ctx->context, cacheSize);
+	ddjvu_cache_set_size(ctx->context, djvuCacheSize());
 	ctx->document = ddjvu_document_create_by_filename(ctx->context, filename, true);
-	djvuHandle(ctx->context, TRUE);
 	if(ctx->document == NULL) {
 		ddjvu_context_release(ctx->context);
 		delete ctx;
 		return NULL;
 	}
-	//ctx->page = ddjvu_page_create_by_pageno(ctx->document, ctx->djvupageno);	 
-	//djvuHandle(ctx->context, TRUE);
-
+	// only the directory is read here, pages are decoded by the worker
+	while (!ddjvu_document_decoding_done(ctx->document))
+		djvuHandle(ctx->context, TRUE);
+	if (ddjvu_document_decoding_error(ctx->document)) {
+		ddjvu_document_release(ctx->document);
+		ddjvu_context_release(ctx->context);
+		delete ctx;
+		return NULL;
+	}
+	ctx->pages = ddjvu_document_get_pagenum(ctx->document);
+
+	ctx->buffers[0] = (char*)FZBufferPool::alloc(DJVU_BUFFER_SIZE, false);
+	ctx->buffers[1] = (char*)FZBufferPool::alloc(DJVU_BUFFER_SIZE, false);
+	pthread_mutex_init(&ctx->mutex, NULL);
+	pthread_cond_init(&ctx->wake, NULL);
+	if (ctx->buffers[0] != NULL && ctx->buffers[1] != NULL) {
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setstacksize(&attr, DJVU_THREAD_STACK);
+		ctx->running = pthread_create(&ctx->thread, &attr, djvuWorker, ctx) == 0;
+		pthread_attr_destroy(&attr);
+	}
 	return ctx;
 }
 
 static void djvuClose(DJVUContext* ctx) {
+	if (ctx->running) {
+		pthread_mutex_lock(&ctx->mutex);
+		ctx->quit = true;
+		pthread_cond_signal(&ctx->wake);
+		pthread_mutex_unlock(&ctx->mutex);
+		pthread_join(ctx->thread, NULL);
+		ctx->running = false;
+	}
+	pthread_cond_destroy(&ctx->wake);
+	pthread_mutex_destroy(&ctx->mutex);
+	FZBufferPool::release(ctx->buffers[0]);
+	FZBufferPool::release(ctx->buffers[1]);
+	ctx->buffers[0] = ctx->buffers[1] = 0;
+	if (ctx->next)
+		ddjvu_page_release(ctx->next);
+	ctx->next = 0;
 	if (ctx->page)
 		ddjvu_page_release(ctx->page);
 	ctx->page = 0;
@@ -147,18 +334,14 @@ static void djvuClose(DJVUContext* ctx) {
 	ctx->context = 0;
 }
 
-static void djvuFree() {
-	if(bounceBuffer)
-		free(bounceBuffer);
-	bounceBuffer = 0;
-}
-
-BKDJVU::BKDJVU(string& f) : ctx(0), fileName(f), panX(0), panY(0), loadNewPage(false), pageError(false) {
-  resetPanXY = false;
+BKDJVU::BKDJVU(string& f) : ctx(0), fileName(f), panX(0), panY(0), loadNewPage(false),
+	resetPanXY(false), pageError(false), leftMargin(0), pageW(0), pageH(0),
+	pageRequested(0), lastDecodeTime(0) {
+	#if defined(__vita__) || defined(HEADLESS)
+		texture = NULL;
+	#endif
 }
 
-static BKDJVU* singleton = 0;
-
 BKDJVU::~BKDJVU() {
 	if (ctx != 0) {
 		saveLastView();
@@ -166,74 +349,78 @@ BKDJVU::~BKDJVU() {
 		delete ctx;
 	}
 	ctx = 0;
-	djvuFree();
-	singleton = 0;
+	#if defined(__vita__) || defined(HEADLESS)
+		if (texture != NULL) {
+			vita2d_wait_rendering_done();
+			_vita2d_free_counted_texture(texture);
+		}
+		texture = NULL;
+	#endif
 }
 
-BKDJVU* BKDJVU::create(string& file, string& longFileName) {
-	if (singleton != 0) {
-		printf("cannot open more than 1 pdf at the same time\n");
-		return singleton;
-	}
-	
+BKDJVU* BKDJVU::create(string& file) {
+	double t = get_time_ms();
 	BKDJVU* b = new BKDJVU(file);
-	singleton = b;
-	b->longFileName = longFileName;
-	b->xpos_mode = 0;
-	if (!djvuInit())
-		return 0;
 
-	DJVUContext* ctx = djvuOpen((char*)file.c_str());
-	if (ctx == 0) {
-		delete b;
-		return 0;
+	DJVUContext* ctx = djvuOpen(file.c_str());
+	if (ctx == 0 || !ctx->running) {
+		if (ctx != 0) {
+			djvuClose(ctx);
+			delete ctx;
+		}
+		b->release();
+		throw "failed opening document";
 	}
 	b->ctx = ctx;
+	openTimings.open = get_time_ms() - t;
+
 	int lastSlash = -1;
-	int n = b->longFileName.size();
+	int n = file.size();
 	for (int i = 0; i < n; ++i) {
-		if (b->longFileName[i] == '\\')
+		if (file[i] == '\\')
 			lastSlash = i;
-		else if (b->longFileName[i] == '/')
+		else if (file[i] == '/')
 			lastSlash = i;
 	}
-	b->title.assign(b->longFileName, lastSlash+1, n - 1 - lastSlash);
-	
-	//load bookmark info if it is available
-	if (b->isBookmarkable()){
-	  BKBookmark bm;
-	  string fn;
-	  b->getFileName(fn); 
-	  if (BKBookmarksManager::getLastView(fn, bm)) {
-	    b->setBookmarkPosition(bm.viewData);
-	    b->setZoom(bm.zoom);
-	  }
-	}
-	ctx->page = ddjvu_page_create_by_pageno(ctx->document, ctx->djvupageno);
-	//djvuHandle(ctx->context, TRUE);
-	
- 	b->redrawBuffer();
+	b->title.assign(file, lastSlash+1, n - 1 - lastSlash);
+
+	#if defined(__vita__) || defined(HEADLESS)
+		b->texture = _vita2d_create_counted_texture(BKDJVU_VIEW_W, BKDJVU_VIEW_H);
+	#endif
+
+	// BKDocument::create restores the last view; start on the first page
+	// until then
+	b->setCurrentPage(1);
+	b->resetPanXY = true;
 	return b;
 }
 
+int BKDJVU::pageWidth() {
+	return ctx->rotateLevel % 2 ? pageH : pageW;
+}
+
+int BKDJVU::pageHeight() {
+	return ctx->rotateLevel % 2 ? pageW : pageH;
+}
+
 void BKDJVU::clipCoords(float& nx, float& ny) {
-		float w = (float)ddjvu_page_get_width(ctx->page) * ctx->zoom;
-		float h = (float)ddjvu_page_get_height(ctx->page) * ctx->zoom;
+		float w = (float)pageWidth() * ctx->zoom;
+		float h = (float)pageHeight() * ctx->zoom;
 		if (ny < 0.0f) {
 			ny = 0.0f;
 		}
-		if (h <= 272.0f) {
+		if (h <= (float)BKDJVU_VIEW_H) {
 			ny = 0.0f;
-		} else if (ny >= h - 272.0f) {
-			ny = h - 272.0f;
+		} else if (ny >= h - (float)BKDJVU_VIEW_H) {
+			ny = h - (float)BKDJVU_VIEW_H;
 		}
 		if (nx < 0.0f) {
 			nx = 0.0f;
 		}
-		if (w <= 480.0f) {
+		if (w <= (float)BKDJVU_VIEW_W) {
 			nx = 0.0f;
-		} else if (nx >= w - 480.0f) {
-			nx = w - 480.0f;
+		} else if (nx >= w - (float)BKDJVU_VIEW_W) {
+			nx = w - (float)BKDJVU_VIEW_W;
 		}
 }
 
@@ -248,27 +435,18 @@ void BKDJVU::getZoomLevels(vector<BKDocument::ZoomLevel>& v) {
 }
 
 int BKDJVU::getCurrentZoomLevel() {
-	int zl = ctx->zoomLevel;
-// 	if(zoomLevels[zl] != ctx->zoom){
-// 	  zl = 0;
-// 	  while (zoomLevels[zl]<ctx->zoom){
-// 	    zl++;
-// 	  }
-// 	}
-	return zl;
+	return ctx->zoomLevel;
 }
-int BKDJVU::setZoomLevel2(int z) {
 
+// first zoom level at or above z
+int BKDJVU::zoomLevelFor(float z) {
 	int n = sizeof(zoomLevels)/sizeof(float);
-	ctx->zoomLevel = z;
-
-	if (ctx->zoomLevel < 0)
-		ctx->zoomLevel = 0;
-	if (ctx->zoomLevel >= n)
-		ctx->zoomLevel = n - 1;
-  	ctx->zoom = zoomLevels[ctx->zoomLevel];
-	return ctx->zoomLevel;
+	int zl = 0;
+	while (zl < n - 1 && zoomLevels[zl] < z)
+		zl++;
+	return zl;
 }
+
 int BKDJVU::setZoomLevel(int z) {
 	if (z == ctx->zoomLevel)
 		return 0;
@@ -277,163 +455,55 @@ int BKDJVU::setZoomLevel(int z) {
 	  z -= 1;
 
 	int n = sizeof(zoomLevels)/sizeof(float);
+	if (z < 0)
+		z = 0;
+	if (z >= n)
+		z = n - 1;
 	ctx->zoomLevel = z;
 
-	if (ctx->zoomLevel < 0)
-		ctx->zoomLevel = 0;
-	if (ctx->zoomLevel >= n)
-		ctx->zoomLevel = n - 1;
-
-
+	char t[256];
 	if (ctx->zoom == zoomLevels[ctx->zoomLevel]){
-	  char t[256];
 	  snprintf(t, 256, "Zoom %2.3gx", ctx->zoom);
 	  setBanner(t);
-	  //	  redrawBuffer();
 	  return 0;
 	}
 
-        panX = int(float( panX + 240 ) * zoomLevels[ctx->zoomLevel] / ctx->zoom - 240);
-        panY = int(float( panY + 136 ) * zoomLevels[ctx->zoomLevel] / ctx->zoom - 136);
-
-	if(xpos_mode || alwaysSetXPos){
-	  int* currentPage;
-	  int* adjPage;
-	  if (ctx->pageno%2){ // current page is odd page
-	    currentPage = &xpos_odd;
-	    adjPage = &xpos_even;
-	  }
-	  else{ // current page is even page.
-	    currentPage = &xpos_even;
-	    adjPage = &xpos_odd;
-	  }
-	
-	  if(ctx->rotateLevel%2){ //vetical mode, take panY value
-	    *currentPage = panY;
-	    *adjPage = int(float( *adjPage + 136 ) * zoomLevels[ctx->zoomLevel] / ctx->zoom - 136);
-	  }
-	  else{ // normal or upsidedown mode, take panX value
-	    *currentPage = panX;
-	    *adjPage = int(float( *adjPage + 240 ) * zoomLevels[ctx->zoomLevel] / ctx->zoom - 240);
-	  }
-	}
+	// keep the centre of the screen where it was
+	panX = int(float(panX + BKDJVU_VIEW_W / 2) * zoomLevels[ctx->zoomLevel] / ctx->zoom - BKDJVU_VIEW_W / 2);
+	panY = int(float(panY + BKDJVU_VIEW_H / 2) * zoomLevels[ctx->zoomLevel] / ctx->zoom - BKDJVU_VIEW_H / 2);
 
 	ctx->zoom = zoomLevels[ctx->zoomLevel];
-// 	float nx = float(panX)*ctx->zoom;
-// 	float ny = float(panY)*ctx->zoom;
-// 	clipCoords(nx, ny);
-// 	panX = int(nx);
-// 	panY = int(ny);
-	char t[256];
 	snprintf(t, 256, "Zoom %2.3gx", ctx->zoom);
 	setBanner(t);
-	redrawBuffer(true);
+	redrawBuffer();
 	return BK_CMD_MARK_DIRTY;
 }
 
-
 bool BKDJVU::hasZoomToFit() {
 	return true;
 }
 
 int BKDJVU::setZoomToFitWidth() {
-	if (ctx->page) {
-		ctx->zoom = 480.0f/ddjvu_page_get_width(ctx->page);
-		int newzl = ctx->zoomLevel;
-		if(zoomLevels[newzl] != ctx->zoom){
-		  newzl = 0;
-		  while (zoomLevels[newzl]<ctx->zoom){
-		    newzl++;
-		  }
-		  ctx->zoomLevel = newzl;
-		}
-	}
-	
-
-// 	float nx = float(panX)*ctx->zoom;
-// 	float ny = float(panY)*ctx->zoom;
-// 	clipCoords(nx, ny);
-// 	panX = int(nx);
-// 	panY = int(ny);
+	if (pageWidth() <= 0)
+		return 0;
+	ctx->zoom = (float)BKDJVU_VIEW_W / pageWidth();
+	ctx->zoomLevel = zoomLevelFor(ctx->zoom);
 	char t[256];
 	snprintf(t, 256, "Zoom %2.3gx", ctx->zoom);
 	setBanner(t);
-	redrawBuffer(true);
+	redrawBuffer();
 	return BK_CMD_MARK_DIRTY;
 }
 
 int BKDJVU::setZoomToFitHeight() {
-
-	if (ctx->page) {
-		ctx->zoom = 272.0f/ddjvu_page_get_height(ctx->page);
-		int newzl = ctx->zoomLevel;
-		if(zoomLevels[newzl] != ctx->zoom){
-		  newzl = 0;
-		  while (zoomLevels[newzl]<ctx->zoom){
-		    newzl++;
-		  }
-		  ctx->zoomLevel = newzl;
-		}
-	}
-// 	float nx = float(panX)*ctx->zoom;
-// 	float ny = float(panY)*ctx->zoom;
-// 	clipCoords(nx, ny);
-// 	panX = int(nx);
-// 	panY = int(ny);
-	char t[256];
-	snprintf(t, 256, "Zoom %2.3gx", ctx->zoom);
-	setBanner(t);
-	redrawBuffer(true);
-	return BK_CMD_MARK_DIRTY;
-}
-int BKDJVU::setZoomIn(int left, int right) {
-
-	float oldZoom = ctx->zoom;
-	ctx->zoom = oldZoom * 480.0f / (right - left);
-	if (ctx->zoom > 16.0f)
-	  ctx->zoom = 16.0f;
-	int newzl = ctx->zoomLevel;
-	if(zoomLevels[newzl] != ctx->zoom){
-	  newzl = 0;
-	  while (zoomLevels[newzl]<ctx->zoom){
-	    newzl++;
-	  }
-	  ctx->zoomLevel = newzl;
-	}
-	
-	float nx,ny;
-	nx = ((float)panX  + left - leftMargin ) * ctx->zoom/oldZoom;
-	ny = float( panY ) * ctx->zoom / oldZoom;
-	panX = int(nx);
-	panY = int(ny);
-
-	if(xpos_mode || alwaysSetXPos){
-	  int* currentPage;
-	  int* adjPage;
-	  if (ctx->pageno%2){ // current page is odd page
-	    currentPage = &xpos_odd;
-	    adjPage = &xpos_even;
-	  }
-	  else{ // current page is even page.
-	    currentPage = &xpos_even;
-	    adjPage = &xpos_odd;
-	  }
-	
-	  if(ctx->rotateLevel%2){ //vetical mode, take panY value
-	    *currentPage = panY;
-	    *adjPage = int(float( *adjPage ) * ctx->zoom / oldZoom);
-	  }
-	  else{ // normal or upsidedown mode, take panX value
-	    *currentPage = panX;
-	    *adjPage = int(((float)(*adjPage)  + left - leftMargin ) * ctx->zoom/oldZoom);
-	  }
-	}
-
-	resetPanXY = false;
+	if (pageHeight() <= 0)
+		return 0;
+	ctx->zoom = (float)BKDJVU_VIEW_H / pageHeight();
+	ctx->zoomLevel = zoomLevelFor(ctx->zoom);
 	char t[256];
 	snprintf(t, 256, "Zoom %2.3gx", ctx->zoom);
 	setBanner(t);
-	redrawBuffer(true);
+	redrawBuffer();
 	return BK_CMD_MARK_DIRTY;
 }
 
@@ -443,26 +513,25 @@ bool BKDJVU::isBookmarkable() {
 
 void BKDJVU::getBookmarkPosition(map<string, float>& m) {
 	m["page"] = ctx->pageno;
-	m["zoom"] = ctx->zoomLevel;
+	m["zoom"] = ctx->zoom;
 	m["panX"] = panX;
 	m["panY"] = panY;
 	m["rotation"] = ctx->rotateLevel;
-	m["xpos_mode"] = xpos_mode;
-	m["xpos_even"] = xpos_even;
-	m["xpos_odd"] = xpos_odd;
-
 }
 
 int BKDJVU::setBookmarkPosition(map<string, float>& m) {
-	setCurrentPage(m["page"]);
-	setZoomLevel2(m["zoom"]);
-	setRotation2(m["rotation"]);
+	setCurrentPage((int)m["page"]);
+	float z = get_or(m, "zoom", 0.2f);
+	if (z > 0.0f) {
+		ctx->zoom = z;
+		ctx->zoomLevel = zoomLevelFor(z);
+	}
+	int r = (int)get_or(m, "rotation", 0);
+	ctx->rotateLevel = r >= 0 && r < 4 ? r : 0;
+	ctx->rotate = rotateLevels[ctx->rotateLevel];
 	panX = m["panX"];
 	panY = m["panY"];
-	xpos_mode = m["xpos_mode"];
-	xpos_even = m["xpos_even"];
-	xpos_odd = m["xpos_odd"];
-	loadNewPage = true;
+	// the page is not decoded yet, keep the saved position
 	resetPanXY = false;
 	return BK_CMD_MARK_DIRTY;
 }
@@ -472,7 +541,7 @@ bool BKDJVU::isPaginated() {
 }
 
 int BKDJVU::getTotalPages() {
-	return ddjvu_document_get_pagenum(ctx->document);
+	return ctx->pages;
 }
 
 int BKDJVU::getCurrentPage() {
@@ -480,23 +549,27 @@ int BKDJVU::getCurrentPage() {
 }
 
 int BKDJVU::setCurrentPage(int position) {
-	ctx->djvupageno = ctx->pageno-1; 
+	if (position < 1)
+		position = 1;
+	if (position > getTotalPages())
+		position = getTotalPages();
+	if (position == ctx->pageno && !loadNewPage && pageW > 0)
+		return 0;
 	ctx->pageno = position;
-	if (ctx->pageno < 1)
-		ctx->pageno = 1;
-	if (ctx->pageno > getTotalPages())
-		ctx->pageno = getTotalPages();
-	if (ctx->pageno-1 != ctx->djvupageno) {
-		loadNewPage = true;
-		resetPanXY = true;
-		char t[256];
-		snprintf(t, 256, "Loading page %d", ctx->pageno);
-		setBanner(t);
-		//panX = 0;
-		//panY = 0;
-		return BK_CMD_MARK_DIRTY;
-	}
-	return 0;
+	loadNewPage = true;
+	resetPanXY = true;
+	pageRequested = get_time_ms();
+
+	pthread_mutex_lock(&ctx->mutex);
+	ctx->wantPage = position - 1;
+	ctx->prefetch = true;
+	pthread_cond_signal(&ctx->wake);
+	pthread_mutex_unlock(&ctx->mutex);
+
+	char t[256];
+	snprintf(t, 256, "Loading page %d", ctx->pageno);
+	setBanner(t);
+	return BK_CMD_MARK_DIRTY;
 }
 
 bool BKDJVU::isRotable() {
@@ -507,131 +580,48 @@ int BKDJVU::getRotation() {
 	return ctx->rotateLevel;
 }
 
-int BKDJVU::setRotation2(int z, bool bForce) {
-	int n = 4;
-	ctx->rotateLevel = z;
-
-	if (ctx->rotateLevel < 0)
-		ctx->rotateLevel = 3;
-	if (ctx->rotateLevel >= n)
-		ctx->rotateLevel = 0;
-
-	ctx->rotate = rotateLevels[ctx->rotateLevel];
-	return ctx->rotate;
-}
-
 int BKDJVU::setRotation(int z, bool bForce) {
-
 	if (z == ctx->rotateLevel)
 		return 0;
 
-	int panYc = panY + 136;
-	int panXc = panX + 240;
+	int panYc = panY + BKDJVU_VIEW_H / 2;
+	int panXc = panX + BKDJVU_VIEW_W / 2;
+	// size of the page as it is shown now
+	int w = (int)((float)pageWidth() * ctx->zoom);
+	int h = (int)((float)pageHeight() * ctx->zoom);
 
 	switch (z - ctx->rotateLevel) {
-	    case 1:  // clockwise
-		panY = panXc - 136;
-		panX = (int)((float)ddjvu_page_get_height(ctx->page) * ctx->zoom) - panYc - 240;
-
-		if(xpos_mode || alwaysSetXPos){
-		  int* currentPage;
-		  int* adjPage;
-		  if (ctx->pageno%2){ // current page is odd page
-		    currentPage = &xpos_odd;
-		    adjPage = &xpos_even;
-		  }
-		  else{ // current page is even page.
-		    currentPage = &xpos_even;
-		    adjPage = &xpos_odd;
-		  }
-		  
-		  if(z%2){ //vetical mode, take panY value
-		    *currentPage = panY;
-		    *adjPage = *adjPage+240-136;
-		  }
-		  else{ // normal or upsidedown mode, take panX value
-		    *currentPage = panX;
-		    *adjPage = (int)((float)ddjvu_page_get_height(ctx->page) * ctx->zoom) - (*adjPage + 136) - 240;
-		  }
-		}
-
-		break;
-	    case -1:  // counter clockwise
-		panX = panYc - 240;
-		panY = (int)((float)ddjvu_page_get_width(ctx->page) * ctx->zoom) - panXc - 136;
-
-		if(xpos_mode || alwaysSetXPos){
-		  int* currentPage;
-		  int* adjPage;
-		  if (ctx->pageno%2){ // current page is odd page
-		    currentPage = &xpos_odd;
-		    adjPage = &xpos_even;
-		  }
-		  else{ // current page is even page.
-		    currentPage = &xpos_even;
-		    adjPage = &xpos_odd;
-		  }
-		  
-		  if(z%2){ //vetical mode, take panY value
-		    *currentPage = panY;
-		    *adjPage = (int)((float)ddjvu_page_get_width(ctx->page) * ctx->zoom) - (*adjPage+240) - 136;
-		  }
-		  else{ // normal or upsidedown mode, take panX value
-		    *currentPage = panX;
-		    *adjPage = (*adjPage + 136) - 240;
-		  }
-		}
-
-		break;
-	    default: //error, shouldn't be here.
-		;
+		case 1:
+		case -3:  // clockwise
+			panY = panXc - BKDJVU_VIEW_H / 2;
+			panX = h - panYc - BKDJVU_VIEW_W / 2;
+			break;
+		case -1:
+		case 3:  // counter clockwise
+			panX = panYc - BKDJVU_VIEW_W / 2;
+			panY = w - panXc - BKDJVU_VIEW_H / 2;
+			break;
+		default:
+			break;
 	}
 
-	int n = 4;
+	if (z < 0)
+		z = 3;
+	if (z >= 4)
+		z = 0;
 	ctx->rotateLevel = z;
-
-	if (ctx->rotateLevel < 0)
-		ctx->rotateLevel = 3;
-	if (ctx->rotateLevel >= n)
-		ctx->rotateLevel = 0;
-
 	ctx->rotate = rotateLevels[ctx->rotateLevel];
 
-
-// 	float nx = float(panX);
-// 	float ny = float(panY);
-// 	clipCoords(nx, ny);
-// 	panX = int(nx);
-// 	panY = int(ny);
 	char t[256];
-	snprintf(t, 256, "Rotate to %3.3g�", 90.0f * ctx->rotateLevel );
-  setBanner(t);
+	snprintf(t, 256, "Rotate to %3.3g°", 90.0f * ctx->rotateLevel);
+	setBanner(t);
 
 	redrawBuffer();
 	return BK_CMD_MARK_DIRTY;
 }
 
-void BKDJVU::getTitle(string& s, int type) {
-  switch(type){
-  case 1:
-    s = "<No Title Info>";
-    break;
-  case 2:
-    s = longFileName;
-    break;
-  case 3:
-    s = "<No Title Info> [";
-    s += longFileName;
-    s += "]";
-    break;
-  case 4:
-    s = longFileName;
-    s += " [<No Title Info>]";
-    break;
-  default:
-    s = title;
-    break;
-  }
+void BKDJVU::getTitle(string& s) {
+	s = title;
 }
 
 void BKDJVU::getType(string& s) {
@@ -648,25 +638,20 @@ int BKDJVU::prePan(int x, int y) {
  	clipCoords(nx, ny);
  	if (panX == int(nx) && panY == int(ny))
  		return 0;
- 	panBuffer(int(nx), int(ny));
-//        panBuffer(panX+x, panY+y);
+	panX = int(nx);
+	panY = int(ny);
+	redrawBuffer();
 	return BK_CMD_MARK_DIRTY;
 }
 
 int BKDJVU::pan(int x, int y) {
-
-  int minValueX = 32 * BKUser::options.analogRateX / 100;
-  int minValueY = 32 * BKUser::options.analogRateY / 100;
-
-	if (x > -1 * minValueX && x < minValueX)
+	if (abs(x) <= FZ_ANALOG_THRESHOLD)
 		x = 0;
-	if (y > -1 * minValueY && y < minValueY)
+	if (abs(y) <= FZ_ANALOG_THRESHOLD)
 		y = 0;
 	if (x == 0 && y == 0)
 		return 0;
-	x >>= 2;
-	y >>= 2;
-	return prePan(x, y);
+	return prePan(x / 10, y / 10);
 }
 
 int BKDJVU::screenUp() {
@@ -686,221 +671,150 @@ int BKDJVU::screenRight() {
 }
 
 void BKDJVU::renderContent() {
-	FZScreen::color(0xffffffff);
-	FZScreen::matricesFor2D();
-	FZScreen::enable(FZ_TEXTURE_2D);
-	FZScreen::enable(FZ_BLEND);
-	FZScreen::blendFunc(FZ_ADD, FZ_SRC_ALPHA, FZ_ONE_MINUS_SRC_ALPHA);
-
-	FZScreen::copyImage(FZ_PSM_8888, 0, 0, 480, 272, 480, bounceBuffer, 0, 0, 512, (void*)(0x04000000+(unsigned int)FZScreen::framebuffer()));
-
-#ifdef PSP
-	//int tfm = sceKernelTotalFreeMemSize();
-	//int mfm = sceKernelMaxFreeMemSize();
-	//printf("tfm %d, mfm %d\n", tfm, mfm);
-#endif
-}
-
-void BKDJVU::redrawBuffer(bool setSpeed) {
-	if(setSpeed)
-	  FZScreen::setSpeed(BKUser::options.pspMenuSpeed);
-
-	if (ctx->pageno-1 != ctx->djvupageno) {
-		if (ctx->page)
-			ddjvu_page_release(ctx->page);
-		ctx->djvupageno = ctx->pageno-1;
-		ctx->page = ddjvu_page_create_by_pageno(ctx->document, ctx->djvupageno);	
-		//djvuHandle(ctx->context, TRUE);
-	}
-	if(ctx->page == NULL){
-		if(setSpeed)
-		  FZScreen::setSpeed(BKUser::options.pspSpeed);
-		return;
-	}
-	ddjvu_page_set_rotation(ctx->page, ctx->rotate);
-
-	char* bufferStart = bounceBuffer;
-
-	ddjvu_rect_t zoomrect;
-	zoomrect.x = zoomrect.y = 0;
-	zoomrect.w = (unsigned int)((float)ddjvu_page_get_width(ctx->page) * ctx->zoom);
-	zoomrect.h = (unsigned int)((float)ddjvu_page_get_height(ctx->page) * ctx->zoom);
-	
-	if (loadNewPage && resetPanXY) {
-
-		if(xpos_mode){
-		  int* currentPage;
-		  if (ctx->pageno%2){ // current page is odd page
-		    currentPage = &xpos_odd;
-		  }
-		  else{ // current page is even page.
-		    currentPage = &xpos_even;
-		  }
-		  
-		  if(ctx->rotateLevel%2){ //vetical mode, set panY value
-		    panY = *currentPage;
-		  }
-		  else{ // normal or upsidedown mode, set panX value
-		    panX = *currentPage;
-		  }
+	FZScreen::clear(BKUser::options.colorSchemes[BKUser::options.currentScheme].txtBGColor & 0xffffff, FZ_COLOR_BUFFER);
+	#if defined(__vita__) || defined(HEADLESS)
+		if (texture == NULL)
+			return;
+		pthread_mutex_lock(&ctx->mutex);
+		if (ctx->frameReady) {
+			FZ_PROFILE(FZ_PROFILE_TEXTURE_UPLOAD);
+			// the GPU may still be drawing last frame's texture
+			vita2d_wait_rendering_done();
+			char* src = ctx->buffers[ctx->front];
+			char* dst = (char*)vita2d_texture_get_datap(texture);
+			unsigned int stride = vita2d_texture_get_stride(texture);
+			for (int y = 0; y < BKDJVU_VIEW_H; y++)
+				memcpy(dst + y * stride, src + y * BKDJVU_VIEW_W * 4, BKDJVU_VIEW_W * 4);
+			ctx->frameReady = false;
 		}
+		pthread_mutex_unlock(&ctx->mutex);
+		vita2d_draw_texture(texture, 0, 0);
+	#endif
+}
+
+// Work out the visible part of the page and hand it to the worker. The
+// frame on screen stays until the new one is ready.
+void BKDJVU::redrawBuffer() {
+	if (loadNewPage || pageW <= 0)
+		return;
+
+	DJVURender r;
+	r.page = ctx->pageno - 1;
+	r.rotate = ctx->rotate;
+	r.pagerect.x = r.pagerect.y = 0;
+	r.pagerect.w = (unsigned int)((float)pageWidth() * ctx->zoom);
+	r.pagerect.h = (unsigned int)((float)pageHeight() * ctx->zoom);
 
-		// set panX or panY according to rotation
+	if (resetPanXY) {
+		// start a new page from the edge the text begins at
 		switch (ctx->rotateLevel){
-		    case 0: //up
-			panY = 0;
-			break;
-		    case 1: //right
-			panX =  zoomrect.w - 480;
-			break;
-		    case 2: //down
-			panY =  zoomrect.h - 272;
-			break;
-		    case 3: //left
-			panX = 0;
-			break;
+			case 0: //up
+				panY = 0;
+				break;
+			case 1: //right
+				panX = r.pagerect.w - BKDJVU_VIEW_W;
+				break;
+			case 2: //down
+				panY = r.pagerect.h - BKDJVU_VIEW_H;
+				break;
+			case 3: //left
+				panX = 0;
+				break;
 		}
+		resetPanXY = false;
 	}
-	
+
  	float nx = float(panX);
  	float ny = float(panY);
  	clipCoords(nx, ny);
  	panX = int(nx);
  	panY = int(ny);
 
-	if(xpos_mode || alwaysSetXPos){
-	  int* currentPage;
-	  if (ctx->pageno%2){ // current page is odd page
-	    currentPage = &xpos_odd;
-	  }
-	  else{ // current page is even page.
-	    currentPage = &xpos_even;
-	  }
-	  
-	  if(ctx->rotateLevel%2){ //vetical mode, take panY value
-	    *currentPage = panY;
-	  }
-	  else{ // normal or upsidedown mode, take panX value
-	    *currentPage = panX;
-	  }
-	}
-
-	
-	ddjvu_rect_t screenrect;
-	screenrect.x = panX;
-	screenrect.y = panY;
-	screenrect.w = 480;
-	screenrect.h = 272;
+	r.renderrect.x = panX;
+	r.renderrect.y = panY;
+	r.renderrect.w = BKDJVU_VIEW_W;
+	r.renderrect.h = BKDJVU_VIEW_H;
+	r.offsetX = r.offsetY = 0;
 	leftMargin = 0;
 	/* while zoomrect is smaller than screenrect */
-	if(screenrect.w > zoomrect.w) {
-		bufferStart += (screenrect.w - zoomrect.w) / 2 * 4;
-		leftMargin = (screenrect.w - zoomrect.w) / 2;
-		screenrect.w = zoomrect.w;
-		
-	} 
-
-	if(screenrect.h > zoomrect.h) {
-		bufferStart += (screenrect.h - zoomrect.h) / 2 * 480 * 4;
-		screenrect.h = zoomrect.h;
-		
-	} 
-
-	if(bufferStart != bounceBuffer) {
-		unsigned int *d = (unsigned int*)bounceBuffer;
-		//const unsigned int c = BKUser::options.pdfBGColor;
-		const unsigned int c = BKUser::options.colorSchemes[BKUser::options.currentScheme].txtBGColor;
-		for (int i = 0; i < 480*272; i++) {
-			*d++ = c;
-		}
+	if (r.renderrect.w > r.pagerect.w) {
+		r.offsetX = (r.renderrect.w - r.pagerect.w) / 2;
+		leftMargin = r.offsetX;
+		r.renderrect.w = r.pagerect.w;
 	}
-	ddjvu_format_t* format = ddjvu_format_create(DDJVU_FORMAT_RGB32, 0, 0);
-	ddjvu_format_set_row_order(format, 1);
-	ddjvu_format_set_y_direction(format, 1);
-	ddjvu_page_render( ctx->page,
-			DDJVU_RENDER_COLOR,
-			&zoomrect,
-			&screenrect,
-			format,
-			480*4,
-			bufferStart);
-	ddjvu_format_release(format);
-	setThumbnail(zoomrect.w, zoomrect.h, screenrect.w, screenrect.h, screenrect.x, screenrect.y);
-	if(setSpeed)
-	  FZScreen::setSpeed(BKUser::options.pspSpeed);
-
-}
-
-void BKDJVU::panBuffer(int nx, int ny) {
-
-	if(xpos_mode || alwaysSetXPos){
-	  int* currentPage;
-	  if (ctx->pageno%2){ // current page is odd page
-	    currentPage = &xpos_odd;
-	  }
-	  else{ // current page is even page.
-	    currentPage = &xpos_even;
-	  }
-	  
-	  if(ctx->rotateLevel%2){ //vetical mode, take panY value
-	    *currentPage = ny;
-	  }
-	  else{ // normal or upsidedown mode, take panX value
-	    *currentPage = nx;
-	  }
+	if (r.renderrect.h > r.pagerect.h) {
+		r.offsetY = (r.renderrect.h - r.pagerect.h) / 2;
+		r.renderrect.h = r.pagerect.h;
 	}
+	r.background = BKUser::options.colorSchemes[BKUser::options.currentScheme].txtBGColor | 0xff000000;
 
-	panX = nx;
-	panY = ny;
-	redrawBuffer(true);
+	pthread_mutex_lock(&ctx->mutex);
+	// a newer view replaces one the worker has not started on
+	ctx->render = r;
+	ctx->renderPending = true;
+	pthread_cond_signal(&ctx->wake);
+	pthread_mutex_unlock(&ctx->mutex);
 }
 
 int BKDJVU::resume() {
-	// mupdf leaves open file descriptors around. they don't survive a suspend.
+	// djvulibre reopens the file for every chunk it reads
 	return 0;
 }
 
 int BKDJVU::updateContent() {
 	if (loadNewPage) {
-		//pageError = pdfLoadPage(ctx) != 0;
-		redrawBuffer(true);
+		pthread_mutex_lock(&ctx->mutex);
+		bool ready = ctx->infoPage == ctx->pageno - 1;
+		if (ready) {
+			pageW = ctx->infoWidth;
+			pageH = ctx->infoHeight;
+			pageError = ctx->infoError;
+		}
+		pthread_mutex_unlock(&ctx->mutex);
+		if (!ready)
+			return 0;
+
+		lastDecodeTime = get_time_ms() - pageRequested;
+		#ifdef DEBUG
+			printf("djvu: page %d decoded in %.1fms\n", ctx->pageno, lastDecodeTime);
+		#endif
 		loadNewPage = false;
-		resetPanXY = false;
+		redrawBuffer();
 		char t[256];
-		snprintf(t, 256, "Page %d of %d", ctx->pageno, getTotalPages());
+		if (pageError)
+			snprintf(t, 256, "Error in page %d", ctx->pageno);
+		else
+			snprintf(t, 256, "Page %d of %d", ctx->pageno, getTotalPages());
 		setBanner(t);
 		return BK_CMD_MARK_DIRTY;
 	}
 
-	return 0;
+	pthread_mutex_lock(&ctx->mutex);
+	bool frame = ctx->frameReady;
+	pthread_mutex_unlock(&ctx->mutex);
+	return frame ? BK_CMD_MARK_DIRTY : 0;
+}
+
+size_t BKDJVU::getMemoryUsage() {
+	// the decoded chunk cache can grow up to its limit
+	return 2 * DJVU_BUFFER_SIZE + ddjvu_cache_get_size(ctx->context);
+}
+
+void BKDJVU::trimMemory() {
+	pthread_mutex_lock(&ctx->mutex);
+	ctx->trim = true;
+	pthread_cond_signal(&ctx->wake);
+	pthread_mutex_unlock(&ctx->mutex);
+}
+
+bool BKDJVU::isDJVU(const char* header, int headerSize) {
+	// "AT&T" magic of the IFF container
+	return headerSize >= 4 && header[0] == 0x41 && header[1] == 0x54 && header[2] == 0x26 && header[3] == 0x54;
 }
 
 bool BKDJVU::isDJVU(string& file) {
 	char header[4];
 	memset((void*)header, 0, 4);
-	FILE* f = fopen(file.c_str(), "r");
-	if (!f)
-	  return false;
-	fread(header, 4, 1, f);
-	fclose(f);
-	return header[0] == 0x41 && header[1] == 0x54 && header[2] == 0x26 && header[3] == 0x54;
-}
-
-float BKDJVU::getCurrentZoom(){
-  if(ctx)
-    return ctx->zoom;
-  return 0.0f;
-}
-void BKDJVU::setZoom(float z){
-  if(ctx && z>0.0f){
-    ctx->zoom = z;
-    int newzl = ctx->zoomLevel;
-    if(zoomLevels[newzl] != ctx->zoom){
-      newzl = 0;
-      while (zoomLevels[newzl]<ctx->zoom){
-	newzl++;
-      }
-      ctx->zoomLevel = newzl;
-    }
-  }
+	int n = read_file_header(file.c_str(), header, 4);
+	return isDJVU(header, n);
 }
@@ -23,30 +23,47 @@
 #include <string>
 
 #include "../graphics/fzscreen.h"
-#include "../graphics/fzfont.h"
 
 using namespace std;
 
 #include "../bkdocument.h"
 
+// Pages are decoded and rendered by a worker thread that owns all the
+// ddjvu calls; the viewer only posts requests and shows finished frames.
 struct DJVUContext;
 class BKDJVU : public BKDocument {
+	#define BKDJVU_VIEW_W FZ_SCREEN_WIDTH
+	#define BKDJVU_VIEW_H FZ_SCREEN_HEIGHT
+
 	DJVUContext* ctx;
 
 	string fileName;
+	string title;
 
 	int panX;
 	int panY;
+	// waiting for the worker to decode the page
 	bool loadNewPage;
 	bool resetPanXY;
 	bool pageError;
 	int leftMargin;
-	void panBuffer(int nx, int ny);
+	// unrotated size of the current page at zoom 1, 0 until decoded
+	int pageW;
+	int pageH;
+	// when the current page was requested, for the decode latency
+	double pageRequested;
+	double lastDecodeTime;
+
+	#if defined(__vita__) || defined(HEADLESS)
+		vita2d_texture* texture;
+	#endif
+
+	int pageWidth();
+	int pageHeight();
 	void clipCoords(float& nx, float& ny);
-	void redrawBuffer(bool setSpeed = false);
+	void redrawBuffer();
 	int prePan(int x, int y);
-
-	string title;
+	int zoomLevelFor(float z);
 
 	protected:
 	BKDJVU(string& f);
@@ -57,25 +74,26 @@ class BKDJVU : public BKDocument {
 	virtual int resume();
 	virtual void renderContent();
 
+	virtual size_t getMemoryUsage();
+	virtual void trimMemory();
+
 	virtual void getFileName(string&);
-	virtual void getTitle(string&, int type = 0);
+	virtual void getTitle(string&);
 	virtual void getType(string&);
 
 	virtual bool isPaginated();
 	virtual int getTotalPages();
+	virtual int getPageCount() { return getTotalPages(); }
 	virtual int getCurrentPage();
 	virtual int setCurrentPage(int);
 
 	virtual bool isZoomable();
 	virtual void getZoomLevels(vector<BKDocument::ZoomLevel>& v);
 	virtual int getCurrentZoomLevel();
-	virtual int setZoomLevel2(int);
 	virtual int setZoomLevel(int);
 	virtual bool hasZoomToFit();
 	virtual int setZoomToFitWidth();
 	virtual int setZoomToFitHeight();
-	virtual int setZoomIn(int, int);
-	virtual void setZoom(float z);
 
 	virtual int pan(int, int);
 
@@ -86,17 +104,18 @@ class BKDJVU : public BKDocument {
 
 	virtual bool isRotable();
 	virtual int getRotation();
-	virtual int setRotation2(int, bool bForce=false);
 	virtual int setRotation(int, bool bForce=false);
 
 	virtual bool isBookmarkable();
 	virtual void getBookmarkPosition(map<string, float>&);
 	virtual int setBookmarkPosition(map<string, float>&);
-	virtual float getCurrentZoom();
 
-	static BKDJVU* create(string& file,string& longfilename);
+	// milliseconds from a page request until the page was decoded
+	double getLastDecodeTime() { return lastDecodeTime; }
+
+	static BKDJVU* create(string& file);
 	static bool isDJVU(string& file);
+	static bool isDJVU(const char* header, int headerSize);
 };
 
 #endif
-
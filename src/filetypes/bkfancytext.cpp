@@ -30,6 +30,8 @@
 #include <list>
 using namespace std;
 #include "bkfancytext.h"
+#include "../graphics/fzprofiler.h"
+#include "../graphics/fzmemory.h"
 #include <cmath>
 #include <cstring>
 #include <algorithm>
@@ -38,7 +40,12 @@ using namespace std;
   #include <psp2/kernel/threadmgr.h>
 #endif
 
-BKFancyText::BKFancyText() : lines(0), nLines(0), topLine(0), maxY(0), font(0), rotation(0), runs(0), nRuns(0), holdScroll(false) {
+// the vita renderer draws whole lines out of sRuns, a page at a time
+static vector<string> sRuns;
+static int pageNumber = 0;
+static int maxPageNumber = 0;
+
+BKFancyText::BKFancyText() : nLines(0), topLine(0), maxY(0), font(0), rotation(0), linesPerPage(25), totalPages(1), reflowWidth(0), runsCapacity(0), textMemory(0), runs(0), nRuns(0), textBytes(0), holdScroll(false) {
     lastFontSize = BKUser::options.txtSize;
     lastFontFace = BKUser::options.txtFont;
     lastHeightPct = BKUser::options.txtHeightPct;
@@ -48,8 +55,7 @@ BKFancyText::BKFancyText() : lines(0), nLines(0), topLine(0), maxY(0), font(0),
 BKFancyText::~BKFancyText() {
     if (runs)
       delete[] runs;
-    if (lines)
-      delete[] lines;
+    FZMemory::update(FZ_MEM_TEXT, textMemory, 0);
     if (font)
       font->release();
 }
@@ -105,25 +111,27 @@ struct BKRunsIterator {
       globalPos(s.globalPos) { }
 };
 
-void BKFancyText::reflow(int width) {
-    if (lines)
-      delete[] lines;
+void BKFancyText::reflow(int width, int firstRun) {
+    FZ_PROFILE(FZ_PROFILE_REFLOW);
+    if (firstRun == 0)
+      lines.clear();
+    reflowWidth = width;
     list<BKLine> tempLines;
 
-    int lineFirstRun = 0;
+    int lineFirstRun = firstRun;
     int lineFirstRunOffset = 0;
     int lineSpaces = 0;
     int lineStartGlobalPos = 0;
     int currentWidth = 0;
     float spaceWidth = 0.0f;
-    BKRunsIterator rit(runs, 0, 0, nRuns);
+    BKRunsIterator rit(runs, firstRun, 0, nRuns);
     BKRunsIterator lastSpace = rit;
 
     #ifdef PSP
       FZCharMetrics* fontChars = font->getMetrics();
       const int spaceWidthC = fontChars[32].xadvance;
       const float spaceWidthCF = float(spaceWidthC);
-    #elif defined(__vita__) || defined(MAC) || defined(WIN32) || defined(SWITCH)
+    #elif defined(__vita__) || defined(MAC) || defined(WIN32) || defined(SWITCH) || defined(HEADLESS)
       const int spaceWidthC = 10;
       const float spaceWidthCF = 10;
     #endif
@@ -164,22 +172,26 @@ void BKFancyText::reflow(int width) {
       }
       #ifdef PSP
         currentWidth += fontChars[c].xadvance;
-      #elif defined(__vita__)
+      #elif defined(__vita__) || defined(HEADLESS)
         currentWidth += 10;
       #endif
       rit.currentWidth = currentWidth;
     }
 
-    nLines = tempLines.size();
-    lines = new BKLine[nLines];
-    list<BKLine>::iterator it(tempLines.begin());
-    int i = 0;
-    while (it != tempLines.end()) {
-      const BKLine& l = *it;
-      lines[i] = l;
-      ++i;
-      ++it;
-    }
+    lines.insert(lines.end(), tempLines.begin(), tempLines.end());
+    nLines = lines.size();
+    updateTextMemory();
+}
+
+void BKFancyText::updateTextMemory() {
+    size_t bytes = textBytes + runsCapacity * sizeof(BKRun) + lines.capacity() * sizeof(BKLine);
+    FZMemory::update(FZ_MEM_TEXT, textMemory, bytes);
+}
+
+void BKFancyText::updatePages() {
+    totalPages = (nLines / linesPerPage) + 1;
+    // the vita renderer pages through sRuns and sizes it lazily
+    maxPageNumber = 0;
 }
 
 void BKFancyText::resizeView(int width, int height) {
@@ -187,12 +199,47 @@ void BKFancyText::resizeView(int width, int height) {
 
     #ifdef PSP
       linesPerPage = (height - 10) / (font->getLineHeight()*(BKUser::options.txtHeightPct/100.0));
-    #elif defined(__vita__)
+    #elif defined(__vita__) || defined(HEADLESS)
       linesPerPage = 25;
     #endif
 
     maxY = height - 10;
-    totalPages = (nLines / linesPerPage) + 1;
+    updatePages();
+}
+
+// create fast fixed size run array
+void BKFancyText::setRuns(list<BKRun>& tempRuns) {
+    if (runs)
+      delete[] runs;
+    runsCapacity = tempRuns.size();
+    runs = new BKRun[runsCapacity];
+    nRuns = 0;
+    appendRuns(tempRuns);
+}
+
+// the array grows geometrically, so streaming a book chunk by chunk
+// costs about as much as tokenizing it in one go
+void BKFancyText::appendRuns(list<BKRun>& tempRuns) {
+    int n = nRuns + tempRuns.size();
+    if (n > runsCapacity) {
+      int c = runsCapacity * 2;
+      if (c < n)
+        c = n;
+      BKRun* r = new BKRun[c];
+      for (int i = 0; i < nRuns; ++i)
+        r[i] = runs[i];
+      if (runs)
+        delete[] runs;
+      runs = r;
+      runsCapacity = c;
+    }
+    list<BKRun>::iterator it(tempRuns.begin());
+    while (it != tempRuns.end()) {
+      runs[nRuns] = *it;
+      ++nRuns;
+      ++it;
+    }
+    updateTextMemory();
 }
 
 // a lot of ebook formats use HTML as a display format, on top of a
@@ -357,42 +404,23 @@ char* BKFancyText::parseHTML(BKFancyText* r, char* in, int n) {
     run.n = i - li;
     tempRuns.push_back(run);
 
-    // create fast fixed size run array	
-    r->runs = new BKRun[tempRuns.size()];
-    r->nRuns = tempRuns.size();
-    list<BKRun>::iterator jt(tempRuns.begin());
-    i = 0;
-    while (jt != tempRuns.end()) {
-      const BKRun& l = *jt;
-      r->runs[i] = l;
-      ++i;
-      ++jt;
-    }
+    r->setRuns(tempRuns);
 
     free(in);
 
     return out;
 }
 
-static vector<string> sRuns;
-static int pageNumber = 0;
-static int maxPageNumber = 0;
-static int linesPerPage = 25;
-char* BKFancyText::parseText(BKFancyText* r, char* b, int length) {
-    sRuns.clear();
-    pageNumber = 0;
-    maxPageNumber = 0;
-
-    // tokenize text file
-    list<BKRun> tempRuns;
+// tokenize text: one run per hard line break. the runs point into b,
+// sRuns keeps a copy of each line for the vita renderer
+static void tokenizeText(char* b, int length, bool wrapCR, bool keepEmptyTail, list<BKRun>& tempRuns) {
     int li = 0;
-    string ss(b);
     BKRun run;
     // int lastbreak = 0;
     for (int i = 0; i < length; ++i) {
       if (b[i] == '\n') {
         bool bBreak = true;
-        if( BKUser::options.txtWrapCR > 0 )
+        if( wrapCR && BKUser::options.txtWrapCR > 0 )
         {
           // if( i-lastbreak < 100 )
           // {
@@ -418,41 +446,56 @@ char* BKFancyText::parseText(BKFancyText* r, char* b, int length) {
         if( bBreak )
         {
           run.text = &b[li];
-          string s = ss.substr(li, (i - li + 1));
           // psp2shell_print("string %i to  %i cstr: %s\n", li, (i - li), s.c_str());
           // sceKernelDelayThread(2*1000000);
           run.n = i - li;
-          li = i+1;
           run.lineBreak = true;
           tempRuns.push_back(run);
-          sRuns.push_back(s);
-          
+          sRuns.push_back(string(&b[li], i - li + 1));
+          li = i+1;
         }
       }
     }
-    
-    // last run
-    run.text = &b[li];
-    run.n = length - li;
-    run.lineBreak = true;
-    tempRuns.push_back(run);
 
-    // create fast fixed size run array	
-    r->runs = new BKRun[tempRuns.size()];
-    r->nRuns = tempRuns.size();
-    list<BKRun>::iterator it(tempRuns.begin());
-    int i = 0;
-    while (it != tempRuns.end()) {
-      const BKRun& l = *it;
-      r->runs[i] = l;
-      //psp2shell_print("run[%i] - %s\n", i, (*it).text);
-      ++i;
-      ++it;
+    // last run
+    if (li < length || keepEmptyTail) {
+      run.text = &b[li];
+      run.n = length - li;
+      run.lineBreak = true;
+      tempRuns.push_back(run);
+      if (li < length)
+        sRuns.push_back(string(&b[li], length - li));
     }
+}
+
+char* BKFancyText::parseText(BKFancyText* r, char* b, int length) {
+    sRuns.clear();
+    pageNumber = 0;
+    maxPageNumber = 0;
+
+    list<BKRun> tempRuns;
+    tokenizeText(b, length, true, true, tempRuns);
+    r->setRuns(tempRuns);
 
     return b;
 }
 
+void BKFancyText::appendText(char* b, int length, bool wrapCR) {
+    if (nRuns == 0) {
+      sRuns.clear();
+      pageNumber = 0;
+      maxPageNumber = 0;
+    }
+    list<BKRun> tempRuns;
+    tokenizeText(b, length, wrapCR, false, tempRuns);
+    if (tempRuns.empty())
+      return;
+    int firstRun = nRuns;
+    appendRuns(tempRuns);
+    reflow(reflowWidth, firstRun);
+    updatePages();
+}
+
 // extern "C" {
 // extern unsigned int size_res_txtfont;
 // extern unsigned char res_txtfont[];
@@ -519,7 +562,7 @@ void BKFancyText::renderContent() {
       FZScreen::ambientColor(0xff000000 | BKUser::options.colorSchemes[BKUser::options.currentScheme].txtFGColor);
     #endif
 
-    #ifdef __vita__
+    #if defined(__vita__) || defined(HEADLESS)
       // psp2shell_print("sruns size: %i", );
       if (maxPageNumber == 0)
         maxPageNumber = (int) floor( (float)sRuns.size() / float(linesPerPage) );
@@ -22,6 +22,7 @@
 
 #include <string>
 #include <vector>
+#include <list>
 
 #include "../graphics/fzscreen.h"
 
@@ -62,7 +63,7 @@ struct BKLine {
 
 class BKFancyText : public BKDocument {
   private:
-  BKLine* lines;
+  vector<BKLine> lines;
   int nLines;
   int topLine;
   int maxY;
@@ -75,11 +76,22 @@ class BKFancyText : public BKDocument {
 
   int linesPerPage;
   int totalPages;
-  void reflow(int width);
+  int reflowWidth;
+  int runsCapacity;
+  // bytes counted under FZ_MEM_TEXT
+  size_t textMemory;
+  void updateTextMemory();
+  // lays out runs from firstRun on, after the lines already there
+  void reflow(int width, int firstRun = 0);
+  void setRuns(list<BKRun>& tempRuns);
+  void appendRuns(list<BKRun>& tempRuns);
+  void updatePages();
 
   protected:
   BKRun* runs;
   int nRuns;
+  // text buffers the runs point into, owned by the subclass
+  size_t textBytes;
   BKFancyText();
   ~BKFancyText();
 
@@ -99,6 +111,13 @@ class BKFancyText : public BKDocument {
   // same with plain text
   static char* parseText(BKFancyText* r, char* b, int length);
 
+  // incremental variant for streamed books: tokenizes one more chunk of
+  // text and lays it out after the current last line. Chunks must end
+  // on a line break and stay allocated for the life of the document.
+  // wrapCR applies the txtWrapCR option, which only makes sense for
+  // hard wrapped plain text.
+  void appendText(char* b, int length, bool wrapCR);
+
   public:
   virtual int updateContent();
   virtual int resume();
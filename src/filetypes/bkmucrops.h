@@ -0,0 +1,75 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BKMUCROPS_H
+#define BKMUCROPS_H
+
+#include <map>
+#include <pthread.h>
+
+#include <mupdf/fitz.h>
+
+using namespace std;
+
+/*! \brief Content boxes of the pages of one MuPDF document, in page
+ *  space.
+ *
+ *  BKMUDocument owns it and hands it to its strip and spread, so a page
+ *  has its margins scanned once, whichever view shows it first, and a
+ *  bookmark saves the box the view used. The workers look boxes up from
+ *  their own threads, so every call takes the lock.
+ */
+class BKMUCrops {
+  pthread_mutex_t mutex;
+  map<int, fz_rect> boxes;
+
+  public:
+  BKMUCrops() { pthread_mutex_init(&mutex, NULL); }
+  ~BKMUCrops() { pthread_mutex_destroy(&mutex); }
+  BKMUCrops(const BKMUCrops&) = delete;
+  BKMUCrops& operator=(const BKMUCrops&) = delete;
+
+  // false if page n was not scanned yet
+  bool find(int n, fz_rect& box) {
+    pthread_mutex_lock(&mutex);
+    map<int, fz_rect>::iterator it = boxes.find(n);
+    bool found = it != boxes.end();
+    if (found)
+      box = it->second;
+    pthread_mutex_unlock(&mutex);
+    return found;
+  }
+
+  void store(int n, const fz_rect& box) {
+    pthread_mutex_lock(&mutex);
+    boxes[n] = box;
+    pthread_mutex_unlock(&mutex);
+  }
+};
+
+#endif
@@ -28,7 +28,6 @@
 
 #include <map>
 #include <fstream>
-#include <chrono>
 #include <iostream>
 #include <sstream>
 
@@ -39,26 +38,78 @@
 #include <time.h>
 #include <malloc.h>
 #include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
 
 #ifdef __vita__
   #include <psp2/io/fcntl.h>
-  extern int _newlib_heap_size_user;
 #endif
 
 #include "bkmudocument.h"
 #include "../bkbookmark.h"
+#include "../bkmemorygovernor.h"
 #include "../utils.h"
+#include "../graphics/fzprofiler.h"
+#include "../graphics/fzmemory.h"
 
 using namespace std;
 
-// make sure only one document is open, do we need this?
-// vita can probably do multiple.
-static BKMUDocument* mudoc_singleton = nullptr;
-// texture of current pixmap, TODO: generic fztexture
-#ifdef __vita__
-static vita2d_texture *texture;
-#elif defined(SWITCH)
-#endif
+// Counting allocator, the size is kept in front of every block. Totals
+// go to the document and to FZ_MEM_MUPDF.
+#define BKMU_ALLOC_HEADER 16
+
+static void* muMalloc(void* user, size_t size) {
+  BKMUHeapUsage* heap = (BKMUHeapUsage*)user;
+  char* p = (char*)malloc(size + BKMU_ALLOC_HEADER);
+  if (p == nullptr) {
+    FZMemory::allocationFailed();
+    return nullptr;
+  }
+  *(size_t*)p = size;
+  FZMemory::add(FZ_MEM_MUPDF, size);
+  heap->current += size;
+  if (heap->current > heap->peak)
+    heap->peak = heap->current;
+  return p + BKMU_ALLOC_HEADER;
+}
+
+static void muFree(void* user, void* ptr) {
+  if (ptr == nullptr)
+    return;
+  BKMUHeapUsage* heap = (BKMUHeapUsage*)user;
+  char* p = (char*)ptr - BKMU_ALLOC_HEADER;
+  heap->current -= *(size_t*)p;
+  FZMemory::sub(FZ_MEM_MUPDF, *(size_t*)p);
+  free(p);
+}
+
+static void* muRealloc(void* user, void* old, size_t size) {
+  if (old == nullptr)
+    return muMalloc(user, size);
+  BKMUHeapUsage* heap = (BKMUHeapUsage*)user;
+  char* p = (char*)old - BKMU_ALLOC_HEADER;
+  size_t oldSize = *(size_t*)p;
+  char* np = (char*)realloc(p, size + BKMU_ALLOC_HEADER);
+  if (np == nullptr) {
+    FZMemory::allocationFailed();
+    return nullptr;
+  }
+  *(size_t*)np = size;
+  FZMemory::sub(FZ_MEM_MUPDF, oldSize);
+  FZMemory::add(FZ_MEM_MUPDF, size);
+  heap->current = heap->current - oldSize + size;
+  if (heap->current > heap->peak)
+    heap->peak = heap->current;
+  return np + BKMU_ALLOC_HEADER;
+}
+
+static void muLock(void* user, int lock) {
+  pthread_mutex_lock(&((pthread_mutex_t*)user)[lock]);
+}
+
+static void muUnlock(void* user, int lock) {
+  pthread_mutex_unlock(&((pthread_mutex_t*)user)[lock]);
+}
 
 // These will crash...
 //, 2.5f, 2.75f, 3.0f, 3.5f, 4.0f, 5.0f, 7.5f, 10.0f, 16.0f };
@@ -69,9 +120,10 @@ static const float rotateLevels[] = { 0.0f, 90.0f, 180.0f, 270.0f };
 
 
 BKMUDocument::BKMUDocument(string& f) : 
-  m_ctx(nullptr), m_doc(nullptr), m_page(nullptr), loadNewPage(false), zooming(false),
+  m_ctx(nullptr), m_stream(nullptr), m_doc(nullptr), m_page(nullptr), m_pix(nullptr), loadNewPage(false), zooming(false),
   m_pageText(nullptr), m_links(nullptr), panX(0), panY(0), m_current_page(0),
-  m_curPageLoaded(false), m_fitWidth(true), m_fitHeight(false), zoomLevel(8)
+  m_curPageLoaded(false), m_fitWidth(true), m_fitHeight(false), zoomLevel(8), m_strip(nullptr), m_continuous(false),
+  m_spread(nullptr), m_spreads(false)
 {
   #ifdef DEBUG
     printf("BKMUDocument::BKMUDocument f: %s, filename: %s\n", f.c_str(), filename.c_str());
@@ -79,57 +131,137 @@ BKMUDocument::BKMUDocument(string& f) :
 
   filename = string(f);
   m_rotate = 0.0f;
+  m_scale = 1.0f;
+  m_autoCrop = BKUser::options.pdfAutoCrop;
   rotateLevel = 0;
   m_width = FZ_SCREEN_WIDTH;
   m_height = FZ_SCREEN_HEIGHT;
 
-  // Initalize fitz context
-  m_ctx = fz_new_context(nullptr, nullptr,
-  #ifdef __vita__
-    _newlib_heap_size_user
-  #elif defined(SWITCH)
-    FZ_STORE_DEFAULT
+  #if defined(__vita__) || defined(HEADLESS)
+    m_texture = nullptr;
   #endif
-  );
 
-  if (m_ctx)
-    fz_register_document_handlers(m_ctx);
+  m_heap.current = 0;
+  m_heap.peak = 0;
+  m_alloc.user = &m_heap;
+  m_alloc.malloc = muMalloc;
+  m_alloc.realloc = muRealloc;
+  m_alloc.free = muFree;
+
+  for (int i = 0; i < FZ_LOCK_MAX; ++i)
+    pthread_mutex_init(&m_locks[i], NULL);
+  m_lockContext.user = m_locks;
+  m_lockContext.lock = muLock;
+  m_lockContext.unlock = muUnlock;
+
+  // Initalize fitz context. Every document has its own, so several can
+  // be open at once (see BKDocumentCache); no store may outgrow the
+  // budget for all of them, BKMemoryGovernor keeps the sum in check.
+  m_ctx = newContext(&m_alloc, &m_lockContext, BKMemoryGovernor::getStoreBudget());
+
+  #ifdef DEBUG
+    printf("BKMUDocument::BKMUDocument end\n");
+  #endif
+}
+
+fz_context* BKMUDocument::newContext(fz_alloc_context* alloc, fz_locks_context* locks, size_t storeBudget) {
+  fz_context* ctx = fz_new_context(alloc, locks, storeBudget);
+
+  if (ctx)
+    fz_register_document_handlers(ctx);
   else
     printf("MuPDF context allocation problem");
 
-  fz_set_use_document_css(m_ctx, 1);
+  if (ctx)
+    fz_set_use_document_css(ctx, 1);
+  return ctx;
+}
+
+// fz_stream over a FILE* that is already open, so the handle used for
+// format detection is the one MuPDF reads the document from.
+#define BKMU_STREAM_BUFFER 8192
+struct BKFileStream {
+  FILE* file;
+  unsigned char buffer[BKMU_STREAM_BUFFER];
+};
+
+static int nextFileStream(fz_context* ctx, fz_stream* stm, size_t max) {
+  BKFileStream* state = (BKFileStream*)stm->state;
+  size_t n = fread(state->buffer, 1, BKMU_STREAM_BUFFER, state->file);
+  if (n < BKMU_STREAM_BUFFER && ferror(state->file))
+    fz_throw(ctx, FZ_ERROR_GENERIC, "read error: %s", strerror(errno));
+  stm->rp = state->buffer;
+  stm->wp = state->buffer + n;
+  stm->pos += n;
+  if (n == 0)
+    return EOF;
+  return *stm->rp++;
+}
+
+static void seekFileStream(fz_context* ctx, fz_stream* stm, int64_t offset, int whence) {
+  BKFileStream* state = (BKFileStream*)stm->state;
+  if (fseek(state->file, offset, whence) != 0)
+    fz_throw(ctx, FZ_ERROR_GENERIC, "cannot seek: %s", strerror(errno));
+  stm->pos = ftell(state->file);
+  stm->rp = state->buffer;
+  stm->wp = state->buffer;
+}
+
+static void dropFileStream(fz_context* ctx, void* s) {
+  BKFileStream* state = (BKFileStream*)s;
+  fclose(state->file);
+  fz_free(ctx, state);
+}
+
+// Takes ownership of file, also when it throws.
+static fz_stream* newFileStream(fz_context* ctx, FILE* file) {
+  BKFileStream* state = nullptr;
+  fz_try(ctx)
+    state = fz_malloc_struct(ctx, BKFileStream);
+  fz_catch(ctx) {
+    fclose(file);
+    fz_rethrow(ctx);
+  }
+  state->file = file;
+
+  // fz_new_stream drops the state if it fails
+  fz_stream* stm = fz_new_stream(ctx, state, nextFileStream, dropFileStream);
+  stm->seek = seekFileStream;
+  return stm;
+}
+
+fz_stream* BKMUDocument::newStream(fz_context* ctx, FILE* f) {
+  return newFileStream(ctx, f);
+}
+
+bool BKMUDocument::open(FILE* file, const char* magic) {
+  if (m_ctx == nullptr) {
+    fclose(file);
+    return false;
+  }
 
   // Open Document; TODO: Implement keyboard password
   fz_try(m_ctx) {
-    m_doc = fz_open_document(m_ctx, f.c_str());
+    // the document keeps its own reference, ours is for resume()
+    m_stream = newFileStream(m_ctx, file);
+    m_doc = fz_open_document_with_stream(m_ctx, magic, m_stream);
     if (fz_needs_password(m_ctx, m_doc)) {
       int okay = 0;
-      char *password;
-      char defaultValue;
       // input for password
       if (!okay)
         fz_throw(m_ctx, FZ_ERROR_GENERIC, "no pass");
     }
   } fz_catch(m_ctx) {
     printf("opening error: %s\n", fz_caught_message(m_ctx));
-    fz_drop_context(m_ctx);
-    fz_throw(m_ctx, FZ_ERROR_GENERIC, "opening error:");
+    fz_drop_document(m_ctx, m_doc);
+    m_doc = nullptr;
+    fz_drop_stream(m_ctx, m_stream);
+    m_stream = nullptr;
+    return false;
   }
 
-
   m_pdf = pdf_specifics(m_ctx, m_doc);
-
-  // Set page count
-  fz_try(m_ctx) {
-    m_pages = fz_count_pages(m_ctx, m_doc);
-  } fz_catch(m_ctx) {
-    printf("page_count error");
-    fz_throw(m_ctx, FZ_ERROR_GENERIC, "page_count error");
-  }
-
-  #ifdef DEBUG
-    printf("BKMUDocument::BKMUDocument end\n");
-  #endif
+  return true;
 }
 
 BKMUDocument::~BKMUDocument() {
@@ -137,36 +269,355 @@ BKMUDocument::~BKMUDocument() {
     printf("BKMUDocument::~BKMUDocument\n");
   #endif
   
-  saveLastView();
-  mudoc_singleton = nullptr;
-  fz_drop_pixmap(m_ctx, m_pix);
-  fz_drop_document(m_ctx, m_doc);
-  fz_drop_context(m_ctx);
+  // a document that failed to open has no view worth remembering
+  if (m_doc != nullptr)
+    saveLastView();
+  // the worker is still inside the document until it is gone
+  delete m_strip;
+  m_strip = nullptr;
+  delete m_spread;
+  m_spread = nullptr;
+  #if defined(__vita__) || defined(HEADLESS)
+    if (m_texture != nullptr)
+      _vita2d_free_counted_texture(m_texture);
+  #endif
+  if (m_ctx != nullptr) {
+    fz_drop_pixmap(m_ctx, m_pix);
+    fz_drop_stext_page(m_ctx, m_pageText);
+    fz_drop_link(m_ctx, m_links);
+    fz_drop_page(m_ctx, m_page);
+    fz_drop_document(m_ctx, m_doc);
+    fz_drop_stream(m_ctx, m_stream);
+    fz_drop_context(m_ctx);
+  }
+  for (int i = 0; i < FZ_LOCK_MAX; ++i)
+    pthread_mutex_destroy(&m_locks[i]);
 }
 
 BKMUDocument* BKMUDocument::create(string& file) {
+  FILE* f = fopen(file.c_str(), "rb");
+  if (f == NULL)
+    throw "failed opening file; try again";
+
+  char header[4];
+  memset((void*)header, 0, 4);
+  int headerSize = fread(header, 1, 4, f);
+  fseek(f, 0, SEEK_SET);
+  return create(file, f, header, headerSize, nullptr);
+}
+
+BKMUDocument* BKMUDocument::create(string& file, FILE* f, const char* header, int headerSize,
+    map<string, float>* view) {
   #ifdef DEBUG
     printf("BKMUDocument::create\n");
   #endif
-  
-  if (mudoc_singleton) {
-    printf("cannot open more than 1 pdf at the same time\n");
-    return mudoc_singleton;
-  }
 
+  double t = get_time_ms();
   BKMUDocument* b = new BKMUDocument(file);
-  mudoc_singleton = b;
 
+  // MuPDF picks the handler from the magic; a %PDF header wins over
+  // whatever the extension says
+  bool isPDF = headerSize >= 4 && memcmp(header, "%PDF", 4) == 0;
+  if (!b->open(f, isPDF ? "application/pdf" : file.c_str())) {
+    delete b;
+    throw "failed opening document";
+  }
+  openTimings.open = get_time_ms() - t;
 
-  b->redrawBuffer();
+  // Set page count
+  t = get_time_ms();
+  bool counted = true;
+  fz_try(b->m_ctx) {
+    b->m_pages = fz_count_pages(b->m_ctx, b->m_doc);
+  } fz_catch(b->m_ctx) {
+    printf("page_count error: %s\n", fz_caught_message(b->m_ctx));
+    counted = false;
+  }
+  if (!counted) {
+    delete b;
+    throw "cannot count pages";
+  }
+  openTimings.countPages = get_time_ms() - t;
+
+  b->importBakedBookmarks();
+
+  // only the page that ends up on screen is rendered, and timed
+  t = get_time_ms();
+  if (view != nullptr)
+    b->applyView(*view);
+  b->syncViewMode();
+  if (view != nullptr)
+    b->showView();
+  else if (b->m_strip == nullptr && b->m_spread == nullptr)
+    b->redrawBuffer();
+  openTimings.firstRender = get_time_ms() - t;
   return b;
 }
 
+fz_matrix BKMUDocument::pageTransform(fz_context* ctx, fz_page* page, float rotate, bool fitWidth, bool fitHeight,
+    int width, int height, float& scale, fz_rect& bounds, const fz_rect* crop) {
+  // bounds for inital window size
+  if (crop != nullptr) {
+    bounds.x0 = 0;
+    bounds.y0 = 0;
+    bounds.x1 = crop->x1 - crop->x0;
+    bounds.y1 = crop->y1 - crop->y0;
+  } else {
+    bounds = fz_bound_page(ctx, page);
+  }
+  #ifdef DEBUG
+    printf("bound_page; (%f, %f) - (%f, %f)\n", bounds.x0, bounds.y0, bounds.y0, bounds.y1);
+  #endif
+
+  fz_matrix rotation_matrix;
+  fz_matrix scaling_matrix;
+  fz_matrix translation_matrix;
+
+  // Rotate first since co-ords can be negative
+  rotation_matrix = fz_rotate(rotate); // m_t = rotate * scaling_matrix
+  fz_transform_rect(bounds, rotation_matrix);
+
+  // Translate to positive coords to figure out fit to width/height scale easily
+  translation_matrix = fz_translate(-bounds.x0, -bounds.y0); // matrix = translation matrix (for rect)
+  fz_transform_rect(bounds, translation_matrix);
+
+  if (fitWidth)
+    scale = width / (bounds.x1 - bounds.x0);
+  else if (fitHeight)
+    scale = height / (bounds.y1 - bounds.y0);
+
+  // Scaling is then always positive so do it last
+  scaling_matrix = fz_scale(scale, scale);
+  fz_transform_rect(bounds, scaling_matrix);
+
+  #ifdef DEBUG
+    printf("bound_page; (%f, %f) - (%f, %f)\n", bounds.x0, bounds.y0, bounds.y0, bounds.y1);
+  #endif
+
+  // Create final transformation matrix in the correct order (Rotation x Scaling x Translation)
+  // fz_concat(&m_transform, &m_transform, &translation_matrix); // dont really need to translate the page...?
+  return fz_concat(rotation_matrix, scaling_matrix);
+}
+
+fz_pixmap* BKMUDocument::renderPage(fz_context* ctx, fz_page* page, fz_matrix transform, const fz_rect* clip) {
+  if (clip == nullptr)
+    return fz_new_pixmap_from_page_contents(ctx, page, transform, fz_device_rgb(ctx), 0);
+
+  fz_irect area = fz_round_rect(fz_transform_rect(*clip, transform));
+  fz_pixmap* pix = fz_new_pixmap_with_bbox(ctx, fz_device_rgb(ctx), area, nullptr, 0);
+  fz_device* dev = nullptr;
+  fz_var(dev);
+  fz_try(ctx) {
+    fz_clear_pixmap_with_value(ctx, pix, 0xff);
+    dev = fz_new_draw_device(ctx, fz_identity, pix);
+    fz_run_page_contents(ctx, page, dev, transform, nullptr);
+    fz_close_device(ctx, dev);
+  } fz_always(ctx) {
+    fz_drop_device(ctx, dev);
+  } fz_catch(ctx) {
+    fz_drop_pixmap(ctx, pix);
+    fz_rethrow(ctx);
+  }
+  return pix;
+}
+
+// Content boxes come from a grayscale render BKMU_CROP_SCAN pixels wide;
+// anything darker than BKMU_CROP_WHITE is content. Rows are tested eight
+// pixels at a time, as one 64 bit word.
+#define BKMU_CROP_SCAN    200
+#define BKMU_CROP_WHITE   0xf0
+#define BKMU_CROP_MARGIN  2
+#define BKMU_CROP_WORD    0xf0f0f0f0f0f0f0f0ULL
+
+static int firstDark(const unsigned char* p, int n) {
+  int x = 0;
+  for (; x + 8 <= n; x += 8) {
+    uint64_t v;
+    memcpy(&v, p + x, 8);
+    if ((v & BKMU_CROP_WORD) != BKMU_CROP_WORD)
+      break;
+  }
+  for (; x < n; ++x) {
+    if (p[x] < BKMU_CROP_WHITE)
+      return x;
+  }
+  return -1;
+}
+
+static int lastDark(const unsigned char* p, int n) {
+  int x = n;
+  for (; x - 8 >= 0; x -= 8) {
+    uint64_t v;
+    memcpy(&v, p + x - 8, 8);
+    if ((v & BKMU_CROP_WORD) != BKMU_CROP_WORD)
+      break;
+  }
+  for (--x; x >= 0; --x) {
+    if (p[x] < BKMU_CROP_WHITE)
+      return x;
+  }
+  return -1;
+}
+
+// pix is rendered at scale s from a page with the given bounds
+static bool scanContent(fz_pixmap* pix, float s, fz_rect bounds, fz_rect& box) {
+  int x0 = pix->w, y0 = pix->h, x1 = -1, y1 = -1;
+  for (int y = 0; y < pix->h; ++y) {
+    const unsigned char* row = pix->samples + y * pix->stride;
+    int l = firstDark(row, pix->w);
+    if (l < 0)
+      continue;
+    int r = lastDark(row, pix->w);
+    if (l < x0) x0 = l;
+    if (r > x1) x1 = r;
+    if (y0 > y) y0 = y;
+    y1 = y;
+  }
+  if (x1 < 0)
+    return false;
+
+  box.x0 = max(bounds.x0, (pix->x + x0 - BKMU_CROP_MARGIN) / s);
+  box.y0 = max(bounds.y0, (pix->y + y0 - BKMU_CROP_MARGIN) / s);
+  box.x1 = min(bounds.x1, (pix->x + x1 + 1 + BKMU_CROP_MARGIN) / s);
+  box.y1 = min(bounds.y1, (pix->y + y1 + 1 + BKMU_CROP_MARGIN) / s);
+  return true;
+}
+
+bool BKMUDocument::contentBox(fz_context* ctx, fz_page* page, fz_rect& box) {
+  fz_pixmap* pix = nullptr;
+  fz_rect bounds;
+  float s = 0;
+  fz_var(pix);
+  fz_try(ctx) {
+    bounds = fz_bound_page(ctx, page);
+    if (bounds.x1 > bounds.x0 && bounds.y1 > bounds.y0) {
+      s = BKMU_CROP_SCAN / (bounds.x1 - bounds.x0);
+      pix = fz_new_pixmap_from_page_contents(ctx, page, fz_scale(s, s), fz_device_gray(ctx), 0);
+    }
+  } fz_catch(ctx) {
+    printf("cannot scan page: %s\n", fz_caught_message(ctx));
+  }
+  if (pix == nullptr)
+    return false;
+  bool found = scanContent(pix, s, bounds, box);
+  fz_drop_pixmap(ctx, pix);
+  return found;
+}
+
+bool BKMUDocument::contentBox(fz_context* ctx, fz_display_list* list, fz_rect& box) {
+  fz_pixmap* pix = nullptr;
+  fz_rect bounds;
+  float s = 0;
+  fz_var(pix);
+  fz_try(ctx) {
+    bounds = fz_bound_display_list(ctx, list);
+    if (bounds.x1 > bounds.x0 && bounds.y1 > bounds.y0) {
+      s = BKMU_CROP_SCAN / (bounds.x1 - bounds.x0);
+      pix = fz_new_pixmap_from_display_list(ctx, list, fz_scale(s, s), fz_device_gray(ctx), 0);
+    }
+  } fz_catch(ctx) {
+    printf("cannot scan page: %s\n", fz_caught_message(ctx));
+  }
+  if (pix == nullptr)
+    return false;
+  bool found = scanContent(pix, s, bounds, box);
+  fz_drop_pixmap(ctx, pix);
+  return found;
+}
+
+bool BKMUDocument::cropFor(int n, fz_page* page, fz_rect& box) {
+  if (m_crops.find(n, box))
+    return true;
+  if (!contentBox(m_ctx, page, box))
+    return false;
+  m_crops.store(n, box);
+  return true;
+}
+
+// The first open of a pre-baked archive takes over the bookmarks of its
+// source, which is looked for next to it. Pages map one to one from the
+// first page baked; the view resets to fit-width since the archive is
+// already at screen resolution.
+void BKMUDocument::importBakedBookmarks() {
+  if (strcmp(get_ext(filename.c_str()), ".cbz") != 0)
+    return;
+
+  fz_archive* arch = nullptr;
+  fz_buffer* buf = nullptr;
+  string meta;
+  fz_var(arch);
+  fz_var(buf);
+  fz_try(m_ctx) {
+    arch = fz_open_archive_with_stream(m_ctx, m_stream);
+    if (fz_has_archive_entry(m_ctx, arch, BKMU_BAKE_ENTRY)) {
+      buf = fz_read_archive_entry(m_ctx, arch, BKMU_BAKE_ENTRY);
+      unsigned char* data;
+      size_t n = fz_buffer_storage(m_ctx, buf, &data);
+      meta.assign((const char*)data, n);
+    }
+  } fz_always(m_ctx) {
+    fz_drop_buffer(m_ctx, buf);
+    fz_drop_archive(m_ctx, arch);
+  } fz_catch(m_ctx) {
+    return;
+  }
+  if (meta.compare(0, strlen(BKMU_BAKE_MAGIC), BKMU_BAKE_MAGIC) != 0)
+    return;
+
+  string source;
+  int first = 1;
+  istringstream in(meta);
+  string line;
+  while (getline(in, line)) {
+    size_t space = line.find(' ');
+    if (space == string::npos)
+      continue;
+    string key = line.substr(0, space);
+    if (key == "source")
+      source = line.substr(space + 1);
+    else if (key == "first")
+      first = atoi(line.substr(space + 1).c_str());
+  }
+  if (source.empty())
+    return;
+  size_t slash = filename.find_last_of('/');
+  if (slash != string::npos)
+    source = filename.substr(0, slash + 1) + source;
+
+  BKBookmark lastView;
+  BKBookmarkList own;
+  BKBookmarksManager::getBookmarks(filename, own);
+  if (!own.empty() || BKBookmarksManager::getLastView(filename, lastView))
+    return;
+
+  BKBookmarkList theirs;
+  BKBookmarksManager::getBookmarks(source, theirs);
+  if (BKBookmarksManager::getLastView(source, lastView))
+    theirs.push_back(lastView);
+  for (size_t i = 0; i < theirs.size(); ++i) {
+    int page = (int)get_or(theirs[i].viewData, "page", theirs[i].page) - (first - 1);
+    if (page < 0 || page >= m_pages)
+      continue;
+    BKBookmark b;
+    b.title = theirs[i].title;
+    b.page = page;
+    b.createdOn = theirs[i].createdOn;
+    b.lastView = theirs[i].lastView;
+    b.viewData["page"] = page;
+    b.viewData["panX"] = 0;
+    b.viewData["panY"] = 0;
+    b.viewData["scale"] = 1;
+    b.viewData["fitWidth"] = 1;
+    b.viewData["fitHeight"] = 0;
+    b.viewData["rotate"] = 0;
+    BKBookmarksManager::addBookmark(filename, b);
+  }
+}
+
 // Draws current page into texture using pixmap
 bool BKMUDocument::redrawBuffer() {
   #ifdef DEBUG
     printf("BKMUDocument::redrawBuffer pp\n");
-    chrono::steady_clock::time_point begin = chrono::steady_clock::now(); 
   #endif
   // fz_scale(&m_transform, m_scale / 72, m_scale / 72);
   // fz_pre_rotate(&m_transform, m_rotate);
@@ -179,41 +630,22 @@ bool BKMUDocument::redrawBuffer() {
   m_page = nullptr;
 
 
-  m_page = fz_load_page(m_ctx, m_doc, m_current_page);
-  m_links = fz_load_links(m_ctx, m_page);
-  m_pageText = fz_new_stext_page_from_page(m_ctx, m_page, nullptr);
+  {
+    FZ_PROFILE(FZ_PROFILE_PAGE_LOAD);
+    m_page = fz_load_page(m_ctx, m_doc, m_current_page);
+    m_links = fz_load_links(m_ctx, m_page);
+    m_pageText = fz_new_stext_page_from_page(m_ctx, m_page, nullptr);
+  }
 
   #ifdef DEBUG
     printf("fz_load\n");
   #endif
 
-  // bounds for inital window size
-  m_bounds = fz_bound_page(m_ctx, m_page);
-  #ifdef DEBUG
-    printf("bound_page; (%f, %f) - (%f, %f)\n", m_bounds.x0, m_bounds.y0, m_bounds.y0, m_bounds.y1);
-  #endif
-
-  fz_matrix rotation_matrix;
-  fz_matrix scaling_matrix;
-  fz_matrix translation_matrix;
-
-  // Rotate first since co-ords can be negative
-  rotation_matrix = fz_rotate(m_rotate); // m_t = rotate * scaling_matrix
-  fz_transform_rect(m_bounds, rotation_matrix);
-
-  // Translate to positive coords to figure out fit to width/height scale easily
-  translation_matrix = fz_translate(-m_bounds.x0, -m_bounds.y0); // matrix = translation matrix (for rect)
-  fz_transform_rect(m_bounds, translation_matrix);
-
-  if (m_fitWidth) {
-    m_scale = m_width / (m_bounds.x1 - m_bounds.x0);
-    vector<float> vec(std::begin(zoomLevels), std::end(zoomLevels));
-    auto const it = std::lower_bound(vec.begin(), vec.end(), m_scale);
-    if (it != vec.end())
-      zoomLevel = it - vec.begin();
-  }
-  else if (m_fitHeight) {
-    m_scale = m_height / (m_bounds.y1 - m_bounds.y0);
+  // blank pages are not cropped
+  fz_rect cropBox;
+  const fz_rect* crop = BKUser::options.pdfAutoCrop && cropFor(m_current_page, m_page, cropBox) ? &cropBox : nullptr;
+  m_transform = pageTransform(m_ctx, m_page, m_rotate, m_fitWidth, m_fitHeight, m_width, m_height, m_scale, m_bounds, crop);
+  if (m_fitWidth || m_fitHeight) {
     vector<float> vec(std::begin(zoomLevels), std::end(zoomLevels));
     auto const it = std::lower_bound(vec.begin(), vec.end(), m_scale);
     if (it != vec.end())
@@ -224,44 +656,38 @@ bool BKMUDocument::redrawBuffer() {
     printf("bound_page; m_scale: %2.3gx, zoomLevel: %i\n", m_scale, zoomLevel);
   #endif
 
-  // Scaling is then always positive so do it last
-  scaling_matrix = fz_scale(m_scale, m_scale);
-  fz_transform_rect(m_bounds, scaling_matrix);
-
-  // Create final transformation matrix in the correct order (Rotation x Scaling x Translation)
-  m_transform = fz_concat(rotation_matrix, scaling_matrix);
-  // fz_concat(&m_transform, &m_transform, &translation_matrix); // dont really need to translate the page...?
-
-  #ifdef DEBUG
-    printf("bound_page; (%f, %f) - (%f, %f)\n", m_bounds.x0, m_bounds.y0, m_bounds.y0, m_bounds.y1);
-  #endif
-
-  #ifdef DEBUG
-    printf("scale/transform\n");
-  #endif
-
   // TODO: Is display list or bbox better?
   // This is currently the longest operation
   pdf_annot *annot;
-  fz_try(m_ctx)
-    m_pix = fz_new_pixmap_from_page_contents(m_ctx, m_page, m_transform, fz_device_rgb(m_ctx), 0);
-  fz_catch(m_ctx) {
-    printf("cannot render page: %s\n", fz_caught_message(m_ctx));
+  {
+    FZ_PROFILE(FZ_PROFILE_PAGE_RENDER);
+    fz_try(m_ctx)
+      m_pix = renderPage(m_ctx, m_page, m_transform, crop);
+    fz_catch(m_ctx) {
+      printf("cannot render page: %s\n", fz_caught_message(m_ctx));
+    }
   }
+  // the samples come from the fitz allocator but are a page pixmap
+  size_t pixBytes = m_pix != nullptr ? (size_t)m_pix->stride * m_pix->h : 0;
+  FZMemory::move(FZ_MEM_MUPDF, FZ_MEM_PIXMAP, pixBytes);
 
   #ifdef DEBUG
     printf("new_pixmap n: %i \n", m_pix->n);
   #endif
 
-  #ifdef __vita__
+  #if defined(__vita__) || defined(HEADLESS)
     // Crashes due to GPU memory use without this.
-    vita2d_free_texture(texture);
+    if (m_texture != nullptr)
+      _vita2d_free_counted_texture(m_texture);
 
     #ifdef DEBUG
       printf("post vita2d_free_texture\n");
     #endif
 
-    texture = _vita2d_load_pixmap_generic(m_pix);
+    {
+      FZ_PROFILE(FZ_PROFILE_TEXTURE_UPLOAD);
+      m_texture = _vita2d_load_pixmap_generic(m_pix);
+    }
 
   #endif
 
@@ -269,13 +695,185 @@ bool BKMUDocument::redrawBuffer() {
     printf("post _vita2d_load_pixmap_generic\n");
   #endif
 
+  FZMemory::move(FZ_MEM_PIXMAP, FZ_MEM_MUPDF, pixBytes);
   fz_drop_pixmap(m_ctx, m_pix);
+  m_pix = nullptr;
   // load annotations
 
   return true;
 }
 
+// Page mode is redrawBuffer() plus a pan over one texture; continuous
+// scroll hands both to m_strip and keeps m_current_page on its top page.
+void BKMUDocument::setContinuous(bool on) {
+  m_continuous = on;
+  if (on == (m_strip != nullptr))
+    return;
+
+  if (on) {
+    m_strip = new BKMUStrip(m_ctx, m_doc, m_pages, &m_crops);
+    if (!m_strip->isRunning()) {
+      delete m_strip;
+      m_strip = nullptr;
+      char t[256];
+      snprintf(t, 256, "Continuous scroll unavailable");
+      setBanner(t);
+      return;
+    }
+    m_strip->setView(m_rotate, m_scale, m_fitWidth, m_fitHeight, m_width, m_height, BKUser::options.pdfAutoCrop);
+    m_strip->setPosition(m_current_page, -panY);
+    // the single page is not drawn until page mode is back
+    #if defined(__vita__) || defined(HEADLESS)
+      if (m_texture != nullptr) {
+        vita2d_wait_rendering_done();
+        _vita2d_free_counted_texture(m_texture);
+        m_texture = nullptr;
+      }
+    #endif
+  } else {
+    m_current_page = m_strip->getPage();
+    panY = 0;
+    delete m_strip;
+    m_strip = nullptr;
+    redrawBuffer();
+  }
+}
+
+// Spreads are always fit to the screen; like the strip they take the
+// place of redrawBuffer() and keep m_current_page on the left page.
+void BKMUDocument::setSpreads(bool on) {
+  m_spreads = on;
+  if (on == (m_spread != nullptr))
+    return;
+
+  if (on) {
+    m_spread = new BKMUSpread(m_ctx, m_doc, m_pages, &m_crops);
+    if (!m_spread->isRunning()) {
+      delete m_spread;
+      m_spread = nullptr;
+      char t[256];
+      snprintf(t, 256, "Two-page spreads unavailable");
+      setBanner(t);
+      return;
+    }
+    m_spread->setView(m_rotate, m_width, m_height, BKUser::options.pdfAutoCrop);
+    m_spread->setCover(BKUser::options.pdfSpreadCover);
+    m_spread->setPage(m_current_page);
+    m_current_page = m_spread->getPage();
+    panX = 0;
+    panY = 0;
+    #if defined(__vita__) || defined(HEADLESS)
+      if (m_texture != nullptr) {
+        vita2d_wait_rendering_done();
+        _vita2d_free_counted_texture(m_texture);
+        m_texture = nullptr;
+      }
+    #endif
+  } else {
+    m_current_page = m_spread->getPage();
+    delete m_spread;
+    m_spread = nullptr;
+    redrawBuffer();
+  }
+}
+
+int BKMUDocument::updateSpread() {
+  int r = 0;
+  m_spread->setCover(BKUser::options.pdfSpreadCover);
+  if (loadNewPage) {
+    loadNewPage = false;
+    m_spread->setPage(m_current_page);
+    m_current_page = m_spread->getPage();
+    saveLastView();
+
+    char t[256];
+    if (m_spread->getCount() == 2)
+      snprintf(t, 256, "Pages %d-%d of %d", m_current_page + 1, m_current_page + 2, m_pages);
+    else
+      snprintf(t, 256, "Page %d of %d", m_current_page + 1, m_pages);
+    setBanner(t);
+    r = BK_CMD_MARK_DIRTY;
+  }
+  // spreads always fit the screen
+  zooming = false;
+
+  if (m_spread->update())
+    r = BK_CMD_MARK_DIRTY;
+  m_current_page = m_spread->getPage();
+  return r;
+}
+
+bool BKMUDocument::syncViewMode() {
+  bool spreads = BKUser::options.pdfSpreads;
+  bool continuous = BKUser::options.pdfContinuousScroll && !spreads;
+  if (spreads == m_spreads && continuous == m_continuous)
+    return false;
+  // leave one mode before entering the other, only one is ever open
+  if (!spreads)
+    setSpreads(false);
+  if (continuous != m_continuous)
+    setContinuous(continuous);
+  if (spreads)
+    setSpreads(true);
+  return true;
+}
+
+void BKMUDocument::refreshView() {
+  if (m_spread != nullptr)
+    m_spread->setView(m_rotate, m_width, m_height, BKUser::options.pdfAutoCrop);
+  else if (m_strip != nullptr)
+    m_strip->setView(m_rotate, m_scale, m_fitWidth, m_fitHeight, m_width, m_height, BKUser::options.pdfAutoCrop);
+  else
+    redrawBuffer();
+}
+
+int BKMUDocument::updateStrip() {
+  int r = 0;
+  if (loadNewPage) {
+    loadNewPage = false;
+    m_strip->setPosition(m_current_page, 0);
+    saveLastView();
+
+    char t[256];
+    snprintf(t, 256, "Page %d of %d", m_current_page + 1, m_pages);
+    setBanner(t);
+    r = BK_CMD_MARK_DIRTY;
+  } else if (zooming) {
+    zooming = false;
+    panX = 0;
+    refreshView();
+    m_strip->setPosition(m_strip->getPage(), 0);
+    char t[256];
+    snprintf(t, 256, "Zoomed...");
+    setBanner(t);
+    r = BK_CMD_MARK_DIRTY;
+  }
+
+  if (m_strip->update())
+    r = BK_CMD_MARK_DIRTY;
+  m_current_page = m_strip->getPage();
+  return r;
+}
+
 int BKMUDocument::updateContent() {
+  // PDFs are reopened as BKMUReflow
+  if (BKUser::options.pdfReflow && m_pdf != nullptr)
+    return BK_CMD_RELOAD;
+  if (syncViewMode()) {
+    loadNewPage = false;
+    zooming = false;
+    return BK_CMD_MARK_DIRTY;
+  }
+  if (m_autoCrop != BKUser::options.pdfAutoCrop) {
+    m_autoCrop = BKUser::options.pdfAutoCrop;
+    refreshView();
+    return BK_CMD_MARK_DIRTY;
+  }
+  if (m_spread != nullptr)
+    return updateSpread();
+  if (m_strip != nullptr)
+    return updateStrip();
+
   if (loadNewPage) {
     panY = 0;
     redrawBuffer();
@@ -305,20 +903,85 @@ int BKMUDocument::updateContent() {
 }
 
 int BKMUDocument::resume() {
-  // mupdf leaves open file descriptors around. they don't survive a suspend.
-  // Is this still the case? yes
-  // TODO: Don't need to reload for epub/html based docs, all kept in memory and retained
-  return BK_CMD_RELOAD;
+  // the workers may be reading through the stream
+  if (m_strip != nullptr) {
+    m_strip->lockDocument();
+    int r = reopenStream();
+    m_strip->unlockDocument();
+    return r;
+  }
+  if (m_spread != nullptr) {
+    m_spread->lockDocument();
+    int r = reopenStream();
+    m_spread->unlockDocument();
+    return r;
+  }
+  return reopenStream();
+}
+
+int BKMUDocument::reopenStream() {
+  // The file descriptor may not survive a suspend. Everything else
+  // (document, store, page, texture) does, so only the file under the
+  // stream is swapped for a fresh one if it went stale.
+  if (m_stream == nullptr)
+    return 0;
+
+  // ask the descriptor itself rather than the stdio buffer in front
+  // of it, which some C libraries seek within without a system call
+  BKFileStream* state = (BKFileStream*)m_stream->state;
+  if (lseek(fileno(state->file), 0, SEEK_CUR) >= 0 && !ferror(state->file))
+    return 0;
+
+  #ifdef DEBUG
+    printf("resume: file descriptor lost, reopening %s\n", filename.c_str());
+  #endif
+  FILE* f = fopen(filename.c_str(), "rb");
+  // the file changed or went away, nothing for it but a full reload
+  if (f == NULL || fseek(f, m_stream->pos, SEEK_SET) != 0) {
+    if (f != NULL)
+      fclose(f);
+    return BK_CMD_RELOAD;
+  }
+  fclose(state->file);
+  state->file = f;
+  // what is still buffered between rp and wp stays valid, the next
+  // read continues from pos in the new file
+  return BK_CMD_MARK_DIRTY;
 }
 
+#ifdef HEADLESS
+void BKMUDocument::invalidateFile() {
+  if (m_stream == nullptr)
+    return;
+  // a pipe cannot seek, the next lseek() fails with ESPIPE as a stale
+  // descriptor would
+  int p[2];
+  if (pipe(p) != 0)
+    return;
+  BKFileStream* state = (BKFileStream*)m_stream->state;
+  dup2(p[0], fileno(state->file));
+  close(p[0]);
+  close(p[1]);
+}
+#endif
+
 void BKMUDocument::renderContent() {
   #ifdef DEBUG_RENDER
     printf("BKMUDocument::renderContent %i / %i\n", m_current_page, m_pages);
   #endif
 
   FZScreen::clear(0xefefef, FZ_COLOR_BUFFER);
-  #ifdef __vita__
-    vita2d_draw_texture(texture, panX, panY);
+  if (m_strip != nullptr) {
+    m_strip->draw(panX);
+    return;
+  }
+  if (m_spread != nullptr) {
+    m_spread->draw();
+    return;
+  }
+  #if defined(__vita__) || defined(HEADLESS)
+    if (m_texture != nullptr)
+      vita2d_draw_texture(m_texture, panX, panY);
   #endif
 
   // TODO: Show Page Error, don"t draw texture then.
@@ -358,43 +1021,46 @@ int BKMUDocument::setCurrentPage(int page_number) {
   return 0;
 }
 
+// With spreads on the flip buttons move a whole spread. The layout is
+// taken from m_current_page, not the spread on screen, so flips made
+// before the next updateContent() add up.
+int BKMUDocument::nextPage() {
+  if (m_spread == nullptr)
+    return setCurrentPage(m_current_page + 1);
+  int left = m_spread->first(m_current_page);
+  return setCurrentPage(left + m_spread->count(left));
+}
+
+int BKMUDocument::previousPage() {
+  if (m_spread == nullptr)
+    return setCurrentPage(m_current_page - 1);
+  int left = m_spread->first(m_current_page);
+  return setCurrentPage(left == 0 ? -1 : m_spread->first(left - 1));
+}
+
 bool BKMUDocument::isMUDocument(string& file) {
   // Read First 4 bytes
   char header[4];
-  memset((void*)header, 0, 4);
-  
-  #ifdef __vita__
-    int fd = sceIoOpen(file.c_str(), SCE_O_RDONLY, 0777);
-    if (fd < 0) {
-      printf("sceIoOpen fail: %d, %s\n", errno, strerror(errno));
-      return false;
-    }
-
-    sceIoRead(fd, header, 4);
-    sceIoClose(fd);
-  #else
-    FILE* f = fopen(file.c_str(), "r");
-    if(f == NULL) {
-      #ifdef DEBUG
-        printf("fopen fail: %d, %s\n", errno, strerror(errno));
-      #endif
-      throw "failed opening file; try again";
-    }
+  if (read_file_header(file.c_str(), header, 4) < 0) {
+    #ifdef DEBUG
+      printf("isMUDocument: cannot open %s: %d, %s\n", file.c_str(), errno, strerror(errno));
+    #endif
+    return false;
+  }
 
-    fread(header, 4, 1, f);
-    fclose(f);
-  #endif
+  return isMUDocument(file, header, 4);
+}
 
+bool BKMUDocument::isMUDocument(string& file, const char* header, int headerSize) {
   const char* ext = get_ext(file.c_str());
 
   #ifdef DEBUG
-    printf("scefile opened\n", ext);
     printf("ismu; ext: %s\n", ext);
   #endif
 
   // TODO: get libmagic or something?
   // Trusting the user for now...
-  return ((header[0] == 0x25 && header[1] == 0x50 && header[2] == 0x44 && header[3] == 0x46) ||
+  return ((headerSize >= 4 && header[0] == 0x25 && header[1] == 0x50 && header[2] == 0x44 && header[3] == 0x46) ||
           (strcmp(ext, ".xps") == 0) ||
           (strcmp(ext, ".svg") == 0) ||
           (strcmp(ext, ".cbz") == 0) ||
@@ -417,6 +1083,11 @@ bool BKMUDocument::isPaginated() {
 
 #define D_PAD_SPEED 250
 int BKMUDocument::screenUp() {
+  if (m_spread != nullptr)
+    return 0;
+  if (m_strip != nullptr)
+    return m_strip->scroll(-D_PAD_SPEED) ? BK_CMD_MARK_DIRTY : 0;
+
   float potentialY = panY + D_PAD_SPEED;
   
   #ifdef DEBUG
@@ -428,9 +1099,15 @@ int BKMUDocument::screenUp() {
     panY = m_bounds.y0;
   else
     panY = potentialY;
+  return BK_CMD_MARK_DIRTY;
 }
 
 int BKMUDocument::screenDown() {
+  if (m_spread != nullptr)
+    return 0;
+  if (m_strip != nullptr)
+    return m_strip->scroll(D_PAD_SPEED) ? BK_CMD_MARK_DIRTY : 0;
+
   float potentialY = panY - D_PAD_SPEED;
   
   #ifdef DEBUG
@@ -443,6 +1120,7 @@ int BKMUDocument::screenDown() {
     panY = -bottomBounds;
   else
     panY = potentialY;
+  return BK_CMD_MARK_DIRTY;
 }
 
 // TODO: Move this to bkuser.
@@ -455,6 +1133,9 @@ int BKMUDocument::pan(int x, int y) {
   if (abs(x) <= FZ_ANALOG_THRESHOLD &&
       abs(y) <= FZ_ANALOG_THRESHOLD)
     return 0;
+  // a spread always fits the screen
+  if (m_spread != nullptr)
+    return 0;
 
   #ifdef DEBUG
     printf("panX: %f panY: %f\n x1:%f y1:%f\n x0:%f y0:%f\n", panX, panY, m_bounds.x1, m_bounds.y1, m_bounds.x0, m_bounds.y0);
@@ -463,6 +1144,21 @@ int BKMUDocument::pan(int x, int y) {
   // if settings.invertAnalog
   // x = -x
 
+  // the strip scrolls over page boundaries, only wide pages pan sideways
+  if (m_strip != nullptr) {
+    if (abs(y) > FZ_ANALOG_THRESHOLD)
+      m_strip->scroll(y/10);
+    if (abs(x) > FZ_ANALOG_THRESHOLD) {
+      panX -= x/10;
+      float left = m_width - m_strip->getVisibleWidth();
+      if (panX < left)
+        panX = left;
+      if (panX > 0)
+        panX = 0;
+    }
+    return BK_CMD_MARK_DIRTY;
+  }
+
   // bounds checked pan
   if (abs(x) > FZ_ANALOG_THRESHOLD) {
     if (panX > m_bounds.x0) { // left bounds
@@ -558,14 +1254,14 @@ bool BKMUDocument::hasZoomToFit() {
 int BKMUDocument::setZoomToFitWidth() {
   m_fitWidth = true;
   m_fitHeight = false;
-  redrawBuffer();
+  refreshView();
   return 0;
 }
 
 int BKMUDocument::setZoomToFitHeight() {
   m_fitWidth = false;
   m_fitHeight = true;
-  redrawBuffer();
+  refreshView();
   return 0;
 }
 
@@ -626,7 +1322,7 @@ int BKMUDocument::setRotation(int r, bool bForce) {
 
   // redrawBuffer();
   // return BK_CMD_MARK_DIRTY;
-  redrawBuffer();
+  refreshView();
 
   return 0;
 }
@@ -637,6 +1333,20 @@ void BKMUDocument::getBookmarkPosition(map<string, float>& m) {
   
   m["panX"] = panX;
   m["panY"] = panY;
+  // the same meaning as in page mode, how far down the page the view is
+  if (m_strip != nullptr) {
+    m["page"] = m_strip->getPage();
+    m["panY"] = -m_strip->getOffset();
+  }
+
+  // the page comes back without a scan
+  fz_rect crop;
+  if (m_crops.find((int)m["page"], crop)) {
+    m["cropX0"] = crop.x0;
+    m["cropY0"] = crop.y0;
+    m["cropX1"] = crop.x1;
+    m["cropY1"] = crop.y1;
+  }
 
   m["scale"] = m_scale;
   m["fitWidth"] = m_fitWidth; 
@@ -648,6 +1358,12 @@ int BKMUDocument::setBookmarkPosition(map<string, float>& m) {
   #ifdef DEBUG
     printf("setBookmarkPosition: page %i, panX %i, panY %i", m["page"], m["panX"], m["panY"]);
   #endif
+  applyView(m);
+  showView();
+  return BK_CMD_MARK_DIRTY;
+}
+
+void BKMUDocument::applyView(map<string, float>& m) {
   setCurrentPage(m["page"]);
   loadNewPage = false;
 
@@ -660,9 +1376,45 @@ int BKMUDocument::setBookmarkPosition(map<string, float>& m) {
   m_fitHeight = get_or(m, "fitHeight", false);
   m_rotate = get_or(m, "rotate", 0);
 
-  redrawBuffer();
+  if (get_or(m, "cropX1", 0) > get_or(m, "cropX0", 0)) {
+    fz_rect crop;
+    crop.x0 = m["cropX0"];
+    crop.y0 = m["cropY0"];
+    crop.x1 = m["cropX1"];
+    crop.y1 = m["cropY1"];
+    m_crops.store(m_current_page, crop);
+  }
+}
 
-  return BK_CMD_MARK_DIRTY;
+void BKMUDocument::showView() {
+  refreshView();
+  if (m_strip != nullptr)
+    m_strip->setPosition(m_current_page, -panY);
+  if (m_spread != nullptr) {
+    m_spread->setPage(m_current_page);
+    m_current_page = m_spread->getPage();
+  }
+}
+
+size_t BKMUDocument::getMemoryUsage() {
+  return m_heap.current;
+}
+
+void BKMUDocument::trimMemory() {
+  if (m_strip != nullptr)
+    m_strip->trim();
+  if (m_spread != nullptr)
+    m_spread->trim();
+  // fonts, images, parsed objects and glyphs come back on demand
+  if (m_ctx != nullptr) {
+    fz_empty_store(m_ctx);
+    fz_purge_glyph_cache(m_ctx);
+  }
+}
+
+void BKMUDocument::shrinkMemory(int percent) {
+  if (m_ctx != nullptr)
+    fz_shrink_store(m_ctx, percent);
 }
 
 void BKMUDocument::getTitle(string& t) {
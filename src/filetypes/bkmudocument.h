@@ -29,17 +29,34 @@
 #ifndef BKMUPDFDOCUMENT_H
 #define BKMUPDFDOCUMENT_H
 
+#include <pthread.h>
+
 #include <mupdf/fitz.h>
 #include <mupdf/pdf.h>
 
 #include "../bkdocument.h"
 #include "../graphics/fzscreen.h"
+#include "bkmustrip.h"
+#include "bkmuspread.h"
+#include "bkmucrops.h"
 
 using namespace std;
 
+// Heap used by one document's fitz context, counted by its allocator.
+struct BKMUHeapUsage {
+  size_t current;
+  size_t peak;
+};
+
 class BKMUDocument : public BKDocument {
 private:
+  BKMUHeapUsage m_heap;
+  fz_alloc_context m_alloc;
+  // the continuous scroll worker shares the store through a clone
+  pthread_mutex_t m_locks[FZ_LOCK_MAX];
+  fz_locks_context m_lockContext;
   fz_context *m_ctx;
+  fz_stream *m_stream;
   fz_document *m_doc;
   fz_page *m_page;
   fz_pixmap *m_pix;
@@ -70,7 +87,42 @@ private:
 
   string filename;
 
+  // content boxes of the pages seen with auto crop on, shared with the
+  // strip and the spread
+  BKMUCrops m_crops;
+  // BKUser::options.pdfAutoCrop when the view was last drawn
+  bool m_autoCrop;
+  // m_crops entry for the page, computed if needed; false if blank
+  bool cropFor(int n, fz_page* page, fz_rect& box);
+
+  // pages stacked top to bottom, see BKMUStrip; null in page mode
+  BKMUStrip* m_strip;
+  // BKUser::options.pdfContinuousScroll when it was last looked at
+  bool m_continuous;
+  // two pages at a time, see BKMUSpread; null unless pdfSpreads is on
+  BKMUSpread* m_spread;
+  bool m_spreads;
+
+  #if defined(__vita__) || defined(HEADLESS)
+    // texture of current pixmap, TODO: generic fztexture
+    vita2d_texture *m_texture;
+  #endif
+
   bool redrawBuffer();
+  // redrawBuffer() or the strip, after the zoom, fit or rotation changed
+  void refreshView();
+  // the saved view state, without drawing; showView() draws it
+  void applyView(map<string, float>& m);
+  void showView();
+  // follows the view options, true if the mode changed
+  bool syncViewMode();
+  void setContinuous(bool on);
+  int updateStrip();
+  void setSpreads(bool on);
+  int updateSpread();
+  int reopenStream();
+  bool open(FILE* file, const char* magic);
+  void importBakedBookmarks();
 
 protected:
   BKMUDocument(string& f);
@@ -79,12 +131,20 @@ protected:
 public:
 	virtual int updateContent();
 	virtual int resume();
+  #ifdef HEADLESS
+    // breaks the descriptor under the stream the way a suspend can, so
+    // bookr-bench can drive resume() without a console
+    void invalidateFile();
+  #endif
 	virtual void renderContent();
 
   virtual bool isPaginated();
   virtual int getTotalPages();
+  virtual int getPageCount() { return m_pages; }
 	virtual int getCurrentPage();
 	virtual int setCurrentPage(int);
+  virtual int nextPage();
+  virtual int previousPage();
 
   virtual int pan(int, int);
   virtual int screenUp();
@@ -92,12 +152,46 @@ public:
 	virtual int screenLeft();
 	virtual int screenRight();
 
+  virtual size_t getMemoryUsage();
+  virtual void trimMemory();
+  virtual void shrinkMemory(int percent);
+
   virtual void getFileName(string&);
   virtual void getTitle(string&);
   virtual void getType(string&);
 
   static BKMUDocument* create(string& file);
+  // takes ownership of f, which must be positioned at the start; view
+  // is the last view to open at, or null for the first page
+  static BKMUDocument* create(string& file, FILE* f, const char* header, int headerSize,
+    map<string, float>* view);
   static bool isMUDocument(string& file);
+  static bool isMUDocument(string& file, const char* header, int headerSize);
+
+  // The view's rendering path without a document or a screen, for batch
+  // tools that must rasterise exactly what the reader shows.
+  // A fitz context set up like a document's; alloc may be null.
+  static fz_context* newContext(fz_alloc_context* alloc, fz_locks_context* locks, size_t storeBudget);
+  // fz_stream over f, which it owns from then on, also if it throws
+  static fz_stream* newStream(fz_context* ctx, FILE* f);
+  // Rotation, then scale or the scale that fits the page into width or
+  // height; scale is updated for the fit modes. bounds gets the page
+  // bounds, or crop moved to the origin if the page is cropped.
+  static fz_matrix pageTransform(fz_context* ctx, fz_page* page, float rotate, bool fitWidth, bool fitHeight,
+    int width, int height, float& scale, fz_rect& bounds, const fz_rect* crop = nullptr);
+  // RGB without alpha, throws through fitz like fz_new_pixmap_from_page_contents;
+  // only the clip area of the page if there is one
+  static fz_pixmap* renderPage(fz_context* ctx, fz_page* page, fz_matrix transform, const fz_rect* clip = nullptr);
+  // Area of the page with something drawn on it, plus a small margin,
+  // found on a small grayscale render; false for a blank page.
+  static bool contentBox(fz_context* ctx, fz_page* page, fz_rect& box);
+  static bool contentBox(fz_context* ctx, fz_display_list* list, fz_rect& box);
+
+  // Comic archives pre-baked by bookr-render --bake carry this entry,
+  // "key value" lines naming the source document and the first page
+  // baked, so the source's bookmarks can follow by page number.
+  #define BKMU_BAKE_ENTRY "bookr-bake.txt"
+  #define BKMU_BAKE_MAGIC "bookr bake 1"
 
 	virtual bool isZoomable();
 	virtual void getZoomLevels(vector<BKDocument::ZoomLevel>& v);
@@ -111,6 +205,11 @@ public:
 	virtual int getRotation() ;
 	virtual int setRotation(int, bool bForce=false);
 
+	// null unless continuous scroll is on
+	BKMUStrip* getStrip() { return m_strip; }
+	// null unless two-page spreads are on
+	BKMUSpread* getSpread() { return m_spread; }
+
 	virtual bool isBookmarkable();
 	virtual void getBookmarkPosition(map<string, float>&);
 	virtual int setBookmarkPosition(map<string, float>&);
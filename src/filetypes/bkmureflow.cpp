@@ -0,0 +1,301 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bkmureflow.h"
+#include "bkmudocument.h"
+#include "../bkmemorygovernor.h"
+#include "../utils.h"
+#include "../graphics/fzprofiler.h"
+
+BKMUReflow::BKMUReflow() : ctx(nullptr), stream(nullptr), doc(nullptr), sourcePages(0) {
+}
+
+BKMUReflow::~BKMUReflow() {
+  saveLastView();
+  closeSource();
+  for (size_t i = 0; i < pages.size(); ++i)
+    free(pages[i].text);
+}
+
+void BKMUReflow::closeSource() {
+  if (ctx == nullptr)
+    return;
+  fz_drop_document(ctx, doc);
+  fz_drop_stream(ctx, stream);
+  fz_drop_context(ctx);
+  doc = nullptr;
+  stream = nullptr;
+  ctx = nullptr;
+}
+
+BKMUReflow* BKMUReflow::create(string& file, FILE* f) {
+  double t = get_time_ms();
+  BKMUReflow* r = new BKMUReflow();
+  r->fileName = file;
+  r->ctx = BKMUDocument::newContext(nullptr, nullptr, BKMemoryGovernor::getStoreBudget());
+  if (r->ctx == nullptr) {
+    fclose(f);
+    delete r;
+    throw "failed opening document";
+  }
+
+  bool opened = true;
+  fz_try(r->ctx) {
+    r->stream = BKMUDocument::newStream(r->ctx, f);
+    r->doc = fz_open_document_with_stream(r->ctx, "application/pdf", r->stream);
+    if (fz_needs_password(r->ctx, r->doc))
+      fz_throw(r->ctx, FZ_ERROR_GENERIC, "no pass");
+    r->sourcePages = fz_count_pages(r->ctx, r->doc);
+  } fz_catch(r->ctx) {
+    printf("opening error: %s\n", fz_caught_message(r->ctx));
+    opened = false;
+  }
+  if (!opened) {
+    delete r;
+    throw "failed opening document";
+  }
+
+  char buf[256];
+  if (fz_lookup_metadata(r->ctx, r->doc, FZ_META_INFO_TITLE, buf, sizeof(buf)) > 0 && buf[0] != 0)
+    r->title = buf;
+  else
+    r->title = file.substr(file.find_last_of('/') + 1);
+
+  r->resizeView(FZ_SCREEN_WIDTH, FZ_SCREEN_HEIGHT);
+  openTimings.open = get_time_ms() - t;
+
+  // only the first pages, the rest is streamed by updateContent
+  t = get_time_ms();
+  while (r->getTotalPages() <= BKMU_REFLOW_OPEN_PAGES && r->loadMore())
+    ;
+  openTimings.countPages = get_time_ms() - t;
+  return r;
+}
+
+bool BKMUReflow::isReflowable(const char* header, int headerSize) {
+  return headerSize >= 4 && memcmp(header, "%PDF", 4) == 0;
+}
+
+static void appendUTF8(string& out, int c) {
+  if (c < 0x80) {
+    out += (char)c;
+  } else if (c < 0x800) {
+    out += (char)(0xc0 | (c >> 6));
+    out += (char)(0x80 | (c & 0x3f));
+  } else if (c < 0x10000) {
+    out += (char)(0xe0 | (c >> 12));
+    out += (char)(0x80 | ((c >> 6) & 0x3f));
+    out += (char)(0x80 | (c & 0x3f));
+  }
+}
+
+static bool aboveBlock(const fz_stext_block* a, const fz_stext_block* b) {
+  return a->bbox.y0 < b->bbox.y0;
+}
+
+static void appendBlock(const fz_stext_block* block, string& out) {
+  size_t start = out.size();
+  for (fz_stext_line* line = block->u.t.first_line; line != nullptr; line = line->next) {
+    if (out.size() > start) {
+      // a word hyphenated at the end of the line is joined again
+      size_t n = out.size();
+      if (n - start >= 2 && out[n - 1] == '-' && isalpha((unsigned char)out[n - 2]))
+        out.erase(n - 1);
+      else if (out[n - 1] != ' ')
+        out += ' ';
+    }
+    for (fz_stext_char* ch = line->first_char; ch != nullptr; ch = ch->next) {
+      int c = ch->c;
+      if (c == 0xa0 || c == '\t')
+        c = ' ';
+      if (c < 32 || (c == ' ' && (out.size() == start || out[out.size() - 1] == ' ')))
+        continue;
+      appendUTF8(out, c);
+    }
+  }
+  while (out.size() > start && out[out.size() - 1] == ' ')
+    out.erase(out.size() - 1);
+  if (out.size() > start)
+    out += '\n';
+}
+
+// Content streams are in drawing order, which is often not the reading
+// order. Blocks are taken top to bottom; blocks that stay in one half of
+// the page are columns, and between two blocks that span the page the
+// left column is read before the right one.
+void BKMUReflow::extractText(fz_stext_page* page, string& out) {
+  vector<fz_stext_block*> blocks;
+  for (fz_stext_block* b = page->first_block; b != nullptr; b = b->next) {
+    if (b->type == FZ_STEXT_BLOCK_TEXT)
+      blocks.push_back(b);
+  }
+  stable_sort(blocks.begin(), blocks.end(), aboveBlock);
+
+  float mid = (page->mediabox.x0 + page->mediabox.x1) / 2;
+  float slack = (page->mediabox.x1 - page->mediabox.x0) / 50;
+  vector<fz_stext_block*> left, right;
+  for (size_t i = 0; i <= blocks.size(); ++i) {
+    fz_stext_block* b = i < blocks.size() ? blocks[i] : nullptr;
+    if (b != nullptr && b->bbox.x1 <= mid + slack) {
+      left.push_back(b);
+      continue;
+    }
+    if (b != nullptr && b->bbox.x0 >= mid - slack) {
+      right.push_back(b);
+      continue;
+    }
+    for (size_t j = 0; j < left.size(); ++j)
+      appendBlock(left[j], out);
+    for (size_t j = 0; j < right.size(); ++j)
+      appendBlock(right[j], out);
+    left.clear();
+    right.clear();
+    if (b != nullptr)
+      appendBlock(b, out);
+  }
+}
+
+// Read, order and lay out one more page. Returns false once the whole
+// PDF is in.
+bool BKMUReflow::loadMore() {
+  if (doc == nullptr)
+    return false;
+
+  int n = pages.size();
+  string text;
+  fz_page* page = nullptr;
+  fz_stext_page* stext = nullptr;
+  fz_var(page);
+  fz_var(stext);
+  {
+    FZ_PROFILE(FZ_PROFILE_PAGE_LOAD);
+    fz_try(ctx) {
+      page = fz_load_page(ctx, doc, n);
+      stext = fz_new_stext_page_from_page(ctx, page, nullptr);
+      extractText(stext, text);
+    } fz_always(ctx) {
+      fz_drop_stext_page(ctx, stext);
+      fz_drop_page(ctx, page);
+    } fz_catch(ctx) {
+      printf("cannot read page %d: %s\n", n + 1, fz_caught_message(ctx));
+    }
+  }
+  // a blank line between pages, also for pages without text, so every
+  // page has a run to start at
+  text += '\n';
+
+  Page p;
+  p.text = (char*)malloc(text.size());
+  memcpy(p.text, text.data(), text.size());
+  p.firstRun = nRuns;
+  pages.push_back(p);
+  textBytes += text.size();
+  appendText(p.text, text.size(), false);
+
+  // the text is all that is needed from now on
+  if ((int)pages.size() >= sourcePages)
+    closeSource();
+  return doc != nullptr;
+}
+
+int BKMUReflow::pageForRun(int run) {
+  int lo = 0;
+  int hi = pages.size() - 1;
+  while (lo < hi) {
+    int m = (lo + hi + 1) / 2;
+    if (pages[m].firstRun <= run)
+      lo = m;
+    else
+      hi = m - 1;
+  }
+  return lo;
+}
+
+int BKMUReflow::updateContent() {
+  // switched back to the page view
+  if (!BKUser::options.pdfReflow)
+    return BK_CMD_RELOAD;
+  int r = BKFancyText::updateContent();
+  if (r != 0 || doc == nullptr)
+    return r;
+  double t = get_time_ms();
+  while (loadMore() && get_time_ms() - t < BKMU_REFLOW_STREAM_MS)
+    ;
+  // refresh the page count once the PDF is complete
+  return doc == nullptr ? BK_CMD_MARK_DIRTY : 0;
+}
+
+int BKMUReflow::setCurrentPage(int p) {
+  while (p > getTotalPages() && loadMore())
+    ;
+  return BKFancyText::setCurrentPage(p);
+}
+
+// Stored with the PDF page as well, so the page view and the reflowed
+// view open each other's last position.
+void BKMUReflow::getBookmarkPosition(map<string, float>& m) {
+  BKFancyText::getBookmarkPosition(m);
+  m["page"] = pages.empty() ? 0 : pageForRun((int)m["topLineFirstRun"]);
+}
+
+int BKMUReflow::setBookmarkPosition(map<string, float>& m) {
+  if (m.find("topLineFirstRun") != m.end()) {
+    int run = (int)m["topLineFirstRun"];
+    while (run >= nRuns && loadMore())
+      ;
+    return BKFancyText::setBookmarkPosition(m);
+  }
+  int page = (int)get_or(m, "page", 0);
+  while (page >= (int)pages.size() && loadMore())
+    ;
+  if (page >= (int)pages.size())
+    return 0;
+  return setLine(lineForRun(pages[page].firstRun));
+}
+
+size_t BKMUReflow::getMemoryUsage() {
+  return textBytes + nRuns * sizeof(BKRun) + pages.capacity() * sizeof(Page);
+}
+
+void BKMUReflow::getFileName(string& fn) {
+  fn = fileName;
+}
+
+void BKMUReflow::getTitle(string& t) {
+  t = title;
+}
+
+void BKMUReflow::getType(string& t) {
+  t = "PDF text";
+}
@@ -0,0 +1,103 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BKMUREFLOW_H
+#define BKMUREFLOW_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <mupdf/fitz.h>
+
+#include "../graphics/fzscreen.h"
+
+using namespace std;
+
+#include "bkfancytext.h"
+
+// A PDF read as text: the structured text of each page is put in
+// reading order and laid out by BKFancyText, nothing is rasterised.
+// Like BKPalmDoc, create() only reads enough pages for the first
+// screens and updateContent() streams in the rest a few milliseconds
+// per frame. The text of every page is kept, so flipping and laying
+// out again never go back to the PDF.
+class BKMUReflow : public BKFancyText {
+  #define BKMU_REFLOW_OPEN_PAGES  2
+  #define BKMU_REFLOW_STREAM_MS   4
+
+  struct Page {
+    // the page's text, the runs point into it
+    char* text;
+    // first run of the page
+    int firstRun;
+  };
+
+  private:
+  string fileName;
+  string title;
+  // null once every page has been read
+  fz_context* ctx;
+  fz_stream* stream;
+  fz_document* doc;
+  int sourcePages;
+  vector<Page> pages;
+
+  bool loadMore();
+  void closeSource();
+  int pageForRun(int run);
+
+  protected:
+  BKMUReflow();
+  ~BKMUReflow();
+
+  public:
+  virtual int updateContent();
+  virtual int setCurrentPage(int);
+  virtual void getBookmarkPosition(map<string, float>&);
+  virtual int setBookmarkPosition(map<string, float>&);
+
+  virtual size_t getMemoryUsage();
+
+  virtual void getFileName(string&);
+  virtual void getTitle(string&);
+  virtual void getType(string&);
+
+  // pages of the PDF, and how many of them are in
+  int getSourcePages() { return sourcePages; }
+  int getLoadedPages() { return pages.size(); }
+
+  // takes ownership of f
+  static BKMUReflow* create(string& file, FILE* f);
+  // reflow applies to PDF files only
+  static bool isReflowable(const char* header, int headerSize);
+  // UTF-8 text of a page, a line per block, in reading order
+  static void extractText(fz_stext_page* page, string& out);
+};
+
+#endif
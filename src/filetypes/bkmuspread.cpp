@@ -0,0 +1,442 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bkmuspread.h"
+#include "bkmudocument.h"
+#include "../utils.h"
+#include "../graphics/fzbufferpool.h"
+#include "../graphics/fzprofiler.h"
+
+struct BKMUSpreadPage {
+  int w, h;
+  // RGBA rows of w * 4 bytes, until they are in the texture
+  char* pixels;
+  bool failed;
+  #if defined(__vita__) || defined(HEADLESS)
+    vita2d_texture* texture;
+  #endif
+  BKMUSpreadPage() : w(0), h(0), pixels(nullptr), failed(false) {
+    #if defined(__vita__) || defined(HEADLESS)
+      texture = nullptr;
+    #endif
+  }
+};
+
+BKMUSpread::BKMUSpread(fz_context* ctx, fz_document* d, int n, BKMUCrops* cr) :
+  doc(d), pages(n), quit(false), generation(0), crops(cr), left(0), cover(true), flipStart(0), lastFlipTime(0)
+{
+  view.rotate = 0;
+  view.width = FZ_SCREEN_WIDTH;
+  view.height = FZ_SCREEN_HEIGHT;
+  view.crop = false;
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_mutex_init(&docLock, NULL);
+  pthread_cond_init(&wake, NULL);
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, BKMU_SPREAD_THREAD_STACK);
+  for (int i = 0; i < BKMU_SPREAD_WORKERS; ++i) {
+    Worker& w = workers[i];
+    w.spread = this;
+    w.running = false;
+    // NULL unless the document's context has locks
+    w.ctx = fz_clone_context(ctx);
+    if (w.ctx != nullptr)
+      w.running = pthread_create(&w.thread, &attr, worker, &w) == 0;
+  }
+  pthread_attr_destroy(&attr);
+}
+
+BKMUSpread::~BKMUSpread() {
+  pthread_mutex_lock(&mutex);
+  quit = true;
+  pthread_cond_broadcast(&wake);
+  pthread_mutex_unlock(&mutex);
+  for (int i = 0; i < BKMU_SPREAD_WORKERS; ++i) {
+    if (workers[i].running)
+      pthread_join(workers[i].thread, NULL);
+    if (workers[i].ctx != nullptr)
+      fz_drop_context(workers[i].ctx);
+  }
+  #if defined(__vita__) || defined(HEADLESS)
+    if (!rendered.empty())
+      vita2d_wait_rendering_done();
+  #endif
+  for (map<int, BKMUSpreadPage*>::iterator it = rendered.begin(); it != rendered.end(); ++it)
+    release(it->second);
+  rendered.clear();
+  pthread_cond_destroy(&wake);
+  pthread_mutex_destroy(&docLock);
+  pthread_mutex_destroy(&mutex);
+}
+
+bool BKMUSpread::isRunning() {
+  for (int i = 0; i < BKMU_SPREAD_WORKERS; ++i) {
+    if (!workers[i].running)
+      return false;
+  }
+  return true;
+}
+
+void BKMUSpread::release(BKMUSpreadPage* p) {
+  #if defined(__vita__) || defined(HEADLESS)
+    if (p->texture != nullptr)
+      _vita2d_free_counted_texture(p->texture);
+  #endif
+  FZBufferPool::release(p->pixels);
+  delete p;
+}
+
+int BKMUSpread::first(int n) {
+  n = max(0, min(pages - 1, n));
+  if (!cover)
+    return n & ~1;
+  return n == 0 ? 0 : ((n - 1) & ~1) + 1;
+}
+
+int BKMUSpread::count(int f) {
+  if (cover && f == 0)
+    return 1;
+  return f + 1 < pages ? 2 : 1;
+}
+
+// Called with mutex held.
+int BKMUSpread::nextPage() {
+  for (size_t i = 0; i < wanted.size(); ++i) {
+    int n = wanted[i];
+    if (rendered.find(n) == rendered.end() && find(busy.begin(), busy.end(), n) == busy.end())
+      return n;
+  }
+  return -1;
+}
+
+void* BKMUSpread::worker(void* arg) {
+  Worker* w = (Worker*)arg;
+  BKMUSpread* s = w->spread;
+  pthread_mutex_lock(&s->mutex);
+  while (!s->quit) {
+    int n = s->nextPage();
+    if (n < 0) {
+      pthread_cond_wait(&s->wake, &s->mutex);
+      continue;
+    }
+    s->busy.push_back(n);
+    View v = s->view;
+    int generation = s->generation;
+    pthread_mutex_unlock(&s->mutex);
+
+    BKMUSpreadPage* p = new BKMUSpreadPage();
+    s->render(w->ctx, n, v, p);
+
+    pthread_mutex_lock(&s->mutex);
+    s->busy.erase(find(s->busy.begin(), s->busy.end(), n));
+    bool stillWanted = find(s->wanted.begin(), s->wanted.end(), n) != s->wanted.end();
+    if (generation == s->generation && stillWanted && s->rendered.find(n) == s->rendered.end()) {
+      s->rendered[n] = p;
+    } else {
+      FZBufferPool::release(p->pixels);
+      delete p;
+    }
+  }
+  pthread_mutex_unlock(&s->mutex);
+  return nullptr;
+}
+
+// The page and its display list come from the shared document, one
+// worker at a time; the rasterising, the slow part, runs on both.
+void BKMUSpread::render(fz_context* ctx, int n, const View& v, BKMUSpreadPage* p) {
+  fz_page* page = nullptr;
+  fz_display_list* list = nullptr;
+  fz_pixmap* pix = nullptr;
+  fz_device* dev = nullptr;
+  fz_rect bounds = fz_empty_rect;
+  fz_var(page);
+  fz_var(list);
+  fz_var(pix);
+  fz_var(dev);
+  lockDocument();
+  {
+    FZ_PROFILE(FZ_PROFILE_PAGE_LOAD);
+    fz_try(ctx) {
+      page = fz_load_page(ctx, doc, n);
+      bounds = fz_bound_page(ctx, page);
+      list = fz_new_display_list_from_page_contents(ctx, page);
+    } fz_always(ctx) {
+      fz_drop_page(ctx, page);
+    } fz_catch(ctx) {
+      printf("cannot load page %d: %s\n", n + 1, fz_caught_message(ctx));
+    }
+  }
+  unlockDocument();
+
+  if (list != nullptr) {
+    // the margins are found on the display list, away from the document
+    bool cropped = false;
+    if (v.crop) {
+      fz_rect box;
+      cropped = crops->find(n, box);
+      if (!cropped && BKMUDocument::contentBox(ctx, list, box)) {
+        cropped = true;
+        crops->store(n, box);
+      }
+      if (cropped)
+        bounds = box;
+    }
+
+    // fit height, but two pages must fit across; the same transform as
+    // BKMUDocument::pageTransform
+    fz_rect r = fz_transform_rect(bounds, fz_rotate(v.rotate));
+    float scale = min(v.height / (r.y1 - r.y0), v.width / 2 / (r.x1 - r.x0));
+    fz_matrix transform = fz_concat(fz_rotate(v.rotate), fz_scale(scale, scale));
+
+    FZ_PROFILE(FZ_PROFILE_PAGE_RENDER);
+    fz_try(ctx) {
+      if (cropped) {
+        pix = fz_new_pixmap_with_bbox(ctx, fz_device_rgb(ctx), fz_round_rect(fz_transform_rect(bounds, transform)),
+          nullptr, 0);
+        fz_clear_pixmap_with_value(ctx, pix, 0xff);
+        dev = fz_new_draw_device(ctx, fz_identity, pix);
+        fz_run_display_list(ctx, list, dev, transform, fz_infinite_rect, nullptr);
+        fz_close_device(ctx, dev);
+      } else {
+        pix = fz_new_pixmap_from_display_list(ctx, list, transform, fz_device_rgb(ctx), 0);
+      }
+    } fz_always(ctx) {
+      fz_drop_device(ctx, dev);
+      fz_drop_display_list(ctx, list);
+    } fz_catch(ctx) {
+      printf("cannot render page %d: %s\n", n + 1, fz_caught_message(ctx));
+      fz_drop_pixmap(ctx, pix);
+      pix = nullptr;
+    }
+  }
+
+  if (pix != nullptr)
+    p->pixels = (char*)FZBufferPool::alloc((size_t)pix->w * pix->h * 4, false);
+  if (p->pixels == nullptr) {
+    p->failed = true;
+    fz_drop_pixmap(ctx, pix);
+    return;
+  }
+  p->w = pix->w;
+  p->h = pix->h;
+  unsigned char* d = (unsigned char*)p->pixels;
+  for (int y = 0; y < pix->h; ++y) {
+    const unsigned char* s = pix->samples + (size_t)y * pix->stride;
+    for (int x = 0; x < pix->w; ++x, s += pix->n, d += 4) {
+      d[0] = s[0];
+      d[1] = s[1];
+      d[2] = s[2];
+      d[3] = 0xff;
+    }
+  }
+  fz_drop_pixmap(ctx, pix);
+}
+
+void BKMUSpread::updateWanted() {
+  vector<int> w;
+  for (int i = 0; i < count(left); ++i)
+    w.push_back(left + i);
+  int next = left + count(left);
+  if (next < pages) {
+    for (int i = 0; i < count(next); ++i)
+      w.push_back(next + i);
+  }
+  pthread_mutex_lock(&mutex);
+  if (w != wanted) {
+    wanted = w;
+    pthread_cond_broadcast(&wake);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+void BKMUSpread::setView(float rotate, int width, int height, bool crop) {
+  if (view.rotate == rotate && view.width == width && view.height == height && view.crop == crop && generation > 0)
+    return;
+
+  vector<BKMUSpreadPage*> drop;
+  pthread_mutex_lock(&mutex);
+  view.rotate = rotate;
+  view.width = width;
+  view.height = height;
+  view.crop = crop;
+  ++generation;
+  for (map<int, BKMUSpreadPage*>::iterator it = rendered.begin(); it != rendered.end(); ++it)
+    drop.push_back(it->second);
+  rendered.clear();
+  pthread_cond_broadcast(&wake);
+  pthread_mutex_unlock(&mutex);
+
+  #if defined(__vita__) || defined(HEADLESS)
+    if (!drop.empty())
+      vita2d_wait_rendering_done();
+  #endif
+  for (size_t i = 0; i < drop.size(); ++i)
+    release(drop[i]);
+  flipStart = get_time_ms();
+  updateWanted();
+}
+
+void BKMUSpread::setCover(bool alone) {
+  if (cover == alone)
+    return;
+  cover = alone;
+  setPage(left);
+}
+
+void BKMUSpread::setPage(int n) {
+  left = first(n);
+  flipStart = get_time_ms();
+  updateWanted();
+}
+
+bool BKMUSpread::update() {
+  updateWanted();
+
+  bool changed = false;
+  vector<BKMUSpreadPage*> drop;
+  vector<BKMUSpreadPage*> upload;
+  pthread_mutex_lock(&mutex);
+  for (map<int, BKMUSpreadPage*>::iterator it = rendered.begin(); it != rendered.end(); ) {
+    if (find(wanted.begin(), wanted.end(), it->first) == wanted.end()) {
+      drop.push_back(it->second);
+      rendered.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  // the spread on screen all at once, the next one a page a frame
+  int visible = count(left);
+  for (size_t i = 0; i < wanted.size(); ++i) {
+    map<int, BKMUSpreadPage*>::iterator it = rendered.find(wanted[i]);
+    if (it != rendered.end() && it->second->pixels != nullptr) {
+      if ((int)i < visible || upload.size() == 0)
+        upload.push_back(it->second);
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+
+  // only the viewer removes pages, those stay valid without the lock
+  for (size_t i = 0; i < upload.size(); ++i) {
+    BKMUSpreadPage* p = upload[i];
+    #if defined(__vita__) || defined(HEADLESS)
+      FZ_PROFILE(FZ_PROFILE_TEXTURE_UPLOAD);
+      p->texture = _vita2d_create_page_texture(p->pixels, p->w, p->h);
+      if (p->texture == nullptr)
+        p->failed = true;
+    #endif
+    pthread_mutex_lock(&mutex);
+    FZBufferPool::release(p->pixels);
+    p->pixels = nullptr;
+    pthread_mutex_unlock(&mutex);
+    changed = true;
+  }
+
+  if (!drop.empty()) {
+    #if defined(__vita__) || defined(HEADLESS)
+      // the GPU may still be drawing last frame's textures
+      vita2d_wait_rendering_done();
+    #endif
+    for (size_t i = 0; i < drop.size(); ++i)
+      release(drop[i]);
+  }
+  if (changed && flipStart != 0 && isReady()) {
+    lastFlipTime = get_time_ms() - flipStart;
+    flipStart = 0;
+  }
+  return changed;
+}
+
+bool BKMUSpread::isReady() {
+  bool ready = true;
+  pthread_mutex_lock(&mutex);
+  for (int i = 0; i < count(left); ++i) {
+    map<int, BKMUSpreadPage*>::iterator it = rendered.find(left + i);
+    if (it == rendered.end())
+      ready = false;
+    else if (!it->second->failed && it->second->pixels != nullptr)
+      ready = false;
+  }
+  pthread_mutex_unlock(&mutex);
+  return ready;
+}
+
+void BKMUSpread::draw() {
+  int n = count(left);
+  BKMUSpreadPage* p[2] = { nullptr, nullptr };
+  pthread_mutex_lock(&mutex);
+  for (int i = 0; i < n; ++i) {
+    map<int, BKMUSpreadPage*>::iterator it = rendered.find(left + i);
+    if (it != rendered.end() && it->second->w > 0)
+      p[i] = it->second;
+  }
+
+  // a page still rendering takes the size of its neighbour
+  int w[2], h[2];
+  for (int i = 0; i < n; ++i) {
+    BKMUSpreadPage* q = p[i] != nullptr ? p[i] : p[1 - i];
+    w[i] = q != nullptr ? q->w : view.width / 2;
+    h[i] = q != nullptr ? q->h : view.height;
+  }
+  float x = (view.width - (n == 2 ? w[0] + w[1] : w[0])) / 2;
+  for (int i = 0; i < n; ++i) {
+    float y = (view.height - h[i]) / 2;
+    #if defined(__vita__) || defined(HEADLESS)
+      if (p[i] != nullptr && p[i]->texture != nullptr)
+        vita2d_draw_texture(p[i]->texture, x, y);
+      else
+        vita2d_draw_rectangle(x, y, w[i], h[i], RGBA8(0xff, 0xff, 0xff, 0xff));
+    #endif
+    x += w[i];
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+void BKMUSpread::trim() {
+  vector<BKMUSpreadPage*> drop;
+  pthread_mutex_lock(&mutex);
+  // the next update() asks for the pages again
+  wanted.clear();
+  for (map<int, BKMUSpreadPage*>::iterator it = rendered.begin(); it != rendered.end(); ++it)
+    drop.push_back(it->second);
+  rendered.clear();
+  pthread_mutex_unlock(&mutex);
+  #if defined(__vita__) || defined(HEADLESS)
+    if (!drop.empty())
+      vita2d_wait_rendering_done();
+  #endif
+  for (size_t i = 0; i < drop.size(); ++i)
+    release(drop[i]);
+}
@@ -0,0 +1,141 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BKMUSPREAD_H
+#define BKMUSPREAD_H
+
+#include <map>
+#include <vector>
+#include <pthread.h>
+
+#include <mupdf/fitz.h>
+
+#include "../graphics/fzscreen.h"
+#include "bkmucrops.h"
+
+using namespace std;
+
+/*! \brief Two facing pages of a MuPDF document side by side.
+ *
+ *  Pages are fit to the screen height, no wider than half of it, and
+ *  drawn centered as one spread. Two worker threads, each with its own
+ *  clone of the document's fitz context, render the left and the right
+ *  page at the same time: loading a page and recording its display list
+ *  is done under the document lock, rasterising the list is not. Once
+ *  the visible pages are done the workers go on with the next spread.
+ *
+ *  With the cover alone, the first page is a spread of its own and the
+ *  others pair up from the second one, as in a printed book.
+ */
+struct BKMUSpreadPage;
+class BKMUSpread {
+  #define BKMU_SPREAD_WORKERS       2
+  #define BKMU_SPREAD_THREAD_STACK  (256 * 1024)
+
+  struct View {
+    float rotate;
+    int width;
+    int height;
+    bool crop;
+  };
+
+  struct Worker {
+    BKMUSpread* spread;
+    fz_context* ctx;
+    pthread_t thread;
+    bool running;
+  };
+
+  fz_document* doc;
+  int pages;
+  Worker workers[BKMU_SPREAD_WORKERS];
+
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;
+  pthread_mutex_t docLock;
+  bool quit;
+  int generation;
+  View view;
+  // visible pages, then the next spread's, in the order they are needed
+  vector<int> wanted;
+  // pages a worker is on
+  vector<int> busy;
+  map<int, BKMUSpreadPage*> rendered;
+  // the document's, see BKMUCrops
+  BKMUCrops* crops;
+
+  /* viewer side */
+  int left;
+  bool cover;
+  double flipStart;
+  double lastFlipTime;
+
+  static void* worker(void* arg);
+  int nextPage();
+  void render(fz_context* ctx, int n, const View& v, BKMUSpreadPage* p);
+  void updateWanted();
+  void release(BKMUSpreadPage* p);
+
+  public:
+  // ctx must have locks; doc stays owned by the caller, who must hold
+  // lockDocument() while using it; crops stays the caller's too, but
+  // takes its own lock
+  BKMUSpread(fz_context* ctx, fz_document* doc, int pages, BKMUCrops* crops);
+  ~BKMUSpread();
+  // true if both workers started
+  bool isRunning();
+
+  // crop trims the margins of every page
+  void setView(float rotate, int width, int height, bool crop);
+  void setCover(bool alone);
+  // the spread that holds page n
+  void setPage(int n);
+  // left page of the spread on screen
+  int getPage() { return left; }
+  int getCount() { return count(left); }
+
+  // layout, independent of what is rendered
+  int first(int n);
+  int count(int first);
+
+  // once a frame on the main thread: textures for finished pages;
+  // true if what is on screen changed
+  bool update();
+  void draw();
+  // both pages of the spread are on screen
+  bool isReady();
+  // milliseconds from the last setPage() to isReady()
+  double getLastFlipTime() { return lastFlipTime; }
+  // release every page, update() asks for them again
+  void trim();
+
+  void lockDocument() { pthread_mutex_lock(&docLock); }
+  void unlockDocument() { pthread_mutex_unlock(&docLock); }
+};
+
+#endif
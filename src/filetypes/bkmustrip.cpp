@@ -0,0 +1,444 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bkmustrip.h"
+#include "bkmudocument.h"
+#include "../utils.h"
+#include "../graphics/fzbufferpool.h"
+#include "../graphics/fzprofiler.h"
+
+// A rendered page. The worker fills in the size and the pixels, the
+// viewer makes the texture; only the viewer removes pages.
+struct BKMUStripPage {
+  int w, h;
+  // RGBA rows of w * 4 bytes, until they are in the texture
+  char* pixels;
+  bool failed;
+  #if defined(__vita__) || defined(HEADLESS)
+    vita2d_texture* texture;
+  #endif
+  BKMUStripPage() : w(0), h(0), pixels(nullptr), failed(false) {
+    #if defined(__vita__) || defined(HEADLESS)
+      texture = nullptr;
+    #endif
+  }
+};
+
+BKMUStrip::BKMUStrip(fz_context* c, fz_document* d, int n, BKMUCrops* cr) :
+  ctx(nullptr), doc(d), pages(n), running(false), quit(false), first(0), last(-1), anchorWanted(0), generation(0),
+  crops(cr), anchor(0), offset(0), estimate(FZ_SCREEN_HEIGHT), blankFrames(0)
+{
+  view.rotate = 0;
+  view.scale = 1;
+  view.fitWidth = true;
+  view.fitHeight = false;
+  view.width = FZ_SCREEN_WIDTH;
+  view.height = FZ_SCREEN_HEIGHT;
+  view.crop = false;
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_mutex_init(&docLock, NULL);
+  pthread_cond_init(&wake, NULL);
+
+  // NULL unless the document's context has locks
+  ctx = fz_clone_context(c);
+  if (ctx == nullptr)
+    return;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, BKMU_STRIP_THREAD_STACK);
+  running = pthread_create(&thread, &attr, worker, this) == 0;
+  pthread_attr_destroy(&attr);
+}
+
+BKMUStrip::~BKMUStrip() {
+  if (running) {
+    pthread_mutex_lock(&mutex);
+    quit = true;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, NULL);
+    running = false;
+  }
+  #if defined(__vita__) || defined(HEADLESS)
+    if (!rendered.empty())
+      vita2d_wait_rendering_done();
+  #endif
+  for (map<int, BKMUStripPage*>::iterator it = rendered.begin(); it != rendered.end(); ++it)
+    release(it->second);
+  rendered.clear();
+  if (ctx != nullptr)
+    fz_drop_context(ctx);
+  pthread_cond_destroy(&wake);
+  pthread_mutex_destroy(&docLock);
+  pthread_mutex_destroy(&mutex);
+}
+
+void BKMUStrip::release(BKMUStripPage* p) {
+  #if defined(__vita__) || defined(HEADLESS)
+    if (p->texture != nullptr)
+      _vita2d_free_counted_texture(p->texture);
+  #endif
+  FZBufferPool::release(p->pixels);
+  delete p;
+}
+
+// The page the view needs most: the top one, then down the window,
+// then up. Called with mutex held.
+int BKMUStrip::nextPage() {
+  for (int n = max(anchorWanted, first); n <= last; ++n) {
+    if (rendered.find(n) == rendered.end())
+      return n;
+  }
+  for (int n = min(anchorWanted - 1, last); n >= first; --n) {
+    if (rendered.find(n) == rendered.end())
+      return n;
+  }
+  return -1;
+}
+
+void* BKMUStrip::worker(void* arg) {
+  BKMUStrip* s = (BKMUStrip*)arg;
+  pthread_mutex_lock(&s->mutex);
+  while (!s->quit) {
+    int n = s->nextPage();
+    if (n < 0) {
+      pthread_cond_wait(&s->wake, &s->mutex);
+      continue;
+    }
+    View v = s->view;
+    int generation = s->generation;
+    pthread_mutex_unlock(&s->mutex);
+
+    BKMUStripPage* p = new BKMUStripPage();
+    s->render(n, v, p);
+
+    pthread_mutex_lock(&s->mutex);
+    // the view may have moved on while the page was drawn
+    if (generation == s->generation && n >= s->first && n <= s->last && s->rendered.find(n) == s->rendered.end()) {
+      s->rendered[n] = p;
+    } else {
+      FZBufferPool::release(p->pixels);
+      delete p;
+    }
+  }
+  pthread_mutex_unlock(&s->mutex);
+  return nullptr;
+}
+
+// Worker side: the same transform and rasteriser as the page view, then
+// RGBA so the viewer only has to copy it into a texture.
+void BKMUStrip::render(int n, const View& v, BKMUStripPage* p) {
+  fz_page* page = nullptr;
+  fz_pixmap* pix = nullptr;
+  fz_var(page);
+  fz_var(pix);
+  lockDocument();
+  {
+    FZ_PROFILE(FZ_PROFILE_PAGE_RENDER);
+    fz_try(ctx) {
+      page = fz_load_page(ctx, doc, n);
+      const fz_rect* crop = nullptr;
+      fz_rect box;
+      if (v.crop) {
+        if (crops->find(n, box)) {
+          crop = &box;
+        } else if (BKMUDocument::contentBox(ctx, page, box)) {
+          crops->store(n, box);
+          crop = &box;
+        }
+      }
+      float scale = v.scale;
+      fz_rect bounds;
+      fz_matrix transform = BKMUDocument::pageTransform(ctx, page, v.rotate, v.fitWidth, v.fitHeight,
+        v.width, v.height, scale, bounds, crop);
+      pix = BKMUDocument::renderPage(ctx, page, transform, crop);
+    } fz_always(ctx) {
+      fz_drop_page(ctx, page);
+    } fz_catch(ctx) {
+      printf("cannot render page %d: %s\n", n + 1, fz_caught_message(ctx));
+    }
+  }
+  unlockDocument();
+
+  if (pix != nullptr)
+    p->pixels = (char*)FZBufferPool::alloc((size_t)pix->w * pix->h * 4, false);
+  if (p->pixels == nullptr) {
+    p->failed = true;
+    fz_drop_pixmap(ctx, pix);
+    return;
+  }
+  p->w = pix->w;
+  p->h = pix->h;
+  unsigned char* d = (unsigned char*)p->pixels;
+  for (int y = 0; y < pix->h; ++y) {
+    const unsigned char* s = pix->samples + (size_t)y * pix->stride;
+    for (int x = 0; x < pix->w; ++x, s += pix->n, d += 4) {
+      d[0] = s[0];
+      d[1] = s[1];
+      d[2] = s[2];
+      d[3] = 0xff;
+    }
+  }
+  fz_drop_pixmap(ctx, pix);
+}
+
+float BKMUStrip::pageHeight(int n) {
+  float h = estimate;
+  pthread_mutex_lock(&mutex);
+  map<int, BKMUStripPage*>::iterator it = rendered.find(n);
+  if (it != rendered.end() && it->second->h > 0)
+    h = it->second->h;
+  pthread_mutex_unlock(&mutex);
+  return h;
+}
+
+// Keep offset inside the anchor page and the strip on screen.
+void BKMUStrip::clamp() {
+  float h;
+  while (anchor < pages - 1 && offset >= (h = pageHeight(anchor)) + BKMU_STRIP_GAP) {
+    offset -= h + BKMU_STRIP_GAP;
+    ++anchor;
+  }
+  while (offset < 0 && anchor > 0) {
+    --anchor;
+    offset += pageHeight(anchor) + BKMU_STRIP_GAP;
+  }
+
+  // the end of the last page does not scroll above the bottom of the view
+  float bottom = -offset;
+  for (int n = anchor; n < pages && bottom < view.height; ++n)
+    bottom += pageHeight(n) + (n < pages - 1 ? BKMU_STRIP_GAP : 0);
+  if (bottom < view.height) {
+    offset -= view.height - bottom;
+    while (offset < 0 && anchor > 0) {
+      --anchor;
+      offset += pageHeight(anchor) + BKMU_STRIP_GAP;
+    }
+  }
+  if (offset < 0)
+    offset = 0;
+}
+
+// The pages on screen plus a margin on both sides go to the worker.
+void BKMUStrip::updateWindow() {
+  int n = anchor;
+  float y = pageHeight(anchor) - offset;
+  while (n < pages - 1 && y + BKMU_STRIP_GAP < view.height) {
+    ++n;
+    y += BKMU_STRIP_GAP + pageHeight(n);
+  }
+  int f = max(0, anchor - BKMU_STRIP_BEHIND);
+  int l = min(pages - 1, n + BKMU_STRIP_AHEAD);
+
+  pthread_mutex_lock(&mutex);
+  if (f != first || l != last || anchor != anchorWanted) {
+    first = f;
+    last = l;
+    anchorWanted = anchor;
+    pthread_cond_signal(&wake);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+void BKMUStrip::setView(float rotate, float scale, bool fitWidth, bool fitHeight, int width, int height, bool crop) {
+  if (view.rotate == rotate && view.scale == scale && view.fitWidth == fitWidth && view.fitHeight == fitHeight &&
+      view.width == width && view.height == height && view.crop == crop && generation > 0)
+    return;
+
+  vector<BKMUStripPage*> drop;
+  pthread_mutex_lock(&mutex);
+  view.rotate = rotate;
+  view.scale = scale;
+  view.fitWidth = fitWidth;
+  view.fitHeight = fitHeight;
+  view.width = width;
+  view.height = height;
+  view.crop = crop;
+  ++generation;
+  for (map<int, BKMUStripPage*>::iterator it = rendered.begin(); it != rendered.end(); ++it)
+    drop.push_back(it->second);
+  rendered.clear();
+  pthread_cond_signal(&wake);
+  pthread_mutex_unlock(&mutex);
+
+  #if defined(__vita__) || defined(HEADLESS)
+    if (!drop.empty())
+      vita2d_wait_rendering_done();
+  #endif
+  for (size_t i = 0; i < drop.size(); ++i)
+    release(drop[i]);
+  clamp();
+  updateWindow();
+}
+
+void BKMUStrip::setPosition(int page, float o) {
+  anchor = max(0, min(pages - 1, page));
+  offset = o;
+  clamp();
+  updateWindow();
+}
+
+bool BKMUStrip::scroll(float dy) {
+  int a = anchor;
+  float o = offset;
+  offset += dy;
+  clamp();
+  updateWindow();
+  return a != anchor || o != offset;
+}
+
+int BKMUStrip::getVisibleWidth() {
+  int w = 0;
+  float y = -offset;
+  pthread_mutex_lock(&mutex);
+  for (int n = anchor; n < pages && y < view.height; ++n) {
+    map<int, BKMUStripPage*>::iterator it = rendered.find(n);
+    float h = estimate;
+    if (it != rendered.end() && it->second->h > 0) {
+      w = max(w, it->second->w);
+      h = it->second->h;
+    }
+    y += h + BKMU_STRIP_GAP;
+  }
+  pthread_mutex_unlock(&mutex);
+  return w > 0 ? w : view.width;
+}
+
+bool BKMUStrip::update() {
+  bool changed = false;
+  vector<BKMUStripPage*> drop;
+  vector<BKMUStripPage*> upload;
+  pthread_mutex_lock(&mutex);
+  // trim() left the worker without a window
+  bool trimmed = last < first;
+  for (map<int, BKMUStripPage*>::iterator it = rendered.begin(); it != rendered.end(); ) {
+    if (it->first < first || it->first > last) {
+      drop.push_back(it->second);
+      rendered.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  // unrendered pages are guessed from the one at the top
+  map<int, BKMUStripPage*>::iterator top = rendered.find(anchor);
+  if (top != rendered.end() && top->second->h > 0 && top->second->h != estimate) {
+    estimate = top->second->h;
+    changed = true;
+  }
+  // pages on screen first
+  for (int i = 0; i <= last - first && (int)upload.size() < BKMU_STRIP_UPLOADS; ++i) {
+    int n = anchor + i <= last ? anchor + i : anchor - (i - (last - anchor));
+    map<int, BKMUStripPage*>::iterator it = rendered.find(n);
+    if (it != rendered.end() && it->second->pixels != nullptr)
+      upload.push_back(it->second);
+  }
+  pthread_mutex_unlock(&mutex);
+
+  // only the viewer removes pages, those stay valid without the lock
+  for (size_t i = 0; i < upload.size(); ++i) {
+    BKMUStripPage* p = upload[i];
+    #if defined(__vita__) || defined(HEADLESS)
+      FZ_PROFILE(FZ_PROFILE_TEXTURE_UPLOAD);
+      p->texture = _vita2d_create_page_texture(p->pixels, p->w, p->h);
+      if (p->texture == nullptr)
+        p->failed = true;
+    #endif
+    pthread_mutex_lock(&mutex);
+    FZBufferPool::release(p->pixels);
+    p->pixels = nullptr;
+    pthread_mutex_unlock(&mutex);
+    changed = true;
+  }
+
+  if (!drop.empty()) {
+    #if defined(__vita__) || defined(HEADLESS)
+      // the GPU may still be drawing last frame's textures
+      vita2d_wait_rendering_done();
+    #endif
+    for (size_t i = 0; i < drop.size(); ++i)
+      release(drop[i]);
+  }
+  if (changed)
+    clamp();
+  if (changed || trimmed)
+    updateWindow();
+  return changed;
+}
+
+void BKMUStrip::draw(float panX) {
+  bool blank = false;
+  float y = -offset;
+  pthread_mutex_lock(&mutex);
+  for (int n = anchor; n < pages && y < view.height; ++n) {
+    map<int, BKMUStripPage*>::iterator it = rendered.find(n);
+    BKMUStripPage* p = it != rendered.end() ? it->second : nullptr;
+    float h = p != nullptr && p->h > 0 ? p->h : estimate;
+    int w = p != nullptr && p->w > 0 ? p->w : view.width;
+    float x = w < view.width ? (view.width - w) / 2 : panX;
+    #if defined(__vita__) || defined(HEADLESS)
+      if (p != nullptr && p->texture != nullptr)
+        vita2d_draw_texture(p->texture, x, y);
+      else
+        vita2d_draw_rectangle(x, y, w, h, RGBA8(0xff, 0xff, 0xff, 0xff));
+      // a page that failed is not waiting for anything
+      if (p == nullptr || (!p->failed && p->texture == nullptr))
+        blank = true;
+    #else
+      if (p == nullptr)
+        blank = true;
+    #endif
+    y += h + BKMU_STRIP_GAP;
+  }
+  pthread_mutex_unlock(&mutex);
+  if (blank)
+    ++blankFrames;
+}
+
+void BKMUStrip::trim() {
+  vector<BKMUStripPage*> drop;
+  pthread_mutex_lock(&mutex);
+  // an empty window, the next update() posts the one on screen
+  first = 0;
+  last = -1;
+  for (map<int, BKMUStripPage*>::iterator it = rendered.begin(); it != rendered.end(); ++it)
+    drop.push_back(it->second);
+  rendered.clear();
+  pthread_mutex_unlock(&mutex);
+  #if defined(__vita__) || defined(HEADLESS)
+    if (!drop.empty())
+      vita2d_wait_rendering_done();
+  #endif
+  for (size_t i = 0; i < drop.size(); ++i)
+    release(drop[i]);
+}
@@ -0,0 +1,143 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BKMUSTRIP_H
+#define BKMUSTRIP_H
+
+#include <map>
+#include <pthread.h>
+
+#include <mupdf/fitz.h>
+
+#include "../graphics/fzscreen.h"
+#include "bkmucrops.h"
+
+using namespace std;
+
+/*! \brief Continuous vertical scroll over a MuPDF document.
+ *
+ *  Consecutive pages are stacked into one strip, with a small gap. A
+ *  worker thread renders the pages around the viewport through its own
+ *  clone of the document's fitz context, the viewer turns finished pages
+ *  into textures a few at a time and releases the ones that scrolled
+ *  away, so scrolling never waits on a page. A page that is not ready
+ *  yet is drawn as a blank sheet.
+ *
+ *  The position is the page at the top of the view and how far into it
+ *  the view starts. Pages that were not rendered yet are assumed to be
+ *  as tall as the last one that was, which is exact for most books.
+ */
+struct BKMUStripPage;
+class BKMUStrip {
+  // pages kept rendered behind and ahead of the visible ones
+  #define BKMU_STRIP_BEHIND     1
+  #define BKMU_STRIP_AHEAD      2
+  // space between two pages
+  #define BKMU_STRIP_GAP        8
+  // textures made per frame, so a burst of finished pages cannot stall one
+  #define BKMU_STRIP_UPLOADS    1
+  #define BKMU_STRIP_THREAD_STACK (256 * 1024)
+
+  struct View {
+    float rotate;
+    float scale;
+    bool fitWidth;
+    bool fitHeight;
+    int width;
+    int height;
+    bool crop;
+  };
+
+  fz_context* ctx;          // worker's clone
+  fz_document* doc;
+  int pages;
+
+  pthread_t thread;
+  bool running;
+  // guards everything the worker reads or writes
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;
+  // held by whichever thread is inside the document
+  pthread_mutex_t docLock;
+  bool quit;
+  int first;                // window the worker fills
+  int last;
+  int anchorWanted;         // rendered first
+  int generation;           // bumped when the view changes
+  View view;
+  map<int, BKMUStripPage*> rendered;
+  // the document's, see BKMUCrops
+  BKMUCrops* crops;
+
+  /* viewer side */
+  int anchor;
+  float offset;
+  float estimate;
+  int blankFrames;
+
+  static void* worker(void* arg);
+  int nextPage();
+  void render(int n, const View& v, BKMUStripPage* p);
+  float pageHeight(int n);
+  void clamp();
+  void updateWindow();
+  void release(BKMUStripPage* p);
+
+  public:
+  // ctx must have locks, the worker gets a clone; doc stays owned by
+  // the caller, who must hold lockDocument() while using it; crops stays
+  // the caller's too, but takes its own lock
+  BKMUStrip(fz_context* ctx, fz_document* doc, int pages, BKMUCrops* crops);
+  ~BKMUStrip();
+  bool isRunning() { return running; }
+
+  // drops what was rendered if anything changed; crop trims the margins
+  void setView(float rotate, float scale, bool fitWidth, bool fitHeight, int width, int height, bool crop);
+  void setPosition(int page, float offset);
+  int getPage() { return anchor; }
+  float getOffset() { return offset; }
+  // moves the view down by dy pixels, up if negative
+  bool scroll(float dy);
+  // width of the widest page on screen, for horizontal panning
+  int getVisibleWidth();
+
+  // once a frame on the main thread: textures for finished pages, far
+  // pages released; true if what is on screen changed
+  bool update();
+  void draw(float panX);
+  // frames that showed a page that was not rendered yet
+  int getBlankFrames() { return blankFrames; }
+  // release every page; the next update() hands the worker the window
+  // on screen again
+  void trim();
+
+  void lockDocument() { pthread_mutex_lock(&docLock); }
+  void unlockDocument() { pthread_mutex_unlock(&docLock); }
+};
+
+#endif
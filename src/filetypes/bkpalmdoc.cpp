@@ -17,83 +17,250 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <ctype.h>
 #include <stdio.h>
-#include <list>
-using namespace std;
+#include <stdlib.h>
+#include <string.h>
 
 #include "bkpalmdoc.h"
-#include "palmdoc/palmdoc.h"
+#include "../graphics/fzinstreamfile.h"
+#include "../utils.h"
+
+BKPalmDoc::BKPalmDoc() : stream(0), mobi(false), inHead(false), lastBlank(true) { }
 
-BKPalmDoc::BKPalmDoc() : buffer(0) { }
 BKPalmDoc::~BKPalmDoc() {
 	saveLastView();
-	if (buffer)
-		free(buffer);
+	if (stream)
+		stream->release();
+	for (size_t i = 0; i < chunks.size(); ++i)
+		free(chunks[i]);
 }
 
-BKPalmDoc* BKPalmDoc::create(string& file, string& longFileName) {
+BKPalmDoc* BKPalmDoc::create(string& file, FILE* f) {
+	double t = get_time_ms();
+	FZInputStreamFile* in = FZInputStreamFile::create(f);
+	if (in == 0)
+		throw "failed opening document";
+	BKPalmDocStream* s = BKPalmDocStream::create(in);
+	in->release();
+	if (s == 0)
+		throw "unsupported PalmDoc/MOBI book (compressed with HUFF/CDIC or DRM protected)";
+
 	BKPalmDoc* r = new BKPalmDoc();
 	r->fileName = file;
-	r->longFileName = longFileName;
-	int length = 0;
-	int isMobi = 0;
-	char ctitle[dmDBNameLength];
-
-	// convert file to plain text
-	char* b = palmdoc_decode(file.c_str(), &length, &isMobi, ctitle);
-	if (b == NULL) {
-		return 0;
-	}
-
-	r->title = ctitle;
+	r->stream = s;
+	r->mobi = s->isMobi();
+	s->getTitle(r->title);
+	r->resizeView(FZ_SCREEN_WIDTH, FZ_SCREEN_HEIGHT);
+	openTimings.open = get_time_ms() - t;
+
+	// only the first pages, the rest is streamed by updateContent
+	t = get_time_ms();
+	while (r->getTotalPages() <= BKPALMDOC_OPEN_PAGES && r->loadMore())
+		;
+	openTimings.countPages = get_time_ms() - t;
+	#ifdef DEBUG
+		printf("BKPalmDoc: first pages from %d bytes of text\n", (int)r->textBytes);
+	#endif
+	return r;
+}
 
-	if (isMobi) {
-		r->buffer = BKFancyText::parseHTML(r, b, length);
+// Decode, filter and tokenize one more chunk of the book. Returns false
+// once the whole book is in.
+bool BKPalmDoc::loadMore() {
+	if (stream == 0)
+		return false;
+	int p = pending.size();
+	pending.resize(p + BKPALMDOC_READ_CHUNK);
+	int n = stream->getBlock(&pending[p], BKPALMDOC_READ_CHUNK);
+	pending.resize(p + n);
+	bool last = stream->eos();
+
+	if (mobi) {
+		int used = stripHTML(pending.data(), pending.size(), last, text);
+		pending.erase(0, used);
 	} else {
-		r->buffer = BKFancyText::parseText(r, b, length);
+		text.append(pending);
+		pending.clear();
 	}
 
-	r->resetFonts();
-	r->resizeView(480, 272);
-	return r;
+	// the tokenizer only gets whole lines
+	size_t cut = text.size();
+	if (!last) {
+		size_t lf = text.rfind('\n');
+		if (lf != string::npos)
+			cut = lf + 1;
+		else if (text.size() < BKPALMDOC_MAX_LINE)
+			cut = 0;
+	}
+	if (cut > 0) {
+		char* chunk = (char*)malloc(cut);
+		memcpy(chunk, text.data(), cut);
+		text.erase(0, cut);
+		chunks.push_back(chunk);
+		textBytes += cut;
+		appendText(chunk, cut, !mobi);
+	}
+
+	if (last) {
+		stream->release();
+		stream = 0;
+		pending.clear();
+		text.clear();
+	}
+	return stream != 0;
+}
+
+static bool isBlockTag(const string& name) {
+	static const char* blocks[] = { "p", "div", "h1", "h2", "h3", "h4", "h5", "h6", "li", "dt", "dd",
+		"tr", "blockquote", "mbp:pagebreak", 0 };
+	for (int i = 0; blocks[i] != 0; ++i) {
+		if (name == blocks[i])
+			return true;
+	}
+	return false;
+}
+
+static void appendUTF8(string& out, int c) {
+	if (c < 0x80) {
+		out += (char)c;
+	} else if (c < 0x800) {
+		out += (char)(0xc0 | (c >> 6));
+		out += (char)(0x80 | (c & 0x3f));
+	} else if (c < 0x10000) {
+		out += (char)(0xe0 | (c >> 12));
+		out += (char)(0x80 | ((c >> 6) & 0x3f));
+		out += (char)(0x80 | (c & 0x3f));
+	}
+}
+
+// MOBI text is html. Block tags become line breaks, other tags are
+// dropped, blanks are folded and the common entities decoded. Returns
+// how much of in was used: a tag or entity cut by the end of the chunk
+// waits for the next one, unless this is the last chunk.
+int BKPalmDoc::stripHTML(const char* in, int n, bool last, string& out) {
+	int i = 0;
+	while (i < n) {
+		char c = in[i];
+		if (c == '<') {
+			const char* e = (const char*)memchr(in + i, '>', n - i);
+			if (e == 0) {
+				if (!last)
+					return i;
+				break;
+			}
+			int j = i + 1;
+			bool closing = j < n && in[j] == '/';
+			if (closing)
+				++j;
+			string name;
+			while (j < e - in && (isalnum((unsigned char)in[j]) || in[j] == ':')) {
+				name += (char)tolower((unsigned char)in[j]);
+				++j;
+			}
+			i = e - in + 1;
+			if (name == "head") {
+				inHead = !closing;
+				continue;
+			}
+			if (inHead)
+				continue;
+			if (name == "br" || (isBlockTag(name) && !out.empty() && out[out.size() - 1] != '\n')) {
+				out += '\n';
+				lastBlank = true;
+			}
+			if (name == "li" && !closing) {
+				out += "* ";
+				lastBlank = true;
+			}
+			continue;
+		}
+		if (inHead) {
+			++i;
+			continue;
+		}
+		if (c == '&') {
+			const char* e = (const char*)memchr(in + i, ';', n - i < 10 ? n - i : 10);
+			if (e == 0 && !last && n - i < 10)
+				return i;
+			if (e != 0) {
+				string entity(in + i + 1, e - in - i - 1);
+				int v = -1;
+				if (entity == "amp") v = '&';
+				else if (entity == "lt") v = '<';
+				else if (entity == "gt") v = '>';
+				else if (entity == "quot") v = '"';
+				else if (entity == "apos") v = '\'';
+				else if (entity == "nbsp") v = ' ';
+				else if (entity.size() > 1 && entity[0] == '#')
+					v = (entity[1] == 'x' || entity[1] == 'X') ? strtol(entity.c_str() + 2, 0, 16) : atoi(entity.c_str() + 1);
+				if (v > 0) {
+					appendUTF8(out, v);
+					lastBlank = v == ' ';
+					i = e - in + 1;
+					continue;
+				}
+			}
+		}
+		++i;
+		if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+			if (!lastBlank) {
+				out += ' ';
+				lastBlank = true;
+			}
+			continue;
+		}
+		if ((unsigned char)c < 32)
+			continue;
+		out += c;
+		lastBlank = false;
+	}
+	return n;
+}
+
+int BKPalmDoc::updateContent() {
+	int r = BKFancyText::updateContent();
+	if (r != 0 || stream == 0)
+		return r;
+	double t = get_time_ms();
+	while (loadMore() && get_time_ms() - t < BKPALMDOC_STREAM_MS)
+		;
+	// refresh the page count once the book is complete
+	return stream == 0 ? BK_CMD_MARK_DIRTY : 0;
+}
+
+int BKPalmDoc::setCurrentPage(int p) {
+	while (p > getTotalPages() && loadMore())
+		;
+	return BKFancyText::setCurrentPage(p);
+}
+
+int BKPalmDoc::setBookmarkPosition(map<string, float>& m) {
+	int run = (int)m["topLineFirstRun"];
+	while (run >= nRuns && loadMore())
+		;
+	return BKFancyText::setBookmarkPosition(m);
+}
+
+size_t BKPalmDoc::getMemoryUsage() {
+	size_t n = textBytes + nRuns * sizeof(BKRun) + pending.capacity() + text.capacity();
+	if (stream)
+		n += (BKPALMDOC_CACHE_RECORDS + 1) * BKPALMDOC_MAX_RECORD;
+	return n;
 }
 
 void BKPalmDoc::getFileName(string& fn) {
 	fn = fileName;
 }
 
-void BKPalmDoc::getTitle(string& s, int type) {
-  switch(type){
-  case 1:
-    s = title;
-    break;
-  case 2:
-    s = longFileName;
-    break;
-  case 3:
-    s = title; 
-    s += " ["; 
-    s += longFileName;
-    s += "]";
-    break;
-  case 4:
-    s = longFileName;
-    s += " [";
-    s += title;
-    s += "]";
-    break;
-  default:
-    s = title;
-    break;
-  }
-
+void BKPalmDoc::getTitle(string& t) {
+	t = title;
 }
 
 void BKPalmDoc::getType(string& t) {
-	t = "PalmDoc";
+	t = mobi ? "MOBI" : "PalmDoc";
 }
 
-bool BKPalmDoc::isPalmDoc(string& file) {
-	return palmdoc_is_palmdoc(file.c_str()) != 0;
+bool BKPalmDoc::isPalmDoc(const char* header, int headerSize) {
+	return BKPalmDocStream::isPalmDoc(header, headerSize);
 }
-
@@ -20,30 +20,62 @@
 #ifndef BKPALMDOC_H
 #define BKPALMDOC_H
 
+#include <stdio.h>
+#include <string>
+#include <vector>
+
 #include "../graphics/fzscreen.h"
 
 using namespace std;
 
-#include "../bkfancytext.h"
+#include "bkfancytext.h"
+#include "bkpalmdocstream.h"
 
+// The book is decoded as it is read: create() only decodes enough text
+// for the first pages, and updateContent() streams in the rest a few
+// milliseconds per frame.
 class BKPalmDoc : public BKFancyText {
+	#define BKPALMDOC_READ_CHUNK	16384
+	#define BKPALMDOC_OPEN_PAGES	2
+	#define BKPALMDOC_STREAM_MS		4
+	#define BKPALMDOC_MAX_LINE		65536
+
 	private:
 	string fileName;
 	string title;
-	char* buffer;
+	// null once the whole book has been read
+	BKPalmDocStream* stream;
+	bool mobi;
+	// decoded but not yet tokenized: html not stripped yet and
+	// text past the last line break
+	string pending;
+	string text;
+	bool inHead;
+	bool lastBlank;
+	// tokenized text, the runs point into these
+	vector<char*> chunks;
+
+	bool loadMore();
+	int stripHTML(const char* in, int n, bool last, string& out);
 
 	protected:
 	BKPalmDoc();
 	~BKPalmDoc();
 
 	public:
+	virtual int updateContent();
+	virtual int setCurrentPage(int);
+	virtual int setBookmarkPosition(map<string, float>&);
+
+	virtual size_t getMemoryUsage();
+
 	virtual void getFileName(string&);
-	virtual void getTitle(string&,int type = 0);
+	virtual void getTitle(string&);
 	virtual void getType(string&);
 
-	static BKPalmDoc* create(string& file,string& longFileName);
-	static bool isPalmDoc(string& file);
+	// takes ownership of f
+	static BKPalmDoc* create(string& file, FILE* f);
+	static bool isPalmDoc(const char* header, int headerSize);
 };
 
 #endif
-
@@ -0,0 +1,353 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bkpalmdocstream.h"
+
+static inline int be16(const unsigned char* p) {
+  return (p[0] << 8) | p[1];
+}
+
+static inline int be32(const unsigned char* p) {
+  return (int)(((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+}
+
+BKPalmDocStream::BKPalmDocStream(FZInputStream* s) : FZInputStream(),
+  in(s), mobi(false), textLength(0), textRecords(0), recordSize(0), compression(0), extraFlags(0),
+  offsets(0), nOffsets(0), useCounter(0), packed(0), record(0), recordOffset(0), position(0), current(0) {
+  in->retain();
+  for (int i = 0; i < BKPALMDOC_CACHE_RECORDS; ++i) {
+    cache[i].index = -1;
+    cache[i].length = 0;
+    cache[i].lastUse = 0;
+    cache[i].data = 0;
+  }
+}
+
+BKPalmDocStream::~BKPalmDocStream() {
+  for (int i = 0; i < BKPALMDOC_CACHE_RECORDS; ++i) {
+    if (cache[i].data)
+      free(cache[i].data);
+  }
+  if (packed)
+    free(packed);
+  if (offsets)
+    delete[] offsets;
+  in->release();
+}
+
+bool BKPalmDocStream::isPalmDoc(const char* header, int headerSize) {
+  if (headerSize < 68)
+    return false;
+  return memcmp(header + 60, "TEXtREAd", 8) == 0 || memcmp(header + 60, "BOOKMOBI", 8) == 0;
+}
+
+BKPalmDocStream* BKPalmDocStream::create(FZInputStream* in) {
+  BKPalmDocStream* s = new BKPalmDocStream(in);
+  if (!s->readHeader()) {
+    s->release();
+    return 0;
+  }
+  return s;
+}
+
+bool BKPalmDocStream::readHeader() {
+  unsigned char h[BKPALMDOC_HEADER_SIZE];
+  in->seek(0);
+  if (in->getBlock((char*)h, BKPALMDOC_HEADER_SIZE) != BKPALMDOC_HEADER_SIZE)
+    return false;
+  if (!isPalmDoc((const char*)h, BKPALMDOC_HEADER_SIZE))
+    return false;
+  mobi = memcmp(h + 60, "BOOKMOBI", 8) == 0;
+  char name[33];
+  memcpy(name, h, 32);
+  name[32] = 0;
+  title = name;
+
+  int n = be16(h + 76);
+  if (n < 2)
+    return false;
+  nOffsets = n + 1;
+  offsets = new int[nOffsets];
+  unsigned char e[8];
+  for (int i = 0; i < n; ++i) {
+    if (in->getBlock((char*)e, 8) != 8)
+      return false;
+    offsets[i] = be32(e);
+  }
+  offsets[n] = in->getSize();
+  for (int i = 0; i < n; ++i) {
+    if (offsets[i] < 0 || offsets[i] > offsets[i + 1])
+      return false;
+  }
+
+  // record 0: the PalmDoc header, followed by the MOBI header
+  int r0Length = offsets[1] - offsets[0];
+  if (r0Length < 16)
+    return false;
+  if (r0Length > 1024)
+    r0Length = 1024;
+  unsigned char r0[1024];
+  in->seek(offsets[0]);
+  if (in->getBlock((char*)r0, r0Length) != r0Length)
+    return false;
+  compression = be16(r0);
+  textLength = be32(r0 + 4);
+  textRecords = be16(r0 + 8);
+  recordSize = be16(r0 + 10);
+  if (compression != 1 && compression != 2) {
+    #ifdef DEBUG
+      printf("BKPalmDocStream: unsupported compression %d\n", compression);
+    #endif
+    return false;
+  }
+  if (textRecords >= n)
+    textRecords = n - 1;
+  if (textLength < 0 || recordSize <= 0 || recordSize > BKPALMDOC_MAX_RECORD)
+    return false;
+
+  if (mobi && r0Length >= 24 && memcmp(r0 + 16, "MOBI", 4) == 0) {
+    if (be16(r0 + 12) != 0) {
+      #ifdef DEBUG
+        printf("BKPalmDocStream: encrypted book\n");
+      #endif
+      return false;
+    }
+    int mobiLength = be32(r0 + 20);
+    // trailing entries appended to each text record
+    if (mobiLength >= 0xe4 && r0Length >= 16 + 0xe4)
+      extraFlags = be16(r0 + 16 + 0xe2);
+    // the full name is usually past what was read of record 0
+    if (r0Length >= 92) {
+      int nameOffset = be32(r0 + 84);
+      int nameLength = be32(r0 + 88);
+      if (nameLength > 0 && nameLength < 1024 && nameOffset > 0 && offsets[0] + nameOffset + nameLength <= offsets[1]) {
+        char* fullName = (char*)malloc(nameLength);
+        in->seek(offsets[0] + nameOffset);
+        if (in->getBlock(fullName, nameLength) == nameLength)
+          title.assign(fullName, nameLength);
+        free(fullName);
+      }
+    }
+  } else {
+    mobi = false;
+  }
+
+  packed = (char*)malloc(BKPALMDOC_MAX_RECORD);
+  return packed != 0;
+}
+
+// Size of the trailing entries at the end of a MOBI text record. Each
+// flag bit above bit 0 adds one entry whose size is stored backwards
+// as a variable length integer; bit 0 adds the multibyte overlap.
+static int trailingSize(const unsigned char* data, int size, int flags) {
+  int n = 0;
+  for (int f = flags >> 1; f != 0; f >>= 1) {
+    if ((f & 1) == 0)
+      continue;
+    int end = size - n;
+    int v = 0;
+    int shift = 0;
+    while (end > 0) {
+      unsigned char c = data[--end];
+      v |= (c & 0x7f) << shift;
+      shift += 7;
+      if ((c & 0x80) != 0 || shift >= 28)
+        break;
+    }
+    n += v;
+    if (n >= size)
+      return size;
+  }
+  if ((flags & 1) != 0 && size - n > 0)
+    n += (data[size - n - 1] & 3) + 1;
+  return n > size ? size : n;
+}
+
+int BKPalmDocStream::decompress(const unsigned char* in, int n, unsigned char* out, int outSize) {
+  int i = 0;
+  int o = 0;
+  while (i < n) {
+    unsigned int c = in[i++];
+    if (c >= 1 && c <= 8) {
+      // literal run
+      if (i + (int)c > n || o + (int)c > outSize)
+        return -1;
+      memcpy(out + o, in + i, c);
+      i += c;
+      o += c;
+    } else if (c < 0x80) {
+      if (o >= outSize)
+        return -1;
+      out[o++] = c;
+    } else if (c >= 0xc0) {
+      // space plus a character
+      if (o + 2 > outSize)
+        return -1;
+      out[o++] = ' ';
+      out[o++] = c ^ 0x80;
+    } else {
+      // back reference: 11 bits of distance, 3 bits of length - 3
+      if (i >= n)
+        return -1;
+      int m = (c << 8) | in[i++];
+      int distance = (m >> 3) & 0x7ff;
+      int length = (m & 7) + 3;
+      if (distance == 0 || distance > o || o + length > outSize)
+        return -1;
+      // copies may overlap their own output
+      unsigned char* d = out + o;
+      const unsigned char* s = d - distance;
+      for (int k = 0; k < length; ++k)
+        d[k] = s[k];
+      o += length;
+    }
+  }
+  return o;
+}
+
+BKPalmDocStream::Record* BKPalmDocStream::getRecord(int i) {
+  Record* victim = &cache[0];
+  for (int k = 0; k < BKPALMDOC_CACHE_RECORDS; ++k) {
+    if (cache[k].index == i) {
+      cache[k].lastUse = ++useCounter;
+      return &cache[k];
+    }
+    if (cache[k].lastUse < victim->lastUse)
+      victim = &cache[k];
+  }
+
+  // text records are 1..textRecords in the PDB
+  int start = offsets[i + 1];
+  int n = offsets[i + 2] - start;
+  if (n > BKPALMDOC_MAX_RECORD)
+    n = BKPALMDOC_MAX_RECORD;
+  if (!in->seek(start) || in->getBlock(packed, n) != n)
+    return 0;
+  if (extraFlags != 0)
+    n -= trailingSize((const unsigned char*)packed, n, extraFlags);
+
+  if (victim->data == 0) {
+    victim->data = (char*)malloc(BKPALMDOC_MAX_RECORD);
+    if (victim->data == 0)
+      return 0;
+  }
+  int length;
+  if (compression == 1) {
+    memcpy(victim->data, packed, n);
+    length = n;
+  } else {
+    length = decompress((const unsigned char*)packed, n, (unsigned char*)victim->data, BKPALMDOC_MAX_RECORD);
+  }
+  if (length < 0) {
+    #ifdef DEBUG
+      printf("BKPalmDocStream: corrupt record %d\n", i);
+    #endif
+    victim->index = -1;
+    return 0;
+  }
+  victim->index = i;
+  victim->length = length;
+  victim->lastUse = ++useCounter;
+  return victim;
+}
+
+bool BKPalmDocStream::eos() {
+  return record >= textRecords;
+}
+
+char BKPalmDocStream::get() {
+  char c = 0;
+  getBlock(&c, 1);
+  return c;
+}
+
+int BKPalmDocStream::getBlock(char* where, int size) {
+  int done = 0;
+  while (done < size && record < textRecords) {
+    if (current == 0 || current->index != record) {
+      current = getRecord(record);
+      if (current == 0) {
+        // skip what cannot be decoded instead of ending the book there
+        ++record;
+        recordOffset = 0;
+        continue;
+      }
+    }
+    int c = current->length - recordOffset;
+    if (c > size - done)
+      c = size - done;
+    memcpy(where + done, current->data + recordOffset, c);
+    done += c;
+    recordOffset += c;
+    position += c;
+    if (recordOffset >= current->length) {
+      ++record;
+      recordOffset = 0;
+    }
+  }
+  return done;
+}
+
+bool BKPalmDocStream::seek(int p) {
+  if (p < 0 || p > textLength)
+    return false;
+  // records decode to recordSize bytes, except maybe the last one; MOBI
+  // multibyte overlaps can shift this by a few bytes
+  record = p / recordSize;
+  recordOffset = p % recordSize;
+  position = p;
+  if (record >= textRecords) {
+    record = textRecords;
+    recordOffset = 0;
+  }
+  return true;
+}
+
+int BKPalmDocStream::tell() {
+  return position;
+}
+
+int BKPalmDocStream::getSize() {
+  return textLength;
+}
+
+void BKPalmDocStream::getTitle(string& t) {
+  t = title;
+}
+
+bool BKPalmDocStream::isMobi() {
+  return mobi;
+}
+
+int BKPalmDocStream::getTextRecords() {
+  return textRecords;
+}
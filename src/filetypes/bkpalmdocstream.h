@@ -0,0 +1,118 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BKPALMDOCSTREAM_H
+#define BKPALMDOCSTREAM_H
+
+#include <string>
+
+#include "../graphics/fzinputstream.h"
+
+using namespace std;
+
+/**
+ * Decoded text of a PalmDoc (TEXtREAd) or MOBI (BOOKMOBI) book.
+ *
+ * Text records are decompressed on demand as the stream is read, so
+ * opening a book only touches the PDB header and record 0. The last few
+ * decoded records are kept in a small cache, which makes seeking back a
+ * short way cheap. Only uncompressed and PalmDoc LZ77 books are read;
+ * HUFF/CDIC compressed and DRM protected books are refused.
+ */
+class BKPalmDocStream : public FZInputStream {
+  #define BKPALMDOC_HEADER_SIZE     78
+  #define BKPALMDOC_CACHE_RECORDS   4
+  #define BKPALMDOC_MAX_RECORD      8192
+
+  struct Record {
+    int index;
+    int length;
+    unsigned int lastUse;
+    char* data;
+  };
+
+  FZInputStream* in;
+  string title;
+  bool mobi;
+  int textLength;
+  int textRecords;
+  int recordSize;
+  int compression;
+  int extraFlags;
+  // file offsets of all the PDB records, plus the file size at the end
+  int* offsets;
+  int nOffsets;
+
+  Record cache[BKPALMDOC_CACHE_RECORDS];
+  unsigned int useCounter;
+  char* packed;
+
+  // current read position in decoded text
+  int record;
+  int recordOffset;
+  int position;
+  Record* current;
+
+  bool readHeader();
+  Record* getRecord(int i);
+
+  protected:
+  BKPalmDocStream(FZInputStream* in);
+  virtual ~BKPalmDocStream();
+
+  public:
+  virtual bool eos();
+  virtual char get();
+  virtual int getBlock(char* where, int size);
+  virtual bool seek(int position);
+  virtual int tell();
+  // the decoded text length as declared in record 0
+  virtual int getSize();
+
+  void getTitle(string& t);
+  // true for MOBI books, whose text is html
+  bool isMobi();
+  int getTextRecords();
+
+  /**
+   * Decompress one PalmDoc LZ77 record. Returns the decoded length,
+   * or -1 if the input is corrupt or does not fit in out.
+   */
+  static int decompress(const unsigned char* in, int n, unsigned char* out, int outSize);
+
+  /**
+   * Open a book. The stream retains in. Returns 0 if in is not a
+   * readable PalmDoc or MOBI book.
+   */
+  static BKPalmDocStream* create(FZInputStream* in);
+
+  // header is the start of the file; type and creator are bytes 60 to 67
+  static bool isPalmDoc(const char* header, int headerSize);
+};
+
+#endif
@@ -33,28 +33,25 @@ BKPlainText::~BKPlainText() {
 }
 
 BKPlainText* BKPlainText::create(string& file) {
-    #ifdef DEBUG
-      printf("BKPlainText::create\n");
-    #endif
-    BKPlainText* r = new BKPlainText();
-    r->fileName = file;
-
-    // read file to memory
-    #ifdef DEBUG
-      printf("pre fopen\n");
-    #endif
     FILE* f = fopen(file.c_str(), "r");
     if (f == NULL) {
       #ifdef DEBUG
         printf("fopen null\n");
       #endif
-      delete r;
       return NULL;
     }
+    return create(file, f);
+}
+
+BKPlainText* BKPlainText::create(string& file, FILE* f) {
     #ifdef DEBUG
-      printf("post fopen\n");
+      printf("BKPlainText::create\n");
     #endif
+    double t = get_time_ms();
+    BKPlainText* r = new BKPlainText();
+    r->fileName = file;
 
+    // read file to memory
     long length = 0;
     fseek(f, 0, SEEK_END);
     length = ftell(f);
@@ -64,6 +61,7 @@ BKPlainText* BKPlainText::create(string& file) {
     char* b = (char*)malloc(length);
     fread(b, length, 1, f);
     fclose(f);
+    r->textBytes = length;
 
     bool isHTML = false;
     // FIX: make the heuristic a bit more advanced than that...
@@ -90,21 +88,29 @@ BKPlainText* BKPlainText::create(string& file) {
     } else {
       r->buffer = BKFancyText::parseText(r, b, length);
     }
+    openTimings.open = get_time_ms() - t;
 
     #ifdef DEBUG
       printf("post parse\n");
     #endif
     
+    // pagination is the layout pass
+    t = get_time_ms();
     //r->resetFonts();
     #ifdef PSP
       r->resizeView(480, 272);
-    #elif defined(__vita__)
+    #elif defined(__vita__) || defined(HEADLESS)
       r->resizeView(960, 544);
     #endif
+    openTimings.countPages = get_time_ms() - t;
 
     return r;
 }
 
+size_t BKPlainText::getMemoryUsage() {
+    return textBytes + nRuns * sizeof(BKRun);
+}
+
 void BKPlainText::getFileName(string& fn) {
     fn = fileName;
 }
@@ -118,11 +124,8 @@ void BKPlainText::getType(string& t) {
 }
 
 bool BKPlainText::isPlainText(string& file) {
-  // Read First 4 bytes
-	FILE* f = fopen(file.c_str(), "r");
   const char* ext = get_ext(file.c_str());
-	fclose(f);
 
   // Trusting the user for now...
-	return strcmp(ext, ".txt") == 0;
+  return strcmp(ext, ".txt") == 0;
 }
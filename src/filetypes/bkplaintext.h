@@ -36,11 +36,18 @@ class BKPlainText : public BKFancyText {
     ~BKPlainText();
 
   public:
+    // the whole file stays in memory, with the runs that point into it
+    virtual size_t getMemoryUsage();
+    // laid out in full when it opens
+    virtual int getPageCount() { return getTotalPages(); }
+
     virtual void getFileName(string&);
     virtual void getTitle(string&);
     virtual void getType(string&);
 
     static BKPlainText* create(string& file);
+    // takes ownership of f
+    static BKPlainText* create(string& file, FILE* f);
     static bool isPlainText(string& file);
 };
 
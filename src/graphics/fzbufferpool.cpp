@@ -0,0 +1,190 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <map>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef MAC
+static void* memalign(int t, int s) {
+  return malloc(s);
+}
+#else
+#include <malloc.h>
+#endif
+
+#include "fzbufferpool.h"
+#include "fzmemory.h"
+
+using namespace std;
+
+#ifdef __vita__
+  #define FZ_POOL_CACHE_LIMIT ((size_t)16 * 1024 * 1024)
+#else
+  #define FZ_POOL_CACHE_LIMIT ((size_t)64 * 1024 * 1024)
+#endif
+
+// Every block starts with a header holding its class and the size the
+// caller asked for; the header is padded so the data stays aligned.
+struct PoolHeader {
+  size_t blockSize;
+  size_t requested;
+};
+#define POOL_HEADER_SIZE ((sizeof(PoolHeader) + FZ_POOL_ALIGN - 1) & ~(size_t)(FZ_POOL_ALIGN - 1))
+
+typedef map<size_t, vector<PoolHeader*> > FreeLists;
+
+// images are decoded on worker threads too
+static pthread_mutex_t poolMutex = PTHREAD_MUTEX_INITIALIZER;
+static FreeLists freeLists;
+static FZBufferPool::Stats stats;
+static size_t cacheLimit = FZ_POOL_CACHE_LIMIT;
+
+static size_t sizeClass(size_t size) {
+  if (size > FZ_POOL_PAGE)
+    return (size + FZ_POOL_PAGE - 1) & ~(size_t)(FZ_POOL_PAGE - 1);
+  size_t c = FZ_POOL_MIN_CLASS;
+  while (c < size)
+    c <<= 1;
+  return c;
+}
+
+void* FZBufferPool::alloc(size_t size, bool clear) {
+  size_t blockSize = sizeClass(size);
+  PoolHeader* h = NULL;
+
+  pthread_mutex_lock(&poolMutex);
+  FreeLists::iterator it = freeLists.find(blockSize);
+  if (it != freeLists.end() && !it->second.empty()) {
+    h = it->second.back();
+    it->second.pop_back();
+    stats.cachedBytes -= blockSize;
+    stats.reuses++;
+    FZMemory::set(FZ_MEM_POOL, stats.cachedBytes);
+  }
+  pthread_mutex_unlock(&poolMutex);
+
+  if (h == NULL) {
+    h = (PoolHeader*)memalign(FZ_POOL_ALIGN, POOL_HEADER_SIZE + blockSize);
+    if (h == NULL) {
+      FZMemory::allocationFailed();
+      return NULL;
+    }
+    h->blockSize = blockSize;
+    pthread_mutex_lock(&poolMutex);
+    stats.heapAllocations++;
+    pthread_mutex_unlock(&poolMutex);
+  }
+  h->requested = size;
+
+  pthread_mutex_lock(&poolMutex);
+  stats.liveBytes += size;
+  stats.slackBytes += blockSize - size;
+  if (stats.liveBytes > stats.peakLiveBytes)
+    stats.peakLiveBytes = stats.liveBytes;
+  pthread_mutex_unlock(&poolMutex);
+  FZMemory::add(FZ_MEM_PIXMAP, size);
+
+  void* p = (char*)h + POOL_HEADER_SIZE;
+  if (clear)
+    memset(p, 0, size);
+  return p;
+}
+
+void FZBufferPool::release(void* p) {
+  if (p == NULL)
+    return;
+  PoolHeader* h = (PoolHeader*)((char*)p - POOL_HEADER_SIZE);
+  bool keep = false;
+
+  pthread_mutex_lock(&poolMutex);
+  stats.liveBytes -= h->requested;
+  stats.slackBytes -= h->blockSize - h->requested;
+  if (stats.cachedBytes + h->blockSize <= cacheLimit) {
+    freeLists[h->blockSize].push_back(h);
+    stats.cachedBytes += h->blockSize;
+    keep = true;
+    FZMemory::set(FZ_MEM_POOL, stats.cachedBytes);
+  }
+  size_t requested = h->requested;
+  pthread_mutex_unlock(&poolMutex);
+  FZMemory::sub(FZ_MEM_PIXMAP, requested);
+
+  if (!keep)
+    free(h);
+}
+
+void FZBufferPool::setCacheLimit(size_t bytes) {
+  pthread_mutex_lock(&poolMutex);
+  cacheLimit = bytes;
+  bool over = stats.cachedBytes > bytes;
+  pthread_mutex_unlock(&poolMutex);
+  if (over)
+    trim();
+}
+
+void FZBufferPool::trim() {
+  FreeLists idle;
+  pthread_mutex_lock(&poolMutex);
+  idle.swap(freeLists);
+  stats.cachedBytes = 0;
+  FZMemory::set(FZ_MEM_POOL, 0);
+  pthread_mutex_unlock(&poolMutex);
+
+  FreeLists::iterator it(idle.begin());
+  for (; it != idle.end(); ++it)
+    for (unsigned int i = 0; i < it->second.size(); i++)
+      free(it->second[i]);
+}
+
+void FZBufferPool::memoryPressure(int) {
+  trim();
+}
+
+void FZBufferPool::getStats(Stats& s) {
+  pthread_mutex_lock(&poolMutex);
+  s = stats;
+  s.classes = 0;
+  FreeLists::iterator it(freeLists.begin());
+  for (; it != freeLists.end(); ++it)
+    if (!it->second.empty())
+      s.classes++;
+  pthread_mutex_unlock(&poolMutex);
+}
+
+void FZBufferPool::report(FILE* out) {
+  Stats s;
+  getStats(s);
+  fprintf(out, "buffer pool: %u heap allocations, %u reuses\n", s.heapAllocations, s.reuses);
+  fprintf(out, "buffer pool: live %u KB (peak %u KB), slack %u KB, idle %u KB in %u classes\n",
+    (unsigned int)(s.liveBytes / 1024), (unsigned int)(s.peakLiveBytes / 1024),
+    (unsigned int)(s.slackBytes / 1024), (unsigned int)(s.cachedBytes / 1024), s.classes);
+}
@@ -0,0 +1,76 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FZBUFFERPOOL_H
+#define FZBUFFERPOOL_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*! \brief Recycling allocator for pixel buffers.
+ *
+ *  Image data is allocated in size classes: powers of two up to 4KB,
+ *  then whole 4KB pages. Released buffers are kept on a free list per
+ *  class, so pages, glyphs and icons of the same size reuse the same
+ *  blocks instead of going back to the newlib heap. Buffers are 16 byte
+ *  aligned and only cleared when asked to. Live buffers are counted
+ *  as FZ_MEM_PIXMAP and idle ones as FZ_MEM_POOL.
+ */
+class FZBufferPool {
+  #define FZ_POOL_ALIGN 16
+  #define FZ_POOL_PAGE 4096
+  #define FZ_POOL_MIN_CLASS 64
+
+  public:
+  struct Stats {
+    unsigned int heapAllocations; // blocks that came from the heap
+    unsigned int reuses;          // blocks served from a free list
+    size_t liveBytes;             // requested bytes currently in use
+    size_t peakLiveBytes;
+    size_t slackBytes;            // rounding waste in live blocks
+    size_t cachedBytes;           // idle blocks on the free lists
+    unsigned int classes;         // size classes with idle blocks
+  };
+
+  // a buffer of at least size bytes; zeroed only if clear is set
+  static void* alloc(size_t size, bool clear);
+  // give a buffer back; null is ignored
+  static void release(void* p);
+
+  // idle bytes kept around before released blocks go to the heap
+  static void setCacheLimit(size_t bytes);
+  // free all idle blocks, e.g. under memory pressure
+  static void trim();
+  // FZMemory pressure handler
+  static void memoryPressure(int level);
+
+  static void getStats(Stats& stats);
+  static void report(FILE* out = stdout);
+};
+
+#endif
@@ -20,7 +20,7 @@
 #ifndef FZFONT_H
 #define FZFONT_H
 
-#ifdef __vita__
+#if defined(__vita__) || defined(HEADLESS)
   #include <vita2d.h>
 #endif
 #include <ft2build.h>
@@ -58,7 +58,7 @@ protected:
 
 
 public:
-  #ifdef __vita__
+  #if defined(__vita__) || defined(HEADLESS)
     vita2d_font* v_font;
   #endif
 
@@ -27,6 +27,7 @@
 */
 
 #include "fzfont.h"
+#include "fzmemory.h"
 // TODO: Figure out how to remove this.
 #if defined(__vita__) && defined(DEBUG)
   #include <psp2/kernel/clib.h>
@@ -37,19 +38,27 @@ FZFont::FZFont() : metrics(0),isUTF(false),ftlib(0),ftface(0) {
   printf("FZFont()\n");
 }
 
-#ifdef __vita__
+#if defined(__vita__) || defined(HEADLESS)
+// vita2d renders the glyphs of each font into its own 512x512 8 bit
+// atlas; the atlas does not grow, so it is counted once per font
+#define FZ_FONT_ATLAS_BYTES (512 * 512)
+
 FZFont::~FZFont() {
   #ifdef DEBUG
     printf("~FZFont()\n");
   #endif
 
-  if (v_font != NULL)
+  if (v_font != NULL) {
+    FZMemory::sub(FZ_MEM_GLYPH, FZ_FONT_ATLAS_BYTES);
     vita2d_free_font(v_font);
+  }
 }
 
 FZFont* FZFont::createFromFile(char* fileName, int fontSize) {
   FZFont* font = new FZFont();
   font->v_font = vita2d_load_font_file(fileName);
+  if (font->v_font != NULL)
+    FZMemory::add(FZ_MEM_GLYPH, FZ_FONT_ATLAS_BYTES);
   return font;
 }
 
@@ -59,6 +68,8 @@ FZFont* FZFont::createFromMemory(unsigned char* buffer, int bufferSize) {
   #endif
   FZFont* font = new FZFont();
   font->v_font = vita2d_load_font_mem(buffer, bufferSize);
+  if (font->v_font != NULL)
+    FZMemory::add(FZ_MEM_GLYPH, FZ_FONT_ATLAS_BYTES);
   font->fontSize = 28;
   return font;
 }
@@ -24,18 +24,11 @@
 #endif
 
 #include "fzimage.h"
+#include "fzbufferpool.h"
 
 //#include <assert.h>
 
-#ifdef MAC
-static void* memalign(int t, int s) {
-	return malloc(s);
-}
-#else
-#include <malloc.h>
-#endif
-
-FZImage::FZImage(unsigned int w, unsigned int h, FZImage::Format f) : data(0), clut(0), clutSize(0) {
+FZImage::FZImage(unsigned int w, unsigned int h, FZImage::Format f) : data(0), clut(0), clutSize(0), pooledData(true) {
 	/*assert(w > 0);
 	assert(h > 0);
 	assert(f == mono8 || f == mono16 || f == dual16 || f == rgb24 || f == rgb32 ||
@@ -47,11 +40,14 @@ FZImage::FZImage(unsigned int w, unsigned int h, FZImage::Format f) : data(0), c
 
 FZImage::~FZImage() {
 	if (clut != NULL) {
-		free(clut);
+		FZBufferPool::release(clut);
 		clut = NULL;
 	}
 	if (data != NULL) {
-		free(data);
+		if (pooledData)
+			FZBufferPool::release(data);
+		else
+			free(data);
 		data = NULL;
 	}
 }
@@ -97,45 +93,192 @@ unsigned int FZImage::getCLUTSize() {
 	return clutSize;
 }
 
-FZImage* FZImage::createEmpty(unsigned int w, unsigned int h, unsigned int cs, Format f) {
+FZImage* FZImage::createEmpty(unsigned int w, unsigned int h, unsigned int cs, Format f, bool clear) {
 	FZImage* image = new FZImage(w, h, f);
-	/*image->data = (char*)memalign(16, h * w  * image->getBytesPerPixel());
-	memset(image->data, 0, h * w  * image->getBytesPerPixel());
+	image->data = (char*)FZBufferPool::alloc(h * w * image->getBytesPerPixel(), clear);
+	if (image->data == NULL) {
+		image->release();
+		return 0;
+	}
 	if (cs > 0) {
+		image->clut = (unsigned int*)FZBufferPool::alloc(cs * 4, clear);
+		if (image->clut == NULL) {
+			image->release();
+			return 0;
+		}
 		image->clutSize = cs;
-		image->clut = (unsigned int*)memalign(16, cs * 4);
-		memset(image->clut, 0, cs * 4);
-	}*/
+	}
 	return image;
 }
 
 FZImage* FZImage::createWithData(unsigned int w, unsigned int h, char* data) {
 	FZImage* image = new FZImage(w, h, rgba32);
 	image->data = data;
+	image->pooledData = false;
 	return image;
 }
 
-void FZImage::swizzle(int sx, int sy) {
-	//FZImage* from = createEmpty(width, height, 0, imageFormat);
-	//char* fromData = from->getData();
-	//int bpp = getBytesPerPixel();
-	//char* fromData = (char*)memalign(16, width * height  * bpp);
-	//char* toData = getData();
-	//memcpy(fromData, toData, width * height * bpp);
-	//int p = width * bpp;
-
-	//for (unsigned int j = 0; j < height; j += sy) {
-	//	for (int i = 0; i < p; i += sx) {
-	//		char* base = &fromData[i + j*p];
-	//		for (int k = 0; k < sy; k++) {
-	//			memcpy(toData, base, sx);
-	//			toData += sx;
-	//			base += p;
-	//		}
-	//	}
-	//}
-	////from->release();
-	//free(fromData);
+// Copies one row of blocks between the linear and the tiled layout.
+// The 16 byte case is the only one the GE uses; the fixed size copy
+// lets the compiler emit vector moves.
+static void swizzleBlockRow(char* linear, char* tiled, unsigned int pitch, int sx, int sy, bool toTiled) {
+	for (unsigned int i = 0; i < pitch; i += sx) {
+		char* base = linear + i;
+		for (int k = 0; k < sy; k++) {
+			if (sx == 16) {
+				if (toTiled)
+					memcpy(tiled, base, 16);
+				else
+					memcpy(base, tiled, 16);
+			} else {
+				if (toTiled)
+					memcpy(tiled, base, sx);
+				else
+					memcpy(base, tiled, sx);
+			}
+			tiled += sx;
+			base += pitch;
+		}
+	}
+}
+
+static bool swizzleData(char* data, unsigned int pitch, unsigned int height, int sx, int sy, bool toTiled) {
+	if (data == NULL || sx <= 0 || sy <= 0 || pitch % sx != 0 || height % sy != 0)
+		return false;
+	unsigned int size = pitch * height;
+	// every byte is written back below
+	char* copy = (char*)FZBufferPool::alloc(size, false);
+	if (copy == NULL)
+		return false;
+	memcpy(copy, data, size);
+	for (unsigned int j = 0; j < height; j += sy) {
+		unsigned int offset = j * pitch;
+		if (toTiled)
+			swizzleBlockRow(copy + offset, data + offset, pitch, sx, sy, true);
+		else
+			swizzleBlockRow(data + offset, copy + offset, pitch, sx, sy, false);
+	}
+	FZBufferPool::release(copy);
+	return true;
+}
+
+bool FZImage::swizzle(int sx, int sy) {
+	return swizzleData(data, width * getBytesPerPixel(), height, sx, sy, true);
+}
+
+bool FZImage::unswizzle(int sx, int sy) {
+	return swizzleData(data, width * getBytesPerPixel(), height, sx, sy, false);
+}
+
+static unsigned int roundUpPow2(unsigned int v) {
+	unsigned int p = 1;
+	while (p < v)
+		p <<= 1;
+	return p;
+}
+
+// Moves the low 16 bits of v to the even bits.
+static unsigned int spreadBits(unsigned int v) {
+	v &= 0xffff;
+	v = (v | (v << 8)) & 0x00ff00ff;
+	v = (v | (v << 4)) & 0x0f0f0f0f;
+	v = (v | (v << 2)) & 0x33333333;
+	v = (v | (v << 1)) & 0x55555555;
+	return v;
+}
+
+// The tiled index of x, y is the x part or'd with the y part.
+struct FZTiledLayout {
+	unsigned int mask, k;
+	bool wide, tall;
+
+	FZTiledLayout(unsigned int w, unsigned int h) {
+		unsigned int tw, th;
+		FZImage::getTiledDimensions(w, h, tw, th);
+		unsigned int side = tw < th ? tw : th;
+		mask = side - 1;
+		k = 0;
+		while ((1u << k) < side)
+			k++;
+		wide = tw > th;
+		tall = th > tw;
+	}
+	unsigned int x(unsigned int x) const {
+		return spreadBits(x & mask) | (wide ? (x >> k) << (2 * k) : 0);
+	}
+	unsigned int y(unsigned int y) const {
+		return (spreadBits(y & mask) << 1) | (tall ? (y >> k) << (2 * k) : 0);
+	}
+};
+
+void FZImage::getTiledDimensions(unsigned int w, unsigned int h, unsigned int& tw, unsigned int& th) {
+	tw = roundUpPow2(w);
+	th = roundUpPow2(h);
+}
+
+size_t FZImage::getTiledSize(unsigned int w, unsigned int h, unsigned int bpp) {
+	unsigned int tw, th;
+	getTiledDimensions(w, h, tw, th);
+	return (size_t)tw * th * bpp;
+}
+
+unsigned int FZImage::getTiledIndex(unsigned int x, unsigned int y, unsigned int w, unsigned int h) {
+	FZTiledLayout layout(w, h);
+	return layout.x(x) | layout.y(y);
+}
+
+// x and x + 1 are neighbours in both layouts when x is even, so pixels
+// move in pairs. BPP is a constant so each pair is one fixed size copy.
+template <unsigned int BPP>
+static void tileRows(char* linear, unsigned int pitch, char* tiled, unsigned int w, unsigned int h,
+		const FZTiledLayout& layout, const unsigned int* xs, bool toTiled) {
+	unsigned int pairs = w / 2;
+	for (unsigned int y = 0; y < h; ++y) {
+		char* row = linear + (size_t)y * pitch;
+		char* base = tiled + (size_t)layout.y(y) * BPP;
+		if (toTiled) {
+			for (unsigned int i = 0; i < pairs; ++i)
+				memcpy(base + (size_t)xs[i] * BPP, row + i * 2 * BPP, 2 * BPP);
+			if (w & 1)
+				memcpy(base + (size_t)xs[pairs] * BPP, row + pairs * 2 * BPP, BPP);
+		} else {
+			for (unsigned int i = 0; i < pairs; ++i)
+				memcpy(row + i * 2 * BPP, base + (size_t)xs[i] * BPP, 2 * BPP);
+			if (w & 1)
+				memcpy(row + pairs * 2 * BPP, base + (size_t)xs[pairs] * BPP, BPP);
+		}
+	}
+}
+
+static bool tileData(char* linear, unsigned int pitch, char* tiled, unsigned int w, unsigned int h, unsigned int bpp, bool toTiled) {
+	if (linear == NULL || tiled == NULL || w == 0 || h == 0)
+		return false;
+	FZTiledLayout layout(w, h);
+	// x parts of the even columns, shared by every row
+	unsigned int n = (w + 1) / 2;
+	unsigned int* xs = (unsigned int*)FZBufferPool::alloc(n * sizeof(unsigned int), false);
+	if (xs == NULL)
+		return false;
+	for (unsigned int i = 0; i < n; ++i)
+		xs[i] = layout.x(i * 2);
+	bool done = true;
+	switch (bpp) {
+		case 1: tileRows<1>(linear, pitch, tiled, w, h, layout, xs, toTiled); break;
+		case 2: tileRows<2>(linear, pitch, tiled, w, h, layout, xs, toTiled); break;
+		case 3: tileRows<3>(linear, pitch, tiled, w, h, layout, xs, toTiled); break;
+		case 4: tileRows<4>(linear, pitch, tiled, w, h, layout, xs, toTiled); break;
+		default: done = false; break;
+	}
+	FZBufferPool::release(xs);
+	return done;
+}
+
+bool FZImage::tile(const char* linear, unsigned int pitch, char* tiled, unsigned int w, unsigned int h, unsigned int bpp) {
+	return tileData((char*)linear, pitch, tiled, w, h, bpp, true);
+}
+
+bool FZImage::untile(const char* tiled, char* linear, unsigned int pitch, unsigned int w, unsigned int h, unsigned int bpp) {
+	return tileData(linear, pitch, (char*)tiled, w, h, bpp, false);
 }
 
 FZImage* FZImage::createRGB24FromRGB32(FZImage* from) {
@@ -144,26 +287,19 @@ FZImage* FZImage::createRGB24FromRGB32(FZImage* from) {
 
 	unsigned int w, h;
 	from->getDimensions(w, h);
-	FZImage* to = createEmpty(w, h, 0, FZImage::rgb24);
-        unsigned char* fromData = (unsigned char*)from->getData();
-	unsigned char* toData = (unsigned char*)to->getData();
-	unsigned char* fromP;
-	unsigned char* fromQ = fromData;
-	unsigned char* toP;
-	unsigned char* toQ = toData;
-	for (unsigned int j = 0; j < h; ++j) {
-		fromP = fromQ;
-		toP = toQ;
-		for (unsigned int i = 0; i < w*3; ++i) {
-			if (i & 3 == 2) {
-				++fromP;
-			}
-			*toP = *fromP;
-			++toP;
-			++fromP;
-		}
-		fromQ += w  * from->getBytesPerPixel();
-		toQ += w  * to->getBytesPerPixel();
+	// every pixel is written below
+	FZImage* to = createEmpty(w, h, 0, FZImage::rgb24, false);
+	if (to == 0)
+		return 0;
+	unsigned char* fromP = (unsigned char*)from->getData();
+	unsigned char* toP = (unsigned char*)to->getData();
+	unsigned int n = w * h;
+	for (unsigned int i = 0; i < n; ++i) {
+		toP[0] = fromP[0];
+		toP[1] = fromP[1];
+		toP[2] = fromP[2];
+		toP += 3;
+		fromP += 4;
 	}
 	return to;
 }
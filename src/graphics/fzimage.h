@@ -38,6 +38,8 @@ class FZImage : public FZRefCounted {
 	char* data;
 	unsigned int* clut;
 	unsigned int clutSize;
+	// data and clut come from FZBufferPool, except for adopted data
+	bool pooledData;
 
 	unsigned int width, height;
 	Format imageFormat;
@@ -72,12 +74,47 @@ class FZImage : public FZRefCounted {
 	 */
 	unsigned int getCLUTSize();
 
-	void swizzle(int sx, int sy);
+	/**
+	 * Reorder the pixel data into blocks of sx bytes by sy rows, the
+	 * tiled layout the PSP GE samples fastest (16x8 bytes). Works for any
+	 * pixel size; the row pitch in bytes must be a multiple of sx and the
+	 * height a multiple of sy, otherwise the image is left untouched and
+	 * false is returned.
+	 */
+	bool swizzle(int sx, int sy);
+	/**
+	 * Undo swizzle() with the same block size.
+	 */
+	bool unswizzle(int sx, int sy);
+
+	/**
+	 * Size of the Vita GXM swizzled layout: both sides rounded up to a
+	 * power of two. Pixels are in Morton order, x in the even bits and y
+	 * in the odd bits of the index, over the smaller side; the rest of
+	 * the larger side's bits go on top.
+	 */
+	static void getTiledDimensions(unsigned int w, unsigned int h, unsigned int& tw, unsigned int& th);
+	static size_t getTiledSize(unsigned int w, unsigned int h, unsigned int bpp);
+	/**
+	 * Index of pixel x, y of a w by h image in the tiled layout.
+	 */
+	static unsigned int getTiledIndex(unsigned int x, unsigned int y, unsigned int w, unsigned int h);
+	/**
+	 * Copy w by h pixels of 1 to 4 bytes between linear rows pitch bytes
+	 * apart and the tiled layout, which must hold getTiledSize() bytes.
+	 * Padding pixels are not written. False for other pixel sizes or when
+	 * the column table cannot be allocated.
+	 */
+	static bool tile(const char* linear, unsigned int pitch, char* tiled, unsigned int w, unsigned int h, unsigned int bpp);
+	static bool untile(const char* tiled, char* linear, unsigned int pitch, unsigned int w, unsigned int h, unsigned int bpp);
 
 	/**
 	 * Create an image from a PNG file.
+	 * Rows are decoded straight into the image. Palette images keep their
+	 * CLUT as mono8 unless paletteToRGBA is set. Safe to call from any
+	 * thread.
 	 */
-	static FZImage* createFromPNG(FZInputStream* in);
+	static FZImage* createFromPNG(FZInputStream* in, bool paletteToRGBA = false);
 	/**
 	 * Create an image from a JPEG file.
 	 */
@@ -85,10 +122,14 @@ class FZImage : public FZRefCounted {
 	/**
 	 * Create an empty image.
 	 * An image is created with the specified parameters, and its data is
-	 * initialized to 0
+	 * initialized to 0. Pass clear = false when every pixel will be
+	 * written anyway.
 	 */
-	static FZImage* createEmpty(unsigned int w, unsigned int h, unsigned int cl, Format f);
+	static FZImage* createEmpty(unsigned int w, unsigned int h, unsigned int cl, Format f, bool clear = true);
 
+	/**
+	 * Create a rgba32 image that takes ownership of malloc'd data.
+	 */
 	static FZImage* createWithData(unsigned int w, unsigned int h, char* data);
 
 	/**
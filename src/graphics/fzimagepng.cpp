@@ -19,36 +19,47 @@
 
 #include <cstdio>
 #include <cstdlib>
-
-#ifdef MAC
-	#include <SOIL.h>
-#else
-	#include <png.h>
-#endif
-
-#ifdef MAC
-static void* memalign(int t, int s) {
-	return malloc(s);
-}
-#else
-#include <malloc.h>
-#endif
+#include <cstring>
+#include <png.h>
 
 #include "fzimage.h"
+#include "fzbufferpool.h"
+#include "fzmemory.h"
+
+// The stream travels in the libpng io pointer, so several images can be
+// decoded at once on different threads.
+static void fz_png_read(png_structp png, png_bytep data, png_size_t size) {
+	FZInputStream* in = (FZInputStream*)png_get_io_ptr(png);
+	if (in->getBlock((char*)data, (int)size) != (int)size)
+		png_error(png, "unexpected end of stream");
+}
 
-static FZInputStream* inStream = 0;
-//static void fz_png_read(png_structp t, png_bytep data, png_uint_32 size) {
-#ifdef MAC
-static void fz_png_read(png_structp t, png_bytep data, png_size_t size) {
-	inStream->getBlock((char*)data, size);
-#else
-static void fz_png_read(png_structp t, png_bytep data, unsigned int size) {
-	inStream->getBlock((char*)data, size);
+// libpng's own allocations, its row buffers and the zlib state, are
+// counted as decoder memory; the size is kept in front of each block
+// since the free callback does not get it
+union PNGBlock {
+	size_t size;
+	double align;
+};
+
+static png_voidp fz_png_malloc(png_structp, png_alloc_size_t size) {
+	PNGBlock* b = (PNGBlock*)malloc(sizeof(PNGBlock) + size);
+	if (b == NULL)
+		return NULL;
+	b->size = size;
+	FZMemory::add(FZ_MEM_DECODE, size);
+	return b + 1;
+}
 
-#endif
+static void fz_png_free(png_structp, png_voidp p) {
+	if (p == NULL)
+		return;
+	PNGBlock* b = (PNGBlock*)p - 1;
+	FZMemory::sub(FZ_MEM_DECODE, b->size);
+	free(b);
 }
 
-FZImage* FZImage::createFromPNG(FZInputStream* in) {
+FZImage* FZImage::createFromPNG(FZInputStream* in, bool paletteToRGBA) {
 	png_byte header[8];
 	// try to read the first 8 bytes
 	if (in->getBlock((char*)header, 8) != 8)
@@ -58,8 +69,8 @@ FZImage* FZImage::createFromPNG(FZInputStream* in) {
 		return 0;
 
 	// create a new png reader struct
-	png_structp readStruct = png_create_read_struct(PNG_LIBPNG_VER_STRING,
-		NULL, NULL, NULL);
+	png_structp readStruct = png_create_read_struct_2(PNG_LIBPNG_VER_STRING,
+		NULL, NULL, NULL, NULL, fz_png_malloc, fz_png_free);
 	if (readStruct == NULL)
 		return 0;
 
@@ -71,54 +82,58 @@ FZImage* FZImage::createFromPNG(FZInputStream* in) {
 		return 0;
 	}
 
-	// read file
-	//png_init_io(readStruct, fp);
-	inStream = in;
-	png_set_read_fn(readStruct, NULL, fz_png_read);
+	// volatile: it is changed between setjmp and a possible longjmp
+	FZImage* volatile image = 0;
+	if (setjmp(png_jmpbuf(readStruct))) {
+		// libpng error: corrupt data or short stream
+		if (image != 0)
+			image->release();
+		png_destroy_read_struct(&readStruct, &infoStruct, (png_infopp)NULL);
+		return 0;
+	}
+
+	png_set_read_fn(readStruct, in, fz_png_read);
 	png_set_sig_bytes(readStruct, 8);
+	png_read_info(readStruct, infoStruct);
+
+	// Transforms are applied by libpng while each row is decoded, so the
+	// rows land in their final format straight in the image buffer.
+	unsigned int bitDepth  = png_get_bit_depth(readStruct, infoStruct);
+	unsigned int colorType = png_get_color_type(readStruct, infoStruct);
+	bool hasCLUT = colorType == PNG_COLOR_TYPE_PALETTE && !paletteToRGBA;
+
+	if (bitDepth == 16)
+		png_set_strip_16(readStruct);
+	if (bitDepth < 8) {
+		if (colorType == PNG_COLOR_TYPE_GRAY)
+			png_set_expand_gray_1_2_4_to_8(readStruct);
+		else
+			png_set_packing(readStruct);
+	}
+	if (colorType == PNG_COLOR_TYPE_PALETTE && paletteToRGBA) {
+		png_set_palette_to_rgb(readStruct);
+		if (png_get_valid(readStruct, infoStruct, PNG_INFO_tRNS))
+			png_set_tRNS_to_alpha(readStruct);
+		else
+			png_set_filler(readStruct, 0xff, PNG_FILLER_AFTER);
+	}
+	// TODO: support single transparency for grayscale - is it useful?
+	int passes = png_set_interlace_handling(readStruct);
+	png_read_update_info(readStruct, infoStruct);
 
-	png_read_png(readStruct, infoStruct,
-		PNG_TRANSFORM_STRIP_16 | PNG_TRANSFORM_PACKING |
-		PNG_TRANSFORM_SWAP_ENDIAN, NULL);
-
-	// transform it!
-	/* only for low-level reads!!!!!!
-		unsigned int bitDepth, colorType;
-		colorType = png_get_color_type(readStruct, infoStruct);
-		bitDepth  = png_get_bit_depth(readStruct, infoStruct);
-		if (colorType == PNG_COLOR_TYPE_PALETTE)
-			png_set_palette_to_rgb(readStruct);
-		if (colorType == PNG_COLOR_TYPE_GRAY && bitDepth < 8)
-			png_set_gray_1_2_4_to_alpha(readStruct);
-		if (colorType == PNG_COLOR_TYPE_RGB_ALPHA)
-			png_set_swap_alpha(readStruct);
-		if (bitDepth == 16)
-			png_set_swap(readStruct);
-		if (colorType == PNG_COLOR_TYPE_RGB ||
-			colorType == PNG_COLOR_TYPE_RGB_ALPHA)
-			png_set_bgr(readStruct);
-		if (bitDepth == 8 && colorType = PNG_COLOR_TYPE_RGB)
-			png_set_filler(readStruct, 255, PNG_FILLER_AFTER);
-	*/
 	// interpret the header
-	unsigned int w, h, bitDepth, colorType, channels, rowBytes;
-	bool hasCLUT = false;
+	unsigned int w, h, rowBytes;
 	FZImage::Format f = mono8;
 	w         = png_get_image_width(readStruct, infoStruct);
 	h         = png_get_image_height(readStruct, infoStruct);
-	bitDepth  = png_get_bit_depth(readStruct, infoStruct);
 	colorType = png_get_color_type(readStruct, infoStruct);
-	channels  = png_get_channels(readStruct, infoStruct);
 	rowBytes  = png_get_rowbytes(readStruct, infoStruct);
 
 	// decide data format
 	switch (colorType) {
 		case PNG_COLOR_TYPE_GRAY:
-			f = mono8;
-		break;
 		case PNG_COLOR_TYPE_PALETTE:
 			f = mono8;
-			hasCLUT = true;
 		break;
 		case PNG_COLOR_TYPE_GRAY_ALPHA:
 			f = dual16;
@@ -132,20 +147,22 @@ FZImage* FZImage::createFromPNG(FZInputStream* in) {
 		default:
 			// clean libpng structs
 			png_destroy_read_struct(&readStruct, &infoStruct, (png_infopp)NULL);
-			return 0;			
+			return 0;
 		break;
 	}
 
-	// allocate data buffer
-	FZImage* image = new FZImage(w, h, f);
-	//image->pitch = rowBytes;
-	//image->data = (char*)malloc(w * image->getPitch() * image->getBytesPerPixel());
-	image->data = (char*)memalign(16, h * w * image->getBytesPerPixel());
-	memset(image->data, 0, h * w * image->getBytesPerPixel());
+	// every row is decoded into place below, no need to clear
+	FZImage* target = createEmpty(w, h, 0, f, false);
+	if (target == 0 || rowBytes != w * target->getBytesPerPixel()) {
+		if (target != 0)
+			target->release();
+		png_destroy_read_struct(&readStruct, &infoStruct, (png_infopp)NULL);
+		return 0;
+	}
+	image = target;
 
 	// copy the CLUT
-	// TODO: support single transparency for grayscale - is it useful?
-	if (f == mono8 && hasCLUT) {
+	if (hasCLUT) {
 		png_colorp palette = NULL;
 		png_bytep trans = NULL;
 		int num_palette = 0;
@@ -153,9 +170,10 @@ FZImage* FZImage::createFromPNG(FZInputStream* in) {
 		png_color_16p trans_values; // for non-PLTE images
 		png_get_PLTE(readStruct, infoStruct, &palette, &num_palette);
 		png_get_tRNS(readStruct, infoStruct, &trans, &num_trans, &trans_values);
-		//image->clut = (unsigned int*)malloc(num_palette * sizeof(unsigned int));
-		image->clut = (unsigned int*)memalign(16, num_palette * sizeof(unsigned int));
-		image->clutSize = num_palette;
+		target->clut = (unsigned int*)FZBufferPool::alloc(num_palette * sizeof(unsigned int), false);
+		if (target->clut == NULL)
+			png_error(readStruct, "out of memory");
+		target->clutSize = num_palette;
 		int i, col;
 		for (i = 0; i < num_palette; i++) {
 			col = (palette[i].red) | (palette[i].green << 8) | (palette[i].blue << 16);
@@ -164,23 +182,22 @@ FZImage* FZImage::createFromPNG(FZInputStream* in) {
 			} else {
 				col |= 0xff000000;
 			}
-			image->clut[i] = col;
+			target->clut[i] = col;
 		}
 	}
 
-	// access & copy the data
-	png_bytep *rowPointers = png_get_rows(readStruct, infoStruct);
-	unsigned int j;
-	unsigned char* cData = (unsigned char*)image->data;
-	for (j = 0; j < image->height; j++) {
-		memcpy(cData, rowPointers[j], rowBytes);
-		cData += rowBytes;
+	// decode row by row; interlaced images make one sweep per pass and
+	// libpng fills in the pixels of each pass
+	for (int pass = 0; pass < passes; pass++) {
+		png_bytep row = (png_bytep)target->data;
+		for (unsigned int j = 0; j < h; j++) {
+			png_read_row(readStruct, row, NULL);
+			row += rowBytes;
+		}
 	}
 
 	// clean libpng structs
 	png_destroy_read_struct(&readStruct, &infoStruct, (png_infopp)NULL);
 
-	inStream = 0;
-
-	return image;
-}
\ No newline at end of file
+	return target;
+}
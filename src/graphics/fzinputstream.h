@@ -43,6 +43,19 @@ public:
 	 * Returns the number of bytes read.
 	 */
 	virtual int getBlock(char* where, int size) = 0;
+	/**
+	 * Move to an absolute position in the stream.
+	 * Returns false if the position is out of range.
+	 */
+	virtual bool seek(int position) = 0;
+	/**
+	 * Get the current position in the stream.
+	 */
+	virtual int tell() = 0;
+	/**
+	 * Get the stream length in bytes.
+	 */
+	virtual int getSize() = 0;
 };
 
 #endif
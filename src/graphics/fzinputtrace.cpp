@@ -0,0 +1,340 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fzinputtrace.h"
+#include "fzprofiler.h"
+
+using namespace std;
+
+/*
+# bookr input trace 1
+# frame ms buttons analogX analogY
+0 0.0 0x0 128 128
+12 201.5 0x10 128 128
+...
+end 340 5688.2
+*/
+
+#define TRACE_OFF     0
+#define TRACE_RECORD  1
+#define TRACE_REPLAY  2
+
+#define TRACE_CENTER  128
+
+struct TraceStep {
+  int frame;
+  double ms;
+  int buttons;
+  int x;
+  int y;
+};
+
+struct TraceEvent {
+  int frame;
+  int buttons;
+  double start;
+  // -1 until the frame showing it is swapped
+  double latency;
+};
+
+static int mode = TRACE_OFF;
+static string tracePath;
+static string reportPath;
+static bool reportToStdout = false;
+
+static vector<TraceStep> steps;
+// frames in the trace, idle frames after the last step included
+static int endFrame = 0;
+static double traceMs = 0;
+static size_t nextStep = 0;
+static TraceStep current;
+static bool finished = false;
+
+// buttons held when recording started, left out until released
+static int heldMask = 0;
+
+static int frame = -1;
+static double startTime = 0;
+static double endTime = 0;
+static int lastButtons = 0;
+static vector<TraceEvent> events;
+static size_t firstPending = 0;
+
+static double nowMs() {
+  return FZProfiler::now() / 1000.0;
+}
+
+static void reset(int m) {
+  mode = m;
+  steps.clear();
+  events.clear();
+  firstPending = 0;
+  nextStep = 0;
+  endFrame = 0;
+  traceMs = 0;
+  finished = false;
+  frame = -1;
+  lastButtons = 0;
+  heldMask = -1;
+  current.frame = 0;
+  current.ms = 0;
+  current.buttons = 0;
+  current.x = TRACE_CENTER;
+  current.y = TRACE_CENTER;
+  startTime = nowMs();
+  endTime = 0;
+}
+
+static void writeReport() {
+  FILE* out = reportToStdout ? stdout : NULL;
+  if (out == NULL && !reportPath.empty())
+    out = fopen(reportPath.c_str(), "w");
+  if (out == NULL)
+    return;
+  FZInputTrace::report(out);
+  if (out != stdout)
+    fclose(out);
+}
+
+bool FZInputTrace::startRecording(const char* path, const char* report) {
+  if (mode != TRACE_OFF)
+    return false;
+  // fail now rather than at the end of a long session
+  FILE* f = fopen(path, "w");
+  if (f == NULL)
+    return false;
+  fclose(f);
+  reset(TRACE_RECORD);
+  tracePath = path;
+  reportPath = report != NULL ? report : "";
+  reportToStdout = report == NULL;
+  return true;
+}
+
+void FZInputTrace::stopRecording() {
+  if (mode != TRACE_RECORD)
+    return;
+  endTime = nowMs();
+  endFrame = frame + 1;
+  // drop the chord that stopped the recording: everything after the
+  // last moment all the buttons were up
+  size_t keep = steps.size();
+  while (keep > 0 && steps[keep - 1].buttons != 0)
+    --keep;
+  if (keep < steps.size())
+    endFrame = steps[keep].frame;
+  while (!events.empty() && events.back().frame >= endFrame)
+    events.pop_back();
+  firstPending = min(firstPending, events.size());
+
+  FILE* f = fopen(tracePath.c_str(), "w");
+  if (f != NULL) {
+    fprintf(f, "# bookr input trace %d\n# frame ms buttons analogX analogY\n", FZ_TRACE_VERSION);
+    for (size_t i = 0; i < keep; ++i) {
+      TraceStep& s = steps[i];
+      fprintf(f, "%d %.1f 0x%x %d %d\n", s.frame, s.ms, s.buttons, s.x, s.y);
+    }
+    fprintf(f, "end %d %.1f\n", endFrame, keep < steps.size() ? steps[keep].ms : endTime - startTime);
+    if (fclose(f) != 0)
+      printf("cannot write the input trace %s\n", tracePath.c_str());
+  } else {
+    printf("cannot write the input trace %s\n", tracePath.c_str());
+  }
+  writeReport();
+  mode = TRACE_OFF;
+}
+
+bool FZInputTrace::isRecording() {
+  return mode == TRACE_RECORD;
+}
+
+bool FZInputTrace::startReplay(const char* path, const char* report) {
+  if (mode != TRACE_OFF)
+    return false;
+  FILE* f = fopen(path, "r");
+  if (f == NULL)
+    return false;
+  reset(TRACE_REPLAY);
+  char line[256];
+  int n = 0;
+  bool ended = false, bad = false;
+  while (!ended && !bad && fgets(line, sizeof(line), f) != NULL) {
+    ++n;
+    if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+      int version;
+      if (sscanf(line, "# bookr input trace %d", &version) == 1 && version > FZ_TRACE_VERSION) {
+        printf("%s: trace version %d is newer than %d\n", path, version, FZ_TRACE_VERSION);
+        bad = true;
+      }
+      continue;
+    }
+    TraceStep s;
+    if (strncmp(line, "end", 3) == 0)
+      ended = sscanf(line + 3, "%d %lf", &endFrame, &traceMs) == 2;
+    else if (sscanf(line, "%d %lf %i %d %d", &s.frame, &s.ms, &s.buttons, &s.x, &s.y) == 5
+        && (steps.empty() || s.frame >= steps.back().frame))
+      steps.push_back(s);
+    else
+      bad = true;
+    if (bad || (!ended && line[0] == 'e')) {
+      printf("%s:%d: bad trace line\n", path, n);
+      bad = true;
+    }
+  }
+  fclose(f);
+  if (!ended) {
+    if (!bad)
+      printf("%s: the trace has no end line\n", path);
+    mode = TRACE_OFF;
+    steps.clear();
+    return false;
+  }
+  reportPath = report != NULL ? report : "";
+  reportToStdout = report == NULL;
+  return true;
+}
+
+bool FZInputTrace::isReplaying() {
+  return mode == TRACE_REPLAY && !finished;
+}
+
+bool FZInputTrace::isReplayFinished() {
+  return mode == TRACE_REPLAY && finished;
+}
+
+void FZInputTrace::sample(int& buttons, int& analogX, int& analogY) {
+  if (mode == TRACE_OFF)
+    return;
+  ++frame;
+  double now = nowMs();
+
+  if (mode == TRACE_REPLAY) {
+    if (!finished) {
+      while (nextStep < steps.size() && steps[nextStep].frame <= frame)
+        current = steps[nextStep++];
+      if (frame >= endFrame) {
+        finished = true;
+        endTime = now;
+        writeReport();
+      }
+    }
+    buttons = finished ? 0 : current.buttons;
+    analogX = finished ? TRACE_CENTER : current.x;
+    analogY = finished ? TRACE_CENTER : current.y;
+  } else {
+    heldMask &= buttons;
+    buttons &= ~heldMask;
+    TraceStep* last = steps.empty() ? &current : &steps.back();
+    if (steps.empty() || buttons != last->buttons
+        || abs(analogX - last->x) >= FZ_TRACE_ANALOG_DEADZONE
+        || abs(analogY - last->y) >= FZ_TRACE_ANALOG_DEADZONE) {
+      TraceStep s;
+      s.frame = frame;
+      s.ms = now - startTime;
+      s.buttons = buttons;
+      s.x = analogX;
+      s.y = analogY;
+      steps.push_back(s);
+    }
+  }
+
+  // a button that was up is now down
+  if (buttons & ~lastButtons) {
+    TraceEvent e;
+    e.frame = frame;
+    e.buttons = buttons;
+    e.start = now;
+    e.latency = -1;
+    events.push_back(e);
+  }
+  lastButtons = buttons;
+}
+
+void FZInputTrace::frameShown() {
+  if (firstPending == events.size())
+    return;
+  double now = nowMs();
+  for (size_t i = firstPending; i < events.size(); ++i)
+    events[i].latency = now - events[i].start;
+  firstPending = events.size();
+}
+
+static double percentile(vector<double>& sorted, int p) {
+  if (sorted.empty())
+    return 0;
+  size_t i = (sorted.size() - 1) * p / 100;
+  return sorted[i];
+}
+
+void FZInputTrace::report(FILE* out) {
+  vector<double> latencies;
+  for (size_t i = 0; i < events.size(); ++i) {
+    if (events[i].latency >= 0)
+      latencies.push_back(events[i].latency);
+  }
+  sort(latencies.begin(), latencies.end());
+  double wall = (endTime > 0 ? endTime : nowMs()) - startTime;
+
+  fprintf(out, "# bookr input latency, %s\n", mode == TRACE_REPLAY ? "replay" : "recording");
+  fprintf(out, "frames %d\n", frame + 1);
+  fprintf(out, "events %d\n", (int)events.size());
+  if (mode == TRACE_REPLAY)
+    fprintf(out, "wall time ms %.1f (recorded %.1f)\n", wall, traceMs);
+  else
+    fprintf(out, "wall time ms %.1f\n", wall);
+  if (!latencies.empty()) {
+    fprintf(out, "latency ms min %.2f median %.2f p90 %.2f p95 %.2f p99 %.2f max %.2f\n",
+      latencies.front(), percentile(latencies, 50), percentile(latencies, 90),
+      percentile(latencies, 95), percentile(latencies, 99), latencies.back());
+  }
+  fprintf(out, "# event frame buttons latency_ms\n");
+  for (size_t i = 0; i < events.size(); ++i) {
+    if (events[i].latency >= 0)
+      fprintf(out, "%d %d 0x%x %.2f\n", (int)i, events[i].frame, events[i].buttons, events[i].latency);
+    else
+      fprintf(out, "%d %d 0x%x -\n", (int)i, events[i].frame, events[i].buttons);
+  }
+}
+
+void FZInputTrace::shutdown() {
+  if (mode == TRACE_RECORD)
+    stopRecording();
+  else if (mode == TRACE_REPLAY && !finished) {
+    endTime = nowMs();
+    writeReport();
+  }
+  mode = TRACE_OFF;
+}
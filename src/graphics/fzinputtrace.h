@@ -0,0 +1,79 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FZINPUTTRACE_H
+#define FZINPUTTRACE_H
+
+#include <stdio.h>
+
+/*! \brief Records and replays the pad, and measures input latency.
+ *
+ *  Every FZScreen backend passes what it read from the pad through
+ *  sample() and calls frameShown() after each swap. While recording,
+ *  each change of the buttons or the sticks is written to a text trace
+ *  with its frame number and time. While replaying, the trace replaces
+ *  the pad: samples are matched by frame number, not by time, so a
+ *  trace recorded on the Vita drives the headless build the same way
+ *  however fast either of them draws.
+ *
+ *  In both modes a button press is an event, and the time from the
+ *  sample that saw it to the end of the next swap is its input to
+ *  frame latency. The report lists every event and their percentiles.
+ */
+class FZInputTrace {
+  public:
+  #define FZ_TRACE_VERSION 1
+  // stick moves smaller than this are not written to the trace
+  #define FZ_TRACE_ANALOG_DEADZONE 8
+
+  // write the pad to path until stopRecording(); the latency report
+  // then goes to reportPath, or stdout if it is NULL
+  static bool startRecording(const char* path, const char* reportPath);
+  static void stopRecording();
+  static bool isRecording();
+
+  // read the pad from the trace at path; the report is written to
+  // reportPath (stdout if NULL) once the trace runs out
+  static bool startReplay(const char* path, const char* reportPath);
+  static bool isReplaying();
+  // the whole trace was played back
+  static bool isReplayFinished();
+
+  // From the backends: once per readCtrl() with the raw buttons and
+  // stick position (0 to 255), which a replay overwrites.
+  static void sample(int& buttons, int& analogX, int& analogY);
+  // after every swap
+  static void frameShown();
+
+  // events, latency percentiles and wall time so far
+  static void report(FILE* out);
+  // stop recording and write what is pending, at exit
+  static void shutdown();
+};
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fzinstreamfile.h"
+
+FZInputStreamFile::FZInputStreamFile(FILE* f, int s, int bs) : FZInputStream(),
+	file(f), buffer(0), blockSize(bs), size(s), bufferStart(0), bufferLength(0), position(0) {
+	buffer = (char*)malloc(blockSize);
+}
+
+FZInputStreamFile::~FZInputStreamFile() {
+	if (buffer != 0)
+		free(buffer);
+	if (file != 0)
+		fclose(file);
+}
+
+FZInputStreamFile* FZInputStreamFile::create(const char* path, int blockSize) {
+	FILE* f = fopen(path, "rb");
+	if (f == NULL)
+		return 0;
+	return create(f, blockSize);
+}
+
+FZInputStreamFile* FZInputStreamFile::create(FILE* f, int blockSize) {
+	if (blockSize <= 0)
+		blockSize = FZ_INSTREAM_FILE_BLOCK;
+	fseek(f, 0, SEEK_END);
+	int s = (int)ftell(f);
+	fseek(f, 0, SEEK_SET);
+	FZInputStreamFile* in = new FZInputStreamFile(f, s, blockSize);
+	if (in->buffer == 0 || s < 0) {
+		in->release();
+		return 0;
+	}
+	return in;
+}
+
+// Load the block starting at the current position.
+bool FZInputStreamFile::fill() {
+	if (fseek(file, position, SEEK_SET) != 0)
+		return false;
+	bufferStart = position;
+	bufferLength = (int)fread(buffer, 1, blockSize, file);
+	return bufferLength > 0;
+}
+
+bool FZInputStreamFile::eos() {
+	return position >= size;
+}
+
+char FZInputStreamFile::get() {
+	if (position < bufferStart || position >= bufferStart + bufferLength) {
+		if (position >= size || !fill())
+			return 0;
+	}
+	return buffer[position++ - bufferStart];
+}
+
+int FZInputStreamFile::getBlock(char* where, int n) {
+	int done = 0;
+	while (done < n && position < size) {
+		// serve what the buffer has first
+		if (position >= bufferStart && position < bufferStart + bufferLength) {
+			int c = bufferStart + bufferLength - position;
+			if (c > n - done)
+				c = n - done;
+			memcpy(where + done, buffer + (position - bufferStart), c);
+			position += c;
+			done += c;
+			continue;
+		}
+		// big reads go straight to the destination
+		if (n - done >= blockSize) {
+			if (fseek(file, position, SEEK_SET) != 0)
+				break;
+			int c = (int)fread(where + done, 1, n - done, file);
+			if (c <= 0)
+				break;
+			position += c;
+			done += c;
+			continue;
+		}
+		if (!fill())
+			break;
+	}
+	return done;
+}
+
+bool FZInputStreamFile::seek(int position) {
+	if (position < 0 || position > size)
+		return false;
+	// the buffer stays valid, the next read refills it only if needed
+	this->position = position;
+	return true;
+}
+
+int FZInputStreamFile::tell() {
+	return position;
+}
+
+int FZInputStreamFile::getSize() {
+	return size;
+}
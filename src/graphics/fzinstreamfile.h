@@ -0,0 +1,74 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FZINSTREAMFILE_H
+#define FZINSTREAMFILE_H
+
+#include <stdio.h>
+
+#include "fzinputstream.h"
+
+/**
+ * File based input stream.
+ * Reads go through a block buffer, so the whole file never has to be in
+ * memory. Requests larger than a block skip the buffer.
+ */
+class FZInputStreamFile : public FZInputStream {
+	#define FZ_INSTREAM_FILE_BLOCK 16384
+
+	FILE* file;
+	char* buffer;
+	int blockSize;
+	int size;
+	int bufferStart;	// file offset of buffer[0]
+	int bufferLength;	// valid bytes in buffer
+	int position;
+
+	bool fill();
+protected:
+	FZInputStreamFile(FILE* f, int s, int bs);
+	virtual ~FZInputStreamFile();
+public:
+	virtual bool eos();
+	virtual char get();
+	virtual int getBlock(char* where, int size);
+	virtual bool seek(int position);
+	virtual int tell();
+	virtual int getSize();
+	/**
+	 * Open a file for reading. Returns 0 if the file cannot be opened.
+	 */
+	static FZInputStreamFile* create(const char* path, int blockSize = FZ_INSTREAM_FILE_BLOCK);
+	/**
+	 * Wrap an already open file. The stream takes ownership of f and
+	 * closes it, also when creation fails.
+	 */
+	static FZInputStreamFile* create(FILE* f, int blockSize = FZ_INSTREAM_FILE_BLOCK);
+};
+
+#endif
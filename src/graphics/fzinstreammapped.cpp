@@ -0,0 +1,80 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if defined(__linux__) || defined(MAC)
+	#define FZ_HAVE_MMAP
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#include "fzinstreammapped.h"
+#include "fzinstreamfile.h"
+
+FZInputStreamMapped::FZInputStreamMapped(void* m, size_t s) : FZInputStreamMem((char*)m, (int)s),
+	map(m), mapSize(s) {
+}
+
+FZInputStreamMapped::~FZInputStreamMapped() {
+#ifdef FZ_HAVE_MMAP
+	if (map != 0)
+		munmap(map, mapSize);
+#endif
+}
+
+FZInputStreamMapped* FZInputStreamMapped::create(const char* path) {
+#ifdef FZ_HAVE_MMAP
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	struct stat st;
+	// empty files cannot be mapped
+	if (fstat(fd, &st) != 0 || st.st_size <= 0 || st.st_size > 0x7fffffff) {
+		close(fd);
+		return 0;
+	}
+	void* m = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps its own reference to the file
+	close(fd);
+	if (m == MAP_FAILED)
+		return 0;
+	// decoders mostly read front to back
+	madvise(m, st.st_size, MADV_SEQUENTIAL);
+	return new FZInputStreamMapped(m, st.st_size);
+#else
+	return 0;
+#endif
+}
+
+FZInputStream* FZInputStreamMapped::open(const char* path) {
+	FZInputStream* in = create(path);
+	if (in == 0)
+		in = FZInputStreamFile::create(path);
+	return in;
+}
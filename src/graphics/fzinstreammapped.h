@@ -0,0 +1,60 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FZINSTREAMMAPPED_H
+#define FZINSTREAMMAPPED_H
+
+#include <stddef.h>
+
+#include "fzinstreammem.h"
+
+/**
+ * Memory mapped file input stream.
+ * The file is mapped read only and served as a memory stream, so pages
+ * are only read from storage when the decoder touches them. Only
+ * available where mmap is (Linux and other POSIX desktops); create()
+ * returns 0 elsewhere and callers should fall back to FZInputStreamFile.
+ */
+class FZInputStreamMapped : public FZInputStreamMem {
+	void* map;
+	size_t mapSize;
+protected:
+	FZInputStreamMapped(void* m, size_t s);
+	virtual ~FZInputStreamMapped();
+public:
+	/**
+	 * Map a file. Returns 0 if it cannot be mapped.
+	 */
+	static FZInputStreamMapped* create(const char* path);
+	/**
+	 * Map a file if possible, otherwise open it buffered.
+	 */
+	static FZInputStream* open(const char* path);
+};
+
+#endif
@@ -34,20 +34,37 @@ FZInputStreamMem* FZInputStreamMem::create(char* b, int s) {
 }
 
 bool FZInputStreamMem::eos() {
-	return position < size;
+	return position >= size;
 }
 
 char FZInputStreamMem::get() {
-	char r = *base;
-	++position;
-	++base;
-	return r;
+	if (position >= size)
+		return 0;
+	return base[position++];
 }
 
 int FZInputStreamMem::getBlock(char* where, int size) {
-	memcpy(where, base, size);
-	base += size;
+	int left = this->size - position;
+	if (size > left)
+		size = left;
+	if (size <= 0)
+		return 0;
+	memcpy(where, base + position, size);
 	position += size;
 	return size;
 }
 
+bool FZInputStreamMem::seek(int position) {
+	if (position < 0 || position > size)
+		return false;
+	this->position = position;
+	return true;
+}
+
+int FZInputStreamMem::tell() {
+	return position;
+}
+
+int FZInputStreamMem::getSize() {
+	return size;
+}
@@ -46,6 +46,9 @@ public:
 	 * Returns the number of bytes read.
 	 */
 	virtual int getBlock(char* where, int size);
+	virtual bool seek(int position);
+	virtual int tell();
+	virtual int getSize();
 	/**
 	 * Create a stream from a memory buffer
 	 */
@@ -0,0 +1,177 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vector>
+#include <atomic>
+#include <stdio.h>
+
+#include "fzmemory.h"
+#include "fzscreen.h"
+
+using namespace std;
+
+static const char* tagNames[FZ_MEM_TAGS] = {
+  "pixmaps",
+  "pool idle",
+  "textures",
+  "mupdf",
+  "glyphs",
+  "text",
+  "bookmarks",
+  "decoders",
+};
+
+static atomic<size_t> current[FZ_MEM_TAGS];
+static atomic<size_t> peak[FZ_MEM_TAGS];
+static atomic<bool> failedAllocation(false);
+
+static size_t heapLimit = 0;
+static vector<FZMemory::PressureHandler> handlers;
+static int pressureLevel = FZ_MEM_PRESSURE_NONE;
+static int framesSinceCheck = 0;
+
+static void raisePeak(int tag, size_t value) {
+  size_t p = peak[tag].load(memory_order_relaxed);
+  while (value > p && !peak[tag].compare_exchange_weak(p, value, memory_order_relaxed))
+    ;
+}
+
+void FZMemory::add(int tag, size_t bytes) {
+  raisePeak(tag, current[tag].fetch_add(bytes, memory_order_relaxed) + bytes);
+}
+
+void FZMemory::sub(int tag, size_t bytes) {
+  current[tag].fetch_sub(bytes, memory_order_relaxed);
+}
+
+void FZMemory::set(int tag, size_t bytes) {
+  current[tag].store(bytes, memory_order_relaxed);
+  raisePeak(tag, bytes);
+}
+
+void FZMemory::move(int from, int to, size_t bytes) {
+  sub(from, bytes);
+  add(to, bytes);
+}
+
+void FZMemory::update(int tag, size_t& accounted, size_t bytes) {
+  if (bytes > accounted)
+    add(tag, bytes - accounted);
+  else if (bytes < accounted)
+    sub(tag, accounted - bytes);
+  accounted = bytes;
+}
+
+const char* FZMemory::getTagName(int tag) {
+  return tagNames[tag];
+}
+
+void FZMemory::getStats(int tag, TagStats& stats) {
+  stats.current = current[tag].load(memory_order_relaxed);
+  stats.peak = peak[tag].load(memory_order_relaxed);
+}
+
+void FZMemory::resetPeak(int tag) {
+  peak[tag].store(current[tag].load(memory_order_relaxed), memory_order_relaxed);
+}
+
+size_t FZMemory::getTotal() {
+  size_t total = 0;
+  for (int i = 0; i < FZ_MEM_TAGS; ++i)
+    total += current[i].load(memory_order_relaxed);
+  return total;
+}
+
+void FZMemory::setHeapLimit(size_t bytes) {
+  heapLimit = bytes;
+}
+
+size_t FZMemory::getHeapLimit() {
+  return heapLimit;
+}
+
+size_t FZMemory::getHeapUsed() {
+  int used = FZScreen::getUsedMemory();
+  if (used > 0)
+    return (size_t)used;
+  return getTotal();
+}
+
+void FZMemory::addPressureHandler(PressureHandler handler) {
+  handlers.push_back(handler);
+}
+
+void FZMemory::allocationFailed() {
+  failedAllocation.store(true, memory_order_relaxed);
+}
+
+void FZMemory::checkPressure() {
+  bool failed = failedAllocation.exchange(false, memory_order_relaxed);
+  if (!failed && ++framesSinceCheck < FZ_MEM_CHECK_FRAMES)
+    return;
+  framesSinceCheck = 0;
+
+  int level = FZ_MEM_PRESSURE_NONE;
+  if (failed) {
+    level = FZ_MEM_PRESSURE_CRITICAL;
+  } else if (heapLimit > 0) {
+    size_t used = getHeapUsed();
+    if (used >= heapLimit / 100 * FZ_MEM_CRITICAL_PCT)
+      level = FZ_MEM_PRESSURE_CRITICAL;
+    else if (used >= heapLimit / 100 * FZ_MEM_MODERATE_PCT)
+      level = FZ_MEM_PRESSURE_MODERATE;
+  }
+
+  // moderate pressure is handled once when it starts, critical pressure
+  // at every check until it eases
+  bool notify = level > pressureLevel || level == FZ_MEM_PRESSURE_CRITICAL;
+  pressureLevel = level;
+  if (!notify)
+    return;
+  #ifdef DEBUG
+    printf("memory pressure %d: %u KB used\n", level, (unsigned int)(getHeapUsed() / 1024));
+  #endif
+  for (unsigned int i = 0; i < handlers.size(); ++i)
+    handlers[i](level);
+}
+
+int FZMemory::getPressureLevel() {
+  return pressureLevel;
+}
+
+void FZMemory::report(FILE* out) {
+  fprintf(out, "memory: heap %u KB used of %u KB, pressure %d\n",
+    (unsigned int)(getHeapUsed() / 1024), (unsigned int)(heapLimit / 1024), pressureLevel);
+  for (int i = 0; i < FZ_MEM_TAGS; ++i) {
+    TagStats s;
+    getStats(i, s);
+    fprintf(out, "memory: %-10s %7u KB (peak %7u KB)\n", tagNames[i],
+      (unsigned int)(s.current / 1024), (unsigned int)(s.peak / 1024));
+  }
+  fprintf(out, "memory: %-10s %7u KB\n", "total", (unsigned int)(getTotal() / 1024));
+}
@@ -0,0 +1,105 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FZMEMORY_H
+#define FZMEMORY_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*! \brief Tagged memory accounting and memory pressure.
+ *
+ *  Subsystems report what they allocate under a tag, and FZMemory keeps
+ *  current and peak bytes for each. Counters are atomics, so the DjVu
+ *  worker and the library scan can report without a lock.
+ *
+ *  The main loop calls checkPressure() once a frame. When the heap gets
+ *  close to its limit, or an allocation failed since the last check,
+ *  the registered handlers are asked to give memory back.
+ */
+class FZMemory {
+  public:
+  #define FZ_MEM_PIXMAP     0   // page and image pixel buffers
+  #define FZ_MEM_POOL       1   // idle buffers kept by FZBufferPool
+  #define FZ_MEM_TEXTURE    2
+  #define FZ_MEM_MUPDF      3   // fitz contexts, store included
+  #define FZ_MEM_GLYPH      4   // UI font glyph atlases
+  #define FZ_MEM_TEXT       5   // reflowable text, runs and lines
+  #define FZ_MEM_BOOKMARK   6
+  #define FZ_MEM_DECODE     7   // image decoder working memory, e.g. libpng
+  #define FZ_MEM_TAGS       8
+
+  #define FZ_MEM_PRESSURE_NONE      0
+  #define FZ_MEM_PRESSURE_MODERATE  1   // background caches should shrink
+  #define FZ_MEM_PRESSURE_CRITICAL  2   // drop everything that can be rebuilt
+
+  // percent of the heap limit where each level starts
+  #define FZ_MEM_MODERATE_PCT 75
+  #define FZ_MEM_CRITICAL_PCT 90
+  // frames between two heap checks, mallinfo walks the heap
+  #define FZ_MEM_CHECK_FRAMES 30
+
+  struct TagStats {
+    size_t current;
+    size_t peak;
+  };
+
+  typedef void (*PressureHandler)(int level);
+
+  static void add(int tag, size_t bytes);
+  static void sub(int tag, size_t bytes);
+  static void set(int tag, size_t bytes);
+  // bytes that changed owner, e.g. a MuPDF pixmap counted as a pixmap
+  static void move(int from, int to, size_t bytes);
+  // bring the bytes counted by one object up to date
+  static void update(int tag, size_t& accounted, size_t bytes);
+
+  static const char* getTagName(int tag);
+  static void getStats(int tag, TagStats& stats);
+  // start a new peak from the current bytes, to measure one operation
+  static void resetPeak(int tag);
+  // sum of the current bytes of all tags
+  static size_t getTotal();
+
+  // heap size the pressure levels are measured against, 0 disables them
+  static void setHeapLimit(size_t bytes);
+  static size_t getHeapLimit();
+  // heap in use: mallinfo where the platform has it, else the tag total
+  static size_t getHeapUsed();
+
+  static void addPressureHandler(PressureHandler handler);
+  // an allocation failed; safe from any thread, handled at the next check
+  static void allocationFailed();
+  // runs the handlers when needed; main thread only
+  static void checkPressure();
+  static int getPressureLevel();
+
+  static void report(FILE* out);
+};
+
+#endif
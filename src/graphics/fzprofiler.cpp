@@ -0,0 +1,311 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <chrono>
+
+#include "fzprofiler.h"
+
+using namespace std;
+
+struct FZProfileEvent {
+  atomic<uint64_t> start;
+  atomic<uint32_t> duration;
+  atomic<uint32_t> zone;
+};
+
+// Written only by its own thread, reset() included: the thread clears
+// its counters itself once it sees a new resetEpoch. Readers skip
+// buffers that have not caught up yet. Events are a seqlock on head:
+// a reader copies them, then drops the ones head has lapped meanwhile.
+struct FZProfileThread {
+  FZProfileThread* next;
+  // next idle buffer, see releaseThreadBuffer()
+  FZProfileThread* nextIdle;
+  int index;
+  atomic<uint32_t> epoch;   // resetEpoch the counters belong to
+  atomic<uint32_t> head;
+  atomic<uint32_t> first;   // head at the last reset
+  FZProfileEvent events[FZ_PROFILE_EVENTS];
+  atomic<uint32_t> histogram[FZ_PROFILE_ZONES][FZ_PROFILE_BUCKETS];
+  atomic<uint32_t> max[FZ_PROFILE_ZONES];
+};
+
+static const char* zoneNames[FZ_PROFILE_ZONES] = {
+  "frame",
+  "input",
+  "draw",
+  "document open",
+  "page load",
+  "page render",
+  "texture upload",
+  "reflow",
+  "bookmark save",
+};
+
+atomic<bool> FZProfiler::enabled(false);
+
+static atomic<FZProfileThread*> threads(nullptr);
+// latest duration of each zone on any thread, for the overlay
+static atomic<uint32_t> lastDuration[FZ_PROFILE_ZONES];
+static atomic<int> threadCount(0);
+static atomic<uint32_t> resetEpoch(0);
+static pthread_key_t threadKey;
+static pthread_once_t threadKeyOnce = PTHREAD_ONCE_INIT;
+// buffers of threads that exited; only touched when a thread starts or
+// ends recording, never per event
+static FZProfileThread* idleThreads = nullptr;
+static pthread_mutex_t idleMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Runs when a thread that recorded exits. Its buffer stays on the list
+// with its events and counts, and the next new thread carries on in it,
+// so the workers that come and go while reading reuse a few buffers
+// instead of leaking one each.
+static void releaseThreadBuffer(void* p) {
+  FZProfileThread* t = (FZProfileThread*)p;
+  pthread_mutex_lock(&idleMutex);
+  t->nextIdle = idleThreads;
+  idleThreads = t;
+  pthread_mutex_unlock(&idleMutex);
+}
+
+static void createThreadKey() {
+  pthread_key_create(&threadKey, releaseThreadBuffer);
+}
+
+// The buffer of the calling thread, taken on its first event. Buffers
+// outlive their threads so their events still show up in the trace.
+static FZProfileThread* threadBuffer() {
+  pthread_once(&threadKeyOnce, createThreadKey);
+  FZProfileThread* t = (FZProfileThread*)pthread_getspecific(threadKey);
+  if (t != nullptr)
+    return t;
+  pthread_mutex_lock(&idleMutex);
+  t = idleThreads;
+  if (t != nullptr)
+    idleThreads = t->nextIdle;
+  pthread_mutex_unlock(&idleMutex);
+  if (t != nullptr) {
+    // already on the list, keeps its index in the trace
+    pthread_setspecific(threadKey, t);
+    return t;
+  }
+  t = (FZProfileThread*)calloc(1, sizeof(FZProfileThread));
+  if (t == nullptr)
+    return nullptr;
+  t->index = threadCount.fetch_add(1);
+  pthread_setspecific(threadKey, t);
+  FZProfileThread* h = threads.load();
+  do {
+    t->next = h;
+  } while (!threads.compare_exchange_weak(h, t));
+  return t;
+}
+
+// four buckets per octave of microseconds
+static int bucketFor(uint32_t us) {
+  if (us < 4)
+    return us;
+  int msb = 2;
+  while ((us >> (msb + 1)) != 0)
+    ++msb;
+  int sub = (us >> (msb - 2)) & 3;
+  return (msb - 1) * 4 + sub;
+}
+
+static float bucketLimit(int b) {
+  if (b < 4)
+    return (b + 1) / 1000.0f;
+  int msb = b / 4 + 1;
+  int sub = b % 4;
+  return (float)((uint64_t)(5 + sub) << (msb - 2)) / 1000.0f;
+}
+
+void FZProfiler::setEnabled(bool on) {
+  if (on && !isEnabled())
+    reset();
+  enabled.store(on, memory_order_relaxed);
+}
+
+uint64_t FZProfiler::now() {
+  return chrono::duration_cast<chrono::microseconds>(
+    chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FZProfiler::record(int zone, uint64_t start, uint64_t end) {
+  if (zone < 0 || zone >= FZ_PROFILE_ZONES)
+    return;
+  FZProfileThread* t = threadBuffer();
+  if (t == nullptr)
+    return;
+  uint64_t d = end - start;
+  uint32_t us = d > 0xffffffffu ? 0xffffffffu : (uint32_t)d;
+
+  uint32_t epoch = resetEpoch.load(memory_order_acquire);
+  if (t->epoch.load(memory_order_relaxed) != epoch) {
+    for (int z = 0; z < FZ_PROFILE_ZONES; ++z) {
+      for (int b = 0; b < FZ_PROFILE_BUCKETS; ++b)
+        t->histogram[z][b].store(0, memory_order_relaxed);
+      t->max[z].store(0, memory_order_relaxed);
+    }
+    t->first.store(t->head.load(memory_order_relaxed), memory_order_relaxed);
+    t->epoch.store(epoch, memory_order_release);
+  }
+
+  uint32_t h = t->head.load(memory_order_relaxed);
+  // head already counts the event this slot held a lap ago as gone;
+  // the fence keeps readers from seeing the new event before that
+  atomic_thread_fence(memory_order_release);
+  FZProfileEvent& e = t->events[h % FZ_PROFILE_EVENTS];
+  e.start.store(start, memory_order_relaxed);
+  e.duration.store(us, memory_order_relaxed);
+  e.zone.store(zone, memory_order_relaxed);
+  t->head.store(h + 1, memory_order_release);
+
+  atomic<uint32_t>& b = t->histogram[zone][bucketFor(us)];
+  b.store(b.load(memory_order_relaxed) + 1, memory_order_relaxed);
+  lastDuration[zone].store(us, memory_order_relaxed);
+  if (us > t->max[zone].load(memory_order_relaxed))
+    t->max[zone].store(us, memory_order_relaxed);
+}
+
+const char* FZProfiler::getZoneName(int zone) {
+  if (zone < 0 || zone >= FZ_PROFILE_ZONES)
+    return "?";
+  return zoneNames[zone];
+}
+
+static float percentile(uint32_t* counts, unsigned int total, float p) {
+  uint64_t target = (uint64_t)(total * p + 0.5f);
+  if (target < 1)
+    target = 1;
+  uint64_t seen = 0;
+  for (int b = 0; b < FZ_PROFILE_BUCKETS; ++b) {
+    seen += counts[b];
+    if (seen >= target)
+      return bucketLimit(b);
+  }
+  return bucketLimit(FZ_PROFILE_BUCKETS - 1);
+}
+
+void FZProfiler::getStats(int zone, ZoneStats& stats) {
+  memset(&stats, 0, sizeof(ZoneStats));
+  if (zone < 0 || zone >= FZ_PROFILE_ZONES)
+    return;
+  uint32_t counts[FZ_PROFILE_BUCKETS];
+  memset(counts, 0, sizeof(counts));
+  uint32_t maxUs = 0;
+  uint32_t epoch = resetEpoch.load(memory_order_relaxed);
+  for (FZProfileThread* t = threads.load(); t != nullptr; t = t->next) {
+    // counted before the last reset
+    if (t->epoch.load(memory_order_acquire) != epoch)
+      continue;
+    for (int b = 0; b < FZ_PROFILE_BUCKETS; ++b) {
+      uint32_t c = t->histogram[zone][b].load(memory_order_relaxed);
+      counts[b] += c;
+      stats.count += c;
+    }
+    uint32_t m = t->max[zone].load(memory_order_relaxed);
+    if (m > maxUs)
+      maxUs = m;
+  }
+  if (stats.count == 0)
+    return;
+  stats.last = lastDuration[zone].load(memory_order_relaxed) / 1000.0f;
+  stats.max = maxUs / 1000.0f;
+  stats.p50 = percentile(counts, stats.count, 0.50f);
+  stats.p95 = percentile(counts, stats.count, 0.95f);
+  stats.p99 = percentile(counts, stats.count, 0.99f);
+}
+
+void FZProfiler::reset() {
+  // each thread clears its own buffer on its next event
+  resetEpoch.fetch_add(1, memory_order_release);
+}
+
+bool FZProfiler::writeTrace(const char* path) {
+  FILE* f = fopen(path, "w");
+  if (f == NULL) {
+    printf("FZProfiler: cannot write %s\n", path);
+    return false;
+  }
+  // a copy of one thread's ring, taken while it may keep recording
+  struct Copy {
+    uint64_t start;
+    uint32_t duration;
+    uint32_t zone;
+  };
+  Copy* copy = (Copy*)malloc(FZ_PROFILE_EVENTS * sizeof(Copy));
+  if (copy == NULL) {
+    fclose(f);
+    return false;
+  }
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool firstEvent = true;
+  uint32_t epoch = resetEpoch.load(memory_order_relaxed);
+  for (FZProfileThread* t = threads.load(); t != nullptr; t = t->next) {
+    fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s%d\"}}",
+      firstEvent ? "" : ",\n", t->index, t->index == 0 ? "main " : "worker ", t->index);
+    firstEvent = false;
+    // nothing recorded since the last reset
+    if (t->epoch.load(memory_order_acquire) != epoch)
+      continue;
+
+    uint32_t h = t->head.load(memory_order_acquire);
+    uint32_t from = t->first.load(memory_order_relaxed);
+    if (h - from > FZ_PROFILE_EVENTS)
+      from = h - FZ_PROFILE_EVENTS;
+    for (uint32_t i = from; i != h; ++i) {
+      const FZProfileEvent& e = t->events[i % FZ_PROFILE_EVENTS];
+      Copy& c = copy[i - from];
+      c.start = e.start.load(memory_order_relaxed);
+      c.duration = e.duration.load(memory_order_relaxed);
+      c.zone = e.zone.load(memory_order_relaxed);
+    }
+    // the writer may be refilling slot now, which held event
+    // now - FZ_PROFILE_EVENTS; older events were overwritten already
+    atomic_thread_fence(memory_order_acquire);
+    uint32_t now = t->head.load(memory_order_relaxed);
+    uint32_t valid = from;
+    if (now - from >= FZ_PROFILE_EVENTS)
+      valid = now - FZ_PROFILE_EVENTS + 1;
+    for (uint32_t i = valid; i - from < h - from; ++i) {
+      const Copy& c = copy[i - from];
+      fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"bookr\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%llu,\"dur\":%u}",
+        getZoneName(c.zone), t->index, (unsigned long long)c.start, c.duration);
+    }
+  }
+  free(copy);
+  fprintf(f, "\n]}\n");
+  bool ok = ferror(f) == 0;
+  ok = fclose(f) == 0 && ok;
+  return ok;
+}
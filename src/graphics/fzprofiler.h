@@ -0,0 +1,115 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FZPROFILER_H
+#define FZPROFILER_H
+
+#include <stdint.h>
+#include <atomic>
+
+/*! \brief Always compiled, runtime toggled frame and hot path profiler.
+ *
+ *  Code is timed with scoped zones (FZ_PROFILE). While the profiler is
+ *  off a zone costs one relaxed load. While it is on, each thread
+ *  writes its own event ring and per zone histograms, so recording
+ *  never takes a lock. Histograms have four buckets per octave, which
+ *  puts percentiles within about 20% of the real value.
+ */
+class FZProfiler {
+  public:
+  #define FZ_PROFILE_FRAME            0
+  #define FZ_PROFILE_INPUT            1
+  #define FZ_PROFILE_DRAW             2   // layers to the display list
+  #define FZ_PROFILE_DOCUMENT_OPEN    3
+  #define FZ_PROFILE_PAGE_LOAD        4
+  #define FZ_PROFILE_PAGE_RENDER      5   // rasterising a page
+  #define FZ_PROFILE_TEXTURE_UPLOAD   6
+  #define FZ_PROFILE_REFLOW           7
+  #define FZ_PROFILE_BOOKMARK_SAVE    8
+  #define FZ_PROFILE_ZONES            9
+
+  // events kept per thread for the trace, the oldest are overwritten
+  #define FZ_PROFILE_EVENTS           4096
+  #define FZ_PROFILE_BUCKETS          124
+
+  struct ZoneStats {
+    unsigned int count;
+    // milliseconds
+    float last;
+    float p50;
+    float p95;
+    float p99;
+    float max;
+  };
+
+  static void setEnabled(bool on);
+  static bool isEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+  }
+
+  // microseconds on a monotonic clock
+  static uint64_t now();
+  static void record(int zone, uint64_t start, uint64_t end);
+
+  static const char* getZoneName(int zone);
+  // merged over all threads
+  static void getStats(int zone, ZoneStats& stats);
+  // forget the histograms and events recorded so far; each thread
+  // clears its own on its next event, until then it is left out
+  static void reset();
+
+  // Chrome trace event JSON, for chrome://tracing or Perfetto.
+  // Returns false if the file cannot be written.
+  static bool writeTrace(const char* path);
+
+  private:
+  static std::atomic<bool> enabled;
+};
+
+class FZProfileZone {
+  int zone;
+  uint64_t start;
+  bool active;
+
+  public:
+  FZProfileZone(int z) : zone(z), start(0), active(FZProfiler::isEnabled()) {
+    if (active)
+      start = FZProfiler::now();
+  }
+  ~FZProfileZone() {
+    if (active)
+      FZProfiler::record(zone, start, FZProfiler::now());
+  }
+};
+
+#define FZ_PROFILE_CONCAT2(a, b) a##b
+#define FZ_PROFILE_CONCAT(a, b) FZ_PROFILE_CONCAT2(a, b)
+// time the rest of the enclosing scope
+#define FZ_PROFILE(zone) FZProfileZone FZ_PROFILE_CONCAT(fzProfileZone, __LINE__)(zone)
+
+#endif
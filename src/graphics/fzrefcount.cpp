@@ -25,27 +25,11 @@
   #ifdef PSP
     #include <pspdebug.h>
     #define printf pspDebugScreenPrintf
-  #elif defined(__vita__)
+  #else
   	#include <stdio.h>
   #endif
 #endif
 
-void FZRefCounted::tidy() {
-	if (references < 0) {
-#ifdef DEBUG_REFCOUNT
-		printf("Instance %p: FZRefCounted::tidy() called with references = %d\n", this, references);
-#endif
-	} else if (references == 0) {
-#ifdef DEBUG_REFCOUNT
-		printf("Instance %p: delete() call chain begins...\n", this);
-#endif
-		delete this;
-#ifdef DEBUG_REFCOUNT
-		printf("Instance %p: delete() call chain ends\n", this);
-#endif
-	}
-}
-
 FZRefCounted::FZRefCounted() : references(1) {
 }
 
@@ -53,17 +37,24 @@ FZRefCounted::~FZRefCounted() {
 }
 
 void FZRefCounted::retain() {
-	++references;
-#ifdef DEBUG_REFCOUNT
-	printf("Instance %p: retained, now references = %d\n", this, references);
-#endif
+	// a new reference can only come from an existing one, so nothing
+	// needs ordering here
+	references.fetch_add(1, std::memory_order_relaxed);
 }
 
 void FZRefCounted::release() {
-	--references;
+	// acq-rel: writes made through any reference are visible to the
+	// thread that ends up deleting the object
+	int previous = references.fetch_sub(1, std::memory_order_acq_rel);
+	if (previous == 1) {
+		delete this;
+	} else if (previous < 1) {
 #ifdef DEBUG_REFCOUNT
-	printf("Instance %p: released, now references = %d\n", this, references);
+		printf("Instance %p: released with references = %d\n", this, previous);
 #endif
-	tidy();
+	}
 }
 
+int FZRefCounted::getReferences() const {
+	return references.load(std::memory_order_relaxed);
+}
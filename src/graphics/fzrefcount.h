@@ -24,6 +24,9 @@
 #pragma warning( disable : 4786 )
 #endif
 
+#include <atomic>
+#include <cstddef>
+
 /**
  * Simple pure reference counted allocation cycle objects.
  * All the objects inheriting from FZRefCounted must be created by factories.
@@ -31,10 +34,11 @@
  * implement creation/destruction behaviour on constructors/destroyers.
  * FZRefCounted::retain() and FZRefCounted::release() are NOT overridable for
  * this reason.
+ * The count is atomic, so references may be taken and dropped from any
+ * thread. The thread dropping the last one runs the destructor.
  */
 class FZRefCounted {
-	int references;
-	void tidy();
+	std::atomic<int> references;
 
 	protected:
 	// Force factory construction
@@ -52,7 +56,88 @@ class FZRefCounted {
 	 * It's only when calling this method that the object may get deleted.
 	 */
 	void release();
+	/**
+	 * Current reference count, for debugging only.
+	 */
+	int getReferences() const;
+};
+
+/**
+ * Intrusive handle for FZRefCounted objects.
+ * Constructing from a raw pointer adopts the reference the factory
+ * returned; copies retain and the destructor releases, moves just hand
+ * the reference over. Use FZRef<T>::retain() to share an object that
+ * somebody else still owns.
+ */
+template<class T>
+class FZRef {
+	T* p;
+
+	public:
+	FZRef() : p(nullptr) { }
+	explicit FZRef(T* adopt) : p(adopt) { }
+	FZRef(const FZRef& o) : p(o.p) {
+		if (p) p->retain();
+	}
+	FZRef(FZRef&& o) : p(o.p) {
+		o.p = nullptr;
+	}
+	template<class U> FZRef(const FZRef<U>& o) : p(o.get()) {
+		if (p) p->retain();
+	}
+	template<class U> FZRef(FZRef<U>&& o) : p(o.detach()) { }
+	~FZRef() {
+		if (p) p->release();
+	}
+
+	FZRef& operator=(FZRef o) {
+		swap(o);
+		return *this;
+	}
+
+	/**
+	 * Take a new reference on an object owned elsewhere.
+	 */
+	static FZRef retain(T* shared) {
+		if (shared) shared->retain();
+		return FZRef(shared);
+	}
+
+	/**
+	 * Release the current object and adopt another one, if any.
+	 */
+	void reset(T* adopt = nullptr) {
+		T* old = p;
+		p = adopt;
+		if (old) old->release();
+	}
+
+	/**
+	 * Give up ownership without releasing; the caller now holds the
+	 * reference.
+	 */
+	T* detach() {
+		T* r = p;
+		p = nullptr;
+		return r;
+	}
+
+	void swap(FZRef& o) {
+		T* t = p;
+		p = o.p;
+		o.p = t;
+	}
+
+	T* get() const { return p; }
+	T* operator->() const { return p; }
+	T& operator*() const { return *p; }
+	explicit operator bool() const { return p != nullptr; }
 };
 
+template<class T, class U>
+inline bool operator==(const FZRef<T>& a, const FZRef<U>& b) { return a.get() == b.get(); }
+template<class T, class U>
+inline bool operator!=(const FZRef<T>& a, const FZRef<U>& b) { return a.get() != b.get(); }
+
 #endif
 
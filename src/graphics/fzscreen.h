@@ -67,6 +67,16 @@
   #include <unistd.h>
 #elif defined(SWITCH)
   #include <switch.h>
+#elif defined(HEADLESS)
+  // the software vita2d in graphics/headless
+  #include <vita2d.h>
+
+  #include <malloc.h>
+  #include <stdarg.h>
+  #include <strings.h>
+  #include <sys/types.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
 #endif
 
 #include "fzfont.h"
@@ -349,6 +359,12 @@ public:
   static void drawTextureTintScaleRotate(const FZTexture *texture, float x, float y, float x_scale, float y_scale, float rad, unsigned int color);
 
   static void* framebuffer();
+#ifdef HEADLESS
+  /**
+   * Write the current framebuffer to a PNG file.
+   */
+  static bool dumpFrame(const char* path);
+#endif
 
   static void blendFunc(int op, int src, int dst);
   static void shadeModel(int mode);
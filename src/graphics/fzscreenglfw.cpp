@@ -43,6 +43,7 @@
 //#include fzscreencommon.
 #include "fzscreen.h"
 #include "fztexture.h"
+#include "fzinputtrace.h"
 #include "shaders/shader.h"
 
 using namespace std;
@@ -361,6 +362,8 @@ bool FZScreen::isClosing() {
 
 int FZScreen::readCtrl() {
     glfwWaitEvents();
+    int x = FZ_ANALOG_CENTER, y = FZ_ANALOG_CENTER;
+    FZInputTrace::sample(keyState, x, y);
     updateReps();
     return keyState;
 }
@@ -372,6 +375,7 @@ void FZScreen::getAnalogPad(int& x, int& y) {
 
 void FZScreen::swapBuffers() {
     glfwSwapBuffers(window);
+    FZInputTrace::frameShown();
 }
 
 void FZScreen::checkEvents(int buttons) {
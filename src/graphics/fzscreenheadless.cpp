@@ -0,0 +1,528 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Headless backend: vita2d is the software one in graphics/headless, so
+// every layer draws exactly as on the Vita into a 960x544 framebuffer in
+// main memory. Input comes from a script instead of a pad.
+//
+//   bookr-headless [--input script] [--frames n] [--fps n]
+//                  [--dump dir] [--draw-log file] [--data dir]
+//                  [--record trace] [--replay trace] [--latency file]
+//
+// A script line is "<frames> <buttons>": the buttons are held for that
+// many frames. Buttons are joined with '+', '-' holds nothing, and '#'
+// starts a comment:
+//
+//   # open the main menu, move down twice and pick the entry
+//   1  start
+//   5  -
+//   1  down
+//   1  -
+//   1  down
+//   1  cross
+//   30 -
+//
+// The app closes when the script runs out, or after --frames frames.
+//
+// --replay plays a trace written by FZInputTrace, e.g. on the Vita,
+// instead of the script and closes once it has been played; --record
+// writes the scripted input as such a trace. Either way the input to
+// frame latency of every button press goes to --latency, or stdout.
+
+#include "fzscreen.h"
+#include "fztexture.h"
+#include "fzinputtrace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <time.h>
+#include <png.h>
+
+static bool closing = false;
+
+FZScreen::FZScreen() {}
+FZScreen::~FZScreen() {}
+
+struct ScriptStep {
+  int frames;
+  int buttons;
+};
+
+static vector<ScriptStep> script;
+static unsigned int scriptStep = 0;
+static int stepFrame = 0;
+static int frameLimit = 0;
+static int frameCount = 0;
+static int framePeriodUs = 0;
+static struct timespec lastFrame = {0, 0};
+static string dumpDir;
+static FILE* drawLog = NULL;
+static string fullPath;
+static vita2d_pgf *pgf;
+static int currentSpeed = 0;
+static int lastAnalogX = FZ_ANALOG_CENTER;
+static int lastAnalogY = FZ_ANALOG_CENTER;
+static string recordPath;
+static string replayPath;
+static string latencyPath;
+
+static const struct {
+  const char* name;
+  int mask;
+} buttonNames[] = {
+  { "select", FZ_CTRL_SELECT }, { "start", FZ_CTRL_START },
+  { "up", FZ_CTRL_UP }, { "right", FZ_CTRL_RIGHT },
+  { "down", FZ_CTRL_DOWN }, { "left", FZ_CTRL_LEFT },
+  { "l", FZ_CTRL_LTRIGGER }, { "r", FZ_CTRL_RTRIGGER },
+  { "triangle", FZ_CTRL_TRIANGLE }, { "circle", FZ_CTRL_CIRCLE },
+  { "cross", FZ_CTRL_CROSS }, { "square", FZ_CTRL_SQUARE },
+  { "home", FZ_CTRL_HOME },
+};
+
+static int parseButtons(char* s, int line) {
+  if (strcmp(s, "-") == 0)
+    return 0;
+  int mask = 0;
+  for (char* name = strtok(s, "+"); name != NULL; name = strtok(NULL, "+")) {
+    unsigned int i = 0;
+    for (; i < sizeof(buttonNames) / sizeof(buttonNames[0]); ++i) {
+      if (strcasecmp(name, buttonNames[i].name) == 0)
+        break;
+    }
+    if (i == sizeof(buttonNames) / sizeof(buttonNames[0])) {
+      fprintf(stderr, "input script line %d: unknown button '%s'\n", line, name);
+      continue;
+    }
+    mask |= buttonNames[i].mask;
+  }
+  return mask;
+}
+
+static bool loadScript(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (f == NULL)
+    return false;
+  char buf[256];
+  int line = 0;
+  while (fgets(buf, sizeof(buf), f) != NULL) {
+    ++line;
+    char* hash = strchr(buf, '#');
+    if (hash != NULL)
+      *hash = 0;
+    int frames = 0;
+    char buttons[200];
+    int n = sscanf(buf, "%d %199s", &frames, buttons);
+    if (n <= 0)
+      continue;
+    if (n == 1 || frames <= 0) {
+      fprintf(stderr, "input script line %d: expected <frames> <buttons>\n", line);
+      continue;
+    }
+    ScriptStep step = { frames, parseButtons(buttons, line) };
+    script.push_back(step);
+  }
+  fclose(f);
+  return true;
+}
+
+int FZScreen::setupCallbacks(void) {
+  return 0;
+}
+
+void FZScreen::open(int argc, char** argv) {
+  char cwd[1024];
+  if (getcwd(cwd, sizeof(cwd)) != NULL)
+    fullPath = cwd;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (value == NULL) {
+      fprintf(stderr, "%s needs a value\n", arg);
+      break;
+    }
+    if (strcmp(arg, "--input") == 0) {
+      if (!loadScript(value))
+        fprintf(stderr, "cannot read input script %s\n", value);
+    } else if (strcmp(arg, "--frames") == 0) {
+      frameLimit = atoi(value);
+    } else if (strcmp(arg, "--fps") == 0) {
+      int fps = atoi(value);
+      framePeriodUs = fps > 0 ? 1000000 / fps : 0;
+    } else if (strcmp(arg, "--dump") == 0) {
+      dumpDir = value;
+      mkdir(value, 0755);
+    } else if (strcmp(arg, "--draw-log") == 0) {
+      drawLog = fopen(value, "w");
+      if (drawLog == NULL)
+        fprintf(stderr, "cannot write draw log %s\n", value);
+    } else if (strcmp(arg, "--data") == 0) {
+      char* resolved = realpath(value, NULL);
+      fullPath = resolved != NULL ? resolved : value;
+      free(resolved);
+    } else if (strcmp(arg, "--record") == 0) {
+      recordPath = value;
+    } else if (strcmp(arg, "--replay") == 0) {
+      replayPath = value;
+    } else if (strcmp(arg, "--latency") == 0) {
+      latencyPath = value;
+    } else {
+      fprintf(stderr, "unknown option %s\n", arg);
+      continue;
+    }
+    ++i;
+  }
+
+  const char* latency = latencyPath.empty() ? NULL : latencyPath.c_str();
+  if (!replayPath.empty() && !FZInputTrace::startReplay(replayPath.c_str(), latency))
+    fprintf(stderr, "cannot replay input trace %s\n", replayPath.c_str());
+  if (!recordPath.empty() && !FZInputTrace::startRecording(recordPath.c_str(), latency))
+    fprintf(stderr, "cannot record input trace %s\n", recordPath.c_str());
+
+  vita2d_init();
+  vita2d_set_clear_color(RGBA8(0, 0, 0, 255));
+  vita2d_soft_set_draw_log(drawLog);
+
+  pgf = vita2d_load_default_pgf();
+}
+
+void FZScreen::close() {
+  vita2d_free_pgf(pgf);
+  vita2d_fini();
+  vita2d_soft_set_draw_log(NULL);
+  if (drawLog != NULL)
+    fclose(drawLog);
+  drawLog = NULL;
+}
+
+void FZScreen::exit() {
+  closing = true;
+}
+
+void FZScreen::drawText(int x, int y, unsigned int color, float scale, const char *text) {
+  vita2d_pgf_draw_text(pgf, x, y, color, scale, text);
+}
+
+void FZScreen::drawFontTextf(FZFont *font, int x, int y, unsigned int color, unsigned int size, const char *text, ...) {
+  char buf[1024];
+  va_list ap;
+  va_start(ap, text);
+  vsnprintf(buf, sizeof(buf), text, ap);
+  va_end(ap);
+  vita2d_font_draw_text(font->v_font, x, y, color, size, buf);
+}
+
+void FZScreen::setTextSize(float x, float y) {
+
+}
+
+static bool stickyKeys = false;
+
+static int breps[16];
+static void updateReps(int keyState) {
+  if (stickyKeys && keyState == 0) {
+    stickyKeys = false;
+  }
+  if (stickyKeys) {
+    memset((void*)breps, 0, sizeof(int)*16);
+    return;
+  }
+  if (keyState & FZ_CTRL_SELECT  ) breps[FZ_REPS_SELECT  ]++; else breps[FZ_REPS_SELECT  ] = 0;
+  if (keyState & FZ_CTRL_START   ) breps[FZ_REPS_START   ]++; else breps[FZ_REPS_START   ] = 0;
+  if (keyState & FZ_CTRL_UP      ) breps[FZ_REPS_UP      ]++; else breps[FZ_REPS_UP      ] = 0;
+  if (keyState & FZ_CTRL_RIGHT   ) breps[FZ_REPS_RIGHT   ]++; else breps[FZ_REPS_RIGHT   ] = 0;
+  if (keyState & FZ_CTRL_DOWN    ) breps[FZ_REPS_DOWN    ]++; else breps[FZ_REPS_DOWN    ] = 0;
+  if (keyState & FZ_CTRL_LEFT    ) breps[FZ_REPS_LEFT    ]++; else breps[FZ_REPS_LEFT    ] = 0;
+  if (keyState & FZ_CTRL_LTRIGGER) breps[FZ_REPS_LTRIGGER]++; else breps[FZ_REPS_LTRIGGER] = 0;
+  if (keyState & FZ_CTRL_RTRIGGER) breps[FZ_REPS_RTRIGGER]++; else breps[FZ_REPS_RTRIGGER] = 0;
+  if (keyState & FZ_CTRL_TRIANGLE) breps[FZ_REPS_TRIANGLE]++; else breps[FZ_REPS_TRIANGLE] = 0;
+  if (keyState & FZ_CTRL_CIRCLE  ) breps[FZ_REPS_CIRCLE  ]++; else breps[FZ_REPS_CIRCLE  ] = 0;
+  if (keyState & FZ_CTRL_CROSS   ) breps[FZ_REPS_CROSS   ]++; else breps[FZ_REPS_CROSS   ] = 0;
+  if (keyState & FZ_CTRL_SQUARE  ) breps[FZ_REPS_SQUARE  ]++; else breps[FZ_REPS_SQUARE  ] = 0;
+  if (keyState & FZ_CTRL_HOME    ) breps[FZ_REPS_HOME    ]++; else breps[FZ_REPS_HOME    ] = 0;
+  if (keyState & FZ_CTRL_HOLD    ) breps[FZ_REPS_HOLD    ]++; else breps[FZ_REPS_HOLD    ] = 0;
+  if (keyState & FZ_CTRL_NOTE    ) breps[FZ_REPS_NOTE    ]++; else breps[FZ_REPS_NOTE    ] = 0;
+}
+
+
+void FZScreen::resetReps() {
+  stickyKeys = true;
+}
+
+int* FZScreen::ctrlReps() {
+  return breps;
+}
+
+void FZScreen::setupCtrl() {
+  resetReps();
+}
+
+// with --fps, hold each frame until its period is over
+static void paceFrame() {
+  if (framePeriodUs == 0)
+    return;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long elapsedUs = (now.tv_sec - lastFrame.tv_sec) * 1000000L + (now.tv_nsec - lastFrame.tv_nsec) / 1000;
+  if (lastFrame.tv_sec != 0 && elapsedUs < framePeriodUs)
+    usleep(framePeriodUs - elapsedUs);
+  clock_gettime(CLOCK_MONOTONIC, &lastFrame);
+}
+
+int FZScreen::readCtrl() {
+  paceFrame();
+  ++frameCount;
+  if (frameLimit > 0 && frameCount > frameLimit)
+    closing = true;
+
+  int buttons = 0;
+  if (scriptStep < script.size()) {
+    buttons = script[scriptStep].buttons;
+    if (++stepFrame >= script[scriptStep].frames) {
+      ++scriptStep;
+      stepFrame = 0;
+    }
+  } else if (frameLimit == 0 && !FZInputTrace::isReplaying()) {
+    closing = true;
+  }
+  lastAnalogX = FZ_ANALOG_CENTER;
+  lastAnalogY = FZ_ANALOG_CENTER;
+  FZInputTrace::sample(buttons, lastAnalogX, lastAnalogY);
+  if (FZInputTrace::isReplayFinished())
+    closing = true;
+  updateReps(buttons);
+  return buttons;
+}
+
+void FZScreen::getAnalogPad(int& x, int& y) {
+  x = lastAnalogX - FZ_ANALOG_CENTER;
+  y = lastAnalogY - FZ_ANALOG_CENTER;
+}
+
+void FZScreen::startDirectList() {
+  vita2d_start_drawing();
+}
+
+void FZScreen::endAndDisplayList() {
+  vita2d_end_drawing();
+}
+
+bool FZScreen::dumpFrame(const char* path) {
+  FILE* f = fopen(path, "wb");
+  if (f == NULL)
+    return false;
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info = png != NULL ? png_create_info_struct(png) : NULL;
+  if (info == NULL || setjmp(png_jmpbuf(png))) {
+    png_destroy_write_struct(&png, info != NULL ? &info : (png_infopp)NULL);
+    fclose(f);
+    return false;
+  }
+  png_init_io(png, f);
+  png_set_IHDR(png, info, FZ_SCREEN_WIDTH, FZ_SCREEN_HEIGHT, 8, PNG_COLOR_TYPE_RGB,
+    PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png, info);
+  // the screen is opaque, the alpha byte of each pixel is dropped
+  png_set_filler(png, 0, PNG_FILLER_AFTER);
+  png_bytep row = (png_bytep)vita2d_get_current_fb();
+  for (int y = 0; y < FZ_SCREEN_HEIGHT; ++y, row += FZ_SCREEN_WIDTH * 4)
+    png_write_row(png, row);
+  png_write_end(png, NULL);
+  png_destroy_write_struct(&png, &info);
+  return fclose(f) == 0;
+}
+
+void FZScreen::swapBuffers() {
+  if (dumpDir.size() > 0) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/frame-%05d.png", dumpDir.c_str(), vita2d_soft_frame_count());
+    if (!dumpFrame(path))
+      fprintf(stderr, "cannot write %s\n", path);
+  }
+  vita2d_swap_buffers();
+  FZInputTrace::frameShown();
+}
+
+void FZScreen::waitVblankStart() {
+}
+
+void* FZScreen::getListMemory(int s) {
+  return 0;
+}
+
+void FZScreen::shadeModel(int mode) {
+}
+
+void FZScreen::color(unsigned int c) {
+}
+
+void FZScreen::ambientColor(unsigned int c) {
+}
+
+void FZScreen::clear(unsigned int color, int b) {
+  vita2d_set_clear_color(color);
+  vita2d_clear_screen();
+}
+
+void FZScreen::checkEvents(int buttons) {
+}
+
+void FZScreen::matricesFor2D(int rotation) {
+}
+
+static FZTexture* boundTexture = 0;
+void FZScreen::setBoundTexture(FZTexture *t) {
+  boundTexture = t;
+}
+
+void FZScreen::drawRectangle(float x, float y, float w, float h, unsigned int color) {
+  vita2d_draw_rectangle(x, y, w, h, color);
+}
+
+void FZScreen::drawFontText(FZFont *font, int x, int y, unsigned int color, unsigned int size, const char *text) {
+  vita2d_font_draw_text(font->v_font, x, y, color, size, text);
+}
+
+void FZScreen::drawTextureScale(const FZTexture *texture, float x, float y, float x_scale, float y_scale) {
+  vita2d_draw_texture_scale(texture->vita_texture, x, y, x_scale, y_scale);
+}
+
+void FZScreen::drawTextureTintScale(const FZTexture *texture, float x, float y, float x_scale, float y_scale, unsigned int color) {
+  vita2d_draw_texture_tint_scale(texture->vita_texture, x, y, x_scale, y_scale, color);
+}
+
+void FZScreen::drawTextureTintScaleRotate(const FZTexture *texture, float x, float y, float x_scale, float y_scale, float rad, unsigned int color) {
+  vita2d_draw_texture_tint_scale_rotate(texture->vita_texture, x, y, x_scale, y_scale, rad, color);
+}
+
+void FZScreen::drawArray(int prim, int vtype, int count, void* indices, void* vertices) {
+}
+
+void FZScreen::copyImage(int psm, int sx, int sy, int width, int height, int srcw, void *src,
+    int dx, int dy, int destw, void *dest) {
+}
+
+void FZScreen::drawPixel(float x, float y, unsigned int color) {
+  vita2d_draw_pixel(x, y, color);
+}
+
+void* FZScreen::framebuffer() {
+  return vita2d_get_current_fb();
+}
+
+void FZScreen::blendFunc(int op, int src, int dst) {
+}
+
+void FZScreen::enable(int m) {
+}
+
+void FZScreen::disable(int m) {
+}
+
+void FZScreen::dcacheWritebackAll() {
+}
+
+string FZScreen::basePath() {
+  return fullPath;
+}
+
+struct CompareDirent {
+  bool operator()(const FZDirent& a, const FZDirent& b) {
+      if ((a.stat & FZ_STAT_IFDIR) == (b.stat & FZ_STAT_IFDIR))
+          return a.name < b.name;
+      if (b.stat & FZ_STAT_IFDIR)
+          return false;
+      return true;
+  }
+};
+
+int FZScreen::dirContents(const char* path, vector<FZDirent>& a) {
+  DIR* dir = opendir(path);
+  if (dir == NULL)
+    return -1;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.')
+      continue;
+    string full = string(path) + "/" + entry->d_name;
+    struct stat st;
+    if (stat(full.c_str(), &st) != 0)
+      continue;
+    // the layers test the Vita mode bits
+    int mode = S_ISDIR(st.st_mode) ? FZ_STAT_IFDIR : S_ISREG(st.st_mode) ? FZ_STAT_IFREG : 0;
+    a.push_back(FZDirent(entry->d_name, mode, (int)st.st_size));
+  }
+  closedir(dir);
+  sort(a.begin(), a.end(), CompareDirent());
+  return 1;
+}
+
+int FZScreen::getSuspendSerial() {
+  return 0;
+}
+
+void FZScreen::setSpeed(int v) {
+  if (v <= 0 || v > 6)
+      return;
+  currentSpeed = speedValues[v*2];
+}
+
+int FZScreen::getSpeed() {
+  return currentSpeed;
+}
+
+void FZScreen::getTime(int &h, int &m) {
+  time_t now = time(NULL);
+  struct tm local;
+  if (localtime_r(&now, &local) != NULL) {
+    h = local.tm_hour;
+    m = local.tm_min;
+  }
+}
+
+int FZScreen::getBattery() {
+  return 100;
+}
+
+int FZScreen::getUsedMemory() {
+  #if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 mi = mallinfo2();
+  #else
+    struct mallinfo mi = mallinfo();
+  #endif
+  return (int)mi.uordblks;
+}
+
+void FZScreen::setBrightness(int b){
+  return;
+}
+
+bool FZScreen::isClosing() {
+  return closing;
+}
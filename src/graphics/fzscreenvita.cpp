@@ -28,6 +28,7 @@
 
 #include "fzscreen.h"
 #include "fztexture.h"
+#include "fzinputtrace.h"
 
 static bool closing = false;
 
@@ -142,6 +143,7 @@ static void initalDraw() {
 
     vita2d_end_drawing();
     vita2d_swap_buffers();
+    FZInputTrace::frameShown();
 }
 
 // Move this to constructor?
@@ -229,10 +231,13 @@ static volatile int lastAnalogY = 0;
 int FZScreen::readCtrl() {
   SceCtrlData pad;
   sceCtrlPeekBufferPositive(0, &pad, 1);
-  updateReps(pad.buttons);
-  lastAnalogX = pad.lx;
-  lastAnalogY = pad.ly;
-  return pad.buttons;
+  int buttons = pad.buttons;
+  int x = pad.lx, y = pad.ly;
+  FZInputTrace::sample(buttons, x, y);
+  updateReps(buttons);
+  lastAnalogX = x;
+  lastAnalogY = y;
+  return buttons;
 }
 
 void FZScreen::getAnalogPad(int& x, int& y) {
@@ -261,6 +266,7 @@ void FZScreen::swapBuffers() {
     printf("FZScreen::swapBuffers\n");
   #endif
     vita2d_swap_buffers();
+    FZInputTrace::frameShown();
 }
 
 void FZScreen::waitVblankStart() {
@@ -36,7 +36,7 @@
 #elif defined(__vita__)
   #include <psp2/display.h>
   #include <vita2d.h>
-#elif defined(SWITCH)
+#elif defined(SWITCH) || defined(HEADLESS)
 #else
   #include <stdio.h>
   #define GLEW_STATIC
@@ -50,9 +50,14 @@
 
 #include "fztexture.h"
 #include "fzscreen.h"
+#include "fzprofiler.h"
+#include "fzmemory.h"
 
-#if defined(PSP) || defined(__vita__) || defined(SWITCH)
-  FZTexture::FZTexture() : texImage(0) {
+#if defined(PSP) || defined(__vita__) || defined(SWITCH) || defined(HEADLESS)
+  FZTexture::FZTexture() : swizzled(false) {
+    #if defined(__vita__) || defined(HEADLESS)
+      vita_texture = NULL;
+    #endif
   }
 
   FZTexture::~FZTexture() {
@@ -60,8 +65,9 @@
         printf("~FZTexture\n");
       #endif
 
-    #ifdef __vita__
+    #if defined(__vita__) || defined(HEADLESS)
     if (vita_texture != NULL) {
+        FZMemory::sub(FZ_MEM_TEXTURE, getVitaTextureSize(vita_texture));
         vita2d_free_texture(vita_texture);
         // vita_texture = NULL;
     }
@@ -85,7 +91,7 @@
       }
       sceGuTexFunc(texenv, pixelComponent);
       //sceGuTexFunc(GU_TFX_MODULATE, GU_TCC_RGBA);
-      sceGuTexMode(pixelFormat, 0, 0, GU_TRUE);
+      sceGuTexMode(pixelFormat, 0, 0, swizzled ? GU_TRUE : GU_FALSE);
       //sceGuTexMode(pixelFormat, 0, 0, GU_FALSE);
       sceGuTexImage(0, width, height, width, texImage->getData());
       sceGuTexScale(1.0f, 1.0f);
@@ -99,7 +105,7 @@
   }
 
 #else
-    FZTexture::FZTexture() : texImage(0) {
+    FZTexture::FZTexture() : swizzled(false) {
         glGenTextures(1, &textureObject);
     }
 
@@ -163,7 +169,7 @@ static bool validatePow2(unsigned int x, unsigned int maxPow) {
         }
         return true;
     }
-#elif __vita__ || defined(SWITCH)
+#elif __vita__ || defined(SWITCH) || defined(HEADLESS)
     bool FZTexture::validateFormat(FZImage* image) {
         FZImage::Format imageFormat = image->getFormat();
         return true;
@@ -216,21 +222,36 @@ FZTexture* FZTexture::createFromImage(FZImage* image, bool buildMipmaps) {
     return texture;
 }
 
-#ifdef __vita__
+#if defined(__vita__) || defined(HEADLESS)
   FZTexture* FZTexture::createFromVitaTexture(vita2d_texture* v_texture) {
       #ifdef DEBUG
         printf("create from vita\n");
       #endif
       FZTexture* texture = new FZTexture();
       texture->vita_texture = v_texture;
+      if (v_texture != NULL)
+        FZMemory::add(FZ_MEM_TEXTURE, getVitaTextureSize(v_texture));
       //psp2shell_print("%p\n", (void *) &(texture->vita_texture));
       return texture;
   }
 
   FZTexture* FZTexture::createFromBuffer(const void * buffer) {
-    FZTexture* texture = new FZTexture();
-    texture->vita_texture = vita2d_load_PNG_buffer(buffer);
-    return texture;
+    return createFromVitaTexture(vita2d_load_PNG_buffer(buffer));
+  }
+
+  size_t FZTexture::getVitaTextureSize(vita2d_texture* texture) {
+    // the stride of a swizzled texture no longer describes its memory
+    if (isVitaTextureTiled(texture))
+      return FZImage::getTiledSize(vita2d_texture_get_width(texture), vita2d_texture_get_height(texture), 4);
+    return (size_t)vita2d_texture_get_stride(texture) * vita2d_texture_get_height(texture);
+  }
+
+  bool FZTexture::isVitaTextureTiled(vita2d_texture* texture) {
+    #ifdef __vita__
+      return sceGxmTextureGetType(&texture->gxm_tex) == SCE_GXM_TEXTURE_SWIZZLED;
+    #else
+      return vita2d_soft_is_tiled(texture) != 0;
+    #endif
   }
 #elif defined(SWITCH)
   FZTexture* FZTexture::createFromBuffer(const void * buffer) {
@@ -248,7 +269,7 @@ FZTexture* FZTexture::createFromImage(FZImage* image, bool buildMipmaps) {
       FZImage* image = FZImage::createWithData(width, height, soil_image);
 
       FZTexture* texture = new FZTexture();
-      texture->texImage = image;
+      texture->texImage.reset(image);
 
     
       glBindTexture(GL_TEXTURE_2D, texture->textureObject);
@@ -266,6 +287,7 @@ FZTexture* FZTexture::createFromImage(FZImage* image, bool buildMipmaps) {
 #endif
     
 bool FZTexture::initFromImage(FZTexture* texture, FZImage* image, bool buildMipmaps) {
+    FZ_PROFILE(FZ_PROFILE_TEXTURE_UPLOAD);
 
     unsigned int width = 0, height = 0;
 
@@ -287,18 +309,21 @@ bool FZTexture::initFromImage(FZTexture* texture, FZImage* image, bool buildMipm
     }
 
     void* data = image->getData();
-    FZImage* buffer = 0;
+    FZRef<FZImage> buffer;
     if (image->getFormat() == FZImage::rgb32) { 
-        buffer = FZImage::createRGB24FromRGB32(image);
+        buffer.reset(FZImage::createRGB24FromRGB32(image));
         data = buffer->getData();
     }
 
 
-  #if defined(PSP) || defined(__vita__)
-    image->retain();
-    // BUG: swizzle is not working above 8bpp
-    image->swizzle(16, 8);	// swizzle is always 16x8 bytes
-    texture->texImage = image;
+  #if defined(PSP)
+    // the GE samples swizzled textures faster; images narrower than a
+    // 16 byte block stay linear
+    texture->swizzled = image->swizzle(16, 8);	// swizzle is always 16x8 bytes
+    texture->texImage = FZRef<FZImage>::retain(image);
+  #elif defined(__vita__) || defined(HEADLESS)
+    // vita2d draws from vita_texture; texImage is only kept for reference
+    texture->texImage = FZRef<FZImage>::retain(image);
   #elif defined(OLD)
     texture->bind();
     glEnable(GL_TEXTURE_2D);
@@ -323,15 +348,11 @@ bool FZTexture::initFromImage(FZTexture* texture, FZImage* image, bool buildMipm
     }
   #endif
 
-    if (buffer != 0) {
-        buffer->release();
-    }
-
     return true;
 }
 
 void FZTexture::texEnv(int op) {
-  #if defined(PSP) || defined(__vita__) || defined(SWITCH)
+  #if defined(PSP) || defined(__vita__) || defined(SWITCH) || defined(HEADLESS)
     texenv = op;
   #else
     texenv = GL_REPLACE;
@@ -345,7 +366,7 @@ void FZTexture::texEnv(int op) {
 }
 
 void FZTexture::filter(int min, int mag) {
-  #if defined(PSP) || defined(__vita__) || defined(SWITCH)
+  #if defined(PSP) || defined(__vita__) || defined(SWITCH) || defined(HEADLESS)
     texMin = min;
     texMag = mag;
   #else
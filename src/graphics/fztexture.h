@@ -32,7 +32,7 @@
 
 #ifdef MAC
 	#include <SOIL.h>
-#elif __vita__
+#elif defined(__vita__) || defined(HEADLESS)
 	#include <vita2d.h>
 #endif
 
@@ -62,7 +62,8 @@ class FZTexture : public FZRefCounted {
 	// psp
 	unsigned int pixelFormat;
 	unsigned int pixelComponent;
-	FZImage* texImage;
+	FZRef<FZImage> texImage;
+	bool swizzled;
 	//void* imageData;
 	//void* clutData;
 
@@ -81,7 +82,7 @@ protected:
 public:
 	// vita
 	// refactor to fzimage with void*
-#ifdef __vita__
+#if defined(__vita__) || defined(HEADLESS)
 		vita2d_texture* vita_texture;
 #endif
 	unsigned char*  soil_data;
@@ -114,8 +115,13 @@ public:
 	static FZTexture* createFromImage(FZImage* image, bool buildMipmaps);
 
 	//refactor
-	#ifdef __vita__
+	#if defined(__vita__) || defined(HEADLESS)
+		// takes ownership of texture
 		static FZTexture* createFromVitaTexture(vita2d_texture * texture);
+		// bytes of texture memory, as counted under FZ_MEM_TEXTURE
+		static size_t getVitaTextureSize(vita2d_texture * texture);
+		// set when the GXM texture samples the swizzled layout
+		static bool isVitaTextureTiled(vita2d_texture * texture);
 	#endif
 
 	static FZTexture* createFromBuffer(const void * buffer);
@@ -0,0 +1,108 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HEADLESS_VITA2D_H
+#define HEADLESS_VITA2D_H
+
+#include <stdio.h>
+
+/*! \brief Software stand-in for the part of vita2d that Bookr uses.
+ *
+ *  The headless build puts this directory on the include path, so code
+ *  written against vita2d compiles unchanged and draws into a 960x544
+ *  RGBA8 framebuffer in main memory. Pixels use the vita2d layout:
+ *  RGBA8() packs red in the low byte, so the buffer reads as R, G, B, A.
+ *
+ *  Textures are sampled nearest, blending is source over, and text is
+ *  drawn with FreeType. Every draw call can also be written as one line
+ *  of text to a log, which is easier to diff than pixels.
+ */
+
+#define RGBA8(r, g, b, a) ((((a)&0xFF)<<24) | (((b)&0xFF)<<16) | (((g)&0xFF)<<8) | (((r)&0xFF)<<0))
+
+#define VITA2D_SOFT_WIDTH  960
+#define VITA2D_SOFT_HEIGHT 544
+
+typedef struct vita2d_texture vita2d_texture;
+typedef struct vita2d_font vita2d_font;
+typedef struct vita2d_pgf vita2d_pgf;
+
+int vita2d_init();
+int vita2d_fini();
+
+void vita2d_start_drawing();
+void vita2d_end_drawing();
+void vita2d_swap_buffers();
+void vita2d_wait_rendering_done();
+void vita2d_set_clear_color(unsigned int color);
+void vita2d_clear_screen();
+void* vita2d_get_current_fb();
+
+void vita2d_draw_pixel(float x, float y, unsigned int color);
+void vita2d_draw_rectangle(float x, float y, float w, float h, unsigned int color);
+
+vita2d_texture* vita2d_create_empty_texture(unsigned int w, unsigned int h);
+vita2d_texture* vita2d_load_PNG_buffer(const void* buffer);
+void vita2d_free_texture(vita2d_texture* texture);
+unsigned int vita2d_texture_get_width(const vita2d_texture* texture);
+unsigned int vita2d_texture_get_height(const vita2d_texture* texture);
+// bytes per row
+unsigned int vita2d_texture_get_stride(const vita2d_texture* texture);
+void* vita2d_texture_get_datap(const vita2d_texture* texture);
+
+void vita2d_draw_texture(const vita2d_texture* texture, float x, float y);
+void vita2d_draw_texture_scale(const vita2d_texture* texture, float x, float y, float x_scale, float y_scale);
+void vita2d_draw_texture_tint_scale(const vita2d_texture* texture, float x, float y, float x_scale, float y_scale, unsigned int color);
+// x, y is the centre of the rotated texture, as in vita2d
+void vita2d_draw_texture_tint_scale_rotate(const vita2d_texture* texture, float x, float y, float x_scale, float y_scale, float rad, unsigned int color);
+
+// y is the baseline of the text
+vita2d_font* vita2d_load_font_mem(const void* buffer, unsigned int size);
+vita2d_font* vita2d_load_font_file(const char* filename);
+void vita2d_free_font(vita2d_font* font);
+int vita2d_font_draw_text(vita2d_font* font, int x, int y, unsigned int color, unsigned int size, const char* text);
+int vita2d_font_draw_textf(vita2d_font* font, int x, int y, unsigned int color, unsigned int size, const char* text, ...);
+int vita2d_font_text_width(vita2d_font* font, unsigned int size, const char* text);
+int vita2d_font_text_height(vita2d_font* font, unsigned int size, const char* text);
+
+// there is no system font; the PGF calls draw with the built in UI font
+vita2d_pgf* vita2d_load_default_pgf();
+void vita2d_free_pgf(vita2d_pgf* font);
+int vita2d_pgf_draw_text(vita2d_pgf* font, int x, int y, unsigned int color, float scale, const char* text);
+int vita2d_pgf_draw_textf(vita2d_pgf* font, int x, int y, unsigned int color, float scale, const char* text, ...);
+
+// headless only: one line per draw call goes to log, NULL turns it off
+void vita2d_soft_set_draw_log(FILE* log);
+// frames presented with vita2d_swap_buffers so far
+int vita2d_soft_frame_count();
+// headless only: stands in for sceGxmTextureInitSwizzled() on a texture
+// whose data holds the w by h image padded to the tiled size
+void vita2d_soft_set_tiled(vita2d_texture* texture, unsigned int w, unsigned int h);
+int vita2d_soft_is_tiled(const vita2d_texture* texture);
+
+#endif
@@ -0,0 +1,568 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vita2d.h>
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "../fzimage.h"
+#include "../fzinstreammem.h"
+
+using namespace std;
+
+// vita2d pads texture rows to 8 pixels, kept so sizes match the Vita
+#define SOFT_TEXTURE_ALIGN 8
+// pixel size of the stand-in PGF font at scale 1.0
+#define SOFT_PGF_SIZE 18
+// no embedded PNG is anywhere near this, it only stops a runaway walk
+#define SOFT_PNG_MAX_BYTES (64 * 1024 * 1024)
+
+struct vita2d_texture {
+  unsigned int w, h;
+  unsigned int stride;
+  unsigned int* data;
+  // set for pixels in the GXM swizzled order: the index of u, v is
+  // tiledX[u] | tiledY[v], see FZImage::getTiledIndex()
+  unsigned int* tiledX;
+  unsigned int* tiledY;
+};
+
+struct vita2d_font {
+  FT_Face face;
+  // set when the font was read from a file and the face points into it
+  unsigned char* fileData;
+};
+
+struct vita2d_pgf {
+  vita2d_font* font;
+};
+
+extern "C" {
+  extern unsigned char res_uifont[];
+  extern unsigned int size_res_uifont;
+};
+
+static unsigned int* framebuffer = NULL;
+static unsigned int clearColor = RGBA8(0, 0, 0, 255);
+static FT_Library ftlib = NULL;
+static FILE* drawLog = NULL;
+static int frames = 0;
+
+static void logCall(const char* fmt, ...) {
+  if (drawLog == NULL)
+    return;
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(drawLog, fmt, ap);
+  va_end(ap);
+  fputc('\n', drawLog);
+}
+
+// source over, the blend vita2d sets up
+static inline void blendPixel(unsigned int* dst, unsigned int src) {
+  unsigned int a = src >> 24;
+  if (a == 0)
+    return;
+  if (a == 255) {
+    *dst = src;
+    return;
+  }
+  unsigned int d = *dst;
+  unsigned int ia = 255 - a;
+  unsigned int r = ((src & 0xff) * a + (d & 0xff) * ia) / 255;
+  unsigned int g = (((src >> 8) & 0xff) * a + ((d >> 8) & 0xff) * ia) / 255;
+  unsigned int b = (((src >> 16) & 0xff) * a + ((d >> 16) & 0xff) * ia) / 255;
+  unsigned int da = a + ((d >> 24) * ia) / 255;
+  *dst = (da << 24) | (b << 16) | (g << 8) | r;
+}
+
+static inline unsigned int modulate(unsigned int c, unsigned int tint) {
+  unsigned int r = (c & 0xff) * (tint & 0xff) / 255;
+  unsigned int g = ((c >> 8) & 0xff) * ((tint >> 8) & 0xff) / 255;
+  unsigned int b = ((c >> 16) & 0xff) * ((tint >> 16) & 0xff) / 255;
+  unsigned int a = (c >> 24) * (tint >> 24) / 255;
+  return (a << 24) | (b << 16) | (g << 8) | r;
+}
+
+// first pixel whose centre is at or right of v, as the GPU rasterises
+static inline int pixelStart(float v) {
+  return (int)ceilf(v - 0.5f);
+}
+
+int vita2d_init() {
+  if (framebuffer == NULL)
+    framebuffer = (unsigned int*)malloc(VITA2D_SOFT_WIDTH * VITA2D_SOFT_HEIGHT * sizeof(unsigned int));
+  if (framebuffer == NULL)
+    return 0;
+  if (ftlib == NULL && FT_Init_FreeType(&ftlib) != 0)
+    ftlib = NULL;
+  vita2d_clear_screen();
+  return 1;
+}
+
+int vita2d_fini() {
+  free(framebuffer);
+  framebuffer = NULL;
+  if (ftlib != NULL)
+    FT_Done_FreeType(ftlib);
+  ftlib = NULL;
+  return 1;
+}
+
+void vita2d_start_drawing() {
+}
+
+void vita2d_end_drawing() {
+}
+
+void vita2d_swap_buffers() {
+  logCall("swap %d", frames);
+  ++frames;
+}
+
+void vita2d_wait_rendering_done() {
+}
+
+void vita2d_set_clear_color(unsigned int color) {
+  clearColor = color;
+}
+
+void vita2d_clear_screen() {
+  logCall("clear 0x%08x", clearColor);
+  for (int i = 0; i < VITA2D_SOFT_WIDTH * VITA2D_SOFT_HEIGHT; ++i)
+    framebuffer[i] = clearColor;
+}
+
+void* vita2d_get_current_fb() {
+  return framebuffer;
+}
+
+void vita2d_draw_pixel(float x, float y, unsigned int color) {
+  logCall("pixel %.1f %.1f 0x%08x", x, y, color);
+  int px = (int)x;
+  int py = (int)y;
+  if (px < 0 || py < 0 || px >= VITA2D_SOFT_WIDTH || py >= VITA2D_SOFT_HEIGHT)
+    return;
+  blendPixel(&framebuffer[py * VITA2D_SOFT_WIDTH + px], color);
+}
+
+void vita2d_draw_rectangle(float x, float y, float w, float h, unsigned int color) {
+  logCall("rect %.1f %.1f %.1f %.1f 0x%08x", x, y, w, h, color);
+  int x0 = pixelStart(x), x1 = pixelStart(x + w);
+  int y0 = pixelStart(y), y1 = pixelStart(y + h);
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+  if (x1 > VITA2D_SOFT_WIDTH) x1 = VITA2D_SOFT_WIDTH;
+  if (y1 > VITA2D_SOFT_HEIGHT) y1 = VITA2D_SOFT_HEIGHT;
+  for (int j = y0; j < y1; ++j) {
+    unsigned int* row = &framebuffer[j * VITA2D_SOFT_WIDTH];
+    for (int i = x0; i < x1; ++i)
+      blendPixel(&row[i], color);
+  }
+}
+
+vita2d_texture* vita2d_create_empty_texture(unsigned int w, unsigned int h) {
+  if (w == 0 || h == 0)
+    return NULL;
+  vita2d_texture* texture = (vita2d_texture*)malloc(sizeof(vita2d_texture));
+  if (texture == NULL)
+    return NULL;
+  unsigned int aligned = (w + SOFT_TEXTURE_ALIGN - 1) & ~(SOFT_TEXTURE_ALIGN - 1);
+  texture->w = w;
+  texture->h = h;
+  texture->stride = aligned * sizeof(unsigned int);
+  texture->tiledX = NULL;
+  texture->tiledY = NULL;
+  texture->data = (unsigned int*)calloc((size_t)aligned * h, sizeof(unsigned int));
+  if (texture->data == NULL) {
+    free(texture);
+    return NULL;
+  }
+  return texture;
+}
+
+// The vita2d call takes no size, so walk the chunks up to IEND.
+static unsigned int pngLength(const unsigned char* p) {
+  static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  if (memcmp(p, signature, 8) != 0)
+    return 0;
+  unsigned int pos = 8;
+  while (pos < SOFT_PNG_MAX_BYTES) {
+    unsigned int len = (p[pos] << 24) | (p[pos + 1] << 16) | (p[pos + 2] << 8) | p[pos + 3];
+    bool end = memcmp(p + pos + 4, "IEND", 4) == 0;
+    // length, type and CRC around the data
+    pos += 12 + len;
+    if (end)
+      return pos;
+  }
+  return 0;
+}
+
+vita2d_texture* vita2d_load_PNG_buffer(const void* buffer) {
+  unsigned int length = pngLength((const unsigned char*)buffer);
+  if (length == 0)
+    return NULL;
+
+  FZInputStreamMem* in = FZInputStreamMem::create((char*)buffer, length);
+  FZImage* image = FZImage::createFromPNG(in, true);
+  in->release();
+  if (image == NULL)
+    return NULL;
+
+  unsigned int w, h;
+  image->getDimensions(w, h);
+  vita2d_texture* texture = vita2d_create_empty_texture(w, h);
+  if (texture == NULL) {
+    image->release();
+    return NULL;
+  }
+
+  FZImage::Format format = image->getFormat();
+  unsigned int bpp = image->getBytesPerPixel();
+  const unsigned char* src = (const unsigned char*)image->getData();
+  for (unsigned int j = 0; j < h; ++j) {
+    unsigned int* dst = (unsigned int*)((char*)texture->data + j * texture->stride);
+    for (unsigned int i = 0; i < w; ++i, src += bpp) {
+      switch (format) {
+        case FZImage::rgba32: dst[i] = RGBA8(src[0], src[1], src[2], src[3]); break;
+        case FZImage::rgb24:  dst[i] = RGBA8(src[0], src[1], src[2], 255); break;
+        case FZImage::dual16: dst[i] = RGBA8(src[0], src[0], src[0], src[1]); break;
+        default:              dst[i] = RGBA8(src[0], src[0], src[0], 255); break;
+      }
+    }
+  }
+  image->release();
+  return texture;
+}
+
+void vita2d_free_texture(vita2d_texture* texture) {
+  if (texture == NULL)
+    return;
+  free(texture->tiledX);
+  free(texture->tiledY);
+  free(texture->data);
+  free(texture);
+}
+
+unsigned int vita2d_texture_get_width(const vita2d_texture* texture) {
+  return texture->w;
+}
+
+unsigned int vita2d_texture_get_height(const vita2d_texture* texture) {
+  return texture->h;
+}
+
+unsigned int vita2d_texture_get_stride(const vita2d_texture* texture) {
+  return texture->stride;
+}
+
+void* vita2d_texture_get_datap(const vita2d_texture* texture) {
+  return texture->data;
+}
+
+void vita2d_soft_set_tiled(vita2d_texture* texture, unsigned int w, unsigned int h) {
+  unsigned int aligned = (w + SOFT_TEXTURE_ALIGN - 1) & ~(SOFT_TEXTURE_ALIGN - 1);
+  texture->w = w;
+  texture->h = h;
+  // what vita2d reports once the GXM texture is swizzled
+  texture->stride = aligned * sizeof(unsigned int);
+  free(texture->tiledX);
+  free(texture->tiledY);
+  texture->tiledX = (unsigned int*)malloc(w * sizeof(unsigned int));
+  texture->tiledY = (unsigned int*)malloc(h * sizeof(unsigned int));
+  for (unsigned int i = 0; i < w; ++i)
+    texture->tiledX[i] = FZImage::getTiledIndex(i, 0, w, h);
+  for (unsigned int j = 0; j < h; ++j)
+    texture->tiledY[j] = FZImage::getTiledIndex(0, j, w, h);
+}
+
+int vita2d_soft_is_tiled(const vita2d_texture* texture) {
+  return texture->tiledX != NULL;
+}
+
+// Every texture draw ends up here: each screen pixel in the bounding box
+// is mapped back into the texture and sampled nearest.
+static void drawTextureTransformed(const vita2d_texture* texture, float cx, float cy,
+    float x_scale, float y_scale, float rad, unsigned int tint) {
+  if (texture == NULL || x_scale == 0.0f || y_scale == 0.0f)
+    return;
+  float hw = texture->w * fabsf(x_scale) * 0.5f;
+  float hh = texture->h * fabsf(y_scale) * 0.5f;
+  float c = cosf(rad), s = sinf(rad);
+  // extent of the rotated rectangle around its centre
+  float ex = fabsf(c) * hw + fabsf(s) * hh;
+  float ey = fabsf(s) * hw + fabsf(c) * hh;
+  int x0 = pixelStart(cx - ex), x1 = pixelStart(cx + ex);
+  int y0 = pixelStart(cy - ey), y1 = pixelStart(cy + ey);
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+  if (x1 > VITA2D_SOFT_WIDTH) x1 = VITA2D_SOFT_WIDTH;
+  if (y1 > VITA2D_SOFT_HEIGHT) y1 = VITA2D_SOFT_HEIGHT;
+
+  for (int j = y0; j < y1; ++j) {
+    float dy = j + 0.5f - cy;
+    unsigned int* row = &framebuffer[j * VITA2D_SOFT_WIDTH];
+    for (int i = x0; i < x1; ++i) {
+      float dx = i + 0.5f - cx;
+      // undo the rotation, then the scale
+      float u = (c * dx + s * dy) / x_scale + texture->w * 0.5f;
+      float v = (-s * dx + c * dy) / y_scale + texture->h * 0.5f;
+      if (u < 0.0f || v < 0.0f || u >= texture->w || v >= texture->h)
+        continue;
+      unsigned int color;
+      if (texture->tiledX != NULL) {
+        color = texture->data[texture->tiledX[(int)u] | texture->tiledY[(int)v]];
+      } else {
+        const unsigned int* texel = (const unsigned int*)((const char*)texture->data + (int)v * texture->stride);
+        color = texel[(int)u];
+      }
+      if (tint != 0xffffffff)
+        color = modulate(color, tint);
+      blendPixel(&row[i], color);
+    }
+  }
+}
+
+void vita2d_draw_texture(const vita2d_texture* texture, float x, float y) {
+  vita2d_draw_texture_tint_scale(texture, x, y, 1.0f, 1.0f, 0xffffffff);
+}
+
+void vita2d_draw_texture_scale(const vita2d_texture* texture, float x, float y, float x_scale, float y_scale) {
+  vita2d_draw_texture_tint_scale(texture, x, y, x_scale, y_scale, 0xffffffff);
+}
+
+void vita2d_draw_texture_tint_scale(const vita2d_texture* texture, float x, float y, float x_scale, float y_scale, unsigned int color) {
+  if (texture == NULL)
+    return;
+  logCall("texture %ux%u %.1f %.1f %.2f %.2f 0x%08x", texture->w, texture->h, x, y, x_scale, y_scale, color);
+  drawTextureTransformed(texture, x + texture->w * x_scale * 0.5f, y + texture->h * y_scale * 0.5f,
+    x_scale, y_scale, 0.0f, color);
+}
+
+void vita2d_draw_texture_tint_scale_rotate(const vita2d_texture* texture, float x, float y, float x_scale, float y_scale, float rad, unsigned int color) {
+  if (texture == NULL)
+    return;
+  logCall("texture %ux%u %.1f %.1f %.2f %.2f rot %.2f 0x%08x", texture->w, texture->h, x, y, x_scale, y_scale, rad, color);
+  drawTextureTransformed(texture, x, y, x_scale, y_scale, rad, color);
+}
+
+static vita2d_font* createFont(const unsigned char* buffer, unsigned int size, unsigned char* fileData) {
+  if (ftlib == NULL)
+    return NULL;
+  vita2d_font* font = (vita2d_font*)malloc(sizeof(vita2d_font));
+  if (font == NULL)
+    return NULL;
+  if (FT_New_Memory_Face(ftlib, buffer, size, 0, &font->face) != 0) {
+    free(font);
+    return NULL;
+  }
+  font->fileData = fileData;
+  return font;
+}
+
+vita2d_font* vita2d_load_font_mem(const void* buffer, unsigned int size) {
+  return createFont((const unsigned char*)buffer, size, NULL);
+}
+
+vita2d_font* vita2d_load_font_file(const char* filename) {
+  FILE* f = fopen(filename, "rb");
+  if (f == NULL)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  unsigned char* data = size > 0 ? (unsigned char*)malloc(size) : NULL;
+  if (data == NULL || fread(data, 1, size, f) != (size_t)size) {
+    free(data);
+    fclose(f);
+    return NULL;
+  }
+  fclose(f);
+  vita2d_font* font = createFont(data, size, data);
+  if (font == NULL)
+    free(data);
+  return font;
+}
+
+void vita2d_free_font(vita2d_font* font) {
+  if (font == NULL)
+    return;
+  FT_Done_Face(font->face);
+  free(font->fileData);
+  free(font);
+}
+
+static unsigned int nextCodepoint(const unsigned char*& p) {
+  unsigned int c = *p++;
+  int extra = 0;
+  if (c >= 0xf0)      { c &= 0x07; extra = 3; }
+  else if (c >= 0xe0) { c &= 0x0f; extra = 2; }
+  else if (c >= 0xc0) { c &= 0x1f; extra = 1; }
+  for (; extra > 0 && (*p & 0xc0) == 0x80; --extra)
+    c = (c << 6) | (*p++ & 0x3f);
+  return c;
+}
+
+// Lays out text from a baseline at x, y. Draws when draw is set, and
+// returns the width of the widest line either way.
+static int layoutText(vita2d_font* font, int x, int y, unsigned int color, unsigned int size,
+    const char* text, bool draw) {
+  if (font == NULL || text == NULL || size == 0)
+    return 0;
+  FT_Face face = font->face;
+  FT_Set_Pixel_Sizes(face, 0, size);
+  int lineHeight = face->size->metrics.height >> 6;
+  int penX = x, penY = y;
+  int width = 0;
+  unsigned int alpha = color >> 24;
+
+  const unsigned char* p = (const unsigned char*)text;
+  while (*p != 0) {
+    unsigned int c = nextCodepoint(p);
+    if (c == '\n') {
+      if (penX - x > width)
+        width = penX - x;
+      penX = x;
+      penY += lineHeight;
+      continue;
+    }
+    if (FT_Load_Char(face, c, draw ? FT_LOAD_RENDER : FT_LOAD_DEFAULT) != 0)
+      continue;
+    FT_GlyphSlot g = face->glyph;
+    if (draw) {
+      FT_Bitmap& bm = g->bitmap;
+      int gx = penX + g->bitmap_left;
+      int gy = penY - g->bitmap_top;
+      for (unsigned int j = 0; j < bm.rows; ++j) {
+        int sy = gy + (int)j;
+        if (sy < 0 || sy >= VITA2D_SOFT_HEIGHT)
+          continue;
+        const unsigned char* src = bm.buffer + j * bm.pitch;
+        for (unsigned int i = 0; i < bm.width; ++i) {
+          int sx = gx + (int)i;
+          if (sx < 0 || sx >= VITA2D_SOFT_WIDTH || src[i] == 0)
+            continue;
+          unsigned int a = src[i] * alpha / 255;
+          blendPixel(&framebuffer[sy * VITA2D_SOFT_WIDTH + sx], (color & 0x00ffffff) | (a << 24));
+        }
+      }
+    }
+    penX += g->advance.x >> 6;
+  }
+  if (penX - x > width)
+    width = penX - x;
+  return width;
+}
+
+int vita2d_font_draw_text(vita2d_font* font, int x, int y, unsigned int color, unsigned int size, const char* text) {
+  if (drawLog != NULL && text != NULL) {
+    // keep one call per line
+    string escaped;
+    for (const char* p = text; *p != 0; ++p) {
+      if (*p == '\n')
+        escaped += "\\n";
+      else if (*p == '"' || *p == '\\')
+        escaped += string("\\") + *p;
+      else
+        escaped += *p;
+    }
+    logCall("text %d %d 0x%08x %u \"%s\"", x, y, color, size, escaped.c_str());
+  }
+  return layoutText(font, x, y, color, size, text, true);
+}
+
+int vita2d_font_draw_textf(vita2d_font* font, int x, int y, unsigned int color, unsigned int size, const char* text, ...) {
+  char buf[1024];
+  va_list ap;
+  va_start(ap, text);
+  vsnprintf(buf, sizeof(buf), text, ap);
+  va_end(ap);
+  return vita2d_font_draw_text(font, x, y, color, size, buf);
+}
+
+int vita2d_font_text_width(vita2d_font* font, unsigned int size, const char* text) {
+  return layoutText(font, 0, 0, 0, size, text, false);
+}
+
+int vita2d_font_text_height(vita2d_font* font, unsigned int size, const char* text) {
+  int lines = 1;
+  for (const char* p = text; *p != 0; ++p)
+    if (*p == '\n')
+      ++lines;
+  return lines * size;
+}
+
+vita2d_pgf* vita2d_load_default_pgf() {
+  vita2d_font* font = vita2d_load_font_mem(res_uifont, size_res_uifont);
+  if (font == NULL)
+    return NULL;
+  vita2d_pgf* pgf = (vita2d_pgf*)malloc(sizeof(vita2d_pgf));
+  if (pgf == NULL) {
+    vita2d_free_font(font);
+    return NULL;
+  }
+  pgf->font = font;
+  return pgf;
+}
+
+void vita2d_free_pgf(vita2d_pgf* font) {
+  if (font == NULL)
+    return;
+  vita2d_free_font(font->font);
+  free(font);
+}
+
+int vita2d_pgf_draw_text(vita2d_pgf* font, int x, int y, unsigned int color, float scale, const char* text) {
+  if (font == NULL)
+    return 0;
+  return vita2d_font_draw_text(font->font, x, y, color, (unsigned int)(SOFT_PGF_SIZE * scale + 0.5f), text);
+}
+
+int vita2d_pgf_draw_textf(vita2d_pgf* font, int x, int y, unsigned int color, float scale, const char* text, ...) {
+  char buf[1024];
+  va_list ap;
+  va_start(ap, text);
+  vsnprintf(buf, sizeof(buf), text, ap);
+  va_end(ap);
+  return vita2d_pgf_draw_text(font, x, y, color, scale, buf);
+}
+
+void vita2d_soft_set_draw_log(FILE* log) {
+  drawLog = log;
+}
+
+int vita2d_soft_frame_count() {
+  return frames;
+}
@@ -0,0 +1,119 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+
+#include <stdio.h>
+
+#include "../bklibrary.h"
+#include "../bkdocument.h"
+
+#include "bktest.h"
+
+using namespace std;
+
+static bool findBook(const string& path, BKLibraryEntry& book) {
+  BKLibraryList books;
+  BKLibrary::getBooks(books);
+  for (size_t i = 0; i < books.size(); ++i) {
+    if (books[i].path == path) {
+      book = books[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+// touch() is what an open records: 0 pages means unknown and must not
+// wipe a count from an earlier open.
+BKTEST("library", touchKeepsKnownPages) {
+  string path = "/books/touch.pdf";
+  BKLibrary::touch(path, BKDOC_FORMAT_MUPDF, 12);
+  BKLibraryEntry book;
+  BKTEST_CHECK(findBook(path, book));
+  BKTEST_CHECK(book.title == "touch");
+  BKTEST_CHECK(book.pages == 12);
+  BKTEST_CHECK(book.lastOpened > 0);
+
+  BKLibrary::touch(path, BKDOC_FORMAT_MUPDF, 0);
+  BKTEST_CHECK(findBook(path, book) && book.pages == 12);
+  BKLibrary::touch(path, BKDOC_FORMAT_MUPDF, 30);
+  BKTEST_CHECK(findBook(path, book) && book.pages == 30);
+}
+
+// What save() writes, init() reads back: later changes in memory are
+// replaced by the saved entry. The path and title need escaping.
+BKTEST("library", saveAndLoad) {
+  string path = "/books/\"Tom & Jerry\" <1>.epub";
+  BKLibrary::touch(path, BKDOC_FORMAT_PLAINTEXT, 7);
+  BKLibraryEntry saved;
+  BKTEST_CHECK(findBook(path, saved));
+  BKLibrary::save();
+
+  BKLibrary::touch(path, BKDOC_FORMAT_MUPDF, 99);
+  BKLibrary::init();
+  BKLibraryEntry loaded;
+  BKTEST_CHECK(findBook(path, loaded));
+  BKTEST_CHECK(loaded.title == saved.title);
+  BKTEST_CHECK(loaded.title == "\"Tom & Jerry\" <1>");
+  BKTEST_CHECK(loaded.format == BKDOC_FORMAT_PLAINTEXT);
+  BKTEST_CHECK(loaded.pages == 7);
+  BKTEST_CHECK(loaded.size == saved.size);
+  BKTEST_CHECK(loaded.mtime == saved.mtime);
+  BKTEST_CHECK(loaded.lastOpened == saved.lastOpened);
+}
+
+// Older or hand-edited files: a book without a title is named after its
+// file, one without a path is skipped.
+BKTEST("library", loadMissingAttributes) {
+  string file = string(BKTest::scratchDir()) + "/" + LIBRARY_XML;
+  FILE* f = fopen(file.c_str(), "wb");
+  BKTEST_CHECK(f != NULL);
+  if (f == NULL)
+    return;
+  fputs("<?xml version=\"1.0\"?>\n<library version=\"1\">\n"
+    "<book path=\"/books/untitled.txt\" format=\"2\" size=\"2048\" mtime=\"100\"/>\n"
+    "<book title=\"no path\" format=\"1\"/>\n"
+    "</library>\n", f);
+  fclose(f);
+
+  BKLibraryList before;
+  BKLibrary::getBooks(before);
+  BKLibrary::init();
+  BKLibraryList after;
+  BKLibrary::getBooks(after);
+  BKLibraryEntry book;
+  BKTEST_CHECK(findBook("/books/untitled.txt", book));
+  BKTEST_CHECK(book.title == "untitled");
+  BKTEST_CHECK(book.format == BKDOC_FORMAT_PLAINTEXT);
+  BKTEST_CHECK(book.pages == 0);
+  BKTEST_CHECK(book.size == 2048);
+  BKTEST_CHECK(book.mtime == 100);
+  BKTEST_CHECK(book.lastOpened == 0);
+  BKTEST_CHECK(after.size() == before.size() + 1);
+}
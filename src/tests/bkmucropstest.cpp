@@ -0,0 +1,93 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <thread>
+#include <vector>
+
+#include "../filetypes/bkmucrops.h"
+
+#include "bktest.h"
+
+using namespace std;
+
+#define CROPS_THREADS 4
+#define CROPS_PAGES   500
+
+static fz_rect pageBox(int n) {
+  fz_rect box;
+  box.x0 = (float)n;
+  box.y0 = (float)(n * 2);
+  box.x1 = (float)(n + 100);
+  box.y1 = (float)(n * 2 + 200);
+  return box;
+}
+
+static bool sameBox(const fz_rect& a, const fz_rect& b) {
+  return a.x0 == b.x0 && a.y0 == b.y0 && a.x1 == b.x1 && a.y1 == b.y1;
+}
+
+BKTEST("crops", storeAndFind) {
+  BKMUCrops crops;
+  fz_rect box;
+  BKTEST_CHECK(!crops.find(3, box));
+  crops.store(3, pageBox(3));
+  BKTEST_CHECK(crops.find(3, box) && sameBox(box, pageBox(3)));
+  BKTEST_CHECK(!crops.find(4, box));
+  // a later scan replaces the box
+  crops.store(3, pageBox(7));
+  BKTEST_CHECK(crops.find(3, box) && sameBox(box, pageBox(7)));
+}
+
+// The strip, the spread and the page view scan pages from their own
+// threads; each stores its pages while looking up the others'.
+BKTEST("crops", sharedBetweenThreads) {
+  BKMUCrops crops;
+  vector<thread> threads;
+  vector<int> torn(CROPS_THREADS, 0);
+  for (int t = 0; t < CROPS_THREADS; ++t) {
+    threads.push_back(thread([&crops, &torn, t]() {
+      for (int n = t; n < CROPS_PAGES; n += CROPS_THREADS) {
+        crops.store(n, pageBox(n));
+        fz_rect box;
+        int other = (n + 1) % CROPS_PAGES;
+        if (crops.find(other, box) && !sameBox(box, pageBox(other)))
+          torn[t]++;
+      }
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i].join();
+  for (int t = 0; t < CROPS_THREADS; ++t)
+    BKTEST_CHECK(torn[t] == 0);
+  bool all = true;
+  for (int n = 0; n < CROPS_PAGES; ++n) {
+    fz_rect box;
+    all = all && crops.find(n, box) && sameBox(box, pageBox(n));
+  }
+  BKTEST_CHECK(all);
+}
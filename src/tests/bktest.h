@@ -0,0 +1,66 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BKTEST_H
+#define BKTEST_H
+
+#include <stdio.h>
+
+/*! \brief Unit tests of bookr-core, run by bookr-tests.
+ *
+ *  A test is a function declared with BKTEST(group, name) in any file
+ *  linked into bookr-tests. `bookr-tests group` runs one group, which
+ *  is how ctest calls it; with no arguments every group runs. A failed
+ *  BKTEST_CHECK prints its file, line and condition, the test carries
+ *  on, and the run exits with 1.
+ */
+class BKTest {
+  public:
+  typedef void (*Function)();
+
+  // adds a test to the list; BKTEST does this before main()
+  struct Registrar {
+    Registrar(const char* group, const char* name, Function f);
+  };
+
+  static bool check(bool ok, const char* what, const char* file, int line);
+  // runs the tests of group, or all of them for NULL; returns the
+  // number of tests that failed, -1 if the group has none
+  static int run(const char* group);
+  // a fresh directory under /tmp, removed with its files at exit
+  static const char* scratchDir();
+};
+
+#define BKTEST(group, name) \
+  static void name(); \
+  static BKTest::Registrar name##Registrar(group, #name, name); \
+  static void name()
+
+#define BKTEST_CHECK(cond) BKTest::check((cond), #cond, __FILE__, __LINE__)
+
+#endif
@@ -0,0 +1,172 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+
+#include <string.h>
+
+// bkuser.h expects it
+using namespace std;
+
+#include "../bkuser.h"
+
+#include "bktest.h"
+
+// a table entry's value as user.xml writes it
+static string settingText(const BKUser::Setting& s) {
+  if (s.type == BKUSER_SETTING_STRING || s.type == BKUSER_SETTING_PATH)
+    return *(string*)s.value;
+  if (s.type == BKUSER_SETTING_BOOL)
+    return *(bool*)s.value ? "1" : "0";
+  return to_string(*(int*)s.value);
+}
+
+static bool isNumeric(const BKUser::Setting& s) {
+  return s.type != BKUSER_SETTING_STRING && s.type != BKUSER_SETTING_PATH;
+}
+
+static bool isDefault(const BKUser::Setting& s) {
+  if (s.type == BKUSER_SETTING_BOOL)
+    return *(bool*)s.value == (s.defaultValue != 0);
+  return *(int*)s.value == s.defaultValue;
+}
+
+// an in-range value other than the default, so a dropped or misread
+// entry cannot pass by holding its default
+static void setOther(const BKUser::Setting& s) {
+  switch (s.type) {
+    case BKUSER_SETTING_BOOL:
+      *(bool*)s.value = s.defaultValue == 0;
+      break;
+    case BKUSER_SETTING_STRING:
+    case BKUSER_SETTING_PATH:
+      *(string*)s.value = string("test/\"<&>\"/") + s.name;
+      break;
+    default: {
+      int v = s.defaultValue < s.maxValue ? s.maxValue : s.minValue;
+      // checks outside the table: quarter turns, an existing scheme
+      if (strcmp(s.name, "txtRotation") == 0)
+        v = 90;
+      else if (strcmp(s.name, "currentScheme") == 0)
+        v = 1;
+      *(int*)s.value = v;
+    }
+  }
+}
+
+static void resetSettings() {
+  BKUser::setDefaultControls();
+  BKUser::setDefaultOptions();
+}
+
+// Every entry set away from its default comes back from serialize()
+// through parse(), strings escaped.
+BKTEST("settings", roundTrip) {
+  string saved;
+  BKUser::serialize(saved);
+  int n;
+  const BKUser::Setting* settings = BKUser::getSettings(n);
+  BKTEST_CHECK(n > 0);
+  vector<string> expected(n);
+  for (int i = 0; i < n; ++i) {
+    setOther(settings[i]);
+    expected[i] = settingText(settings[i]);
+  }
+  string xml;
+  BKUser::serialize(xml);
+  resetSettings();
+  BKTEST_CHECK(BKUser::parse(xml.c_str(), xml.size()) == 0);
+  for (int i = 0; i < n; ++i) {
+    if (!BKTEST_CHECK(settingText(settings[i]) == expected[i]))
+      printf("  %s is \"%s\", saved \"%s\"\n", settings[i].name, settingText(settings[i]).c_str(),
+        expected[i].c_str());
+  }
+  resetSettings();
+  BKUser::parse(saved.c_str(), saved.size());
+}
+
+// user.xml with value for every numeric entry, or with each entry's
+// range exceeded by one when range is 1 (above) or -1 (below)
+static string numericXML(const char* value, int range) {
+  int n;
+  const BKUser::Setting* settings = BKUser::getSettings(n);
+  string controls, options;
+  for (int i = 0; i < n; ++i) {
+    const BKUser::Setting& s = settings[i];
+    if (!isNumeric(s))
+      continue;
+    string v = range > 0 ? to_string((long)s.maxValue + 1) : range < 0 ? to_string((long)s.minValue - 1) : value;
+    if (s.type == BKUSER_SETTING_BUTTON)
+      controls += string("<bind action=\"") + s.name + "\" button=\"" + v + "\"/>";
+    else
+      options += string("<set option=\"") + s.name + "\" value=\"" + v + "\"/>";
+  }
+  return "<?xml version=\"1.0\"?><user><controls>" + controls + "</controls><options>" + options
+    + "</options></user>";
+}
+
+// Out of range and malformed numbers reset their entry to the default
+// and are counted, starting from values that are not the defaults.
+BKTEST("settings", badValuesReset) {
+  string saved;
+  BKUser::serialize(saved);
+  int n;
+  const BKUser::Setting* settings = BKUser::getSettings(n);
+  int numeric = 0;
+  for (int i = 0; i < n; ++i)
+    numeric += isNumeric(settings[i]) ? 1 : 0;
+
+  struct { const char* value; int range; } cases[] = {
+    { "", 1 }, { "", -1 }, { "", 0 }, { "abc", 0 }, { "12x", 0 }, { "1.5", 0 },
+  };
+  for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); ++k) {
+    resetSettings();
+    for (int i = 0; i < n; ++i)
+      setOther(settings[i]);
+    string xml = numericXML(cases[k].value, cases[k].range);
+    BKTEST_CHECK(BKUser::parse(xml.c_str(), xml.size()) == numeric);
+    for (int i = 0; i < n; ++i) {
+      if (isNumeric(settings[i]) && !BKTEST_CHECK(isDefault(settings[i])))
+        printf("  %s kept \"%s\" after \"%s\" (range %d)\n", settings[i].name,
+          settingText(settings[i]).c_str(), cases[k].value, cases[k].range);
+    }
+  }
+  resetSettings();
+  BKUser::parse(saved.c_str(), saved.size());
+}
+
+// Text that is not a settings file changes nothing; a missing file is
+// reported.
+BKTEST("settings", notASettingsFile) {
+  const char* truncated = "<user><options><set option=";
+  BKTEST_CHECK(BKUser::parse(truncated, strlen(truncated)) == -1);
+  BKTEST_CHECK(BKUser::parse("", 0) == -1);
+  string missing = string(BKTest::scratchDir()) + "/missing.xml";
+  BKTEST_CHECK(BKUser::loadFile(missing.c_str()) == -1);
+}
@@ -0,0 +1,148 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "../graphics/fzscreen.h"
+#include "../bkuser.h"
+#include "../bklibrary.h"
+
+#include "bktest.h"
+
+using namespace std;
+
+/*
+ * bookr-tests: unit tests of bookr-core.
+ *
+ *   bookr-tests [group...]
+ *
+ * The screen is opened on a scratch data directory, so library.xml and
+ * the other data files start empty and the user's own are never read.
+ */
+
+struct Test {
+  const char* group;
+  const char* name;
+  BKTest::Function f;
+};
+
+// filled by the registrars before main(), hence a function static
+static vector<Test>& tests() {
+  static vector<Test> list;
+  return list;
+}
+
+static int checksFailed = 0;
+static char scratch[] = "/tmp/bookr-tests-XXXXXX";
+
+BKTest::Registrar::Registrar(const char* group, const char* name, Function f) {
+  Test t = { group, name, f };
+  tests().push_back(t);
+}
+
+bool BKTest::check(bool ok, const char* what, const char* file, int line) {
+  if (!ok) {
+    printf("%s:%d: failed: %s\n", file, line, what);
+    fflush(stdout);
+    ++checksFailed;
+  }
+  return ok;
+}
+
+int BKTest::run(const char* group) {
+  int ran = 0, failed = 0;
+  for (size_t i = 0; i < tests().size(); ++i) {
+    const Test& t = tests()[i];
+    if (group != NULL && strcmp(group, t.group) != 0)
+      continue;
+    int before = checksFailed;
+    t.f();
+    bool ok = checksFailed == before;
+    printf("%s %s.%s\n", ok ? "ok  " : "FAIL", t.group, t.name);
+    // seen even if a later test crashes
+    fflush(stdout);
+    ++ran;
+    if (!ok)
+      ++failed;
+  }
+  return ran == 0 ? -1 : failed;
+}
+
+const char* BKTest::scratchDir() {
+  return scratch;
+}
+
+static void removeScratch() {
+  DIR* dir = opendir(scratch);
+  if (dir == NULL)
+    return;
+  struct dirent* e;
+  while ((e = readdir(dir)) != NULL) {
+    if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0)
+      remove((string(scratch) + "/" + e->d_name).c_str());
+  }
+  closedir(dir);
+  rmdir(scratch);
+}
+
+int main(int argc, char* argv[]) {
+  if (mkdtemp(scratch) == NULL) {
+    fprintf(stderr, "cannot create a data directory\n");
+    return 1;
+  }
+  atexit(removeScratch);
+  char* screenArgs[] = { argv[0], (char*)"--data", scratch };
+  FZScreen::open(3, screenArgs);
+  BKUser::init();
+
+  int failed = 0;
+  if (argc < 2) {
+    failed = BKTest::run(NULL);
+  } else {
+    for (int i = 1; i < argc; ++i) {
+      int n = BKTest::run(argv[i]);
+      if (n < 0) {
+        fprintf(stderr, "no tests in group %s\n", argv[i]);
+        n = 1;
+      }
+      failed += n;
+    }
+  }
+
+  BKLibrary::shutdown();
+  BKUser::shutdown();
+  FZScreen::close();
+  return failed == 0 ? 0 : 1;
+}
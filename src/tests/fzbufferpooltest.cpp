@@ -0,0 +1,130 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../graphics/fzbufferpool.h"
+#include "../graphics/fzmemory.h"
+
+#include "bktest.h"
+
+// Sizes and the class they must land in: powers of two from 64 bytes
+// up to a page, then whole pages.
+static const size_t classes[][2] = {
+  { 1, 64 }, { 64, 64 }, { 65, 128 }, { 1000, 1024 }, { 4096, 4096 },
+  { 4097, 8192 }, { 10000, 12288 }, { 1 << 20, 1 << 20 },
+};
+#define CLASS_COUNT (sizeof(classes) / sizeof(classes[0]))
+
+BKTEST("pool", sizeClasses) {
+  for (size_t i = 0; i < CLASS_COUNT; ++i) {
+    // no idle block to reuse
+    FZBufferPool::trim();
+    FZBufferPool::Stats before, live, after;
+    FZBufferPool::getStats(before);
+    void* p = FZBufferPool::alloc(classes[i][0], false);
+    BKTEST_CHECK(p != NULL);
+    if (p == NULL)
+      continue;
+    BKTEST_CHECK(((uintptr_t)p & (FZ_POOL_ALIGN - 1)) == 0);
+    FZBufferPool::getStats(live);
+    BKTEST_CHECK(live.liveBytes - before.liveBytes == classes[i][0]);
+    BKTEST_CHECK(live.slackBytes - before.slackBytes == classes[i][1] - classes[i][0]);
+    // the whole class is usable
+    memset(p, 0xa5, classes[i][1]);
+    FZBufferPool::release(p);
+    FZBufferPool::getStats(after);
+    BKTEST_CHECK(after.liveBytes == before.liveBytes);
+    BKTEST_CHECK(after.cachedBytes - before.cachedBytes == classes[i][1]);
+  }
+  FZBufferPool::trim();
+}
+
+// A released block serves the next request of its class, of any size in
+// it, and comes back zeroed when asked.
+BKTEST("pool", reuseWithinClass) {
+  FZBufferPool::trim();
+  FZBufferPool::Stats before, after;
+  FZBufferPool::getStats(before);
+  char* p = (char*)FZBufferPool::alloc(100, false);
+  memset(p, 0xff, 100);
+  FZBufferPool::release(p);
+  char* q = (char*)FZBufferPool::alloc(120, true);
+  FZBufferPool::getStats(after);
+  BKTEST_CHECK(q == p);
+  BKTEST_CHECK(after.heapAllocations - before.heapAllocations == 1);
+  BKTEST_CHECK(after.reuses - before.reuses == 1);
+  bool zero = true;
+  for (int i = 0; i < 120; ++i)
+    zero = zero && q[i] == 0;
+  BKTEST_CHECK(zero);
+
+  // another class does not take it
+  FZBufferPool::release(q);
+  void* r = FZBufferPool::alloc(200, false);
+  FZBufferPool::getStats(after);
+  BKTEST_CHECK(after.reuses - before.reuses == 1);
+  FZBufferPool::release(r);
+  FZBufferPool::trim();
+}
+
+// Idle blocks are counted as FZ_MEM_POOL and go back to the heap on
+// trim() or when they would exceed the cache limit.
+BKTEST("pool", idleLimit) {
+  FZBufferPool::trim();
+  FZBufferPool::Stats stats;
+  FZMemory::TagStats pool;
+  void* p = FZBufferPool::alloc(8192, false);
+  FZBufferPool::release(p);
+  FZBufferPool::getStats(stats);
+  FZMemory::getStats(FZ_MEM_POOL, pool);
+  BKTEST_CHECK(stats.cachedBytes == 8192);
+  BKTEST_CHECK(stats.classes == 1);
+  BKTEST_CHECK(pool.current == 8192);
+
+  FZBufferPool::trim();
+  FZBufferPool::getStats(stats);
+  FZMemory::getStats(FZ_MEM_POOL, pool);
+  BKTEST_CHECK(stats.cachedBytes == 0);
+  BKTEST_CHECK(stats.classes == 0);
+  BKTEST_CHECK(pool.current == 0);
+
+  FZBufferPool::setCacheLimit(4096);
+  p = FZBufferPool::alloc(8192, false);
+  void* q = FZBufferPool::alloc(4096, false);
+  FZBufferPool::release(p);
+  FZBufferPool::release(q);
+  FZBufferPool::getStats(stats);
+  BKTEST_CHECK(stats.cachedBytes == 4096);
+  FZBufferPool::setCacheLimit(0);
+  FZBufferPool::getStats(stats);
+  BKTEST_CHECK(stats.cachedBytes == 0);
+  // the desktop default
+  FZBufferPool::setCacheLimit((size_t)64 * 1024 * 1024);
+}
@@ -0,0 +1,243 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vector>
+
+#include <string.h>
+#include <png.h>
+
+#include "../graphics/fzimage.h"
+#include "../graphics/fzinstreammem.h"
+#include "../graphics/fzmemory.h"
+
+#include "bktest.h"
+
+using namespace std;
+
+// An encoded test image and the rows it was made from.
+struct PNGCase {
+  unsigned int w, h;
+  int colorType, bitDepth, interlace;
+  int channels;
+  vector<unsigned char> pixels;  // packed rows as libpng takes them
+  vector<png_color> palette;
+  vector<png_byte> trans;
+  vector<unsigned char> png;
+};
+
+static void appendData(png_structp png, png_bytep data, png_size_t size) {
+  vector<unsigned char>* out = (vector<unsigned char>*)png_get_io_ptr(png);
+  out->insert(out->end(), data, data + size);
+}
+
+static void flushData(png_structp) {
+}
+
+static size_t rowBytes(const PNGCase& c) {
+  return ((size_t)c.w * c.channels * c.bitDepth + 7) / 8;
+}
+
+static bool encode(PNGCase& c) {
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info = png ? png_create_info_struct(png) : NULL;
+  if (info == NULL) {
+    png_destroy_write_struct(&png, NULL);
+    return false;
+  }
+  if (setjmp(png_jmpbuf(png))) {
+    png_destroy_write_struct(&png, &info);
+    return false;
+  }
+  png_set_write_fn(png, &c.png, appendData, flushData);
+  png_set_IHDR(png, info, c.w, c.h, c.bitDepth, c.colorType, c.interlace,
+    PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  if (!c.palette.empty())
+    png_set_PLTE(png, info, &c.palette[0], c.palette.size());
+  if (!c.trans.empty())
+    png_set_tRNS(png, info, &c.trans[0], c.trans.size(), NULL);
+  png_write_info(png, info);
+  vector<png_bytep> rows(c.h);
+  for (unsigned int j = 0; j < c.h; ++j)
+    rows[j] = &c.pixels[j * rowBytes(c)];
+  png_write_image(png, &rows[0]);
+  png_write_end(png, info);
+  png_destroy_write_struct(&png, &info);
+  return true;
+}
+
+static PNGCase makeCase(unsigned int w, unsigned int h, int colorType, int bitDepth, int channels,
+    int interlace = PNG_INTERLACE_NONE) {
+  PNGCase c;
+  c.w = w;
+  c.h = h;
+  c.colorType = colorType;
+  c.bitDepth = bitDepth;
+  c.interlace = interlace;
+  c.channels = channels;
+  c.pixels.resize(rowBytes(c) * h);
+  for (size_t i = 0; i < c.pixels.size(); ++i)
+    c.pixels[i] = (unsigned char)(i * 31 + i / 7);
+  return c;
+}
+
+static FZImage* decode(PNGCase& c, bool paletteToRGBA = false) {
+  if (!BKTEST_CHECK(encode(c)))
+    return NULL;
+  FZInputStreamMem* in = FZInputStreamMem::create((char*)&c.png[0], c.png.size());
+  FZImage* image = FZImage::createFromPNG(in, paletteToRGBA);
+  in->release();
+  return image;
+}
+
+// the decoded image has the case's size and format and, when 8 bit, its
+// exact bytes
+static void checkImage(FZImage* image, const PNGCase& c, FZImage::Format format) {
+  BKTEST_CHECK(image != NULL);
+  if (image == NULL)
+    return;
+  unsigned int w, h;
+  image->getDimensions(w, h);
+  BKTEST_CHECK(w == c.w && h == c.h);
+  BKTEST_CHECK(image->getFormat() == format);
+  if (c.bitDepth == 8)
+    BKTEST_CHECK(memcmp(image->getData(), &c.pixels[0], c.pixels.size()) == 0);
+  image->release();
+}
+
+// Every direct colour type lands row by row in the matching format.
+BKTEST("png", colorTypes) {
+  PNGCase gray = makeCase(5, 3, PNG_COLOR_TYPE_GRAY, 8, 1);
+  checkImage(decode(gray), gray, FZImage::mono8);
+  PNGCase dual = makeCase(5, 3, PNG_COLOR_TYPE_GRAY_ALPHA, 8, 2);
+  checkImage(decode(dual), dual, FZImage::dual16);
+  PNGCase rgb = makeCase(7, 5, PNG_COLOR_TYPE_RGB, 8, 3);
+  checkImage(decode(rgb), rgb, FZImage::rgb24);
+  PNGCase rgba = makeCase(7, 5, PNG_COLOR_TYPE_RGB_ALPHA, 8, 4);
+  checkImage(decode(rgba), rgba, FZImage::rgba32);
+}
+
+// 16 bit samples keep their high byte; 1 bit gray expands to 0 and 255.
+BKTEST("png", bitDepths) {
+  PNGCase deep = makeCase(6, 4, PNG_COLOR_TYPE_RGB_ALPHA, 16, 4);
+  FZImage* image = decode(deep);
+  BKTEST_CHECK(image != NULL);
+  if (image != NULL) {
+    BKTEST_CHECK(image->getFormat() == FZImage::rgba32);
+    bool same = true;
+    const unsigned char* data = (const unsigned char*)image->getData();
+    for (size_t i = 0; i < deep.pixels.size() / 2; ++i)
+      same = same && data[i] == deep.pixels[i * 2];
+    BKTEST_CHECK(same);
+    checkImage(image, deep, FZImage::rgba32);
+  }
+
+  PNGCase mono = makeCase(9, 2, PNG_COLOR_TYPE_GRAY, 1, 1);
+  image = decode(mono);
+  BKTEST_CHECK(image != NULL);
+  if (image != NULL) {
+    BKTEST_CHECK(image->getFormat() == FZImage::mono8);
+    bool same = true;
+    const unsigned char* data = (const unsigned char*)image->getData();
+    for (unsigned int j = 0; j < mono.h; ++j) {
+      for (unsigned int i = 0; i < mono.w; ++i) {
+        bool set = mono.pixels[j * rowBytes(mono) + i / 8] & (0x80 >> (i % 8));
+        same = same && data[j * mono.w + i] == (set ? 255 : 0);
+      }
+    }
+    BKTEST_CHECK(same);
+    checkImage(image, mono, FZImage::mono8);
+  }
+}
+
+// Each Adam7 pass sweeps the rows again; the result matches the plain
+// image.
+BKTEST("png", interlaced) {
+  PNGCase rgb = makeCase(13, 11, PNG_COLOR_TYPE_RGB, 8, 3, PNG_INTERLACE_ADAM7);
+  checkImage(decode(rgb), rgb, FZImage::rgb24);
+}
+
+// Palette images keep their indices and a CLUT with the tRNS alphas, or
+// become RGBA when asked.
+BKTEST("png", palette) {
+  PNGCase c = makeCase(4, 4, PNG_COLOR_TYPE_PALETTE, 8, 1);
+  for (size_t i = 0; i < c.pixels.size(); ++i)
+    c.pixels[i] = i % 3;
+  png_color colors[3] = { { 10, 20, 30 }, { 40, 50, 60 }, { 70, 80, 90 } };
+  c.palette.assign(colors, colors + 3);
+  c.trans.push_back(0x40);
+
+  FZImage* image = decode(c);
+  BKTEST_CHECK(image != NULL);
+  if (image != NULL) {
+    BKTEST_CHECK(image->getCLUTSize() == 3);
+    unsigned int* clut = image->getCLUT();
+    BKTEST_CHECK(clut != NULL && clut[0] == 0x401e140a);
+    BKTEST_CHECK(clut != NULL && clut[2] == 0xff5a5046);
+    checkImage(image, c, FZImage::mono8);
+  }
+
+  PNGCase rgba = c;
+  rgba.png.clear();
+  image = decode(rgba, true);
+  BKTEST_CHECK(image != NULL);
+  if (image != NULL) {
+    BKTEST_CHECK(image->getFormat() == FZImage::rgba32);
+    BKTEST_CHECK(image->getCLUT() == NULL);
+    const unsigned char* p = (const unsigned char*)image->getData();
+    // pixel 0 is index 0, pixel 1 index 1
+    BKTEST_CHECK(p[0] == 10 && p[1] == 20 && p[2] == 30 && p[3] == 0x40);
+    BKTEST_CHECK(p[4] == 40 && p[5] == 50 && p[6] == 60 && p[7] == 0xff);
+    image->release();
+  }
+}
+
+// A cut off stream is rejected, and neither a good nor a bad decode
+// leaves decoder or pixel memory behind.
+BKTEST("png", truncatedAndAccounting) {
+  FZMemory::TagStats decodeBefore, pixmapBefore, decodeAfter, pixmapAfter;
+  FZMemory::getStats(FZ_MEM_DECODE, decodeBefore);
+  FZMemory::getStats(FZ_MEM_PIXMAP, pixmapBefore);
+
+  PNGCase c = makeCase(32, 32, PNG_COLOR_TYPE_RGB_ALPHA, 8, 4);
+  FZImage* image = decode(c);
+  BKTEST_CHECK(image != NULL);
+  if (image != NULL)
+    image->release();
+
+  FZInputStreamMem* in = FZInputStreamMem::create((char*)&c.png[0], c.png.size() / 2);
+  BKTEST_CHECK(FZImage::createFromPNG(in) == NULL);
+  in->release();
+  in = FZInputStreamMem::create((char*)&c.pixels[0], c.pixels.size());
+  BKTEST_CHECK(FZImage::createFromPNG(in) == NULL);
+  in->release();
+
+  FZMemory::getStats(FZ_MEM_DECODE, decodeAfter);
+  FZMemory::getStats(FZ_MEM_PIXMAP, pixmapAfter);
+  BKTEST_CHECK(decodeAfter.current == decodeBefore.current);
+  BKTEST_CHECK(pixmapAfter.current == pixmapBefore.current);
+}
@@ -0,0 +1,136 @@
+/*
+ * Bookr % VITA: document reader for the Sony PS Vita
+ * Copyright (C) 2017 Sreekara C. (pathway27 at gmail dot com)
+ *
+ * IS A MODIFICATION OF THE ORIGINAL
+ *
+ * Bookr and bookr-mod for PSP
+ * Copyright (C) 2005 Carlos Carrasco Martinez (carloscm at gmail dot com),
+ *               2007 Christian Payeur (christian dot payeur at gmail dot com),
+ *               2009 Nguyen Chi Tam (nguyenchitam at gmail dot com),
+
+ * AND VARIOUS OTHER FORKS.
+ * See Forks in the README for more info
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../graphics/fzimage.h"
+
+#include "bktest.h"
+
+using namespace std;
+
+// Bit by bit from the layout's definition: x and y bits alternate while
+// both sides have them, then the larger side's bits follow.
+static unsigned int tiledReference(unsigned int x, unsigned int y, unsigned int w, unsigned int h) {
+  unsigned int tw, th;
+  FZImage::getTiledDimensions(w, h, tw, th);
+  unsigned int index = 0, bit = 0;
+  for (unsigned int b = 1; b < tw || b < th; b <<= 1) {
+    if (b < tw)
+      index |= (x & b ? 1u : 0u) << bit++;
+    if (b < th)
+      index |= (y & b ? 1u : 0u) << bit++;
+  }
+  return index;
+}
+
+static const unsigned int sizes[][2] = {
+  { 1, 1 }, { 2, 1 }, { 1, 9 }, { 7, 3 }, { 3, 7 }, { 33, 17 }, { 64, 64 }, { 100, 300 }, { 960, 544 },
+};
+#define SIZE_COUNT (sizeof(sizes) / sizeof(sizes[0]))
+
+BKTEST("tiling", dimensions) {
+  unsigned int tw, th;
+  FZImage::getTiledDimensions(960, 544, tw, th);
+  BKTEST_CHECK(tw == 1024 && th == 1024);
+  FZImage::getTiledDimensions(64, 65, tw, th);
+  BKTEST_CHECK(tw == 64 && th == 128);
+  BKTEST_CHECK(FZImage::getTiledSize(3, 5, 2) == 4 * 8 * 2);
+  // a 2x2 quad is contiguous, then the next quad along x
+  BKTEST_CHECK(FZImage::getTiledIndex(1, 0, 4, 4) == 1);
+  BKTEST_CHECK(FZImage::getTiledIndex(0, 1, 4, 4) == 2);
+  BKTEST_CHECK(FZImage::getTiledIndex(2, 0, 4, 4) == 4);
+  // past the square, the larger side's bits go on top
+  BKTEST_CHECK(FZImage::getTiledIndex(0, 2, 2, 4) == 4);
+  BKTEST_CHECK(FZImage::getTiledIndex(2, 0, 4, 2) == 4);
+}
+
+BKTEST("tiling", indexMatchesReference) {
+  for (size_t k = 0; k < SIZE_COUNT; ++k) {
+    unsigned int w = sizes[k][0], h = sizes[k][1];
+    bool same = true;
+    for (unsigned int y = 0; y < h; ++y)
+      for (unsigned int x = 0; x < w; ++x)
+        same = same && FZImage::getTiledIndex(x, y, w, h) == tiledReference(x, y, w, h);
+    BKTEST_CHECK(same);
+  }
+}
+
+// tile() puts every pixel where the reference says, untile() brings the
+// rows back, for each pixel size and a pitch with slack.
+BKTEST("tiling", roundTrip) {
+  for (unsigned int bpp = 1; bpp <= 4; ++bpp) {
+    for (size_t k = 0; k < SIZE_COUNT; ++k) {
+      unsigned int w = sizes[k][0], h = sizes[k][1];
+      unsigned int pitch = w * bpp + 5;
+      vector<char> linear((size_t)pitch * h), tiled(FZImage::getTiledSize(w, h, bpp)), back(linear.size());
+      for (size_t i = 0; i < linear.size(); ++i)
+        linear[i] = (char)rand();
+      BKTEST_CHECK(FZImage::tile(&linear[0], pitch, &tiled[0], w, h, bpp));
+      BKTEST_CHECK(FZImage::untile(&tiled[0], &back[0], pitch, w, h, bpp));
+      bool placed = true, restored = true;
+      for (unsigned int y = 0; y < h; ++y) {
+        for (unsigned int x = 0; x < w; ++x) {
+          const char* p = &linear[(size_t)y * pitch + x * bpp];
+          placed = placed && memcmp(&tiled[(size_t)tiledReference(x, y, w, h) * bpp], p, bpp) == 0;
+          restored = restored && memcmp(&back[(size_t)y * pitch + x * bpp], p, bpp) == 0;
+        }
+      }
+      BKTEST_CHECK(placed);
+      BKTEST_CHECK(restored);
+    }
+  }
+  char pixel[8];
+  BKTEST_CHECK(!FZImage::tile(pixel, 8, pixel, 1, 1, 8));
+}
+
+// The PSP GE blocks: 16 bytes by 8 rows, undone by unswizzle(), and
+// refused when the image is not a whole number of blocks.
+BKTEST("tiling", pspSwizzle) {
+  FZImage* image = FZImage::createEmpty(32, 16, 0, FZImage::rgba32, false);
+  BKTEST_CHECK(image != NULL);
+  if (image == NULL)
+    return;
+  char* data = image->getData();
+  unsigned int pitch = 32 * 4, size = pitch * 16;
+  for (unsigned int i = 0; i < size; ++i)
+    data[i] = (char)(i * 13);
+  vector<char> original(data, data + size);
+  BKTEST_CHECK(image->swizzle(16, 8));
+  // block 1 of row 0 starts with bytes 16 to 31 of the first line
+  BKTEST_CHECK(memcmp(data + 16 * 8, &original[16], 16) == 0);
+  // the second line of block 0
+  BKTEST_CHECK(memcmp(data + 16, &original[pitch], 16) == 0);
+  BKTEST_CHECK(image->unswizzle(16, 8));
+  BKTEST_CHECK(memcmp(data, &original[0], size) == 0);
+  BKTEST_CHECK(!image->swizzle(16, 7));
+  image->release();
+}
@@ -1,12 +1,19 @@
 // TODO: Find a place for this
 
 #include "graphics/fzscreen.h"
+#include "graphics/fzmemory.h"
+#include "graphics/fztexture.h"
 #include "utils.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <chrono>
 
 #ifdef __vita__
+  #include <psp2/io/fcntl.h>
+#endif
+
+#if defined(__vita__) || defined(HEADLESS)
 vita2d_texture* _vita2d_load_pixmap_generic(fz_pixmap *pixmap)
 {
   srand(time(NULL));
@@ -18,7 +25,7 @@ vita2d_texture* _vita2d_load_pixmap_generic(fz_pixmap *pixmap)
   int height = pixmap->h;
 
   printf("creating empty texture w: %i h: %i\n", width, height);
-  vita2d_texture *texture = vita2d_create_empty_texture(width, height);
+  vita2d_texture *texture = _vita2d_create_counted_texture(width, height);
   if (texture == NULL) {
     printf("failed to create empty texture\n");
     return NULL;
@@ -48,6 +55,61 @@ vita2d_texture* _vita2d_load_pixmap_generic(fz_pixmap *pixmap)
   #endif
   return texture;
 }
+
+vita2d_texture* _vita2d_create_counted_texture(unsigned int w, unsigned int h)
+{
+  vita2d_texture *texture = vita2d_create_empty_texture(w, h);
+  if (texture == NULL)
+    FZMemory::allocationFailed();
+  else
+    FZMemory::add(FZ_MEM_TEXTURE, FZTexture::getVitaTextureSize(texture));
+  return texture;
+}
+
+void _vita2d_free_counted_texture(vita2d_texture *texture)
+{
+  FZMemory::sub(FZ_MEM_TEXTURE, FZTexture::getVitaTextureSize(texture));
+  vita2d_free_texture(texture);
+}
+
+vita2d_texture* _vita2d_create_counted_tiled_texture(unsigned int w, unsigned int h)
+{
+  unsigned int tw, th;
+  FZImage::getTiledDimensions(w, h, tw, th);
+  vita2d_texture *texture = vita2d_create_empty_texture(tw, th);
+  if (texture == NULL) {
+    FZMemory::allocationFailed();
+    return NULL;
+  }
+  // same memory, now sampled as a swizzled w by h texture
+  #ifdef __vita__
+    sceGxmTextureInitSwizzled(&texture->gxm_tex, vita2d_texture_get_datap(texture),
+      sceGxmTextureGetFormat(&texture->gxm_tex), w, h, 0);
+  #else
+    vita2d_soft_set_tiled(texture, w, h);
+  #endif
+  FZMemory::add(FZ_MEM_TEXTURE, FZTexture::getVitaTextureSize(texture));
+  return texture;
+}
+
+vita2d_texture* _vita2d_create_page_texture(const char *pixels, unsigned int w, unsigned int h)
+{
+  size_t linear = (size_t)w * h * 4;
+  if (FZImage::getTiledSize(w, h, 4) * 100 <= linear * (100 + BK_TILED_MAX_WASTE)) {
+    vita2d_texture *texture = _vita2d_create_counted_tiled_texture(w, h);
+    if (texture != NULL)
+      FZImage::tile(pixels, w * 4, (char*)vita2d_texture_get_datap(texture), w, h, 4);
+    return texture;
+  }
+  vita2d_texture *texture = _vita2d_create_counted_texture(w, h);
+  if (texture != NULL) {
+    char *dst = (char*)vita2d_texture_get_datap(texture);
+    unsigned int stride = vita2d_texture_get_stride(texture);
+    for (unsigned int y = 0; y < h; ++y)
+      memcpy(dst + y * stride, pixels + (size_t)y * w * 4, w * 4);
+  }
+  return texture;
+}
 #endif
 
 const char *get_ext (const char *fspec) {
@@ -57,6 +119,33 @@ const char *get_ext (const char *fspec) {
     return e;
 }
 
+int read_file_header(const char* path, char* header, int len) {
+  memset((void*)header, 0, len);
+
+  #ifdef __vita__
+    int fd = sceIoOpen(path, SCE_O_RDONLY, 0777);
+    if (fd < 0)
+      return -1;
+
+    int n = sceIoRead(fd, header, len);
+    sceIoClose(fd);
+  #else
+    FILE* f = fopen(path, "rb");
+    if (f == NULL)
+      return -1;
+
+    int n = fread(header, 1, len, f);
+    fclose(f);
+  #endif
+
+  return n;
+}
+
+double get_time_ms() {
+  return std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 // Put this in bookmark class?
 float get_or(std::map<std::string, float> m, std::string key, float default_value) {
   auto it = m.find(key);
@@ -9,13 +9,27 @@
 
 #include <mupdf/fitz.h>
 
-#ifdef __vita__
+#if defined(__vita__) || defined(HEADLESS)
 #include <vita2d.h>
 
+#define BK_TILED_MAX_WASTE 30
+
 vita2d_texture* _vita2d_load_pixmap_generic(fz_pixmap *pixmap);
+// vita2d textures counted under FZ_MEM_TEXTURE
+vita2d_texture* _vita2d_create_counted_texture(unsigned int w, unsigned int h);
+void _vita2d_free_counted_texture(vita2d_texture *texture);
+// w by h, in the GXM swizzled layout of FZImage::tile()
+vita2d_texture* _vita2d_create_counted_tiled_texture(unsigned int w, unsigned int h);
+// counted texture from w by h RGBA rows, tiled unless padding the sides
+// to powers of two would waste more than BK_TILED_MAX_WASTE percent
+vita2d_texture* _vita2d_create_page_texture(const char *pixels, unsigned int w, unsigned int h);
 #endif
 
 const char *get_ext (const char *fspec);
+// reads up to len bytes from the start of path; returns bytes read or -1
+int read_file_header(const char* path, char* header, int len);
+// monotonic clock in milliseconds, for timing
+double get_time_ms();
 float get_or(std::map<std::string, float>, std::string k, float default_value);
 
 #endif
\ No newline at end of file
@@ -28,6 +28,9 @@ add_executable(bookr-modern
 
   src/graphics/fzfontvita.cpp
   src/filetypes/bkmudocument.cpp
+  src/filetypes/bkmustrip.cpp
+  src/filetypes/bkmuspread.cpp
+  src/filetypes/bkmureflow.cpp
 )
 
 # Library to link to (drop the -l prefix). This will mostly be stubs.
@@ -61,6 +61,15 @@ link_directories(
 )
 
 
+## Optional viewers
+# DjVu needs djvulibre built for the Vita
+find_library(DJVULIBRE_LIBRARY djvulibre)
+IF(DJVULIBRE_LIBRARY)
+  add_definitions(-DBOOKR_DJVU)
+  set(VIEWER_SRCS ${VIEWER_SRCS} src/filetypes/bkdjvu.cpp)
+  set(VIEWER_LIBS ${VIEWER_LIBS} ${DJVULIBRE_LIBRARY})
+ENDIF()
+
 ## Build and link
 # Add all the files needed to compile here
 add_executable(bookr-mod-vita
@@ -70,15 +79,21 @@ add_executable(bookr-mod-vita
   data/fonts/res_uifont.c
 
   src/graphics/fzscreenvita.cpp
+  src/graphics/fzimagepng.cpp
 
   src/filetypes/bkmudocument.cpp
+  src/filetypes/bkmustrip.cpp
+  src/filetypes/bkmuspread.cpp
+  src/filetypes/bkmureflow.cpp
   src/graphics/fzfontvita.cpp
+  ${VIEWER_SRCS}
 )
 
 # Library to link to (drop the -l prefix). This will mostly be stubs.
 #-lpsp2shell -lSceSysmodule_stub -lSceNet_stub \ -lSceNetCtl_stub -lSceKernel_stub -lScePower_stub -lSceAppMgr_stub
 #mupdf -ldjvulibre -lraster -lworld -lfonts -lstream -lbase -lm
 target_link_libraries(bookr-mod-vita
+  ${VIEWER_LIBS}
   vita2d
   mupdf
   mupdf-third